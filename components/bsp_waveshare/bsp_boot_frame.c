@@ -0,0 +1,77 @@
+#include "bsp_waveshare.h"
+#include "deck_area.h"
+#include "deck_bootframe.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+
+/* Rows per window. Two windows alternate, one is sent by DMA while the next
+ * is decoded from the mapped partition.
+ */
+#define BOOT_FRAME_ROWS 16
+
+esp_err_t bsp_lcd_draw_boot_frame(bsp_handles_t *handles) {
+  const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, DECK_BOOTFRAME_SUBTYPE, NULL);
+  if (part == NULL)
+    return ESP_ERR_NOT_FOUND;
+
+  deck_bootframe_header_t hdr;
+  esp_err_t err = esp_partition_read(part, 0, &hdr, sizeof(hdr));
+  if (err != ESP_OK)
+    return err;
+  if (hdr.magic != DECK_BOOTFRAME_MAGIC ||
+      hdr.size > part->size - sizeof(hdr))
+    return ESP_ERR_NOT_FOUND;
+  if (hdr.width != handles->lcd_width || hdr.height != handles->lcd_height ||
+      hdr.orientation != lcd_get_orientation())
+    return ESP_ERR_INVALID_STATE;
+
+  const void *map;
+  esp_partition_mmap_handle_t map_handle;
+  err = esp_partition_mmap(part, 0, sizeof(hdr) + hdr.size,
+                           ESP_PARTITION_MMAP_DATA, &map, &map_handle);
+  if (err != ESP_OK)
+    return err;
+  const uint8_t *rle = (const uint8_t *)map + sizeof(hdr);
+  if (esp_rom_crc32_le(0, rle, hdr.size) != hdr.crc32) {
+    esp_partition_munmap(map_handle);
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  size_t window_px = hdr.width * BOOT_FRAME_ROWS;
+  uint16_t *buf = heap_caps_malloc(window_px * sizeof(uint16_t) * 2,
+                                   MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  if (buf == NULL) {
+    esp_partition_munmap(map_handle);
+    return ESP_ERR_NO_MEM;
+  }
+
+  deck_rle_reader_t reader;
+  deck_rle_reader_init(&reader, rle, hdr.size);
+  int64_t start = esp_timer_get_time();
+  int half = 0;
+  for (int y = 0; y < hdr.height; y += BOOT_FRAME_ROWS, half ^= 1) {
+    int rows = hdr.height - y < BOOT_FRAME_ROWS ? hdr.height - y
+                                                : BOOT_FRAME_ROWS;
+    uint16_t *px = buf + half * window_px;
+    if (deck_rle_read(&reader, px, hdr.width * rows) != hdr.width * rows) {
+      err = ESP_ERR_INVALID_SIZE;
+      break;
+    }
+    // The other half is still on the bus, the rows after these go there
+    lcd_io_wait_done(handles->lcd_io);
+    lcd_io_draw_window(handles->lcd_io, 0, y, hdr.width, y + rows, px);
+  }
+  lcd_io_wait_done(handles->lcd_io);
+  heap_caps_free(buf);
+  esp_partition_munmap(map_handle);
+
+  if (err == ESP_OK)
+    ESP_LOGI("LCD", "Boot frame drawn in %lld us, %lu bytes",
+             esp_timer_get_time() - start, (unsigned long)hdr.size);
+  return err;
+}
@@ -24,17 +24,8 @@ esp_err_t bsp_lcd_init(bsp_config_t *config, bsp_handles_t *handles) {
     return err;
   }
 
-  esp_lcd_panel_io_spi_config_t io_config = {
-      .dc_gpio_num = config->lcd_dc,
-      .cs_gpio_num = config->lcd_cs,
-      .pclk_hz = 40 * 1000 * 1000,
-      .lcd_cmd_bits = 8,
-      .lcd_param_bits = 8,
-      .spi_mode = 0,
-      .trans_queue_depth = 10,
-  };
-  err = esp_lcd_new_panel_io_spi((esp_lcd_spi_bus_handle_t)config->lcd_host,
-                                 &io_config, &handles->lcd_io);
+  err = bsp_lcd_io_new(config, 40 * 1000 * 1000, buscfg.max_transfer_sz,
+                       &handles->lcd_io);
   if (err != ESP_OK) {
     ESP_LOGE("LCD IO", "Failed to create LCD panel IO: %s",
              esp_err_to_name(err));
@@ -62,7 +53,8 @@ esp_err_t bsp_lcd_init(bsp_config_t *config, bsp_handles_t *handles) {
     return err;
   }
 
+  // Dark until something was drawn, frame memory holds noise after reset
   gpio_set_direction(config->lcd_bl, GPIO_MODE_OUTPUT);
-  gpio_set_level(config->lcd_bl, 1);
+  gpio_set_level(config->lcd_bl, 0);
   return ESP_OK;
 }
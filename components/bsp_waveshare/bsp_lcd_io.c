@@ -0,0 +1,423 @@
+#include "bsp_waveshare.h"
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_lcd_panel_io_interface.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LCD_CMD_CASET 0x2A
+#define LCD_CMD_RASET 0x2B
+#define LCD_CMD_RAMWR 0x2C
+
+/* Transactions in flight at most, also the SPI queue depth */
+#define LCD_IO_POOL 128
+/* Windows up to this size are copied into a batch, larger ones are sent from
+ * the caller's buffer
+ */
+#define LCD_IO_STAGE_WINDOW_MAX 2048
+#define LCD_IO_STAGE_SIZE (8 * 1024)
+#define LCD_IO_BATCH_WINDOWS 10
+/* Log the overhead statistics every this many batches */
+#define LCD_IO_REPORT_BATCHES 1000
+
+#define TRANS_DC (1 << 0)     // data, DC high
+#define TRANS_FIRST (1 << 1)  // first transaction of a window or batch
+#define TRANS_LAST (1 << 2)   // last transaction of a window or batch
+#define TRANS_NOTIFY (1 << 3) // call on_color_trans_done when done
+#define TRANS_BATCH (1 << 4)  // part of a batch of staged windows
+
+typedef struct lcd_io_t lcd_io_t;
+
+typedef struct {
+  spi_transaction_t base;
+  lcd_io_t *io;
+  uint8_t flags;
+  uint8_t windows; // on TRANS_LAST, windows covered by the group
+  uint32_t bytes;  // on TRANS_LAST, bytes sent by the group
+} lcd_trans_t;
+
+typedef struct {
+  uint16_t x1, y1, x2, y2;
+  uint32_t offset;
+  uint32_t size;
+} staged_window_t;
+
+typedef struct {
+  uint8_t *buf;
+  size_t used;
+  uint32_t last_ticket; // transactions up to this ticket read the buffer
+  staged_window_t windows[LCD_IO_BATCH_WINDOWS];
+  size_t count;
+} stage_t;
+
+/* ST7796 panel IO on a dedicated SPI device. Every transaction is queued,
+ * commands and their parameters travel in the transaction itself
+ * (SPI_TRANS_USE_TXDATA) and DC is driven from the pre-transaction callback,
+ * so a window never waits for the CPU between its command and pixel phases.
+ */
+struct lcd_io_t {
+  esp_lcd_panel_io_t base;
+  spi_device_handle_t spi;
+  int dc_gpio;
+  uint32_t pclk_hz;
+  size_t max_transfer;
+  esp_lcd_panel_io_color_trans_done_cb_t on_color_trans_done;
+  void *user_ctx;
+
+  lcd_trans_t pool[LCD_IO_POOL];
+  uint32_t queued;             // tickets handed out, a ticket per transaction
+  uint32_t reaped;             // results collected from the SPI driver
+  volatile uint32_t completed; // transactions finished, updated from the ISR
+  volatile uint32_t notify_ticket;
+  portMUX_TYPE lock;
+
+  stage_t stages[2];
+  int stage;
+
+  // Overhead accounting: the ISR sums bus time and bytes under the lock,
+  // lcd_io_get_stats divides
+  int64_t group_start_us;
+  lcd_io_stats_t stats;
+  uint64_t batched_busy_us;
+  uint64_t batched_bytes;
+  uint64_t direct_busy_us;
+  uint64_t direct_bytes;
+  uint32_t direct_windows;
+};
+
+static void IRAM_ATTR lcd_io_pre_trans_cb(spi_transaction_t *t) {
+  lcd_trans_t *trans = __containerof(t, lcd_trans_t, base);
+  gpio_set_level(trans->io->dc_gpio, trans->flags & TRANS_DC);
+  if (trans->flags & TRANS_FIRST)
+    trans->io->group_start_us = esp_timer_get_time();
+}
+
+static void IRAM_ATTR lcd_io_post_trans_cb(spi_transaction_t *t) {
+  lcd_trans_t *trans = __containerof(t, lcd_trans_t, base);
+  lcd_io_t *io = trans->io;
+
+  int64_t busy_us = 0;
+  if (trans->flags & TRANS_LAST)
+    busy_us = esp_timer_get_time() - io->group_start_us;
+
+  bool notify = trans->flags & TRANS_NOTIFY;
+  portENTER_CRITICAL_ISR(&io->lock);
+  if (trans->flags & TRANS_LAST) {
+    if (trans->flags & TRANS_BATCH) {
+      io->batched_busy_us += busy_us;
+      io->batched_bytes += trans->bytes;
+    } else {
+      io->direct_busy_us += busy_us;
+      io->direct_bytes += trans->bytes;
+      io->direct_windows += trans->windows;
+    }
+  }
+  io->completed++;
+  if (io->completed == io->notify_ticket) {
+    io->notify_ticket = 0;
+    notify = true;
+  }
+  portEXIT_CRITICAL_ISR(&io->lock);
+
+  if (notify && io->on_color_trans_done != NULL)
+    io->on_color_trans_done(&io->base, NULL, io->user_ctx);
+}
+
+static void lcd_io_reap_one(lcd_io_t *io) {
+  spi_transaction_t *done;
+  spi_device_get_trans_result(io->spi, &done, portMAX_DELAY);
+  io->reaped++;
+}
+
+static void lcd_io_reap_until(lcd_io_t *io, uint32_t ticket) {
+  while ((int32_t)(io->reaped - ticket) < 0)
+    lcd_io_reap_one(io);
+}
+
+/* Queue one transaction. windows and bytes describe the group it closes when
+ * flags has TRANS_LAST; they are set before queueing since the ISR may run
+ * right away.
+ */
+static uint32_t lcd_io_queue(lcd_io_t *io, const void *data, size_t size,
+                             uint8_t flags, uint8_t windows, uint32_t bytes) {
+  while (io->queued - io->reaped >= LCD_IO_POOL)
+    lcd_io_reap_one(io);
+
+  lcd_trans_t *trans = &io->pool[io->queued % LCD_IO_POOL];
+  memset(trans, 0, sizeof(*trans));
+  trans->io = io;
+  trans->flags = flags;
+  trans->windows = windows;
+  trans->bytes = bytes;
+  trans->base.length = size * 8;
+  if (size <= 4) {
+    trans->base.flags = SPI_TRANS_USE_TXDATA;
+    memcpy(trans->base.tx_data, data, size);
+  } else {
+    trans->base.tx_buffer = data;
+  }
+
+  io->queued++;
+  io->stats.transactions++;
+  spi_device_queue_trans(io->spi, &trans->base, portMAX_DELAY);
+  return io->queued;
+}
+
+static uint32_t lcd_io_queue_cmd(lcd_io_t *io, int cmd, const void *param,
+                                 size_t param_size, uint8_t flags) {
+  uint8_t cmd_byte = cmd;
+  uint32_t ticket = lcd_io_queue(io, &cmd_byte, 1, flags & TRANS_FIRST, 0, 0);
+  if (param_size > 0)
+    ticket = lcd_io_queue(io, param, param_size, TRANS_DC, 0, 0);
+  return ticket;
+}
+
+/* Pixel data, split into chunks the SPI driver can move in one transfer. The
+ * last chunk gets flags and the group accounting.
+ */
+static uint32_t lcd_io_queue_color(lcd_io_t *io, const uint8_t *data,
+                                   size_t size, uint8_t flags, uint8_t windows,
+                                   uint32_t bytes) {
+  uint32_t ticket = 0;
+  while (size > 0) {
+    size_t chunk = size > io->max_transfer ? io->max_transfer : size;
+    size -= chunk;
+    if (size == 0) {
+      ticket = lcd_io_queue(io, data, chunk, TRANS_DC | flags, windows, bytes);
+    } else {
+      ticket = lcd_io_queue(io, data, chunk, TRANS_DC, 0, 0);
+    }
+    data += chunk;
+  }
+  return ticket;
+}
+
+static void lcd_io_queue_window_cmds(lcd_io_t *io, int x1, int y1, int x2,
+                                     int y2, uint8_t flags) {
+  uint8_t caset[] = {x1 >> 8, x1 & 0xFF, (x2 - 1) >> 8, (x2 - 1) & 0xFF};
+  uint8_t raset[] = {y1 >> 8, y1 & 0xFF, (y2 - 1) >> 8, (y2 - 1) & 0xFF};
+  lcd_io_queue_cmd(io, LCD_CMD_CASET, caset, 4, flags);
+  lcd_io_queue_cmd(io, LCD_CMD_RASET, raset, 4, 0);
+  lcd_io_queue_cmd(io, LCD_CMD_RAMWR, NULL, 0, 0);
+}
+
+static esp_err_t lcd_io_tx_param(esp_lcd_panel_io_t *base, int lcd_cmd,
+                                 const void *param, size_t param_size) {
+  lcd_io_t *io = __containerof(base, lcd_io_t, base);
+  if (param_size > 4) {
+    // Parameters not held in the transaction must outlive the call
+    lcd_io_queue_cmd(io, lcd_cmd, NULL, 0, 0);
+    lcd_io_reap_until(io,
+                      lcd_io_queue(io, param, param_size, TRANS_DC, 0, 0));
+    return ESP_OK;
+  }
+  lcd_io_queue_cmd(io, lcd_cmd, param, param_size, 0);
+  return ESP_OK;
+}
+
+static esp_err_t lcd_io_tx_color(esp_lcd_panel_io_t *base, int lcd_cmd,
+                                 const void *color, size_t color_size) {
+  lcd_io_t *io = __containerof(base, lcd_io_t, base);
+  lcd_io_queue_cmd(io, lcd_cmd, NULL, 0, 0);
+  lcd_io_queue_color(io, color, color_size, TRANS_NOTIFY, 0, 0);
+  return ESP_OK;
+}
+
+static esp_err_t lcd_io_register_event_callbacks(
+    esp_lcd_panel_io_t *base, const esp_lcd_panel_io_callbacks_t *cbs,
+    void *user_ctx) {
+  lcd_io_t *io = __containerof(base, lcd_io_t, base);
+  io->on_color_trans_done = cbs->on_color_trans_done;
+  io->user_ctx = user_ctx;
+  return ESP_OK;
+}
+
+static esp_err_t lcd_io_del(esp_lcd_panel_io_t *base) {
+  lcd_io_t *io = __containerof(base, lcd_io_t, base);
+  lcd_io_reap_until(io, io->queued);
+  spi_device_release_bus(io->spi);
+  spi_bus_remove_device(io->spi);
+  heap_caps_free(io->stages[0].buf);
+  heap_caps_free(io->stages[1].buf);
+  free(io);
+  return ESP_OK;
+}
+
+esp_err_t bsp_lcd_io_new(bsp_config_t *config, int pclk_hz,
+                         size_t max_transfer,
+                         esp_lcd_panel_io_handle_t *ret_io) {
+  lcd_io_t *io = heap_caps_calloc(1, sizeof(lcd_io_t), MALLOC_CAP_INTERNAL);
+  if (io == NULL)
+    return ESP_ERR_NO_MEM;
+
+  for (int i = 0; i < 2; i++) {
+    io->stages[i].buf = heap_caps_malloc(LCD_IO_STAGE_SIZE, MALLOC_CAP_DMA);
+    if (io->stages[i].buf == NULL) {
+      heap_caps_free(io->stages[0].buf);
+      free(io);
+      return ESP_ERR_NO_MEM;
+    }
+  }
+
+  gpio_config_t dc_conf = {
+      .mode = GPIO_MODE_OUTPUT,
+      .pin_bit_mask = 1ULL << config->lcd_dc,
+  };
+  esp_err_t err = gpio_config(&dc_conf);
+
+  spi_device_interface_config_t dev_config = {
+      .clock_speed_hz = pclk_hz,
+      .mode = 0,
+      .spics_io_num = config->lcd_cs,
+      .queue_size = LCD_IO_POOL,
+      .pre_cb = lcd_io_pre_trans_cb,
+      .post_cb = lcd_io_post_trans_cb,
+  };
+  if (err == ESP_OK)
+    err = spi_bus_add_device(config->lcd_host, &dev_config, &io->spi);
+  if (err != ESP_OK) {
+    ESP_LOGE("LCD IO", "Failed to add SPI device: %s", esp_err_to_name(err));
+    heap_caps_free(io->stages[0].buf);
+    heap_caps_free(io->stages[1].buf);
+    free(io);
+    return err;
+  }
+  // The LCD is the only device on its bus, keep it to skip the bus lock on
+  // every transaction
+  spi_device_acquire_bus(io->spi, portMAX_DELAY);
+
+  io->dc_gpio = config->lcd_dc;
+  io->pclk_hz = pclk_hz;
+  io->max_transfer = max_transfer;
+  io->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+  io->base.tx_param = lcd_io_tx_param;
+  io->base.tx_color = lcd_io_tx_color;
+  io->base.del = lcd_io_del;
+  io->base.register_event_callbacks = lcd_io_register_event_callbacks;
+  *ret_io = &io->base;
+  return ESP_OK;
+}
+
+static void lcd_io_report(lcd_io_t *io) {
+  lcd_io_stats_t stats;
+  lcd_io_get_stats(&io->base, &stats);
+  ESP_LOGI("LCD IO",
+           "%" PRIu32 " windows (%" PRIu32 " batched), overhead per window "
+           "%" PRIu32 " us direct, %" PRIu32 " us batched",
+           stats.windows, stats.staged, stats.direct_overhead_us,
+           stats.batched_overhead_us);
+}
+
+void lcd_io_commit(esp_lcd_panel_io_handle_t handle) {
+  lcd_io_t *io = __containerof(handle, lcd_io_t, base);
+  stage_t *stage = &io->stages[io->stage];
+  if (stage->count == 0)
+    return;
+
+  // 3 commands and 8 parameter bytes per window
+  uint32_t bytes = 0;
+  for (size_t i = 0; i < stage->count; i++)
+    bytes += stage->windows[i].size + 11;
+
+  for (size_t i = 0; i < stage->count; i++) {
+    staged_window_t *w = &stage->windows[i];
+    bool last = i == stage->count - 1;
+    lcd_io_queue_window_cmds(io, w->x1, w->y1, w->x2, w->y2,
+                             i == 0 ? TRANS_FIRST : 0);
+    lcd_io_queue_color(io, stage->buf + w->offset, w->size,
+                       last ? TRANS_LAST | TRANS_BATCH : 0, stage->count,
+                       bytes);
+  }
+  stage->last_ticket = io->queued;
+
+  io->stats.batches++;
+  stage->count = 0;
+  stage->used = 0;
+  io->stage ^= 1;
+
+  if (io->stats.batches % LCD_IO_REPORT_BATCHES == 0)
+    lcd_io_report(io);
+}
+
+bool lcd_io_draw_window(esp_lcd_panel_io_handle_t handle, int x1, int y1,
+                        int x2, int y2, const void *data) {
+  lcd_io_t *io = __containerof(handle, lcd_io_t, base);
+  size_t size = (x2 - x1) * (y2 - y1) * sizeof(uint16_t);
+  io->stats.windows++;
+  io->stats.bytes += size;
+
+  stage_t *stage = &io->stages[io->stage];
+  if (size <= LCD_IO_STAGE_WINDOW_MAX) {
+    if (stage->used + size > LCD_IO_STAGE_SIZE ||
+        stage->count == LCD_IO_BATCH_WINDOWS) {
+      lcd_io_commit(handle);
+      stage = &io->stages[io->stage];
+    }
+    if (stage->count == 0)
+      lcd_io_reap_until(io, stage->last_ticket); // DMA may still read it
+
+    stage->windows[stage->count++] = (staged_window_t){
+        .x1 = x1, .y1 = y1, .x2 = x2, .y2 = y2, .offset = stage->used,
+        .size = size};
+    memcpy(stage->buf + stage->used, data, size);
+    stage->used += (size + 3) & ~3; // keep DMA buffers word aligned
+    io->stats.staged++;
+    return true;
+  }
+
+  // Keep windows in order, staged ones first
+  lcd_io_commit(handle);
+  lcd_io_queue_window_cmds(io, x1, y1, x2, y2, TRANS_FIRST);
+  lcd_io_queue_color(io, data, size, TRANS_LAST, 1, size + 11);
+  return false;
+}
+
+void lcd_io_wait_done(esp_lcd_panel_io_handle_t handle) {
+  lcd_io_t *io = __containerof(handle, lcd_io_t, base);
+  lcd_io_commit(handle);
+  lcd_io_reap_until(io, io->queued);
+}
+
+bool lcd_io_notify_when_done(esp_lcd_panel_io_handle_t handle) {
+  lcd_io_t *io = __containerof(handle, lcd_io_t, base);
+  bool pending;
+  portENTER_CRITICAL(&io->lock);
+  pending = io->completed != io->queued;
+  if (pending)
+    io->notify_ticket = io->queued;
+  portEXIT_CRITICAL(&io->lock);
+  return pending;
+}
+
+/* Time the bus was busy per window beyond moving the bits of the windows */
+static uint32_t overhead_per_window(uint64_t busy_us, uint64_t bytes,
+                                    uint32_t windows, uint32_t pclk_hz) {
+  if (windows == 0)
+    return 0;
+  uint64_t ideal_us = bytes * 8 * 1000000 / pclk_hz;
+  return busy_us > ideal_us ? (busy_us - ideal_us) / windows : 0;
+}
+
+void lcd_io_get_stats(esp_lcd_panel_io_handle_t handle, lcd_io_stats_t *out) {
+  lcd_io_t *io = __containerof(handle, lcd_io_t, base);
+  portENTER_CRITICAL(&io->lock);
+  *out = io->stats;
+  uint64_t batched_busy_us = io->batched_busy_us;
+  uint64_t batched_bytes = io->batched_bytes;
+  uint64_t direct_busy_us = io->direct_busy_us;
+  uint64_t direct_bytes = io->direct_bytes;
+  uint32_t direct_windows = io->direct_windows;
+  portEXIT_CRITICAL(&io->lock);
+
+  out->direct_overhead_us = overhead_per_window(
+      direct_busy_us, direct_bytes, direct_windows, io->pclk_hz);
+  out->batched_overhead_us = overhead_per_window(
+      batched_busy_us, batched_bytes, out->staged, io->pclk_hz);
+}
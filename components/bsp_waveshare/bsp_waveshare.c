@@ -8,6 +8,11 @@
 #include "esp_lcd_types.h"
 #include "esp_log.h"
 
+#define LCD_CMD_VSCRDEF 0x33
+#define LCD_CMD_VSCRSADD 0x37
+
+static enum Orientation current_orientation = PORTRAIT;
+
 esp_err_t bsp_init(bsp_config_t *config, bsp_handles_t *handles) {
   esp_err_t err = bsp_lcd_init(config, handles);
   if (err != ESP_OK) {
@@ -15,6 +20,7 @@ esp_err_t bsp_init(bsp_config_t *config, bsp_handles_t *handles) {
     return err;
   }
   ESP_LOGI("BSP", "✓ LCD panel initialized successfully");
+  lcd_backlight_on(config->lcd_bl);
 
   err = bsp_touch_init(config, handles);
   if (err != ESP_OK) {
@@ -29,6 +35,7 @@ esp_err_t bsp_init(bsp_config_t *config, bsp_handles_t *handles) {
 
 void lcd_set_orientation(esp_lcd_panel_handle_t *panel_handle,
                          enum Orientation orientation) {
+  current_orientation = orientation;
   switch (orientation) {
   case PORTRAIT:
     ESP_ERROR_CHECK(esp_lcd_panel_swap_xy(*panel_handle, false));
@@ -52,5 +59,59 @@ void lcd_set_orientation(esp_lcd_panel_handle_t *panel_handle,
   }
 }
 
+enum Orientation lcd_get_orientation(void) { return current_orientation; }
+
+void lcd_get_scroll_axis(enum Orientation orientation, bool *along_x,
+                         bool *reversed) {
+  // Scrolling follows frame memory lines, which are screen rows without
+  // swap_xy and screen columns with it. mirror_y (MADCTL MY) reverses them,
+  // see lcd_set_orientation.
+  switch (orientation) {
+  case PORTRAIT:
+    *along_x = false;
+    *reversed = true;
+    break;
+  case LANDSCAPE:
+    *along_x = true;
+    *reversed = true;
+    break;
+  case INVERTED_PORTRAIT:
+    *along_x = false;
+    *reversed = false;
+    break;
+  case INVERTED_LANDSCAPE:
+  default:
+    *along_x = true;
+    *reversed = false;
+    break;
+  }
+}
+
+esp_err_t lcd_set_scroll_area(esp_lcd_panel_io_handle_t io_handle,
+                              uint16_t top_fixed, uint16_t scroll_lines,
+                              uint16_t bottom_fixed) {
+  if (top_fixed + scroll_lines + bottom_fixed != LCD_SCROLL_LINES) {
+    ESP_LOGE("LCD", "Scroll area %d+%d+%d does not cover %d lines", top_fixed,
+             scroll_lines, bottom_fixed, LCD_SCROLL_LINES);
+    return ESP_ERR_INVALID_ARG;
+  }
+  return esp_lcd_panel_io_tx_param(io_handle, LCD_CMD_VSCRDEF,
+                                   (uint8_t[]){
+                                       top_fixed >> 8,
+                                       top_fixed & 0xFF,
+                                       scroll_lines >> 8,
+                                       scroll_lines & 0xFF,
+                                       bottom_fixed >> 8,
+                                       bottom_fixed & 0xFF,
+                                   },
+                                   6);
+}
+
+esp_err_t lcd_set_scroll_start(esp_lcd_panel_io_handle_t io_handle,
+                               uint16_t line) {
+  return esp_lcd_panel_io_tx_param(io_handle, LCD_CMD_VSCRSADD,
+                                   (uint8_t[]){line >> 8, line & 0xFF}, 2);
+}
+
 void lcd_backlight_on(int lcd_bl_gpio) { gpio_set_level(lcd_bl_gpio, 1); }
 void lcd_backlight_off(int lcd_bl_gpio) { gpio_set_level(lcd_bl_gpio, 0); }
@@ -58,10 +58,89 @@ typedef struct {
   uint16_t lcd_height;
 } bsp_handles_t;
 
+/* bsp_lcd_init leaves the backlight off, bsp_init turns it on */
 esp_err_t bsp_init(bsp_config_t *config, bsp_handles_t *handles);
 esp_err_t bsp_lcd_init(bsp_config_t *config, bsp_handles_t *handles);
 esp_err_t bsp_touch_init(bsp_config_t *config, bsp_handles_t *handles);
 
+/* LCD panel IO statistics
+ * - windows: windows drawn with lcd_io_draw_window
+ * - staged: windows copied into a batch
+ * - batches: batches sent
+ * - transactions: SPI transactions queued
+ * - bytes: pixel bytes drawn
+ * - direct_overhead_us: average bus time per window sent on its own beyond
+ *   the time needed to clock its bytes
+ * - batched_overhead_us: the same per window sent in a batch
+ */
+typedef struct {
+  uint32_t windows;
+  uint32_t staged;
+  uint32_t batches;
+  uint32_t transactions;
+  uint64_t bytes;
+  uint32_t direct_overhead_us;
+  uint32_t batched_overhead_us;
+} lcd_io_stats_t;
+
+/* Function to create the SPI panel IO of the ST7796. Commands, parameters
+ * and pixels are all queued transactions, and small windows drawn with
+ * lcd_io_draw_window are batched. Implements esp_lcd_panel_io_t so the
+ * ST7796 panel driver runs on top of it.
+ * Parameters:
+ * - config: Board configuration (host, CS and DC pins).
+ * - pclk_hz: SPI clock.
+ * - max_transfer: Largest single transfer of the SPI bus.
+ * - ret_io: Returned panel IO handle.
+ */
+esp_err_t bsp_lcd_io_new(bsp_config_t *config, int pclk_hz,
+                         size_t max_transfer,
+                         esp_lcd_panel_io_handle_t *ret_io);
+
+/* Function to draw an RGB565 window through the panel IO created by
+ * bsp_lcd_io_new, bypassing the panel driver. Small windows are copied into
+ * the current batch and sent with lcd_io_commit; larger ones are queued from
+ * data directly after the pending batch.
+ * Parameters:
+ * - io_handle: Panel IO created by bsp_lcd_io_new.
+ * - x1, y1: Start of the window.
+ * - x2, y2: End of the window (exclusive).
+ * - data: Pixels of the window.
+ * Returns true when data was copied and can be reused right away, false when
+ * it is read by DMA until the transfer is done.
+ */
+bool lcd_io_draw_window(esp_lcd_panel_io_handle_t io_handle, int x1, int y1,
+                        int x2, int y2, const void *data);
+
+/* Function to send the windows batched so far */
+void lcd_io_commit(esp_lcd_panel_io_handle_t io_handle);
+
+/* Function to send the pending batch and wait until everything queued so
+ * far has been sent, after which the buffers of all windows drawn can be
+ * reused. Only for the task drawing the windows.
+ */
+void lcd_io_wait_done(esp_lcd_panel_io_handle_t io_handle);
+
+/* Function to request on_color_trans_done once everything queued so far has
+ * been sent. Returns false, and does not call it, if the bus is already idle.
+ */
+bool lcd_io_notify_when_done(esp_lcd_panel_io_handle_t io_handle);
+
+void lcd_io_get_stats(esp_lcd_panel_io_handle_t io_handle,
+                      lcd_io_stats_t *stats);
+
+/* Function to draw the boot frame (deck_bootframe.h) saved in the flash
+ * partition, streamed through lcd_io_draw_window while the next rows are
+ * decoded. Call it after lcd_set_orientation and before LVGL draws.
+ * Parameters:
+ * - handles: Handles of the initialized LCD panel, lcd_width and lcd_height
+ *   in the current orientation.
+ * Returns ESP_ERR_NOT_FOUND without a saved frame, ESP_ERR_INVALID_STATE if
+ * it was saved for another orientation or resolution, an error when it could
+ * not be drawn completely.
+ */
+esp_err_t bsp_lcd_draw_boot_frame(bsp_handles_t *handles);
+
 /* Function to set the LCD orientation. This sends the appropriate command to
  * the LCD panel to change its orientation based on the provided enum value.
  * Parameters:
@@ -72,6 +151,48 @@ esp_err_t bsp_touch_init(bsp_config_t *config, bsp_handles_t *handles);
 void lcd_set_orientation(esp_lcd_panel_handle_t *panel_handle,
                          enum Orientation orientation);
 
+/* Returns the orientation last set with lcd_set_orientation (PORTRAIT until
+ * it is called).
+ */
+enum Orientation lcd_get_orientation(void);
+
+/* Number of frame memory lines the ST7796 can scroll (its gate lines). The
+ * scroll axis is the panel's native vertical axis, which is the screen's X
+ * axis in landscape orientations.
+ */
+#define LCD_SCROLL_LINES 480
+
+/* Function to describe the hardware scroll axis for an orientation.
+ * Parameters:
+ * - orientation: Orientation as given to lcd_set_orientation.
+ * - along_x: Set to true when scrolling moves the image horizontally.
+ * - reversed: Set to true when screen coordinates along the axis run opposite
+ *   to frame memory lines (MADCTL MY set).
+ */
+void lcd_get_scroll_axis(enum Orientation orientation, bool *along_x,
+                         bool *reversed);
+
+/* Function to define the vertical scrolling area (VSCRDEF). The three parts
+ * are in frame memory lines and must add up to LCD_SCROLL_LINES.
+ * Parameters:
+ * - io_handle: Handle of the LCD panel IO.
+ * - top_fixed: Lines at the start of memory that do not scroll.
+ * - scroll_lines: Lines of the scrolling area.
+ * - bottom_fixed: Lines at the end of memory that do not scroll.
+ */
+esp_err_t lcd_set_scroll_area(esp_lcd_panel_io_handle_t io_handle,
+                              uint16_t top_fixed, uint16_t scroll_lines,
+                              uint16_t bottom_fixed);
+
+/* Function to set the vertical scroll start address (VSCRSADD), the frame
+ * memory line shown at the first line of the scrolling area.
+ * Parameters:
+ * - io_handle: Handle of the LCD panel IO.
+ * - line: Frame memory line, top_fixed <= line < top_fixed + scroll_lines.
+ */
+esp_err_t lcd_set_scroll_start(esp_lcd_panel_io_handle_t io_handle,
+                               uint16_t line);
+
 /* Functions to control the LCD backlight. These functions set the specified
  * GPIO pin to turn the backlight on or off. Parameters:
  * - lcd_bl_gpio: The GPIO number connected to the LCD backlight control.
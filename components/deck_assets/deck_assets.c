@@ -0,0 +1,457 @@
+#include "deck_assets.h"
+#include "deck_hid.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ASSETS_SECTOR 4096
+
+/* USB update protocol, feature report DECK_ASSETS_HID_REPORT (63 bytes):
+ * - SET [0] = ASSETS_OP_BEGIN, [1..4] container size
+ * - SET [0] = ASSETS_OP_DATA, [1..4] offset, [5] length, [6..] data
+ * - SET [0] = ASSETS_OP_COMMIT
+ * - GET: [0] writing, [1..4] result of the last operation (esp_err_t),
+ *   [5..8] bytes written, [9..12] partition size, [13] operations queued
+ * A sector erase takes tens of milliseconds, too long for the USB task:
+ * operations are queued and applied by the assets task, the status tells
+ * their result once [13] dropped to 0. The host keeps at most
+ * ASSETS_QUEUE_LEN of them queued, one arriving at a full queue fails the
+ * update.
+ */
+#define ASSETS_OP_BEGIN 1
+#define ASSETS_OP_DATA 2
+#define ASSETS_OP_COMMIT 3
+#define ASSETS_STATUS_LEN 14
+#define ASSETS_REPORT_LEN 63
+#define ASSETS_QUEUE_LEN 32
+#define ASSETS_TASK_PRIO 2
+
+typedef struct {
+  uint8_t len;
+  uint8_t data[ASSETS_REPORT_LEN];
+} assets_op_t;
+
+typedef struct {
+  const esp_partition_t *part;
+  esp_partition_mmap_handle_t map_handle;
+  const uint8_t *base; // NULL while no container is mapped
+  const deck_assets_header_t *header;
+  const deck_assets_entry_t *index;
+  lv_image_dsc_t *images; // one per entry, filled for images only
+
+  bool writing;
+  uint32_t write_size;
+  uint32_t written;
+  uint32_t erased_end;
+  deck_assets_header_t pending_header; // written last, see write_end
+  esp_err_t last_err;
+
+  TaskHandle_t task;
+  portMUX_TYPE queue_lock;
+  assets_op_t queue[ASSETS_QUEUE_LEN];
+  uint32_t queue_head;
+  uint32_t queued; // the one being applied included
+
+  deck_assets_change_cb_t change_cb;
+  void *change_user_data;
+} assets_ctx_t;
+
+static assets_ctx_t assets = {.queue_lock = portMUX_INITIALIZER_UNLOCKED};
+
+static uint32_t get_le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static void assets_notify(bool loaded) {
+  // Decoded images are cached by source pointer, which may now point at
+  // different data
+  lv_image_cache_drop(NULL);
+  if (assets.change_cb != NULL)
+    assets.change_cb(loaded, assets.change_user_data);
+}
+
+/* Size LVGL's image cache for the icons of one page, as computed when the
+ * container was built. Never below LV_CACHE_DEF_SIZE: images that are not
+ * icons use the cache too, and icons drawn straight from flash need none.
+ */
+static void assets_apply_manifest(void) {
+  size_t size;
+  const deck_assets_manifest_t *m =
+      deck_assets_data(DECK_ASSETS_MANIFEST, DECK_ASSET_BLOB, &size);
+  if (m == NULL || size < sizeof(*m))
+    return;
+
+  uint32_t bytes = LV_MAX(m->image_cache_bytes, (uint32_t)LV_CACHE_DEF_SIZE);
+  if (bytes > 0)
+    lv_image_cache_resize(bytes, true);
+  ESP_LOGI("ASSETS", "%u icons of %upx, image cache %lu bytes",
+           m->icon_count, m->icon_size, (unsigned long)bytes);
+}
+
+static bool assets_check_index(const deck_assets_header_t *hdr,
+                               const deck_assets_entry_t *index) {
+  for (uint32_t i = 0; i < hdr->count; i++) {
+    const deck_assets_entry_t *e = &index[i];
+    if (e->offset % DECK_ASSETS_ALIGN != 0 || e->offset > hdr->size ||
+        e->size > hdr->size - e->offset)
+      return false;
+    if (i > 0 &&
+        strncmp(index[i - 1].name, e->name, DECK_ASSETS_NAME_MAX) >= 0)
+      return false;
+  }
+  return true;
+}
+
+/* Map the container and publish it. Leaves the assets unloaded if the
+ * partition holds no valid container.
+ */
+static esp_err_t assets_map(void) {
+  deck_assets_header_t hdr;
+  esp_err_t err = esp_partition_read(assets.part, 0, &hdr, sizeof(hdr));
+  if (err != ESP_OK)
+    return err;
+
+  size_t index_size = hdr.count * sizeof(deck_assets_entry_t);
+  if (hdr.magic != DECK_ASSETS_MAGIC || hdr.version != DECK_ASSETS_VERSION ||
+      hdr.size > assets.part->size || sizeof(hdr) + index_size > hdr.size) {
+    ESP_LOGW("ASSETS", "No asset container in partition '%s'",
+             assets.part->label);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  const void *ptr;
+  esp_partition_mmap_handle_t handle;
+  err = esp_partition_mmap(assets.part, 0, hdr.size, ESP_PARTITION_MMAP_DATA,
+                           &ptr, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE("ASSETS", "Failed to map assets: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  const uint8_t *base = ptr;
+  const deck_assets_entry_t *index =
+      (const deck_assets_entry_t *)(base + sizeof(hdr));
+  lv_image_dsc_t *images = calloc(hdr.count ? hdr.count : 1, sizeof(*images));
+  if (images == NULL || !assets_check_index(&hdr, index)) {
+    ESP_LOGE("ASSETS", "Invalid asset index");
+    free(images);
+    esp_partition_munmap(handle);
+    return images == NULL ? ESP_ERR_NO_MEM : ESP_ERR_INVALID_STATE;
+  }
+
+  // Image descriptors point straight at the pixels in flash
+  for (uint32_t i = 0; i < hdr.count; i++) {
+    const deck_assets_entry_t *e = &index[i];
+    const lv_image_header_t *img_hdr =
+        (const lv_image_header_t *)(base + e->offset);
+    if (e->type != DECK_ASSET_IMAGE || e->size < sizeof(*img_hdr) ||
+        img_hdr->magic != LV_IMAGE_HEADER_MAGIC)
+      continue;
+    images[i].header = *img_hdr;
+    images[i].data_size = e->size - sizeof(*img_hdr);
+    images[i].data = base + e->offset + sizeof(*img_hdr);
+  }
+
+  lv_lock();
+  assets.map_handle = handle;
+  assets.base = base;
+  assets.header = (const deck_assets_header_t *)base;
+  assets.index = index;
+  assets.images = images;
+  assets_apply_manifest();
+  assets_notify(true);
+  lv_unlock();
+
+  ESP_LOGI("ASSETS", "%u assets, %lu bytes mapped from '%s'", hdr.count,
+           (unsigned long)hdr.size, assets.part->label);
+  return ESP_OK;
+}
+
+static void assets_unmap(void) {
+  if (assets.base == NULL)
+    return;
+
+  // Nothing may draw from the mapping once it is gone
+  lv_lock();
+  assets.base = NULL;
+  assets.header = NULL;
+  assets.index = NULL;
+  assets_notify(false);
+  lv_unlock();
+
+  esp_partition_munmap(assets.map_handle);
+  free(assets.images);
+  assets.images = NULL;
+}
+
+static int assets_find(const char *name, deck_asset_type_t type) {
+  if (assets.base == NULL || name == NULL)
+    return -1;
+
+  // The index is sorted by name
+  int lo = 0;
+  int hi = (int)assets.header->count - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    const deck_assets_entry_t *e = &assets.index[mid];
+    int cmp = strncmp(name, e->name, DECK_ASSETS_NAME_MAX);
+    if (cmp == 0)
+      return e->type == type ? mid : -1;
+    if (cmp < 0)
+      hi = mid - 1;
+    else
+      lo = mid + 1;
+  }
+  return -1;
+}
+
+const lv_image_dsc_t *deck_assets_image(const char *name) {
+  int i = assets_find(name, DECK_ASSET_IMAGE);
+  if (i < 0 || assets.images[i].data == NULL)
+    return NULL;
+  return &assets.images[i];
+}
+
+lv_color_t deck_assets_image_tint(const char *name) {
+  int i = assets_find(name, DECK_ASSET_IMAGE);
+  if (i < 0)
+    return lv_color_black();
+  const uint8_t *tint = assets.index[i].tint;
+  return lv_color_make(tint[0], tint[1], tint[2]);
+}
+
+const void *deck_assets_data(const char *name, deck_asset_type_t type,
+                             size_t *size) {
+  int i = assets_find(name, type);
+  if (i < 0)
+    return NULL;
+  if (size != NULL)
+    *size = assets.index[i].size;
+  return assets.base + assets.index[i].offset;
+}
+
+void deck_assets_set_change_cb(deck_assets_change_cb_t cb, void *user_data) {
+  assets.change_cb = cb;
+  assets.change_user_data = user_data;
+}
+
+esp_err_t deck_assets_write_begin(uint32_t size) {
+  if (assets.part == NULL)
+    return ESP_ERR_NOT_FOUND;
+  if (size < sizeof(deck_assets_header_t) || size > assets.part->size)
+    return ESP_ERR_INVALID_SIZE;
+
+  assets_unmap();
+
+  // Drop the old header first, the rest is erased as the data arrives
+  esp_err_t err = esp_partition_erase_range(assets.part, 0, ASSETS_SECTOR);
+  if (err != ESP_OK)
+    return err;
+
+  assets.writing = true;
+  assets.write_size = size;
+  assets.written = 0;
+  assets.erased_end = ASSETS_SECTOR;
+  memset(&assets.pending_header, 0xFF, sizeof(assets.pending_header));
+  ESP_LOGI("ASSETS", "Updating assets, %lu bytes", (unsigned long)size);
+  return ESP_OK;
+}
+
+esp_err_t deck_assets_write(uint32_t offset, const void *data, size_t len) {
+  if (!assets.writing)
+    return ESP_ERR_INVALID_STATE;
+  if (offset != assets.written)
+    return ESP_ERR_INVALID_ARG;
+  if (len > assets.write_size - offset)
+    return ESP_ERR_INVALID_SIZE;
+
+  while (offset + len > assets.erased_end) {
+    esp_err_t err = esp_partition_erase_range(assets.part, assets.erased_end,
+                                              ASSETS_SECTOR);
+    if (err != ESP_OK)
+      return err;
+    assets.erased_end += ASSETS_SECTOR;
+  }
+
+  const uint8_t *p = data;
+  size_t n = len;
+  // The header is held back until the whole container is verified
+  if (offset < sizeof(deck_assets_header_t)) {
+    size_t head = LV_MIN(n, sizeof(deck_assets_header_t) - offset);
+    memcpy((uint8_t *)&assets.pending_header + offset, p, head);
+    offset += head;
+    p += head;
+    n -= head;
+  }
+  if (n > 0) {
+    esp_err_t err = esp_partition_write(assets.part, offset, p, n);
+    if (err != ESP_OK)
+      return err;
+  }
+  assets.written += len;
+  return ESP_OK;
+}
+
+static esp_err_t assets_verify(const deck_assets_header_t *hdr) {
+  if (hdr->magic != DECK_ASSETS_MAGIC || hdr->version != DECK_ASSETS_VERSION ||
+      hdr->size != assets.write_size)
+    return ESP_ERR_INVALID_VERSION;
+
+  uint8_t *buf = malloc(ASSETS_SECTOR);
+  if (buf == NULL)
+    return ESP_ERR_NO_MEM;
+
+  uint32_t crc = 0;
+  esp_err_t err = ESP_OK;
+  for (uint32_t pos = sizeof(*hdr); pos < hdr->size && err == ESP_OK;) {
+    size_t n = LV_MIN(ASSETS_SECTOR, hdr->size - pos);
+    err = esp_partition_read(assets.part, pos, buf, n);
+    crc = esp_rom_crc32_le(crc, buf, n);
+    pos += n;
+  }
+  free(buf);
+
+  if (err == ESP_OK && crc != hdr->crc32)
+    err = ESP_ERR_INVALID_CRC;
+  return err;
+}
+
+esp_err_t deck_assets_write_end(void) {
+  if (!assets.writing)
+    return ESP_ERR_INVALID_STATE;
+  assets.writing = false;
+  if (assets.written != assets.write_size)
+    return ESP_ERR_INVALID_SIZE;
+
+  esp_err_t err = assets_verify(&assets.pending_header);
+  if (err == ESP_OK)
+    err = esp_partition_write(assets.part, 0, &assets.pending_header,
+                              sizeof(assets.pending_header));
+  if (err != ESP_OK) {
+    ESP_LOGE("ASSETS", "Asset update rejected: %s", esp_err_to_name(err));
+    return err;
+  }
+  return assets_map();
+}
+
+static void assets_apply(const assets_op_t *op) {
+  const uint8_t *data = op->data;
+  uint16_t len = op->len;
+  esp_err_t err = ESP_ERR_INVALID_SIZE;
+  switch (len > 0 ? data[0] : 0) {
+  case ASSETS_OP_BEGIN:
+    if (len >= 5)
+      err = deck_assets_write_begin(get_le32(data + 1));
+    break;
+  case ASSETS_OP_DATA:
+    if (len >= 6 && 6 + data[5] <= len)
+      err = deck_assets_write(get_le32(data + 1), data + 6, data[5]);
+    break;
+  case ASSETS_OP_COMMIT:
+    err = deck_assets_write_end();
+    break;
+  default:
+    err = ESP_ERR_NOT_SUPPORTED;
+    break;
+  }
+
+  if (err != ESP_OK)
+    ESP_LOGW("ASSETS", "Update op %d failed: %s", len > 0 ? data[0] : 0,
+             esp_err_to_name(err));
+  assets.last_err = err;
+}
+
+static void assets_task(void *arg) {
+  assets_op_t op;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (true) {
+      portENTER_CRITICAL(&assets.queue_lock);
+      bool any = assets.queued > 0;
+      if (any)
+        op = assets.queue[assets.queue_head];
+      portEXIT_CRITICAL(&assets.queue_lock);
+      if (!any)
+        break;
+
+      assets_apply(&op);
+      // The slot stays taken until here, so [13] of the status counts it
+      portENTER_CRITICAL(&assets.queue_lock);
+      assets.queue_head = (assets.queue_head + 1) % ASSETS_QUEUE_LEN;
+      assets.queued--;
+      portEXIT_CRITICAL(&assets.queue_lock);
+    }
+  }
+}
+
+static void assets_hid_set(uint8_t report_id, const uint8_t *data,
+                           uint16_t len) {
+  len = LV_MIN(len, ASSETS_REPORT_LEN);
+  portENTER_CRITICAL(&assets.queue_lock);
+  bool full = assets.queued == ASSETS_QUEUE_LEN;
+  if (!full) {
+    assets_op_t *op =
+        &assets.queue[(assets.queue_head + assets.queued) % ASSETS_QUEUE_LEN];
+    op->len = len;
+    memcpy(op->data, data, len);
+    assets.queued++;
+  }
+  portEXIT_CRITICAL(&assets.queue_lock);
+
+  if (full) {
+    // Dropped data leaves a gap, the following ones fail on their offset
+    ESP_LOGW("ASSETS", "Update op %d dropped, queue full",
+             len > 0 ? data[0] : 0);
+    assets.last_err = ESP_ERR_NO_MEM;
+    return;
+  }
+  xTaskNotifyGive(assets.task);
+}
+
+static uint16_t assets_hid_get(uint8_t report_id, uint8_t *buf,
+                               uint16_t reqlen) {
+  uint8_t status[ASSETS_STATUS_LEN];
+  status[0] = assets.writing;
+  put_le32(status + 1, (uint32_t)assets.last_err);
+  put_le32(status + 5, assets.written);
+  put_le32(status + 9, assets.part ? assets.part->size : 0);
+  status[13] = assets.queued;
+
+  uint16_t n = LV_MIN(reqlen, sizeof(status));
+  memcpy(buf, status, n);
+  return n;
+}
+
+esp_err_t deck_assets_init(void) {
+  assets.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         ESP_PARTITION_SUBTYPE_ANY,
+                                         DECK_ASSETS_PARTITION);
+  if (assets.part == NULL) {
+    ESP_LOGW("ASSETS", "No '%s' partition", DECK_ASSETS_PARTITION);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // Updates are accepted even if the partition holds no container yet. The
+  // task rebuilds the pages when an update is committed.
+  if (xTaskCreate(assets_task, "assets", 6144, NULL, ASSETS_TASK_PRIO,
+                  &assets.task) == pdPASS) {
+    deck_hid_register_report(DECK_ASSETS_HID_REPORT, assets_hid_set,
+                             assets_hid_get);
+  } else {
+    ESP_LOGW("ASSETS", "No memory for the update task, updates disabled");
+  }
+  return assets_map();
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Asset partition, a container of icons and fonts that LVGL reads in place
+ * from memory mapped flash. Layout, little endian:
+ * - deck_assets_header_t at offset 0
+ * - header.count deck_assets_entry_t right after it, sorted by name
+ * - the data of each entry at entry.offset, aligned to DECK_ASSETS_ALIGN.
+ *   Images are LVGL binary images (lv_image_header_t followed by the pixels).
+ * Containers are built and uploaded by tools/assets/deck_assets.py.
+ */
+#define DECK_ASSETS_PARTITION "assets"
+#define DECK_ASSETS_MAGIC 0x53414B44 // "DKAS"
+#define DECK_ASSETS_VERSION 1
+#define DECK_ASSETS_NAME_MAX 24
+#define DECK_ASSETS_ALIGN 4
+
+/* HID feature report used to rewrite the partition over USB */
+#define DECK_ASSETS_HID_REPORT 4
+
+typedef enum {
+  DECK_ASSET_IMAGE = 1,
+  DECK_ASSET_FONT = 2,
+  DECK_ASSET_BLOB = 3,
+  DECK_ASSET_ANIM = 4,
+} deck_asset_type_t;
+
+/* container header
+ * - magic, version: DECK_ASSETS_MAGIC, DECK_ASSETS_VERSION
+ * - count: number of index entries
+ * - size: bytes used by the container, header included
+ * - crc32: CRC-32 (zlib) of the bytes after the header
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t size;
+  uint32_t crc32;
+} deck_assets_header_t;
+
+/* index entry
+ * - name: NUL padded, not terminated at full length
+ * - type: deck_asset_type_t
+ * - tint: RGB color A8 images are drawn in
+ * - offset, size: data location from the start of the container
+ */
+typedef struct __attribute__((packed)) {
+  char name[DECK_ASSETS_NAME_MAX];
+  uint8_t type;
+  uint8_t tint[3];
+  uint32_t offset;
+  uint32_t size;
+} deck_assets_entry_t;
+
+/* Blob written by tools/assets/build_assets.py describing the icons
+ * - image_cache_bytes: LVGL image cache needed for one page of icons that
+ *   are decoded before drawing (indexed or compressed)
+ * - decoded_max: largest decoded icon
+ * - icon_size: key cell size the icons were scaled to
+ * - icon_count: number of icons
+ */
+#define DECK_ASSETS_MANIFEST "_manifest"
+
+typedef struct __attribute__((packed)) {
+  uint32_t image_cache_bytes;
+  uint32_t decoded_max;
+  uint16_t icon_size;
+  uint16_t icon_count;
+} deck_assets_manifest_t;
+
+/* Animation, a sequence of full RGB565 frames of one size
+ * - deck_anim_header_t
+ * - header.frame_count deck_anim_frame_t
+ * - the frame data at frame.offset from the start of the animation, the
+ *   pixels (stride w * 2) compressed with method: 0 none, 1 LVGL RLE with
+ *   2 byte blocks, 2 LZ4 block
+ */
+#define DECK_ANIM_MAGIC 0x4E414B44 // "DKAN"
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t w;
+  uint16_t h;
+  uint16_t frame_count;
+  uint16_t reserved;
+} deck_anim_header_t;
+
+/* animation frame
+ * - offset, size: compressed frame data
+ * - delay_ms: time the frame is shown
+ * - method: compression
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t offset;
+  uint32_t size;
+  uint16_t delay_ms;
+  uint8_t method;
+  uint8_t reserved;
+} deck_anim_frame_t;
+
+/* Called with the LVGL lock held when the assets become unavailable (an
+ * update over USB starts) or available again. Objects showing assets must be
+ * rebuilt, pointers returned earlier are invalid.
+ */
+typedef void (*deck_assets_change_cb_t)(bool loaded, void *user_data);
+
+/* Function to map the asset partition and register the USB update report,
+ * whose operations a task of its own applies. Must be called after lv_init. The deck works without assets, lookups then
+ * return NULL.
+ * Returns ESP_ERR_NOT_FOUND without partition, ESP_ERR_INVALID_STATE if it
+ * holds no valid container.
+ */
+esp_err_t deck_assets_init(void);
+
+void deck_assets_set_change_cb(deck_assets_change_cb_t cb, void *user_data);
+
+/* Function to look up an image. The descriptor points into flash, drawing it
+ * costs no heap. Call from the LVGL task or with the LVGL lock held.
+ * Returns NULL if there is no such image.
+ */
+const lv_image_dsc_t *deck_assets_image(const char *name);
+
+/* Function to get the color an A8 (alpha only) image is meant to be drawn
+ * in, black for other images.
+ */
+lv_color_t deck_assets_image_tint(const char *name);
+
+/* Function to look up the raw data of an asset, e.g. a font.
+ * Parameters:
+ * - name: Asset name.
+ * - type: Expected type.
+ * - size: Set to the data size, can be NULL.
+ * Returns NULL if there is no such asset.
+ */
+const void *deck_assets_data(const char *name, deck_asset_type_t type,
+                             size_t *size);
+
+/* Functions to rewrite the partition, used by the USB update report. The
+ * container is written in order; its header is only written by
+ * deck_assets_write_end once the CRC matches, so an interrupted update
+ * leaves no container instead of a corrupt one.
+ */
+esp_err_t deck_assets_write_begin(uint32_t size);
+esp_err_t deck_assets_write(uint32_t offset, const void *data, size_t len);
+esp_err_t deck_assets_write_end(void);
@@ -0,0 +1,164 @@
+#include "deck_area.h"
+#include "deck_live_proto.h"
+#include "deck_report.h"
+#include "deck_state.h"
+#include "deck_touch.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Microbenchmarks of the deck_core hot paths. Every case runs a fixed
+ * number of iterations a few times and reports the fastest run, which is
+ * the least disturbed by the host. Meant for comparing builds on the same
+ * machine, not for absolute numbers on the deck.
+ */
+
+#define RUNS 5
+
+static volatile uint32_t sink;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+typedef struct {
+  const char *name;
+  const char *unit; // what one iteration handles
+  uint32_t iterations;
+  void (*run)(uint32_t iterations);
+} bench_t;
+
+static void bench_report_merge(uint32_t iterations) {
+  deck_input_report_t pending = {0};
+  for (uint32_t i = 0; i < iterations; i++) {
+    deck_input_report_t r = {0};
+    deck_report_press(&r, 1 + i % 8);
+    r.slider1 = i;
+    deck_report_merge(&pending, &r);
+  }
+  sink = deck_report_state(&pending);
+}
+
+static void bench_state_predict(uint32_t iterations) {
+  static deck_state_t state = DECK_STATE_INITIALIZER;
+  for (uint32_t i = 0; i < DECK_PAGE_MAX * 4; i++)
+    deck_state_page_switch(&state, i % DECK_PAGE_MAX, (i * 7) % DECK_PAGE_MAX);
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++)
+    acc += deck_state_likely_next(&state, i % DECK_PAGE_MAX, DECK_PAGE_MAX);
+  sink = acc;
+}
+
+/* A full 63 byte report of value records, the common case while a host
+ * streams data to many keys
+ */
+static void bench_live_parse(uint32_t iterations) {
+  uint8_t report[63] = {0};
+  for (int i = 0; i + 6 <= 63; i += 6) {
+    report[i] = i / 6;
+    report[i + 1] = DECK_LIVE_OP_VALUE;
+    report[i + 2] = i;
+  }
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    deck_live_reader_t reader;
+    deck_live_record_t rec;
+    deck_live_reader_init(&reader, report, sizeof(report));
+    while (deck_live_read(&reader, &rec) == DECK_LIVE_READ_RECORD)
+      acc += deck_live_get_le32(rec.args);
+  }
+  sink = acc;
+}
+
+static void bench_live_format(uint32_t iterations) {
+  char out[DECK_LIVE_DIGITS_MAX];
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    deck_live_format(i % 3, 7, (int32_t)(i * 37), out);
+    acc += out[6];
+  }
+  sink = acc;
+}
+
+static void bench_touch_transform(uint32_t iterations) {
+  deck_touch_map_t map = {.width = 480, .height = 320, .swap_xy = true,
+                          .mirror_y = true};
+  int32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    int32_t x, y;
+    deck_touch_transform(&map, i % 320, i % 480, &x, &y);
+    acc += x + y;
+  }
+  sink = acc;
+}
+
+static void bench_scroll_split(uint32_t iterations) {
+  deck_span_t spans[DECK_SCROLL_SPANS_MAX];
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++)
+    acc += deck_scroll_split(0, 480, i % 480, (i * 13) % 400,
+                             (i * 13) % 400 + 79, spans);
+  sink = acc;
+}
+
+/* Mirror tiles are 32 x 16 pixels, read out of a 480 pixel wide buffer */
+static uint16_t frame[480 * 16];
+
+static void bench_tile_hash(uint32_t iterations) {
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++)
+    acc += deck_tile_hash((const uint8_t *)(frame + (i % 15) * 32), 480 * 2,
+                          32, 16);
+  sink = acc;
+}
+
+static uint16_t tile[32 * 16];
+
+static void bench_rle(uint32_t iterations) {
+  uint8_t out[32 * 16 * 2];
+  uint32_t acc = 0;
+  for (uint32_t i = 0; i < iterations; i++)
+    acc += deck_rle_encode(tile, 32 * 16, out, sizeof(out));
+  sink = acc;
+}
+
+static const bench_t benches[] = {
+    {"report_merge", "report", 10000000, bench_report_merge},
+    {"state_predict", "lookup", 1000000, bench_state_predict},
+    {"live_parse", "report", 1000000, bench_live_parse},
+    {"live_format", "value", 1000000, bench_live_format},
+    {"touch_transform", "point", 10000000, bench_touch_transform},
+    {"scroll_split", "area", 10000000, bench_scroll_split},
+    {"tile_hash", "32x16 tile", 200000, bench_tile_hash},
+    {"rle_encode", "32x16 tile", 200000, bench_rle},
+};
+
+int main(int argc, char **argv) {
+  const char *only = argc > 1 ? argv[1] : NULL;
+
+  // A key face: flat background with some anti-aliased text edges
+  for (int i = 0; i < 480 * 16; i++)
+    frame[i] = (i % 480) / 40 % 2 ? 0x2104 : (uint16_t)(i * 2654435761u >> 16);
+  for (int i = 0; i < 32 * 16; i++)
+    tile[i] = i % 32 > 8 && i % 32 < 14 && i / 32 > 3 ? 0xFFFF - i : 0x2104;
+
+  printf("%-16s %12s %10s\n", "case", "ns/op", "unit");
+  for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+    const bench_t *bench = &benches[b];
+    if (only != NULL && strcmp(only, bench->name) != 0)
+      continue;
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < RUNS; run++) {
+      uint64_t start = now_ns();
+      bench->run(bench->iterations);
+      uint64_t elapsed = now_ns() - start;
+      if (elapsed < best)
+        best = elapsed;
+    }
+    printf("%-16s %12.2f %10s\n", bench->name,
+           (double)best / bench->iterations, bench->unit);
+  }
+  return 0;
+}
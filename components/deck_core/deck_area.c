@@ -0,0 +1,128 @@
+#include "deck_area.h"
+#include <string.h>
+
+int32_t deck_scroll_wrap(int32_t value, int32_t length) {
+  value %= length;
+  return value < 0 ? value + length : value;
+}
+
+uint32_t deck_scroll_split(int32_t start, int32_t length, int32_t shift,
+                           int32_t a1, int32_t a2,
+                           deck_span_t spans[DECK_SCROLL_SPANS_MAX]) {
+  int32_t end = start + length - 1;
+  uint32_t n = 0;
+
+  // Fixed part before the scrolling region
+  if (a1 < start) {
+    int32_t seg_end = a2 < start - 1 ? a2 : start - 1;
+    spans[n++] = (deck_span_t){a1, seg_end, a1};
+  }
+
+  // Scrolling region, split where it wraps in frame memory
+  int32_t r1 = a1 > start ? a1 : start;
+  int32_t r2 = a2 < end ? a2 : end;
+  while (r1 <= r2) {
+    int32_t q1 = start + deck_scroll_wrap(r1 - start + shift, length);
+    int32_t seg_end = r1 + (end - q1);
+    if (seg_end > r2)
+      seg_end = r2;
+    spans[n++] = (deck_span_t){r1, seg_end, q1};
+    r1 = seg_end + 1;
+  }
+
+  // Fixed part after it
+  if (a2 > end) {
+    int32_t seg_start = a1 > end + 1 ? a1 : end + 1;
+    spans[n++] = (deck_span_t){seg_start, a2, seg_start};
+  }
+  return n;
+}
+
+uint32_t deck_tile_hash(const uint8_t *px, int32_t stride, int32_t w,
+                        int32_t h) {
+  uint32_t hash = 2166136261u;
+  for (int32_t y = 0; y < h; y++) {
+    const uint16_t *row = (const uint16_t *)(px + y * stride);
+    for (int32_t x = 0; x < w; x++)
+      hash = (hash ^ row[x]) * 16777619u;
+  }
+  return hash;
+}
+
+size_t deck_rle_encode(const uint16_t *px, size_t count, uint8_t *out,
+                       size_t max) {
+  size_t pos = 0;
+  size_t i = 0;
+  while (i < count) {
+    size_t run = 1;
+    while (i + run < count && run < 127 && px[i + run] == px[i])
+      run++;
+    if (run >= 3) {
+      if (pos + 3 > max)
+        return 0;
+      out[pos++] = run;
+      memcpy(out + pos, &px[i], 2);
+      pos += 2;
+      i += run;
+      continue;
+    }
+
+    // Literals up to the next run of three
+    size_t n = 0;
+    while (i + n < count && n < 127 &&
+           !(i + n + 2 < count && px[i + n] == px[i + n + 1] &&
+             px[i + n] == px[i + n + 2]))
+      n++;
+    if (pos + 1 + n * 2 > max)
+      return 0;
+    out[pos++] = 0x80 | n;
+    memcpy(out + pos, &px[i], n * 2);
+    pos += n * 2;
+    i += n;
+  }
+  return pos;
+}
+
+void deck_rle_reader_init(deck_rle_reader_t *r, const uint8_t *data,
+                          size_t len) {
+  *r = (deck_rle_reader_t){.in = data, .end = data + len};
+}
+
+size_t deck_rle_read(deck_rle_reader_t *r, uint16_t *px, size_t count) {
+  size_t n = 0;
+  while (n < count) {
+    if (r->left == 0) {
+      if (r->in == r->end)
+        break;
+      uint8_t ctrl = *r->in++;
+      r->literal = ctrl & 0x80;
+      r->left = ctrl & 0x7F;
+      if (!r->literal) {
+        if (r->end - r->in < 2)
+          goto cut;
+        memcpy(&r->value, r->in, 2);
+        r->in += 2;
+      }
+      continue;
+    }
+
+    size_t k = r->left < count - n ? r->left : count - n;
+    if (r->literal) {
+      if ((size_t)(r->end - r->in) < k * 2)
+        goto cut;
+      memcpy(px + n, r->in, k * 2);
+      r->in += k * 2;
+    } else {
+      for (size_t i = 0; i < k; i++)
+        px[n + i] = r->value;
+    }
+    r->left -= k;
+    n += k;
+  }
+  return n;
+
+cut:
+  r->in = r->end;
+  r->left = 0;
+  return n;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Part [a1, a2] of a flushed area (along the scroll axis, screen
+ * coordinates) and where it goes in panel frame memory
+ */
+typedef struct {
+  int32_t a1;
+  int32_t a2;
+  int32_t q1;
+} deck_span_t;
+
+/* A fixed part before the region, the region split once where it wraps and
+ * a fixed part after it
+ */
+#define DECK_SCROLL_SPANS_MAX 4
+
+/* value modulo length, in [0, length) also for negative values */
+int32_t deck_scroll_wrap(int32_t value, int32_t length);
+
+/* Function to split [a1, a2] for a panel that shows frame memory shifted by
+ * shift lines inside [start, start + length), wrapping inside the region.
+ * Returns the number of spans written.
+ */
+uint32_t deck_scroll_split(int32_t start, int32_t length, int32_t shift,
+                           int32_t a1, int32_t a2,
+                           deck_span_t spans[DECK_SCROLL_SPANS_MAX]);
+
+/* FNV-1a over the RGB565 pixels of a w x h block, stride in bytes */
+uint32_t deck_tile_hash(const uint8_t *px, int32_t stride, int32_t w,
+                        int32_t h);
+
+/* LVGL RLE with 2 byte blocks: a control byte with bit 7 set is followed by
+ * that many literal pixels, otherwise by one pixel repeated that many times.
+ * Returns the encoded size, 0 if it would not be smaller than max.
+ */
+size_t deck_rle_encode(const uint16_t *px, size_t count, uint8_t *out,
+                       size_t max);
+
+/* Decoder of deck_rle_encode's output that stops and resumes anywhere, for
+ * data larger than the buffer it is decoded into
+ */
+typedef struct {
+  const uint8_t *in;
+  const uint8_t *end;
+  uint8_t left; // pixels left of the current block
+  bool literal;
+  uint16_t value; // of a run
+} deck_rle_reader_t;
+
+void deck_rle_reader_init(deck_rle_reader_t *r, const uint8_t *data,
+                          size_t len);
+
+/* Function to decode the next count pixels at most. Returns the number
+ * decoded, fewer than count at the end of the data or of a cut off block.
+ */
+size_t deck_rle_read(deck_rle_reader_t *r, uint16_t *px, size_t count);
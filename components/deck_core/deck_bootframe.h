@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+/* Boot frame, the deck screen as last shown, kept in the bootframe
+ * partition by deck_gl and drawn by bsp_waveshare right after panel init,
+ * before LVGL has built the UI. The partition holds a
+ * deck_bootframe_header_t followed by size bytes of RGB565 pixels as LVGL
+ * renders them for the panel, rows top to bottom, compressed row by row
+ * with deck_rle_encode (deck_area.h). The header is written last.
+ */
+#define DECK_BOOTFRAME_SUBTYPE 0x41
+#define DECK_BOOTFRAME_MAGIC 0x31464244 // "DBF1"
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t width;
+  uint16_t height;
+  uint8_t orientation; // of the panel, as given to lcd_set_orientation
+  uint8_t reserved[3];
+  uint32_t size;
+  uint32_t crc32; // esp_rom_crc32_le of the compressed rows
+} deck_bootframe_header_t;
@@ -0,0 +1,99 @@
+#include "deck_live_proto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void deck_live_reader_init(deck_live_reader_t *reader, const uint8_t *data,
+                           uint16_t len) {
+  reader->data = data;
+  reader->len = len;
+  reader->pos = 0;
+}
+
+deck_live_read_t deck_live_read(deck_live_reader_t *reader,
+                                deck_live_record_t *rec) {
+  uint16_t pos = reader->pos;
+  if (pos + 2 > reader->len)
+    return DECK_LIVE_READ_END;
+
+  rec->key = reader->data[pos];
+  rec->op = reader->data[pos + 1];
+  rec->args = reader->data + pos + 2;
+  uint16_t avail = reader->len - pos - 2;
+  uint16_t used;
+
+  switch (rec->op) {
+  case DECK_LIVE_OP_END:
+    return DECK_LIVE_READ_END;
+  case DECK_LIVE_OP_CONFIG:
+    used = 7;
+    break;
+  case DECK_LIVE_OP_VALUE:
+    used = 4;
+    break;
+  case DECK_LIVE_OP_SAMPLES:
+    used = avail > 0 ? 1 + 2 * rec->args[0] : 1;
+    break;
+  case DECK_LIVE_OP_REMOVE:
+    used = 0;
+    break;
+  default:
+    return DECK_LIVE_READ_BAD;
+  }
+  if (used > avail)
+    return DECK_LIVE_READ_BAD;
+
+  rec->args_len = used;
+  reader->pos = pos + 2 + used;
+  return DECK_LIVE_READ_RECORD;
+}
+
+int16_t deck_live_get_le16(const uint8_t *p) {
+  return (int16_t)(p[0] | p[1] << 8);
+}
+
+int32_t deck_live_get_le32(const uint8_t *p) {
+  return (int32_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+void deck_live_get_config(const uint8_t *args, deck_live_config_t *cfg) {
+  cfg->type = args[0];
+  cfg->format = args[1];
+  cfg->digits = args[2];
+  cfg->min = deck_live_get_le16(args + 3);
+  cfg->max = deck_live_get_le16(args + 5);
+}
+
+void deck_live_format(uint8_t format, uint8_t digits, int32_t value,
+                      char *out) {
+  char buf[24];
+  long v = value;
+  switch (format) {
+  case DECK_LIVE_FORMAT_DURATION: {
+    // The sign goes in front, under a minute there are no minutes to carry it
+    const char *sign = v < 0 ? "-" : "";
+    long long a = llabs((long long)v);
+    if (a >= 3600)
+      snprintf(buf, sizeof(buf), "%s%lld:%02lld:%02lld", sign, a / 3600,
+               a / 60 % 60, a % 60);
+    else
+      snprintf(buf, sizeof(buf), "%s%lld:%02lld", sign, a / 60, a % 60);
+    break;
+  }
+  case DECK_LIVE_FORMAT_TENTHS:
+    snprintf(buf, sizeof(buf), "%s%ld.%ld", v < 0 ? "-" : "", labs(v / 10),
+             labs(v % 10));
+    break;
+  default:
+    snprintf(buf, sizeof(buf), "%ld", v);
+    break;
+  }
+
+  size_t len = strlen(buf);
+  if (len > digits) {
+    memset(out, '-', digits);
+    return;
+  }
+  memset(out, ' ', digits - len);
+  memcpy(out + digits - len, buf, len);
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+
+/* Live data protocol, keys showing values pushed by the host through
+ * DECK_LIVE_HID_REPORT (a 63 byte feature report). A report is a sequence of
+ * records, each starting with the key (page * 8 + button id - 1) and an op:
+ * - DECK_LIVE_OP_CONFIG: type, format, digits (u8), min, max (i16); shows a
+ *   widget on the key, replacing its previous one
+ * - DECK_LIVE_OP_VALUE: value (i32); sparklines append it as a sample
+ * - DECK_LIVE_OP_SAMPLES: count (u8), count samples (i16) for sparklines
+ * - DECK_LIVE_OP_REMOVE: removes the widget
+ * - DECK_LIVE_OP_END (or the end of the report): no more records
+ * Values are little endian. Keys of pages that are not built keep their
+ * state and show it when the page is built.
+ */
+#define DECK_LIVE_HID_REPORT 5
+/* Samples a sparkline holds */
+#define DECK_LIVE_POINTS 32
+/* Character cells of a readout */
+#define DECK_LIVE_DIGITS_MAX 8
+
+typedef enum {
+  DECK_LIVE_OP_END = 0,
+  DECK_LIVE_OP_CONFIG = 1,
+  DECK_LIVE_OP_VALUE = 2,
+  DECK_LIVE_OP_SAMPLES = 3,
+  DECK_LIVE_OP_REMOVE = 4,
+} deck_live_op_t;
+
+/* live widget type
+ * - DECK_LIVE_READOUT: number in fixed width digit cells
+ * - DECK_LIVE_SPARKLINE: line chart of the last DECK_LIVE_POINTS samples
+ * - DECK_LIVE_METER: bar from min to max
+ */
+typedef enum {
+  DECK_LIVE_READOUT = 1,
+  DECK_LIVE_SPARKLINE = 2,
+  DECK_LIVE_METER = 3,
+} deck_live_type_t;
+
+/* readout format
+ * - DECK_LIVE_FORMAT_INT: the value
+ * - DECK_LIVE_FORMAT_DURATION: seconds as m:ss or h:mm:ss
+ * - DECK_LIVE_FORMAT_TENTHS: value / 10 with one decimal
+ */
+typedef enum {
+  DECK_LIVE_FORMAT_INT = 0,
+  DECK_LIVE_FORMAT_DURATION = 1,
+  DECK_LIVE_FORMAT_TENTHS = 2,
+} deck_live_format_t;
+
+/* Arguments of DECK_LIVE_OP_CONFIG */
+typedef struct {
+  uint8_t type;
+  uint8_t format;
+  uint8_t digits;
+  int16_t min;
+  int16_t max;
+} deck_live_config_t;
+
+/* Cursor over the records of one report */
+typedef struct {
+  const uint8_t *data;
+  uint16_t len;
+  uint16_t pos; // of the next record
+} deck_live_reader_t;
+
+/* One record, args points into the report */
+typedef struct {
+  uint8_t key;
+  uint8_t op;
+  const uint8_t *args;
+  uint16_t args_len;
+} deck_live_record_t;
+
+/* result of deck_live_read
+ * - DECK_LIVE_READ_RECORD: rec holds the next record
+ * - DECK_LIVE_READ_END: DECK_LIVE_OP_END or the end of the report
+ * - DECK_LIVE_READ_BAD: unknown op or arguments cut off at reader->pos;
+ *   the rest of the report can not be parsed
+ */
+typedef enum {
+  DECK_LIVE_READ_RECORD,
+  DECK_LIVE_READ_END,
+  DECK_LIVE_READ_BAD,
+} deck_live_read_t;
+
+void deck_live_reader_init(deck_live_reader_t *reader, const uint8_t *data,
+                           uint16_t len);
+deck_live_read_t deck_live_read(deck_live_reader_t *reader,
+                                deck_live_record_t *rec);
+
+int16_t deck_live_get_le16(const uint8_t *p);
+int32_t deck_live_get_le32(const uint8_t *p);
+
+/* Function to read the arguments of a DECK_LIVE_OP_CONFIG record */
+void deck_live_get_config(const uint8_t *args, deck_live_config_t *cfg);
+
+/* Function to format value right aligned into exactly digits characters
+ * (not terminated), dashes when it does not fit
+ */
+void deck_live_format(uint8_t format, uint8_t digits, int32_t value,
+                      char *out);
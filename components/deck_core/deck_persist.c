@@ -0,0 +1,146 @@
+#include "deck_persist.h"
+#include <string.h>
+
+typedef struct {
+  uint8_t *buf;
+  size_t max;
+  size_t pos;
+  bool full;
+} writer_t;
+
+static void put(writer_t *w, const void *data, size_t len) {
+  if (w->full || len > w->max - w->pos) {
+    w->full = true;
+    return;
+  }
+  memcpy(w->buf + w->pos, data, len);
+  w->pos += len;
+}
+
+static void put_u8(writer_t *w, uint8_t v) { put(w, &v, 1); }
+
+static void put_le16(writer_t *w, uint16_t v) {
+  uint8_t b[2] = {v & 0xFF, v >> 8};
+  put(w, b, 2);
+}
+
+/* Starts a section, its length is filled in by section_end */
+static size_t section_begin(writer_t *w, uint8_t tag) {
+  put_u8(w, tag);
+  size_t at = w->pos;
+  put_le16(w, 0);
+  return at;
+}
+
+static void section_end(writer_t *w, size_t at) {
+  if (w->full)
+    return;
+  uint16_t len = w->pos - at - 2;
+  w->buf[at] = len & 0xFF;
+  w->buf[at + 1] = len >> 8;
+}
+
+size_t deck_persist_encode(const deck_persist_t *p, uint8_t *buf,
+                           size_t max) {
+  writer_t w = {.buf = buf, .max = max};
+  put_u8(&w, DECK_PERSIST_VERSION);
+
+  size_t at = section_begin(&w, DECK_PERSIST_SLIDERS);
+  put(&w, p->state.sliders, DECK_SLIDER_COUNT);
+  section_end(&w, at);
+
+  at = section_begin(&w, DECK_PERSIST_PAGE);
+  put_u8(&w, p->page);
+  section_end(&w, at);
+
+  // Only the switches seen, most of the matrix is zero
+  at = section_begin(&w, DECK_PERSIST_SWITCHES);
+  for (uint32_t from = 0; from < DECK_PAGE_MAX; from++) {
+    for (uint32_t to = 0; to < DECK_PAGE_MAX; to++) {
+      uint8_t count = p->state.transitions[from][to];
+      if (count == 0)
+        continue;
+      uint8_t entry[3] = {from, to, count};
+      put(&w, entry, sizeof(entry));
+    }
+  }
+  section_end(&w, at);
+
+  at = section_begin(&w, DECK_PERSIST_LIVE);
+  for (uint32_t i = 0; i < p->live_count && i < DECK_PERSIST_LIVE_MAX; i++) {
+    const deck_persist_live_t *l = &p->live[i];
+    uint8_t entry[4] = {l->key, l->cfg.type, l->cfg.format, l->cfg.digits};
+    put(&w, entry, sizeof(entry));
+    put_le16(&w, l->cfg.min);
+    put_le16(&w, l->cfg.max);
+  }
+  section_end(&w, at);
+
+  at = section_begin(&w, DECK_PERSIST_PROFILE);
+  put(&w, p->profile, strnlen(p->profile, DECK_PROFILE_NAME_MAX));
+  section_end(&w, at);
+
+  return w.full ? 0 : w.pos;
+}
+
+static void decode_section(uint8_t tag, const uint8_t *d, size_t len,
+                           deck_persist_t *p) {
+  switch (tag) {
+  case DECK_PERSIST_SLIDERS:
+    memcpy(p->state.sliders, d,
+           len < DECK_SLIDER_COUNT ? len : DECK_SLIDER_COUNT);
+    break;
+  case DECK_PERSIST_PAGE:
+    if (len >= 1)
+      p->page = d[0];
+    break;
+  case DECK_PERSIST_SWITCHES:
+    memset(p->state.transitions, 0, sizeof(p->state.transitions));
+    for (size_t i = 0; i + 3 <= len; i += 3) {
+      if (d[i] < DECK_PAGE_MAX && d[i + 1] < DECK_PAGE_MAX)
+        p->state.transitions[d[i]][d[i + 1]] = d[i + 2];
+    }
+    break;
+  case DECK_PERSIST_LIVE:
+    p->live_count = 0;
+    for (size_t i = 0; i + 8 <= len; i += 8) {
+      if (d[i] >= DECK_PERSIST_LIVE_MAX ||
+          p->live_count == DECK_PERSIST_LIVE_MAX)
+        continue;
+      deck_persist_live_t *l = &p->live[p->live_count++];
+      l->key = d[i];
+      l->cfg.type = d[i + 1];
+      l->cfg.format = d[i + 2];
+      l->cfg.digits = d[i + 3];
+      l->cfg.min = deck_live_get_le16(d + i + 4);
+      l->cfg.max = deck_live_get_le16(d + i + 6);
+    }
+    break;
+  case DECK_PERSIST_PROFILE:
+    if (len > DECK_PROFILE_NAME_MAX)
+      len = DECK_PROFILE_NAME_MAX;
+    memcpy(p->profile, d, len);
+    p->profile[len] = '\0';
+    break;
+  default: // from a newer firmware
+    break;
+  }
+}
+
+bool deck_persist_decode(const uint8_t *data, size_t len, deck_persist_t *p) {
+  if (len < 1 || data[0] != DECK_PERSIST_VERSION)
+    return false;
+  size_t pos = 1;
+  while (pos < len) {
+    if (len - pos < 3)
+      return false;
+    uint8_t tag = data[pos];
+    size_t section = data[pos + 1] | data[pos + 2] << 8;
+    pos += 3;
+    if (section > len - pos)
+      return false;
+    decode_section(tag, data + pos, section, p);
+    pos += section;
+  }
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "deck_live_proto.h"
+#include "deck_profile.h"
+#include "deck_state.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* What the deck keeps across reboots: its state (deck_state.h), the profile
+ * and page it showed and the live widgets the host configured. Encoded as a
+ * version byte followed by sections {tag (u8), length (u16), data}, little
+ * endian:
+ * - DECK_PERSIST_SLIDERS: one byte per slider
+ * - DECK_PERSIST_PAGE: the page shown (u8)
+ * - DECK_PERSIST_SWITCHES: {from, to, count} (u8) per counted page switch
+ * - DECK_PERSIST_LIVE: {key, type, format, digits (u8), min, max (i16)} per
+ *   configured key
+ * - DECK_PERSIST_PROFILE: name of the profile shown (deck_profile.h), not
+ *   terminated, empty for the built-in pages
+ * Decoders skip sections they do not know, so adding one keeps the version;
+ * the version changes when a section changes its meaning.
+ */
+#define DECK_PERSIST_VERSION 1
+
+enum {
+  DECK_PERSIST_SLIDERS = 1,
+  DECK_PERSIST_PAGE = 2,
+  DECK_PERSIST_SWITCHES = 3,
+  DECK_PERSIST_LIVE = 4,
+  DECK_PERSIST_PROFILE = 5,
+};
+
+/* Keys that can show a live widget, 8 per page */
+#define DECK_PERSIST_LIVE_MAX (DECK_PAGE_MAX * 8)
+
+#define DECK_PERSIST_SIZE_MAX                                                  \
+  (1 + 5 * 3 + DECK_SLIDER_COUNT + 1 + DECK_PAGE_MAX * DECK_PAGE_MAX * 3 +     \
+   DECK_PERSIST_LIVE_MAX * 8 + DECK_PROFILE_NAME_MAX)
+
+typedef struct {
+  uint8_t key; // page * 8 + button id - 1
+  deck_live_config_t cfg;
+} deck_persist_live_t;
+
+typedef struct {
+  deck_state_t state;
+  char profile[DECK_PROFILE_NAME_MAX + 1];
+  uint8_t page;
+  uint16_t live_count;
+  deck_persist_live_t live[DECK_PERSIST_LIVE_MAX];
+} deck_persist_t;
+
+/* Function to encode p into buf (DECK_PERSIST_SIZE_MAX is always enough).
+ * Returns the encoded size, 0 if it does not fit max.
+ */
+size_t deck_persist_encode(const deck_persist_t *p, uint8_t *buf, size_t max);
+
+/* Function to decode what deck_persist_encode wrote. Sections missing from
+ * data leave p as it is. Returns false, with p partly written, for another
+ * version or data that is cut off.
+ */
+bool deck_persist_decode(const uint8_t *data, size_t len, deck_persist_t *p);
@@ -0,0 +1,157 @@
+#include "deck_profile.h"
+#include <ctype.h>
+#include <string.h>
+
+// BUTTON_ACTION_OPEN_PAGE of deck_gl.h
+#define ACTION_OPEN_PAGE 1
+
+static bool string_ok(const deck_profile_header_t *hdr, uint32_t offset) {
+  return offset == 0 ||
+         (offset >= hdr->strings && offset - hdr->strings < hdr->strings_size);
+}
+
+static bool page_ok(const deck_profile_header_t *hdr,
+                    const deck_profile_page_t *page, uint32_t page_count) {
+  if (!string_ok(hdr, page->name) ||
+      (page->parent != DECK_PROFILE_ROOT && page->parent >= page_count))
+    return false;
+  for (int i = 0; i < DECK_SLIDER_COUNT; i++) {
+    if (!string_ok(hdr, page->slider_names[i]))
+      return false;
+  }
+  for (int i = 0; i < 8; i++) {
+    const deck_profile_button_t *b = &page->buttons[i];
+    if (!string_ok(hdr, b->label) || !string_ok(hdr, b->icon) ||
+        !string_ok(hdr, b->anim) || b->action > DECK_PROFILE_ACTION_MAX ||
+        (b->action == ACTION_OPEN_PAGE && b->target >= page_count))
+      return false;
+  }
+  return true;
+}
+
+bool deck_profile_check(const uint8_t *data, size_t size) {
+  const deck_profile_header_t *hdr = deck_profile_header(data);
+  if (size < sizeof(*hdr) || hdr->magic != DECK_PROFILE_MAGIC ||
+      hdr->version != DECK_PROFILE_VERSION || hdr->size > size ||
+      hdr->size < sizeof(*hdr))
+    return false;
+
+  // Sizes in 64 bits, the fields are 32 bits wide
+  uint64_t entries_end =
+      sizeof(*hdr) + (uint64_t)hdr->count * sizeof(deck_profile_entry_t);
+  uint64_t pages_end =
+      hdr->pages + (uint64_t)hdr->page_count * sizeof(deck_profile_page_t);
+  if (entries_end > hdr->size || hdr->pages < entries_end ||
+      hdr->pages % DECK_PROFILE_ALIGN != 0 || pages_end > hdr->size ||
+      (uint64_t)hdr->strings + hdr->strings_size > hdr->size ||
+      hdr->strings < sizeof(*hdr))
+    return false;
+  // Every string ends within the pool, the last one included
+  if (hdr->strings_size > 0 &&
+      data[hdr->strings + hdr->strings_size - 1] != '\0')
+    return false;
+
+  for (uint32_t i = 0; i < hdr->count; i++) {
+    const deck_profile_entry_t *e = deck_profile_entry(data, i);
+    if (e->name == 0 || !string_ok(hdr, e->name) || !string_ok(hdr, e->apps) ||
+        strlen((const char *)data + e->name) > DECK_PROFILE_NAME_MAX ||
+        e->page_count == 0 || e->page_count > DECK_PAGE_MAX ||
+        e->first_page + e->page_count > hdr->page_count)
+      return false;
+    for (uint32_t j = 0; j < i; j++) {
+      if (strcmp((const char *)data + e->name,
+                 (const char *)data + deck_profile_entry(data, j)->name) == 0)
+        return false;
+    }
+    const deck_profile_page_t *pages = deck_profile_pages(data, e);
+    for (uint32_t p = 0; p < e->page_count; p++) {
+      if (!page_ok(hdr, &pages[p], e->page_count))
+        return false;
+    }
+  }
+  return true;
+}
+
+int deck_profile_find(const uint8_t *data, const char *name) {
+  const deck_profile_header_t *hdr = deck_profile_header(data);
+  for (uint32_t i = 0; i < hdr->count; i++) {
+    if (strcmp(name, (const char *)data + deck_profile_entry(data, i)->name) ==
+        0)
+      return (int)i;
+  }
+  return -1;
+}
+
+static bool app_equal(const char *a, size_t a_len, const char *b,
+                      size_t b_len) {
+  if (a_len != b_len)
+    return false;
+  for (size_t i = 0; i < a_len; i++) {
+    if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+      return false;
+  }
+  return true;
+}
+
+int deck_profile_find_app(const uint8_t *data, const char *app, size_t len) {
+  const deck_profile_header_t *hdr = deck_profile_header(data);
+  for (uint32_t i = 0; i < hdr->count; i++) {
+    const char *line =
+        deck_profile_string(data, deck_profile_entry(data, i)->apps);
+    while (line != NULL && *line != '\0') {
+      size_t n = strcspn(line, "\n");
+      if (app_equal(line, n, app, len))
+        return (int)i;
+      line += n + (line[n] == '\n');
+    }
+  }
+  for (uint32_t i = 0; i < hdr->count; i++) {
+    const char *name =
+        deck_profile_string(data, deck_profile_entry(data, i)->name);
+    if (app_equal(name, strlen(name), app, len))
+      return (int)i;
+  }
+  return -1;
+}
+
+void deck_profile_history_push(deck_profile_history_t *h, uint8_t profile) {
+  if (h->count > 0 && h->profiles[h->count - 1] == profile)
+    return;
+  if (h->count == DECK_PROFILE_HISTORY) {
+    memmove(h->profiles, h->profiles + 1, DECK_PROFILE_HISTORY - 1);
+    h->count--;
+  }
+  h->profiles[h->count++] = profile;
+}
+
+uint32_t deck_profile_history_likely_next(const deck_profile_history_t *h,
+                                          uint8_t from) {
+  // Switch i -> i + 1 weighs i + 1, the most recent one the most
+  uint8_t to[DECK_PROFILE_HISTORY];
+  uint32_t score[DECK_PROFILE_HISTORY];
+  uint32_t n = 0;
+  uint32_t best = UINT32_MAX;
+  for (uint32_t i = 0; i + 1 < h->count; i++) {
+    if (h->profiles[i] != from)
+      continue;
+    uint32_t j = 0;
+    while (j < n && to[j] != h->profiles[i + 1])
+      j++;
+    if (j == n) {
+      to[n] = h->profiles[i + 1];
+      score[n++] = 0;
+    }
+    score[j] += i + 1;
+    if (best == UINT32_MAX || score[j] >= score[best])
+      best = j;
+  }
+  if (best != UINT32_MAX)
+    return to[best];
+
+  // Only ever switched to from, most likely back
+  for (uint32_t i = h->count; i-- > 0;) {
+    if (h->profiles[i] == from)
+      return i > 0 ? h->profiles[i - 1] : UINT32_MAX;
+  }
+  return UINT32_MAX;
+}
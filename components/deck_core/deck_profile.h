@@ -0,0 +1,162 @@
+#pragma once
+#include "deck_state.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Profile partition, a container of page layouts (one profile per host
+ * application) that deck_gl binds its pages to in place, from memory mapped
+ * flash. Layout, little endian:
+ * - deck_profile_header_t at offset 0
+ * - header.count deck_profile_entry_t right after it
+ * - header.page_count deck_profile_page_t at header.pages, the pages of
+ *   each profile one after the other
+ * - the string pool, header.strings_size bytes at header.strings: NUL
+ *   terminated UTF-8, referenced by their offset from the start of the
+ *   container. Offset 0 (the header) stands for no string.
+ * Icons and animations are named, they live in the asset partition
+ * (deck_assets.h). Containers are built and checked by
+ * tools/profiles/deck_profiles.py.
+ */
+#define DECK_PROFILE_SUBTYPE 0x42
+#define DECK_PROFILE_MAGIC 0x46504B44 // "DKPF"
+#define DECK_PROFILE_VERSION 1
+#define DECK_PROFILE_ALIGN 4
+
+/* Longest profile name, without the NUL */
+#define DECK_PROFILE_NAME_MAX 31
+
+/* deck_profile_page_t.parent of a root page */
+#define DECK_PROFILE_ROOT 0xFF
+
+/* container header
+ * - magic, version: DECK_PROFILE_MAGIC, DECK_PROFILE_VERSION
+ * - count: number of profiles
+ * - size: bytes used by the container, header included
+ * - crc32: CRC-32 (zlib) of the bytes after the header
+ * - pages, page_count: page table of all profiles
+ * - strings, strings_size: string pool
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t size;
+  uint32_t crc32;
+  uint32_t pages;
+  uint16_t page_count;
+  uint16_t reserved;
+  uint32_t strings;
+  uint32_t strings_size;
+} deck_profile_header_t;
+
+/* profile
+ * - name: string, unique, at most DECK_PROFILE_NAME_MAX bytes
+ * - apps: string, the host applications the profile is for, one per line
+ * - first_page, page_count: its pages in the page table; page numbers in
+ *   its pages count from first_page
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t name;
+  uint32_t apps;
+  uint16_t first_page;
+  uint16_t page_count;
+} deck_profile_entry_t;
+
+/* button, see button_t of deck_gl.h
+ * - label, icon, anim: strings
+ * - color: background, red, green, blue as lv_color_make takes them
+ * - action: button_action_t
+ * - target: page of the profile opened by BUTTON_ACTION_OPEN_PAGE
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t label;
+  uint32_t icon;
+  uint32_t anim;
+  uint8_t color[3];
+  uint8_t action;
+  uint8_t target;
+  uint8_t radius;
+  uint8_t reserved[2];
+} deck_profile_button_t;
+
+/* page, see page_config_t of deck_gl.h
+ * - name, slider_names: strings, no slider name keeps the default
+ * - parent: page of the profile, DECK_PROFILE_ROOT for a root page
+ * - buttons: the button grid, button i has id i + 1
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t name;
+  uint32_t slider_names[DECK_SLIDER_COUNT];
+  uint8_t parent;
+  uint8_t reserved[3];
+  deck_profile_button_t buttons[8];
+} deck_profile_page_t;
+
+/* Highest action a button may have, BUTTON_ACTION_BACK */
+#define DECK_PROFILE_ACTION_MAX 2
+
+/* Function to check that a container is complete and consistent: every
+ * table and page range within it, every string offset inside the pool,
+ * page numbers within their profile, names unique. The CRC is left to the
+ * caller. Once it passed the accessors below need no further checks.
+ */
+bool deck_profile_check(const uint8_t *data, size_t size);
+
+/* Accessors of a checked container */
+static inline const deck_profile_header_t *
+deck_profile_header(const uint8_t *data) {
+  return (const deck_profile_header_t *)data;
+}
+
+static inline const deck_profile_entry_t *
+deck_profile_entry(const uint8_t *data, uint32_t index) {
+  return (const deck_profile_entry_t *)(data +
+                                        sizeof(deck_profile_header_t)) +
+         index;
+}
+
+static inline const deck_profile_page_t *
+deck_profile_pages(const uint8_t *data, const deck_profile_entry_t *e) {
+  return (const deck_profile_page_t *)(data +
+                                       deck_profile_header(data)->pages) +
+         e->first_page;
+}
+
+/* NULL for no string */
+static inline const char *deck_profile_string(const uint8_t *data,
+                                              uint32_t offset) {
+  return offset != 0 ? (const char *)data + offset : NULL;
+}
+
+/* Index of the profile called name, -1 if there is none */
+int deck_profile_find(const uint8_t *data, const char *name);
+
+/* Index of the profile for a host application: the first listing app
+ * among its apps, ignoring ASCII case, otherwise the one called app. app
+ * has len bytes and need not be terminated. -1 if there is none.
+ */
+int deck_profile_find_app(const uint8_t *data, const char *app, size_t len);
+
+/* Length of the recent profile switches kept */
+#define DECK_PROFILE_HISTORY 32
+/* The pages built into the firmware, in the history */
+#define DECK_PROFILE_BUILTIN 0xFF
+
+/* Profiles shown, oldest first, each differing from the one before */
+typedef struct {
+  uint8_t profiles[DECK_PROFILE_HISTORY];
+  uint8_t count;
+} deck_profile_history_t;
+
+/* Function to note that profile is shown now, the oldest entry drops out
+ * of a full history
+ */
+void deck_profile_history_push(deck_profile_history_t *h, uint8_t profile);
+
+/* The profile most likely shown after from: the one that followed from
+ * most often, switches weighing more the more recent they are, otherwise
+ * the one shown before from. UINT32_MAX when the history holds neither.
+ */
+uint32_t deck_profile_history_likely_next(const deck_profile_history_t *h,
+                                          uint8_t from);
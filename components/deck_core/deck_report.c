@@ -0,0 +1,21 @@
+#include "deck_report.h"
+#include <string.h>
+
+void deck_report_press(deck_input_report_t *report, uint32_t button_id) {
+  if (button_id >= 1 && button_id <= 8)
+    report->buttons |= 1 << (button_id - 1);
+}
+
+void deck_report_merge(deck_input_report_t *pending,
+                       const deck_input_report_t *report) {
+  pending->buttons |= report->buttons;
+  pending->slider1 = report->slider1;
+  pending->slider2 = report->slider2;
+  pending->slider3 = report->slider3;
+}
+
+uint32_t deck_report_state(const deck_input_report_t *report) {
+  uint32_t state;
+  memcpy(&state, report, sizeof(state));
+  return state;
+}
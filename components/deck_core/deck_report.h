@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+
+/* Input report (ID 1) the deck sends when a key is pressed or a slider
+ * moved. Builders and the merge used by deck_hid while a report is in
+ * flight; no USB or RTOS code, so it also builds on a host.
+ */
+typedef struct __attribute__((packed)) {
+  // 8 buttons packed into 1 byte (bit 0 = button 1, bit 7 = button 8)
+  union {
+    uint8_t buttons;
+    struct {
+      uint8_t btn1 : 1;
+      uint8_t btn2 : 1;
+      uint8_t btn3 : 1;
+      uint8_t btn4 : 1;
+      uint8_t btn5 : 1;
+      uint8_t btn6 : 1;
+      uint8_t btn7 : 1;
+      uint8_t btn8 : 1;
+    };
+  };
+  // 3 sliders, 0–100
+  uint8_t slider1;
+  uint8_t slider2;
+  uint8_t slider3;
+} deck_input_report_t;
+
+/* Function to set the bit of button_id (1..8), other IDs are ignored */
+void deck_report_press(deck_input_report_t *report, uint32_t button_id);
+
+/* Function to merge report into pending, a report that has not been sent
+ * yet: buttons accumulate and sliders take the values of report, so a press
+ * is never lost behind a slider update.
+ */
+void deck_report_merge(deck_input_report_t *pending,
+                       const deck_input_report_t *report);
+
+/* The report as one word, for traces */
+uint32_t deck_report_state(const deck_input_report_t *report);
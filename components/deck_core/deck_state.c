@@ -0,0 +1,40 @@
+#include "deck_state.h"
+
+void deck_state_set_slider(deck_state_t *state, uint32_t index,
+                           int32_t value) {
+  if (index >= DECK_SLIDER_COUNT)
+    return;
+  state->sliders[index] = value < 0 ? 0 : value > UINT8_MAX ? UINT8_MAX : value;
+}
+
+void deck_state_fill_report(const deck_state_t *state,
+                            deck_input_report_t *report) {
+  report->slider1 = state->sliders[0];
+  report->slider2 = state->sliders[1];
+  report->slider3 = state->sliders[2];
+}
+
+void deck_state_page_switch(deck_state_t *state, uint32_t from, uint32_t to) {
+  if (from >= DECK_PAGE_MAX || to >= DECK_PAGE_MAX || from == to)
+    return;
+  if (state->transitions[from][to] < UINT8_MAX)
+    state->transitions[from][to]++;
+}
+
+uint32_t deck_state_likely_next(const deck_state_t *state, uint32_t from,
+                                uint32_t page_count) {
+  if (from >= DECK_PAGE_MAX)
+    return UINT32_MAX;
+  if (page_count > DECK_PAGE_MAX)
+    page_count = DECK_PAGE_MAX;
+
+  uint32_t best = UINT32_MAX;
+  uint8_t best_count = 0;
+  for (uint32_t i = 0; i < page_count; i++) {
+    if (state->transitions[from][i] > best_count) {
+      best_count = state->transitions[from][i];
+      best = i;
+    }
+  }
+  return best;
+}
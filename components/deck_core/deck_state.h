@@ -0,0 +1,40 @@
+#pragma once
+#include "deck_report.h"
+#include <stdint.h>
+
+/* Maximum number of pages a deck can hold */
+#ifndef DECK_PAGE_MAX
+#define DECK_PAGE_MAX 16
+#endif
+
+#define DECK_SLIDER_COUNT 3
+
+/* State of the deck that outlives the LVGL objects showing it: the slider
+ * values reported to the host and the page switches seen so far, which
+ * predict the page to prefetch.
+ */
+typedef struct {
+  uint8_t sliders[DECK_SLIDER_COUNT];
+  // transitions[from][to]: how often a switch from -> to happened
+  uint8_t transitions[DECK_PAGE_MAX][DECK_PAGE_MAX];
+} deck_state_t;
+
+/* Sliders start centered, no switches seen */
+#define DECK_STATE_INITIALIZER {.sliders = {50, 50, 50}}
+
+/* Function to store a slider value, clamped to what the report carries */
+void deck_state_set_slider(deck_state_t *state, uint32_t index,
+                           int32_t value);
+
+/* Function to copy the slider values into a report */
+void deck_state_fill_report(const deck_state_t *state,
+                            deck_input_report_t *report);
+
+/* Function to count a switch between two pages, saturating */
+void deck_state_page_switch(deck_state_t *state, uint32_t from, uint32_t to);
+
+/* The page most often switched to from page from (of the first page_count),
+ * UINT32_MAX when no switch out of it was seen
+ */
+uint32_t deck_state_likely_next(const deck_state_t *state, uint32_t from,
+                                uint32_t page_count);
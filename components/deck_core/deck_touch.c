@@ -0,0 +1,13 @@
+#include "deck_touch.h"
+
+void deck_touch_transform(const deck_touch_map_t *map, uint16_t raw_x,
+                          uint16_t raw_y, int32_t *x, int32_t *y) {
+  int32_t px = map->swap_xy ? raw_y : raw_x;
+  int32_t py = map->swap_xy ? raw_x : raw_y;
+  if (map->mirror_x)
+    px = map->width - 1 - px;
+  if (map->mirror_y)
+    py = map->height - 1 - py;
+  *x = px;
+  *y = py;
+}
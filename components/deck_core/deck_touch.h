@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Mapping of touch controller coordinates onto the display. Applied in
+ * order: swap the axes, then mirror each axis inside width/height (the
+ * display's resolution), so 0 becomes the last pixel, width - 1.
+ */
+typedef struct {
+  uint16_t width;
+  uint16_t height;
+  bool swap_xy;
+  bool mirror_x;
+  bool mirror_y;
+} deck_touch_map_t;
+
+void deck_touch_transform(const deck_touch_map_t *map, uint16_t raw_x,
+                          uint16_t raw_y, int32_t *x, int32_t *y);
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdio.h>
+
+/* Minimal test runner: a failed check is printed and counted, the test
+ * goes on so one run shows every failure.
+ */
+extern int deck_test_checks;
+extern int deck_test_failures;
+
+#define CHECK(cond)                                                          \
+  do {                                                                       \
+    deck_test_checks++;                                                      \
+    if (!(cond)) {                                                           \
+      deck_test_failures++;                                                  \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);        \
+    }                                                                        \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                       \
+  do {                                                                       \
+    long long _a = (long long)(a);                                           \
+    long long _b = (long long)(b);                                           \
+    deck_test_checks++;                                                      \
+    if (_a != _b) {                                                          \
+      deck_test_failures++;                                                  \
+      printf("%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__,  \
+             #a, #b, _a, _b);                                                \
+    }                                                                        \
+  } while (0)
+
+/* One function per source file, called by test_main.c */
+void test_report(void);
+void test_state(void);
+void test_live_proto(void);
+void test_touch(void);
+void test_area(void);
+void test_persist(void);
+void test_profile(void);
@@ -0,0 +1,155 @@
+#include "deck_area.h"
+#include "deck_test.h"
+#include <string.h>
+
+static void test_wrap(void) {
+  CHECK_EQ(deck_scroll_wrap(0, 480), 0);
+  CHECK_EQ(deck_scroll_wrap(479, 480), 479);
+  CHECK_EQ(deck_scroll_wrap(480, 480), 0);
+  CHECK_EQ(deck_scroll_wrap(-1, 480), 479);
+  CHECK_EQ(deck_scroll_wrap(-961, 480), 479);
+}
+
+static void test_split_unscrolled(void) {
+  deck_span_t spans[DECK_SCROLL_SPANS_MAX];
+  uint32_t n = deck_scroll_split(0, 480, 0, 100, 199, spans);
+  CHECK_EQ(n, 1);
+  CHECK_EQ(spans[0].a1, 100);
+  CHECK_EQ(spans[0].a2, 199);
+  CHECK_EQ(spans[0].q1, 100);
+}
+
+static void test_split_wrap(void) {
+  deck_span_t spans[DECK_SCROLL_SPANS_MAX];
+  // Shifted by 400 inside [0, 480): 0..79 lands at 400..479, the rest wraps
+  uint32_t n = deck_scroll_split(0, 480, 400, 0, 479, spans);
+  CHECK_EQ(n, 2);
+  CHECK_EQ(spans[0].a1, 0);
+  CHECK_EQ(spans[0].a2, 79);
+  CHECK_EQ(spans[0].q1, 400);
+  CHECK_EQ(spans[1].a1, 80);
+  CHECK_EQ(spans[1].a2, 479);
+  CHECK_EQ(spans[1].q1, 0);
+
+  // Negative shifts wrap the other way
+  n = deck_scroll_split(0, 480, -10, 0, 19, spans);
+  CHECK_EQ(n, 2);
+  CHECK_EQ(spans[0].q1, 470);
+  CHECK_EQ(spans[0].a2, 9);
+  CHECK_EQ(spans[1].a1, 10);
+  CHECK_EQ(spans[1].q1, 0);
+}
+
+static void test_split_fixed_parts(void) {
+  deck_span_t spans[DECK_SCROLL_SPANS_MAX];
+  // Region [100, 300) shifted by 150, the area covers everything
+  uint32_t n = deck_scroll_split(100, 200, 150, 0, 399, spans);
+  CHECK_EQ(n, 4);
+  CHECK_EQ(spans[0].a1, 0);
+  CHECK_EQ(spans[0].a2, 99);
+  CHECK_EQ(spans[0].q1, 0);
+  CHECK_EQ(spans[1].a1, 100);
+  CHECK_EQ(spans[1].a2, 149);
+  CHECK_EQ(spans[1].q1, 250);
+  CHECK_EQ(spans[2].a1, 150);
+  CHECK_EQ(spans[2].a2, 299);
+  CHECK_EQ(spans[2].q1, 100);
+  CHECK_EQ(spans[3].a1, 300);
+  CHECK_EQ(spans[3].a2, 399);
+  CHECK_EQ(spans[3].q1, 300);
+
+  // Every line is written exactly once
+  int32_t lines = 0;
+  for (uint32_t i = 0; i < n; i++)
+    lines += spans[i].a2 - spans[i].a1 + 1;
+  CHECK_EQ(lines, 400);
+}
+
+static void test_hash(void) {
+  uint16_t a[4 * 4] = {0};
+  uint16_t b[4 * 4] = {0};
+  CHECK_EQ(deck_tile_hash((uint8_t *)a, 8, 4, 4),
+           deck_tile_hash((uint8_t *)b, 8, 4, 4));
+  b[5] = 1;
+  CHECK(deck_tile_hash((uint8_t *)a, 8, 4, 4) !=
+        deck_tile_hash((uint8_t *)b, 8, 4, 4));
+  // Only the w x h block counts, not the rest of the stride
+  CHECK_EQ(deck_tile_hash((uint8_t *)a, 8, 1, 4),
+           deck_tile_hash((uint8_t *)b, 8, 1, 4));
+}
+
+/* Decoder matching lv_rle_decompress with 2 byte blocks */
+static size_t rle_decode(const uint8_t *in, size_t len, uint16_t *out) {
+  size_t n = 0;
+  size_t pos = 0;
+  while (pos < len) {
+    uint8_t ctrl = in[pos++];
+    if (ctrl & 0x80) {
+      memcpy(out + n, in + pos, (ctrl & 0x7F) * 2);
+      n += ctrl & 0x7F;
+      pos += (ctrl & 0x7F) * 2;
+    } else {
+      for (int i = 0; i < ctrl; i++)
+        memcpy(out + n++, in + pos, 2);
+      pos += 2;
+    }
+  }
+  return n;
+}
+
+static void test_rle(void) {
+  uint16_t px[300];
+  for (int i = 0; i < 300; i++)
+    px[i] = i < 200 ? 0x1234 : i % 7 == 0 ? 0 : i;
+  uint8_t enc[700];
+  size_t len = deck_rle_encode(px, 300, enc, sizeof(enc));
+  CHECK(len > 0 && len < 300 * 2);
+
+  uint16_t dec[300];
+  CHECK_EQ(rle_decode(enc, len, dec), 300);
+  CHECK(memcmp(px, dec, sizeof(px)) == 0);
+
+  // Noise does not get smaller than raw
+  for (int i = 0; i < 300; i++)
+    px[i] = i * 31;
+  CHECK_EQ(deck_rle_encode(px, 300, enc, 300 * 2), 0);
+}
+
+static void test_rle_reader(void) {
+  uint16_t px[1000];
+  for (int i = 0; i < 1000; i++)
+    px[i] = i % 300 < 200 ? 0x1234 : i % 7 == 0 ? 0 : i;
+  uint8_t enc[2100];
+  size_t len = deck_rle_encode(px, 1000, enc, sizeof(enc));
+  CHECK(len > 0);
+
+  // Chunks that end inside runs and literals alike
+  uint16_t dec[1000];
+  deck_rle_reader_t r;
+  deck_rle_reader_init(&r, enc, len);
+  size_t n = 0;
+  for (size_t chunk = 1; n < 1000; chunk = chunk * 3 % 97 + 1) {
+    size_t got = deck_rle_read(&r, dec + n, chunk);
+    if (got == 0)
+      break;
+    n += got;
+  }
+  CHECK_EQ(n, 1000);
+  CHECK(memcmp(px, dec, sizeof(px)) == 0);
+  CHECK_EQ(deck_rle_read(&r, dec, 1), 0);
+
+  // Cut off data ends early instead of reading past it
+  deck_rle_reader_init(&r, enc, len - 1);
+  CHECK(deck_rle_read(&r, dec, 1000) < 1000);
+  CHECK_EQ(deck_rle_read(&r, dec, 1000), 0);
+}
+
+void test_area(void) {
+  test_wrap();
+  test_split_unscrolled();
+  test_split_wrap();
+  test_split_fixed_parts();
+  test_hash();
+  test_rle();
+  test_rle_reader();
+}
@@ -0,0 +1,109 @@
+#include "deck_live_proto.h"
+#include "deck_test.h"
+#include <string.h>
+
+static void test_records(void) {
+  const uint8_t report[] = {
+      3, DECK_LIVE_OP_CONFIG, DECK_LIVE_READOUT, DECK_LIVE_FORMAT_INT, 4,
+      0x00, 0x80, 0xFF, 0x7F,                            // min, max
+      3, DECK_LIVE_OP_VALUE, 0x2A, 0x00, 0x00, 0x00,     // 42
+      9, DECK_LIVE_OP_SAMPLES, 2, 0x01, 0x00, 0xFF, 0xFF, // 1, -1
+      3, DECK_LIVE_OP_REMOVE,                            //
+      DECK_LIVE_OP_END, DECK_LIVE_OP_END, 7, 7,          // ignored
+  };
+  deck_live_reader_t reader;
+  deck_live_record_t rec;
+  deck_live_reader_init(&reader, report, sizeof(report));
+
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_RECORD);
+  CHECK_EQ(rec.key, 3);
+  CHECK_EQ(rec.op, DECK_LIVE_OP_CONFIG);
+  CHECK_EQ(rec.args_len, 7);
+  CHECK_EQ(deck_live_get_le16(rec.args + 3), INT16_MIN);
+  CHECK_EQ(deck_live_get_le16(rec.args + 5), INT16_MAX);
+
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_RECORD);
+  CHECK_EQ(rec.op, DECK_LIVE_OP_VALUE);
+  CHECK_EQ(deck_live_get_le32(rec.args), 42);
+
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_RECORD);
+  CHECK_EQ(rec.key, 9);
+  CHECK_EQ(rec.args_len, 5);
+  CHECK_EQ(deck_live_get_le16(rec.args + 3), -1);
+
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_RECORD);
+  CHECK_EQ(rec.op, DECK_LIVE_OP_REMOVE);
+  CHECK_EQ(rec.args_len, 0);
+
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_END);
+}
+
+static void test_config(void) {
+  const uint8_t args[] = {DECK_LIVE_METER, DECK_LIVE_FORMAT_TENTHS, 5,
+                          0x9C, 0xFF, 0xE8, 0x03}; // min -100, max 1000
+  deck_live_config_t cfg;
+  deck_live_get_config(args, &cfg);
+  CHECK_EQ(cfg.type, DECK_LIVE_METER);
+  CHECK_EQ(cfg.format, DECK_LIVE_FORMAT_TENTHS);
+  CHECK_EQ(cfg.digits, 5);
+  CHECK_EQ(cfg.min, -100);
+  CHECK_EQ(cfg.max, 1000);
+}
+
+static void test_bad_records(void) {
+  deck_live_reader_t reader;
+  deck_live_record_t rec;
+
+  // Value cut off by the end of the report
+  const uint8_t short_value[] = {1, DECK_LIVE_OP_VALUE, 1, 2};
+  deck_live_reader_init(&reader, short_value, sizeof(short_value));
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_BAD);
+  CHECK_EQ(reader.pos, 0);
+
+  // More samples announced than present
+  const uint8_t short_samples[] = {1, DECK_LIVE_OP_SAMPLES, 3, 1, 0};
+  deck_live_reader_init(&reader, short_samples, sizeof(short_samples));
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_BAD);
+
+  const uint8_t unknown[] = {1, DECK_LIVE_OP_REMOVE, 1, 99};
+  deck_live_reader_init(&reader, unknown, sizeof(unknown));
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_RECORD);
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_BAD);
+  CHECK_EQ(reader.pos, 2);
+
+  // A lone key byte is the end of the report
+  const uint8_t lone[] = {1};
+  deck_live_reader_init(&reader, lone, sizeof(lone));
+  CHECK_EQ(deck_live_read(&reader, &rec), DECK_LIVE_READ_END);
+}
+
+static int format_is(uint8_t format, uint8_t digits, int32_t value,
+                     const char *expected) {
+  char out[DECK_LIVE_DIGITS_MAX + 1] = {0};
+  deck_live_format(format, digits, value, out);
+  if (strcmp(out, expected) == 0)
+    return 1;
+  printf("  format %u/%u of %ld: '%s', expected '%s'\n", format, digits,
+         (long)value, out, expected);
+  return 0;
+}
+
+static void test_format(void) {
+  CHECK(format_is(DECK_LIVE_FORMAT_INT, 4, 42, "  42"));
+  CHECK(format_is(DECK_LIVE_FORMAT_INT, 3, -42, "-42"));
+  CHECK(format_is(DECK_LIVE_FORMAT_INT, 3, 1234, "---"));
+  CHECK(format_is(DECK_LIVE_FORMAT_DURATION, 5, 65, " 1:05"));
+  CHECK(format_is(DECK_LIVE_FORMAT_DURATION, 7, 3725, "1:02:05"));
+  CHECK(format_is(DECK_LIVE_FORMAT_DURATION, 5, -59, "-0:59"));
+  CHECK(format_is(DECK_LIVE_FORMAT_DURATION, 5, -65, "-1:05"));
+  CHECK(format_is(DECK_LIVE_FORMAT_DURATION, 8, -3725, "-1:02:05"));
+  CHECK(format_is(DECK_LIVE_FORMAT_TENTHS, 5, 215, " 21.5"));
+  CHECK(format_is(DECK_LIVE_FORMAT_TENTHS, 4, -5, "-0.5"));
+}
+
+void test_live_proto(void) {
+  test_records();
+  test_config();
+  test_bad_records();
+  test_format();
+}
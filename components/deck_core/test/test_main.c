@@ -0,0 +1,25 @@
+#include "deck_test.h"
+
+int deck_test_checks;
+int deck_test_failures;
+
+static const struct {
+  const char *name;
+  void (*run)(void);
+} suites[] = {
+    {"report", test_report},         {"state", test_state},
+    {"live_proto", test_live_proto}, {"touch", test_touch},
+    {"area", test_area},             {"persist", test_persist},
+    {"profile", test_profile},
+};
+
+int main(void) {
+  for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+    int failures = deck_test_failures;
+    suites[i].run();
+    printf("%-12s %s\n", suites[i].name,
+           deck_test_failures == failures ? "ok" : "FAILED");
+  }
+  printf("%d checks, %d failed\n", deck_test_checks, deck_test_failures);
+  return deck_test_failures ? 1 : 0;
+}
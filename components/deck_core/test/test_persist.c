@@ -0,0 +1,93 @@
+#include "deck_persist.h"
+#include "deck_test.h"
+#include <string.h>
+
+static deck_persist_t sample(void) {
+  deck_persist_t p = {
+      .state = DECK_STATE_INITIALIZER, .profile = "OBS", .page = 3};
+  p.state.sliders[1] = 70;
+  p.state.transitions[0][3] = 5;
+  p.state.transitions[3][0] = 255;
+  p.live[0] = (deck_persist_live_t){
+      .key = 10,
+      .cfg = {DECK_LIVE_SPARKLINE, DECK_LIVE_FORMAT_INT, 4, -100, 100}};
+  p.live[1] = (deck_persist_live_t){
+      .key = 127,
+      .cfg = {DECK_LIVE_METER, DECK_LIVE_FORMAT_TENTHS, 8, INT16_MIN,
+              INT16_MAX}};
+  p.live_count = 2;
+  return p;
+}
+
+static void test_round_trip(void) {
+  deck_persist_t p = sample();
+  uint8_t buf[DECK_PERSIST_SIZE_MAX];
+  size_t len = deck_persist_encode(&p, buf, sizeof(buf));
+  // Version, five section headers, 3 sliders, page, 2 switches, 2 keys,
+  // profile name
+  CHECK_EQ(len, 1 + 5 * 3 + 3 + 1 + 2 * 3 + 2 * 8 + 3);
+
+  deck_persist_t q = {.state = DECK_STATE_INITIALIZER};
+  q.state.transitions[5][6] = 1; // replaced, not merged
+  CHECK(deck_persist_decode(buf, len, &q));
+  CHECK_EQ(q.page, 3);
+  CHECK(strcmp(q.profile, "OBS") == 0);
+  CHECK_EQ(q.state.sliders[0], 50);
+  CHECK_EQ(q.state.sliders[1], 70);
+  CHECK(memcmp(&q.state, &p.state, sizeof(p.state)) == 0);
+  CHECK_EQ(q.live_count, 2);
+  CHECK_EQ(q.live[1].key, 127);
+  CHECK_EQ(q.live[1].cfg.type, DECK_LIVE_METER);
+  CHECK_EQ(q.live[1].cfg.digits, 8);
+  CHECK_EQ(q.live[1].cfg.min, INT16_MIN);
+  CHECK_EQ(q.live[0].cfg.min, -100);
+
+  // Too small a buffer fails as a whole
+  CHECK_EQ(deck_persist_encode(&p, buf, len - 1), 0);
+}
+
+static void test_worst_case(void) {
+  deck_persist_t p = {.state = DECK_STATE_INITIALIZER};
+  memset(p.state.transitions, 1, sizeof(p.state.transitions));
+  for (uint32_t i = 0; i < DECK_PERSIST_LIVE_MAX; i++)
+    p.live[i].key = i;
+  p.live_count = DECK_PERSIST_LIVE_MAX;
+  memset(p.profile, 'x', DECK_PROFILE_NAME_MAX);
+  static uint8_t buf[DECK_PERSIST_SIZE_MAX];
+  CHECK_EQ(deck_persist_encode(&p, buf, sizeof(buf)), DECK_PERSIST_SIZE_MAX);
+}
+
+static void test_compat(void) {
+  deck_persist_t p = sample();
+  uint8_t buf[DECK_PERSIST_SIZE_MAX + 8];
+  size_t len = deck_persist_encode(&p, buf, sizeof(buf));
+
+  // A section of a newer firmware is skipped
+  const uint8_t extra[] = {200, 2, 0, 0xAA, 0xBB};
+  memcpy(buf + len, extra, sizeof(extra));
+  deck_persist_t q = {0};
+  CHECK(deck_persist_decode(buf, len + sizeof(extra), &q));
+  CHECK_EQ(q.page, 3);
+
+  // Another version, or a cut off section, is not read
+  CHECK(!deck_persist_decode(buf, len - 1, &q));
+  buf[0] = DECK_PERSIST_VERSION + 1;
+  CHECK(!deck_persist_decode(buf, len, &q));
+  CHECK(!deck_persist_decode(buf, 0, &q));
+
+  // Entries out of range are dropped
+  const uint8_t bad[] = {DECK_PERSIST_VERSION, DECK_PERSIST_SWITCHES, 6, 0,
+                         DECK_PAGE_MAX, 0, 9, 1, 2, 7};
+  memset(&q, 0, sizeof(q));
+  strcpy(q.profile, "DAW"); // no profile section, kept
+  CHECK(deck_persist_decode(bad, sizeof(bad), &q));
+  CHECK_EQ(q.state.transitions[1][2], 7);
+  CHECK_EQ(q.state.transitions[0][0], 0);
+  CHECK(strcmp(q.profile, "DAW") == 0);
+}
+
+void test_persist(void) {
+  test_round_trip();
+  test_worst_case();
+  test_compat();
+}
@@ -0,0 +1,176 @@
+#include "deck_profile.h"
+#include "deck_test.h"
+#include <string.h>
+
+/* Two profiles: "OBS" with a root page and a folder, "DAW" with one page */
+typedef struct __attribute__((packed)) {
+  deck_profile_header_t hdr;
+  deck_profile_entry_t entries[2];
+  deck_profile_page_t pages[3];
+  char strings[32];
+} sample_t;
+
+/* Offset of the pool string starting with text */
+static uint32_t pool_offset(const sample_t *s, const char *text) {
+  for (uint32_t i = 1; i < sizeof(s->strings); i++) {
+    if (s->strings[i - 1] == '\0' &&
+        strncmp(s->strings + i, text, strlen(text)) == 0)
+      return offsetof(sample_t, strings) + i;
+  }
+  return 0;
+}
+
+static void sample(sample_t *s) {
+  memset(s, 0, sizeof(*s));
+  // Pool: "\0OBS\0DAW\0Scenes\0Back\0obs64\nobs\0" fits in 32 bytes
+  memcpy(s->strings, "\0OBS\0DAW\0Scenes\0Back\0obs64\nobs", 31);
+  s->hdr = (deck_profile_header_t){
+      .magic = DECK_PROFILE_MAGIC,
+      .version = DECK_PROFILE_VERSION,
+      .count = 2,
+      .size = sizeof(*s),
+      .pages = offsetof(sample_t, pages),
+      .page_count = 3,
+      .strings = offsetof(sample_t, strings),
+      .strings_size = sizeof(s->strings),
+  };
+  s->entries[0] = (deck_profile_entry_t){.name = pool_offset(s, "OBS"),
+                                         .apps = pool_offset(s, "obs64"),
+                                         .page_count = 2};
+  s->entries[1] = (deck_profile_entry_t){
+      .name = pool_offset(s, "DAW"), .first_page = 2, .page_count = 1};
+
+  s->pages[0].parent = DECK_PROFILE_ROOT;
+  s->pages[0].buttons[0] = (deck_profile_button_t){
+      .label = pool_offset(s, "Scenes"), .action = 1, .target = 1};
+  s->pages[1].name = pool_offset(s, "Scenes");
+  s->pages[1].parent = 0;
+  s->pages[1].buttons[7] = (deck_profile_button_t){
+      .label = pool_offset(s, "Back"), .action = 2};
+  s->pages[2].parent = DECK_PROFILE_ROOT;
+}
+
+static void test_valid(void) {
+  sample_t s;
+  sample(&s);
+  const uint8_t *data = (const uint8_t *)&s;
+  CHECK(deck_profile_check(data, sizeof(s)));
+  // Trailing flash after the container does not matter
+  CHECK(deck_profile_check(data, sizeof(s) + 100));
+
+  CHECK_EQ(deck_profile_find(data, "OBS"), 0);
+  CHECK_EQ(deck_profile_find(data, "DAW"), 1);
+  CHECK_EQ(deck_profile_find(data, "IDE"), -1);
+  CHECK_EQ(deck_profile_find(data, "OB"), -1);
+
+  const deck_profile_entry_t *e = deck_profile_entry(data, 1);
+  CHECK(strcmp(deck_profile_string(data, e->name), "DAW") == 0);
+  CHECK(deck_profile_string(data, e->apps) == NULL);
+  CHECK(deck_profile_pages(data, e) == &s.pages[2]);
+
+  e = deck_profile_entry(data, 0);
+  CHECK(strcmp(deck_profile_string(data, e->apps), "obs64\nobs") == 0);
+  const deck_profile_page_t *pages = deck_profile_pages(data, e);
+  CHECK(strcmp(deck_profile_string(data, pages[1].buttons[7].label),
+               "Back") == 0);
+}
+
+static void test_invalid(void) {
+  sample_t s;
+  const uint8_t *data = (const uint8_t *)&s;
+
+  sample(&s);
+  CHECK(!deck_profile_check(data, sizeof(s) - 1)); // cut off
+  s.hdr.version++;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.pages[0].buttons[0].target = 2; // a page of the other profile
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.pages[2].parent = 1;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.pages[1].buttons[3].action = DECK_PROFILE_ACTION_MAX + 1;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.pages[1].slider_names[2] = offsetof(sample_t, pages); // not in the pool
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.strings[sizeof(s.strings) - 1] = 'x'; // last string not terminated
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.entries[1].name = s.entries[0].name;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.entries[1].page_count = 2; // past the page table
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.entries[0].name = 0;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+
+  sample(&s);
+  s.hdr.count = 0xFFFF;
+  CHECK(!deck_profile_check(data, sizeof(s)));
+}
+
+static void test_find_app(void) {
+  sample_t s;
+  sample(&s);
+  const uint8_t *data = (const uint8_t *)&s;
+  CHECK_EQ(deck_profile_find_app(data, "obs64", 5), 0);
+  CHECK_EQ(deck_profile_find_app(data, "OBS", 3), 0);
+  // Not terminated, case ignored
+  CHECK_EQ(deck_profile_find_app(data, "Obs64.exe", 5), 0);
+  CHECK_EQ(deck_profile_find_app(data, "daw", 3), 1);
+  CHECK_EQ(deck_profile_find_app(data, "obs6", 4), -1);
+  CHECK_EQ(deck_profile_find_app(data, "obs64\nobs", 9), -1);
+  CHECK_EQ(deck_profile_find_app(data, "", 0), -1);
+}
+
+static void test_history(void) {
+  deck_profile_history_t h = {0};
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), UINT32_MAX);
+  deck_profile_history_push(&h, 0);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), UINT32_MAX);
+
+  // Back to the previous profile before anything followed this one
+  deck_profile_history_push(&h, 1);
+  deck_profile_history_push(&h, 1);
+  CHECK_EQ(h.count, 2);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 1), 0);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), 1);
+
+  // 0 -> 1 twice long ago weighs 1 + 3, 0 -> 2 once lately 5
+  deck_profile_history_push(&h, 0);
+  deck_profile_history_push(&h, 1);
+  deck_profile_history_push(&h, 0);
+  deck_profile_history_push(&h, 2);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), 2);
+  deck_profile_history_push(&h, 0);
+  deck_profile_history_push(&h, 1);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), 1);
+  CHECK_EQ(deck_profile_history_likely_next(&h, DECK_PROFILE_BUILTIN),
+           UINT32_MAX);
+
+  // A full history drops its oldest switches
+  for (int i = 0; i < DECK_PROFILE_HISTORY; i++)
+    deck_profile_history_push(&h, i % 2 ? 3 : 4);
+  CHECK_EQ(h.count, DECK_PROFILE_HISTORY);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 0), UINT32_MAX);
+  CHECK_EQ(deck_profile_history_likely_next(&h, 3), 4);
+}
+
+void test_profile(void) {
+  test_valid();
+  test_invalid();
+  test_find_app();
+  test_history();
+}
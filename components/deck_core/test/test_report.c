@@ -0,0 +1,46 @@
+#include "deck_report.h"
+#include "deck_test.h"
+
+static void test_press(void) {
+  deck_input_report_t r = {0};
+  deck_report_press(&r, 1);
+  deck_report_press(&r, 8);
+  CHECK_EQ(r.buttons, 0x81);
+  CHECK(r.btn1 && r.btn8 && !r.btn2);
+
+  // Out of range IDs leave the report alone
+  deck_report_press(&r, 0);
+  deck_report_press(&r, 9);
+  CHECK_EQ(r.buttons, 0x81);
+}
+
+static void test_merge(void) {
+  deck_input_report_t pending = {.buttons = 0x01, .slider1 = 10,
+                                 .slider2 = 20, .slider3 = 30};
+  deck_input_report_t next = {.buttons = 0x04, .slider1 = 11, .slider2 = 21,
+                              .slider3 = 31};
+  deck_report_merge(&pending, &next);
+  CHECK_EQ(pending.buttons, 0x05);
+  CHECK_EQ(pending.slider1, 11);
+  CHECK_EQ(pending.slider2, 21);
+  CHECK_EQ(pending.slider3, 31);
+
+  // A slider update keeps the press it is queued behind
+  deck_input_report_t slider = {.slider1 = 50};
+  deck_report_merge(&pending, &slider);
+  CHECK_EQ(pending.buttons, 0x05);
+  CHECK_EQ(pending.slider1, 50);
+}
+
+static void test_state_word(void) {
+  CHECK_EQ(sizeof(deck_input_report_t), 4);
+  deck_input_report_t r = {.buttons = 0x12, .slider1 = 0x34, .slider2 = 0x56,
+                           .slider3 = 0x78};
+  CHECK_EQ(deck_report_state(&r), 0x78563412);
+}
+
+void test_report(void) {
+  test_press();
+  test_merge();
+  test_state_word();
+}
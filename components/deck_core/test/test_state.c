@@ -0,0 +1,48 @@
+#include "deck_state.h"
+#include "deck_test.h"
+
+static void test_sliders(void) {
+  deck_state_t s = DECK_STATE_INITIALIZER;
+  CHECK_EQ(s.sliders[0], 50);
+  CHECK_EQ(s.sliders[2], 50);
+
+  deck_state_set_slider(&s, 0, 30);
+  deck_state_set_slider(&s, 1, -5);
+  deck_state_set_slider(&s, 2, 1000);
+  deck_state_set_slider(&s, 3, 1); // ignored
+  deck_input_report_t r = {.buttons = 0x02};
+  deck_state_fill_report(&s, &r);
+  CHECK_EQ(r.buttons, 0x02);
+  CHECK_EQ(r.slider1, 30);
+  CHECK_EQ(r.slider2, 0);
+  CHECK_EQ(r.slider3, 255);
+}
+
+static void test_transitions(void) {
+  deck_state_t s = DECK_STATE_INITIALIZER;
+  CHECK_EQ(deck_state_likely_next(&s, 0, 4), UINT32_MAX);
+
+  deck_state_page_switch(&s, 0, 2);
+  deck_state_page_switch(&s, 0, 3);
+  deck_state_page_switch(&s, 0, 3);
+  deck_state_page_switch(&s, 0, 0); // not a switch
+  CHECK_EQ(deck_state_likely_next(&s, 0, 4), 3);
+  // Pages beyond the current count are not predicted
+  CHECK_EQ(deck_state_likely_next(&s, 0, 3), 2);
+  CHECK_EQ(deck_state_likely_next(&s, 1, 4), UINT32_MAX);
+
+  // Counts saturate instead of wrapping to zero
+  for (int i = 0; i < 300; i++)
+    deck_state_page_switch(&s, 1, 2);
+  CHECK_EQ(s.transitions[1][2], 255);
+  CHECK_EQ(deck_state_likely_next(&s, 1, 4), 2);
+
+  deck_state_page_switch(&s, DECK_PAGE_MAX, 0);
+  CHECK_EQ(deck_state_likely_next(&s, DECK_PAGE_MAX, DECK_PAGE_MAX),
+           UINT32_MAX);
+}
+
+void test_state(void) {
+  test_sliders();
+  test_transitions();
+}
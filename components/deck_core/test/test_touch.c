@@ -0,0 +1,29 @@
+#include "deck_test.h"
+#include "deck_touch.h"
+
+void test_touch(void) {
+  int32_t x, y;
+
+  deck_touch_map_t identity = {.width = 480, .height = 320};
+  deck_touch_transform(&identity, 10, 20, &x, &y);
+  CHECK_EQ(x, 10);
+  CHECK_EQ(y, 20);
+
+  // The deck's GT911 in inverted landscape
+  deck_touch_map_t deck = {.width = 480, .height = 320, .swap_xy = true,
+                           .mirror_y = true};
+  deck_touch_transform(&deck, 10, 20, &x, &y);
+  CHECK_EQ(x, 20);
+  CHECK_EQ(y, 309);
+  deck_touch_transform(&deck, 319, 0, &x, &y);
+  CHECK_EQ(x, 0);
+  CHECK_EQ(y, 0);
+
+  deck_touch_map_t mirrored = {.width = 480, .height = 320, .mirror_x = true};
+  deck_touch_transform(&mirrored, 0, 0, &x, &y);
+  CHECK_EQ(x, 479);
+  CHECK_EQ(y, 0);
+  deck_touch_transform(&mirrored, 479, 319, &x, &y);
+  CHECK_EQ(x, 0);
+  CHECK_EQ(y, 319);
+}
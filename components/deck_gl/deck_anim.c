@@ -0,0 +1,305 @@
+#include "deck_assets.h"
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_private.h"
+#if LV_USE_LZ4_INTERNAL
+#include "src/libs/lz4/lz4.h"
+#endif
+#include <inttypes.h>
+#include <string.h>
+
+/* Period of the timer swapping in decoded frames, bounds the frame jitter */
+#define ANIM_TIMER_MS 5
+/* The decoder runs next to the touch and USB tasks on core 0, below them and
+ * below the draw threads
+ */
+#define ANIM_TASK_CORE 0
+#define ANIM_TASK_PRIO 2
+/* Interval of the frame rate log */
+#define ANIM_LOG_PERIOD_MS 10000
+
+/* One animated key. The LVGL side shows frame[front] while the decoder fills
+ * the other buffer; back_ready hands the buffer over in both directions.
+ */
+typedef struct {
+  lv_obj_t *image;
+  const uint8_t *data;
+  const deck_anim_header_t *hdr;
+  const deck_anim_frame_t *frames;
+  lv_image_dsc_t frame[2];
+  uint8_t front;
+  volatile bool back_ready;
+  uint16_t back_index;
+  int64_t deadline_us;
+} anim_key_t;
+
+static anim_key_t keys[DECK_ANIM_MAX];
+static SemaphoreHandle_t anim_lock;
+static TaskHandle_t anim_worker;
+static lv_timer_t *anim_timer;
+static portMUX_TYPE anim_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static deck_anim_stats_t anim_stats;
+static deck_anim_stats_t anim_stats_logged;
+static int64_t anim_log_us;
+
+static bool anim_decode(anim_key_t *k, uint16_t index, uint8_t *out) {
+  const deck_anim_frame_t *f = &k->frames[index];
+  const uint8_t *in = k->data + f->offset;
+  uint32_t len = (uint32_t)k->hdr->w * k->hdr->h * 2;
+
+  switch (f->method) {
+  case 0:
+    if (f->size != len)
+      return false;
+    memcpy(out, in, len);
+    return true;
+  case 1:
+    return lv_rle_decompress(in, f->size, out, len, 2) == len;
+#if LV_USE_LZ4_INTERNAL
+  case 2:
+    return LZ4_decompress_safe((const char *)in, (char *)out, f->size, len) ==
+           (int)len;
+#endif
+  default:
+    return false;
+  }
+}
+
+/* Decodes the next frame of every key whose back buffer was handed back */
+static void anim_task(void *arg) {
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    xSemaphoreTake(anim_lock, portMAX_DELAY);
+    for (int i = 0; i < DECK_ANIM_MAX; i++) {
+      anim_key_t *k = &keys[i];
+      if (k->image == NULL || k->back_ready)
+        continue;
+
+      int64_t start = esp_timer_get_time();
+      uint8_t *back = (uint8_t *)k->frame[k->front ^ 1].data;
+      bool ok = anim_decode(k, k->back_index, back);
+      uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+      portENTER_CRITICAL(&anim_stats_lock);
+      anim_stats.decoded++;
+      anim_stats.decode_us += us;
+      if (us > anim_stats.max_decode_us)
+        anim_stats.max_decode_us = us;
+      if (!ok)
+        anim_stats.errors++;
+      portEXIT_CRITICAL(&anim_stats_lock);
+      // A broken frame leaves an older frame in the buffer, shown instead
+      k->back_ready = true;
+    }
+    xSemaphoreGive(anim_lock);
+  }
+}
+
+static void anim_log_stats(int64_t now) {
+  if (now - anim_log_us < ANIM_LOG_PERIOD_MS * 1000)
+    return;
+
+  deck_anim_stats_t s;
+  deck_anim_get_stats(&s);
+  uint32_t shown = s.shown - anim_stats_logged.shown;
+  uint32_t dropped = s.dropped - anim_stats_logged.dropped;
+  uint32_t decoded = s.decoded - anim_stats_logged.decoded;
+  uint64_t decode_us = s.decode_us - anim_stats_logged.decode_us;
+  if (shown > 0 || dropped > 0) {
+    ESP_LOG_LEVEL(dropped > 0 ? ESP_LOG_INFO : ESP_LOG_DEBUG, "ANIM",
+                  "%" PRIu32 " frames shown (%.1f fps), %" PRIu32
+                  " dropped, decode avg %" PRIu32 " us max %" PRIu32 " us",
+                  shown, shown * 1e6f / (float)(now - anim_log_us), dropped,
+                  decoded ? (uint32_t)(decode_us / decoded) : 0,
+                  s.max_decode_us);
+  }
+  anim_stats_logged = s;
+  anim_log_us = now;
+}
+
+/* Swaps in the decoded frames that are due, invalidating only their keys */
+static void anim_timer_cb(lv_timer_t *timer) {
+  int64_t now = esp_timer_get_time();
+  lv_obj_t *screen = lv_screen_active();
+  bool wake = false;
+
+  for (int i = 0; i < DECK_ANIM_MAX; i++) {
+    anim_key_t *k = &keys[i];
+    // Keys of cached pages are paused until their page is shown again
+    if (k->image == NULL || k->hdr->frame_count < 2 ||
+        lv_obj_get_screen(k->image) != screen) {
+      k->deadline_us = 0;
+      continue;
+    }
+    if (k->deadline_us != 0 && now < k->deadline_us)
+      continue;
+
+    if (!k->back_ready) {
+      // Decoder behind, the deadline passes with the old frame on screen
+      if (k->deadline_us != 0) {
+        portENTER_CRITICAL(&anim_stats_lock);
+        anim_stats.dropped++;
+        portEXIT_CRITICAL(&anim_stats_lock);
+        k->deadline_us += k->frames[k->back_index].delay_ms * 1000;
+      }
+      continue;
+    }
+
+    k->front ^= 1;
+    lv_image_dsc_t *dsc = &k->frame[k->front];
+    // Same pointer, new pixels: drop what the image cache knows about it.
+    // Setting the source invalidates the image, not the whole button.
+    lv_image_cache_drop(dsc);
+    lv_image_set_src(k->image, dsc);
+
+    uint32_t delay_us = k->frames[k->back_index].delay_ms * 1000;
+    // Keep the cadence, unless the key fell more than a frame behind
+    if (k->deadline_us == 0 || now - k->deadline_us > delay_us)
+      k->deadline_us = now;
+    k->deadline_us += delay_us;
+    k->back_index = (k->back_index + 1) % k->hdr->frame_count;
+    k->back_ready = false;
+    wake = true;
+
+    portENTER_CRITICAL(&anim_stats_lock);
+    anim_stats.shown++;
+    portEXIT_CRITICAL(&anim_stats_lock);
+  }
+
+  if (wake)
+    xTaskNotifyGive(anim_worker);
+  anim_log_stats(now);
+}
+
+static void anim_key_release(anim_key_t *k) {
+  xSemaphoreTake(anim_lock, portMAX_DELAY);
+  for (int b = 0; b < 2; b++) {
+    lv_image_cache_drop(&k->frame[b]);
+    heap_caps_free((void *)k->frame[b].data);
+  }
+  memset(k, 0, sizeof(*k));
+  xSemaphoreGive(anim_lock);
+}
+
+static void anim_delete_event_cb(lv_event_t *e) {
+  lv_obj_t *image = lv_event_get_target(e);
+  for (int i = 0; i < DECK_ANIM_MAX; i++) {
+    if (keys[i].image == image)
+      anim_key_release(&keys[i]);
+  }
+}
+
+static void anim_start(void) {
+  anim_lock = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(anim_task, "anim", 3072, NULL, ANIM_TASK_PRIO,
+                          &anim_worker, ANIM_TASK_CORE);
+  anim_timer = lv_timer_create(anim_timer_cb, ANIM_TIMER_MS, NULL);
+  anim_log_us = esp_timer_get_time();
+}
+
+static void *anim_alloc_frame(size_t size) {
+  // Internal RAM keeps the frames eligible for the GDMA blit unit
+  void *buf = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+  if (buf == NULL)
+    buf = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+  return buf;
+}
+
+lv_obj_t *deck_anim_create(lv_obj_t *parent, const char *name) {
+  size_t size;
+  const uint8_t *data = deck_assets_data(name, DECK_ASSET_ANIM, &size);
+  const deck_anim_header_t *hdr = (const deck_anim_header_t *)data;
+  if (data == NULL || size < sizeof(*hdr) || hdr->magic != DECK_ANIM_MAGIC ||
+      hdr->frame_count == 0 ||
+      size < sizeof(*hdr) + hdr->frame_count * sizeof(deck_anim_frame_t)) {
+    if (data != NULL)
+      ESP_LOGW("ANIM", "'%s' is not an animation", name);
+    return NULL;
+  }
+
+  anim_key_t *k = NULL;
+  for (int i = 0; i < DECK_ANIM_MAX && k == NULL; i++) {
+    if (keys[i].image == NULL)
+      k = &keys[i];
+  }
+  if (k == NULL) {
+    ESP_LOGW("ANIM", "No free slot for '%s', %d keys animated", name,
+             DECK_ANIM_MAX);
+    return NULL;
+  }
+  if (anim_worker == NULL)
+    anim_start();
+
+  size_t frame_bytes = (size_t)hdr->w * hdr->h * 2;
+  void *buf[2] = {anim_alloc_frame(frame_bytes), anim_alloc_frame(frame_bytes)};
+  if (buf[0] == NULL || buf[1] == NULL) {
+    ESP_LOGW("ANIM", "No memory for the frames of '%s'", name);
+    heap_caps_free(buf[0]);
+    heap_caps_free(buf[1]);
+    return NULL;
+  }
+
+  k->data = data;
+  k->hdr = hdr;
+  k->frames = (const deck_anim_frame_t *)(hdr + 1);
+  for (int b = 0; b < 2; b++) {
+    k->frame[b] = (lv_image_dsc_t){
+        .header.magic = LV_IMAGE_HEADER_MAGIC,
+        .header.cf = LV_COLOR_FORMAT_RGB565,
+        .header.w = hdr->w,
+        .header.h = hdr->h,
+        .header.stride = hdr->w * 2,
+        .data_size = frame_bytes,
+        .data = buf[b],
+    };
+  }
+  // The first frame is decoded right away so the key never shows garbage
+  if (!anim_decode(k, 0, buf[0]))
+    memset(buf[0], 0, frame_bytes);
+  k->front = 0;
+  k->back_index = hdr->frame_count > 1 ? 1 : 0;
+  k->deadline_us = 0;
+
+  lv_obj_t *image = lv_image_create(parent);
+  lv_image_set_src(image, &k->frame[0]);
+  lv_obj_add_event_cb(image, anim_delete_event_cb, LV_EVENT_DELETE, NULL);
+
+  xSemaphoreTake(anim_lock, portMAX_DELAY);
+  k->image = image;
+  k->back_ready = false;
+  xSemaphoreGive(anim_lock);
+  // Single frame animations only ever show their first frame
+  if (hdr->frame_count > 1)
+    xTaskNotifyGive(anim_worker);
+  return image;
+}
+
+void deck_anim_stop_all(void) {
+  for (int i = 0; i < DECK_ANIM_MAX; i++) {
+    if (keys[i].image == NULL)
+      continue;
+    lv_obj_t *image = keys[i].image;
+    lv_obj_remove_event_cb(image, anim_delete_event_cb);
+    anim_key_release(&keys[i]);
+    lv_image_set_src(image, NULL);
+  }
+}
+
+void deck_anim_get_stats(deck_anim_stats_t *stats) {
+  portENTER_CRITICAL(&anim_stats_lock);
+  *stats = anim_stats;
+  portEXIT_CRITICAL(&anim_stats_lock);
+  stats->active = 0;
+  for (int i = 0; i < DECK_ANIM_MAX; i++) {
+    if (keys[i].image != NULL)
+      stats->active++;
+  }
+}
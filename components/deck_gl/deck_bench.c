@@ -0,0 +1,136 @@
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "lvgl_driver.h"
+#include <stdint.h>
+#include <string.h>
+
+#if CONFIG_DECK_GL_BENCHMARKS
+
+#define BENCH_ROUNDS 20
+#define BLIT_ROUNDS 50
+#define BLIT_KEY_MAX 128
+#define BLIT_KEY_IMAGE 64
+
+static const uint32_t blit_key_sizes[] = {32, 48, 64, 96, BLIT_KEY_MAX};
+
+/* Average time (us) to redraw obj after invalidating it */
+static uint32_t bench_redraw(lv_display_t *disp, lv_obj_t *obj) {
+  lv_refr_now(disp);
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    lv_obj_invalidate(obj);
+    lv_refr_now(disp);
+  }
+  return (esp_timer_get_time() - start) / BENCH_ROUNDS;
+}
+
+static void bench_tiles(lv_display_t *disp, const char *name, lv_obj_t *obj,
+                        uint32_t tiles) {
+  lv_display_set_tile_cnt(disp, 1);
+  uint32_t single = bench_redraw(disp, obj);
+  lv_display_set_tile_cnt(disp, tiles);
+  uint32_t tiled = bench_redraw(disp, obj);
+  ESP_LOGI("BENCH", "render: %s %lu us -> %lu us with %lu tiles (x%.2f)", name,
+           (unsigned long)single, (unsigned long)tiled, (unsigned long)tiles,
+           tiled ? (float)single / tiled : 0.0f);
+}
+
+void deck_render_run_benchmark(void) {
+  lv_display_t *disp = lv_display_get_default();
+  uint32_t tiles = lv_display_get_tile_cnt(disp);
+  lv_obj_t *page = lv_screen_active();
+  lv_obj_t *key = ui_ctx.btn[0];
+
+  ESP_LOGI("BENCH", "render: %d draw units", LV_DRAW_SW_DRAW_UNIT_CNT);
+
+  // Rendering alone, then including the transfer to the panel
+  lvgl_display_set_flush_enabled(disp, false);
+  bench_tiles(disp, "full page (render)", page, tiles);
+  if (key != NULL)
+    bench_tiles(disp, "key (render)", key, tiles);
+  lvgl_display_set_flush_enabled(disp, true);
+
+  bench_tiles(disp, "full page (render+flush)", page, tiles);
+  if (key != NULL)
+    bench_tiles(disp, "key (render+flush)", key, tiles);
+
+  lv_obj_invalidate(page);
+}
+
+/* Average time (us) to copy a size x size key image into the draw buffer */
+static uint32_t bench_copy(uint8_t *dst, size_t dst_stride, const uint8_t *src,
+                           uint32_t size, bool dma) {
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < BLIT_ROUNDS; i++) {
+    lvgl_blit_copy(dst, dst_stride, src, size * 2, size * 2, size, dma);
+  }
+  return (esp_timer_get_time() - start) / BLIT_ROUNDS;
+}
+
+void deck_blit_run_benchmark(void) {
+  lv_display_t *disp = lv_display_get_default();
+  size_t dst_stride = lv_display_get_horizontal_resolution(disp) * 2;
+  uint8_t *dst = heap_caps_malloc(dst_stride * BLIT_KEY_MAX, MALLOC_CAP_DMA);
+  uint8_t *src =
+      heap_caps_malloc(BLIT_KEY_MAX * BLIT_KEY_MAX * 2, MALLOC_CAP_DMA);
+  if (dst == NULL || src == NULL) {
+    ESP_LOGE("BENCH", "blit: out of DMA memory");
+    heap_caps_free(dst);
+    heap_caps_free(src);
+    return;
+  }
+  memset(src, 0x5a, BLIT_KEY_MAX * BLIT_KEY_MAX * 2);
+
+  // Raw copies into a display wide buffer, one row per DMA transfer
+  for (size_t i = 0; i < sizeof(blit_key_sizes) / sizeof(blit_key_sizes[0]);
+       i++) {
+    uint32_t size = blit_key_sizes[i];
+    uint32_t cpu = bench_copy(dst, dst_stride, src, size, false);
+    uint32_t dma = bench_copy(dst, dst_stride, src, size, true);
+    ESP_LOGI("BENCH", "blit: %lux%lu key cpu %lu us, gdma %lu us (x%.2f)",
+             (unsigned long)size, (unsigned long)size, (unsigned long)cpu,
+             (unsigned long)dma, dma ? (float)cpu / dma : 0.0f);
+  }
+
+  // Key redraw, the draw units render the rest of the key during the copy
+  lv_obj_t *key = ui_ctx.btn[0];
+  if (key != NULL) {
+    lv_image_dsc_t img = {
+        .header = {.magic = LV_IMAGE_HEADER_MAGIC,
+                   .cf = LV_COLOR_FORMAT_RGB565,
+                   .w = BLIT_KEY_IMAGE,
+                   .h = BLIT_KEY_IMAGE,
+                   .stride = BLIT_KEY_IMAGE * 2},
+        .data_size = BLIT_KEY_IMAGE * BLIT_KEY_IMAGE * 2,
+        .data = src,
+    };
+    update_button_image(0, &img);
+    lvgl_display_set_flush_enabled(disp, false);
+
+    lvgl_blit_set_enabled(false);
+    uint32_t cpu = bench_redraw(disp, key);
+    lvgl_blit_set_enabled(true);
+    uint32_t dma = bench_redraw(disp, key);
+
+    lvgl_display_set_flush_enabled(disp, true);
+    update_button_image(0, NULL);
+    lv_obj_invalidate(key);
+
+    lvgl_blit_stats_t stats;
+    lvgl_blit_get_stats(&stats);
+    ESP_LOGI("BENCH",
+             "blit: key with image (render) cpu %lu us, gdma %lu us, "
+             "%lu gdma / %lu cpu blits",
+             (unsigned long)cpu, (unsigned long)dma,
+             (unsigned long)stats.dma_blits, (unsigned long)stats.cpu_blits);
+  }
+
+  heap_caps_free(dst);
+  heap_caps_free(src);
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "deck_gl.h"
+
+#if CONFIG_DECK_GL_BOOT_FRAME
+
+#include "deck_area.h"
+#include "deck_bootframe.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BOOT_FRAME_ROWS 16
+#define BOOT_FRAME_SECTOR 4096
+#define BOOT_FRAME_CHECK_MS 1000
+#define BOOT_FRAME_TASK_PRIO 1
+
+/* There is no memory for a whole frame, so the screen is rendered again in
+ * bands of BOOT_FRAME_ROWS rows into a layer of its own, the way
+ * lv_snapshot does, and compressed row by row. A first pass only sizes and
+ * checksums the frame; when it differs from the saved one a second pass
+ * writes it. The header goes last and only if the screen was not redrawn
+ * in between, so a frame cut short by a reset or a change is never drawn.
+ */
+typedef struct {
+  lv_display_t *disp;
+  uint8_t orientation;
+  const esp_partition_t *part;
+  volatile int64_t rendered_us; // last refresh not saved yet, 0 when none
+  int64_t written_us;           // last write, 0 before the first
+  lv_draw_buf_t *band;
+  uint8_t *row;
+  size_t row_max;
+} bootframe_t;
+
+static bootframe_t bf;
+
+static void bootframe_render_cb(lv_event_t *e) {
+  bf.rendered_us = esp_timer_get_time();
+}
+
+/* Renders rows [y, y + rows) of the active screen into the band */
+static void bootframe_render_band(int32_t y, int32_t rows) {
+  int32_t w = lv_display_get_horizontal_resolution(bf.disp);
+  lv_layer_t layer;
+  lv_layer_init(&layer);
+  layer.draw_buf = bf.band;
+  layer.buf_area = (lv_area_t){0, y, w - 1, y + BOOT_FRAME_ROWS - 1};
+  layer.color_format = LV_COLOR_FORMAT_RGB565;
+  layer._clip_area = (lv_area_t){0, y, w - 1, y + rows - 1};
+  layer.phy_clip_area = layer._clip_area;
+  lv_draw_buf_clear(bf.band, NULL);
+
+  lv_display_t *disp_old = lv_refr_get_disp_refreshing();
+  lv_layer_t *layer_old = bf.disp->layer_head;
+  bf.disp->layer_head = &layer;
+  lv_refr_set_disp_refreshing(bf.disp);
+
+  lv_obj_redraw(&layer, lv_display_get_screen_active(bf.disp));
+  while (layer.draw_task_head) {
+    lv_draw_dispatch_wait_for_request();
+    lv_draw_dispatch();
+  }
+
+  bf.disp->layer_head = layer_old;
+  lv_refr_set_disp_refreshing(disp_old);
+}
+
+/* One pass over the screen, writing the compressed rows behind the header
+ * when write is set. Returns their size, 0 on error.
+ */
+static size_t bootframe_pass(bool write, uint32_t *crc) {
+  int32_t w = lv_display_get_horizontal_resolution(bf.disp);
+  int32_t h = lv_display_get_vertical_resolution(bf.disp);
+  size_t size = 0;
+  *crc = 0;
+  for (int32_t y = 0; y < h; y += BOOT_FRAME_ROWS) {
+    int32_t rows = LV_MIN(BOOT_FRAME_ROWS, h - y);
+    lv_lock();
+    bootframe_render_band(y, rows);
+    lv_unlock();
+
+    for (int32_t r = 0; r < rows; r++) {
+      const uint16_t *px = lv_draw_buf_goto_xy(bf.band, 0, r);
+      size_t n = deck_rle_encode(px, w, bf.row, bf.row_max);
+      if (n == 0 ||
+          size + n > bf.part->size - sizeof(deck_bootframe_header_t))
+        return 0;
+      if (write && esp_partition_write(bf.part,
+                                       sizeof(deck_bootframe_header_t) + size,
+                                       bf.row, n) != ESP_OK)
+        return 0;
+      *crc = esp_rom_crc32_le(*crc, bf.row, n);
+      size += n;
+    }
+  }
+  return size;
+}
+
+static void bootframe_save(void) {
+  deck_bootframe_header_t hdr = {
+      .magic = DECK_BOOTFRAME_MAGIC,
+      .width = lv_display_get_horizontal_resolution(bf.disp),
+      .height = lv_display_get_vertical_resolution(bf.disp),
+      .orientation = bf.orientation,
+  };
+  int64_t rendered_us = bf.rendered_us;
+  uint32_t crc;
+  hdr.size = bootframe_pass(false, &crc);
+  hdr.crc32 = crc;
+  if (hdr.size == 0) {
+    ESP_LOGW("BOOTFRAME", "Screen does not fit the boot frame partition");
+    bf.rendered_us = 0;
+    return;
+  }
+
+  deck_bootframe_header_t saved;
+  if (esp_partition_read(bf.part, 0, &saved, sizeof(saved)) == ESP_OK &&
+      memcmp(&saved, &hdr, sizeof(hdr)) == 0) {
+    // The same frame as saved, e.g. right after boot
+    if (bf.rendered_us == rendered_us)
+      bf.rendered_us = 0;
+    return;
+  }
+  int64_t start = esp_timer_get_time();
+  bf.written_us = start;
+  size_t erase = (sizeof(hdr) + hdr.size + BOOT_FRAME_SECTOR - 1) /
+                 BOOT_FRAME_SECTOR * BOOT_FRAME_SECTOR;
+  esp_err_t err = esp_partition_erase_range(bf.part, 0, erase);
+  if (err == ESP_OK && (bootframe_pass(true, &crc) != hdr.size ||
+                        crc != hdr.crc32 || bf.rendered_us != rendered_us))
+    err = ESP_ERR_INVALID_STATE; // redrawn meanwhile
+  if (err == ESP_OK)
+    err = esp_partition_write(bf.part, 0, &hdr, sizeof(hdr));
+  if (err != ESP_OK) {
+    ESP_LOGW("BOOTFRAME", "Boot frame not saved: %s", esp_err_to_name(err));
+    return;
+  }
+  if (bf.rendered_us == rendered_us)
+    bf.rendered_us = 0;
+  ESP_LOGI("BOOTFRAME", "Boot frame saved, %lu bytes in %lu ms",
+           (unsigned long)hdr.size,
+           (unsigned long)((esp_timer_get_time() - start) / 1000));
+}
+
+static void bootframe_task(void *arg) {
+  while (1) {
+    vTaskDelay(pdMS_TO_TICKS(BOOT_FRAME_CHECK_MS));
+    // Writes are spaced out, live data may change the screen all the time
+    int64_t now = esp_timer_get_time();
+    int64_t rendered_us = bf.rendered_us;
+    if (rendered_us != 0 &&
+        now - rendered_us >= CONFIG_DECK_GL_BOOT_FRAME_IDLE_S * 1000000LL &&
+        (bf.written_us == 0 ||
+         now - bf.written_us >=
+             CONFIG_DECK_GL_BOOT_FRAME_INTERVAL_S * 1000000LL))
+      bootframe_save();
+  }
+}
+
+esp_err_t deck_bootframe_init(lv_display_t *disp, uint8_t orientation) {
+  bf.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                     DECK_BOOTFRAME_SUBTYPE, NULL);
+  if (bf.part == NULL)
+    return ESP_ERR_NOT_FOUND;
+
+  int32_t w = lv_display_get_horizontal_resolution(disp);
+  bf.disp = disp;
+  bf.orientation = orientation;
+  bf.band = lv_draw_buf_create(w, BOOT_FRAME_ROWS, LV_COLOR_FORMAT_RGB565,
+                               LV_STRIDE_AUTO);
+  // Literal blocks of 127 pixels at most, with one byte in front
+  bf.row_max = w * sizeof(uint16_t) + w / 127 + 1;
+  bf.row = malloc(bf.row_max);
+  if (bf.band == NULL || bf.row == NULL)
+    return ESP_ERR_NO_MEM;
+
+  lv_display_add_event_cb(disp, bootframe_render_cb, LV_EVENT_RENDER_READY,
+                          NULL);
+  if (xTaskCreate(bootframe_task, "bootframe", 4096, NULL,
+                  BOOT_FRAME_TASK_PRIO, NULL) != pdPASS)
+    return ESP_ERR_NO_MEM;
+  return ESP_OK;
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include "deck_assets.h"
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lvgl.h"
+#include "lvgl_private.h"
+#include <inttypes.h>
+#include <string.h>
+
+/* Glyphs dropped from the cache per pass when a font is destroyed */
+#define FONT_DROP_BATCH 32
+
+/* A font loaded from the asset partition. TTF fonts are rendered by two
+ * tiny_ttf instances on the same data: metrics answers glyph descriptors from
+ * its own small cache, raster has no cache and rasterizes into glyph_cache.
+ * Binary fonts are loaded into RAM as a whole and used as they are.
+ */
+typedef struct {
+  lv_font_t font;
+  lv_font_t *metrics;
+  lv_font_t *raster;
+} deck_font_t;
+
+/* Entry of the glyph cache, slot must be first for the size based LRU */
+typedef struct {
+  lv_cache_slot_size_t slot;
+  const deck_font_t *font;
+  uint32_t glyph;
+  lv_draw_buf_t *draw_buf;
+} glyph_entry_t;
+
+static lv_cache_t *glyph_cache;
+static portMUX_TYPE font_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static deck_font_stats_t font_stats;
+static lv_font_t *label_font;
+
+static lv_cache_compare_res_t glyph_compare_cb(const glyph_entry_t *lhs,
+                                               const glyph_entry_t *rhs) {
+  if (lhs->font != rhs->font)
+    return lhs->font > rhs->font ? 1 : -1;
+  if (lhs->glyph != rhs->glyph)
+    return lhs->glyph > rhs->glyph ? 1 : -1;
+  return 0;
+}
+
+/* Called by the cache on a miss with the glyph descriptor of the lookup */
+static bool glyph_create_cb(glyph_entry_t *node, lv_font_glyph_dsc_t *g_dsc) {
+  int64_t start = esp_timer_get_time();
+
+  lv_font_glyph_dsc_t g = *g_dsc;
+  g.resolved_font = node->font->raster;
+  g.entry = NULL;
+  // Without a cache tiny_ttf hands over a new draw buffer for every call
+  node->draw_buf = (lv_draw_buf_t *)node->font->raster->get_glyph_bitmap(
+      &g, NULL);
+
+  uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+  portENTER_CRITICAL(&font_stats_lock);
+  font_stats.misses++;
+  font_stats.raster_us += us;
+  if (us > font_stats.max_raster_us)
+    font_stats.max_raster_us = us;
+  portEXIT_CRITICAL(&font_stats_lock);
+  return node->draw_buf != NULL;
+}
+
+static void glyph_free_cb(glyph_entry_t *node, void *user_data) {
+  lv_draw_buf_destroy(node->draw_buf);
+  node->draw_buf = NULL;
+  portENTER_CRITICAL(&font_stats_lock);
+  font_stats.evictions++;
+  portEXIT_CRITICAL(&font_stats_lock);
+}
+
+static bool font_get_glyph_dsc(const lv_font_t *font, lv_font_glyph_dsc_t *dsc,
+                               uint32_t letter, uint32_t letter_next) {
+  const deck_font_t *f = font->dsc;
+  return f->metrics->get_glyph_dsc(f->metrics, dsc, letter, letter_next);
+}
+
+static const void *font_get_glyph_bitmap(lv_font_glyph_dsc_t *g_dsc,
+                                         lv_draw_buf_t *draw_buf) {
+  glyph_entry_t key = {
+      .slot.size = lv_draw_buf_width_to_stride(g_dsc->box_w,
+                                               LV_COLOR_FORMAT_A8) *
+                       g_dsc->box_h +
+                   sizeof(lv_draw_buf_t),
+      .font = g_dsc->resolved_font->dsc,
+      .glyph = g_dsc->gid.index,
+  };
+
+  portENTER_CRITICAL(&font_stats_lock);
+  font_stats.lookups++;
+  portEXIT_CRITICAL(&font_stats_lock);
+
+  // The entry stays referenced, and so can't be evicted, until the letter
+  // has been drawn and font_release_glyph is called
+  lv_cache_entry_t *entry =
+      lv_cache_acquire_or_create(glyph_cache, &key, g_dsc);
+  if (entry == NULL)
+    return NULL;
+  g_dsc->entry = entry;
+  glyph_entry_t *data = lv_cache_entry_get_data(entry);
+  return data->draw_buf;
+}
+
+static void font_release_glyph(const lv_font_t *font,
+                               lv_font_glyph_dsc_t *g_dsc) {
+  if (g_dsc->entry == NULL)
+    return;
+  lv_cache_release(glyph_cache, g_dsc->entry, NULL);
+  g_dsc->entry = NULL;
+}
+
+static bool font_is_ttf(const uint8_t *data, size_t size) {
+  static const char *const tags[] = {"\x00\x01\x00\x00", "true", "OTTO",
+                                     "ttcf"};
+  if (size < 4)
+    return false;
+  for (size_t i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+    if (memcmp(data, tags[i], 4) == 0)
+      return true;
+  }
+  return false;
+}
+
+static lv_font_t *font_create_ttf(const void *data, size_t size,
+                                  int32_t font_size) {
+  if (glyph_cache == NULL) {
+    glyph_cache = lv_cache_create(
+        &lv_cache_class_lru_rb_size, sizeof(glyph_entry_t),
+        DECK_FONT_GLYPH_CACHE_BYTES,
+        (lv_cache_ops_t){
+            .compare_cb = (lv_cache_compare_cb_t)glyph_compare_cb,
+            .create_cb = (lv_cache_create_cb_t)glyph_create_cb,
+            .free_cb = (lv_cache_free_cb_t)glyph_free_cb,
+        });
+    lv_cache_set_name(glyph_cache, "DECK_GLYPH");
+  }
+
+  deck_font_t *f = lv_malloc_zeroed(sizeof(deck_font_t));
+  f->metrics = lv_tiny_ttf_create_data_ex(data, size, font_size,
+                                          LV_FONT_KERNING_NORMAL,
+                                          LV_TINY_TTF_CACHE_GLYPH_CNT);
+  f->raster = lv_tiny_ttf_create_data_ex(data, size, font_size,
+                                         LV_FONT_KERNING_NONE, 0);
+  if (f->metrics == NULL || f->raster == NULL) {
+    if (f->metrics != NULL)
+      lv_tiny_ttf_destroy(f->metrics);
+    if (f->raster != NULL)
+      lv_tiny_ttf_destroy(f->raster);
+    lv_free(f);
+    return NULL;
+  }
+
+  lv_font_t *font = &f->font;
+  font->get_glyph_dsc = font_get_glyph_dsc;
+  font->get_glyph_bitmap = font_get_glyph_bitmap;
+  font->release_glyph = font_release_glyph;
+  font->line_height = f->metrics->line_height;
+  font->base_line = f->metrics->base_line;
+  font->underline_position = f->metrics->underline_position;
+  font->underline_thickness = f->metrics->underline_thickness;
+  font->kerning = f->metrics->kerning;
+  font->dsc = f;
+  return font;
+}
+
+static bool font_is_cached(const lv_font_t *font) {
+  return font->get_glyph_dsc == font_get_glyph_dsc;
+}
+
+lv_font_t *deck_font_load(const char *name, int32_t font_size) {
+  size_t size;
+  const void *data = deck_assets_data(name, DECK_ASSET_FONT, &size);
+  if (data == NULL)
+    return NULL;
+
+  lv_font_t *font;
+  if (font_is_ttf(data, size)) {
+    font = font_create_ttf(data, size, font_size);
+  } else {
+    // Binary fonts come with their own size, font_size does not apply
+    font = lv_binfont_create_from_buffer((void *)data, size);
+  }
+  if (font == NULL) {
+    ESP_LOGW("FONT", "Font '%s' could not be loaded", name);
+    return NULL;
+  }
+  // Symbols and scripts the font lacks come from the built-in font
+  font->fallback = &lv_font_montserrat_14;
+
+  int64_t start = esp_timer_get_time();
+  uint32_t glyphs = 0;
+  if (font_is_cached(font)) {
+    char ascii[0x7F - 0x20 + 1];
+    for (int c = 0x20; c < 0x7F; c++)
+      ascii[c - 0x20] = (char)c;
+    ascii[sizeof(ascii) - 1] = '\0';
+    glyphs = deck_font_prewarm(font, ascii);
+  }
+  ESP_LOGI("FONT", "Font '%s' loaded (%s, %" PRId32 " px), %" PRIu32
+           " glyphs prewarmed in %" PRIu32 " us",
+           name, font_is_cached(font) ? "TTF" : "binfont", font->line_height,
+           glyphs, (uint32_t)(esp_timer_get_time() - start));
+  return font;
+}
+
+uint32_t deck_font_prewarm(const lv_font_t *font, const char *text) {
+  uint32_t glyphs = 0;
+  uint32_t i = 0;
+  while (text[i] != '\0') {
+    uint32_t letter = lv_text_encoded_next(text, &i);
+    lv_font_glyph_dsc_t g;
+    if (!lv_font_get_glyph_dsc(font, &g, letter, 0) || g.resolved_font == NULL ||
+        !font_is_cached(g.resolved_font) || g.box_w == 0 || g.box_h == 0)
+      continue;
+    if (lv_font_get_glyph_bitmap(&g, NULL) != NULL)
+      glyphs++;
+    lv_font_glyph_release_draw_data(&g);
+  }
+  return glyphs;
+}
+
+void deck_font_destroy(lv_font_t *font) {
+  if (font == NULL)
+    return;
+  if (!font_is_cached(font)) {
+    lv_binfont_destroy(font);
+    return;
+  }
+
+  // Glyphs are keyed by the font's address, a later font may get the same
+  deck_font_t *f = (deck_font_t *)font->dsc;
+  glyph_entry_t batch[FONT_DROP_BATCH];
+  uint32_t n;
+  do {
+    n = 0;
+    lv_iter_t *iter = lv_cache_iter_create(glyph_cache);
+    glyph_entry_t entry;
+    while (n < FONT_DROP_BATCH &&
+           lv_iter_next(iter, &entry) == LV_RESULT_OK) {
+      if (entry.font == f)
+        batch[n++] = entry;
+    }
+    lv_iter_destroy(iter);
+    for (uint32_t i = 0; i < n; i++)
+      lv_cache_drop(glyph_cache, &batch[i], NULL);
+  } while (n == FONT_DROP_BATCH);
+
+  lv_tiny_ttf_destroy(f->metrics);
+  lv_tiny_ttf_destroy(f->raster);
+  lv_free(f);
+}
+
+void deck_font_get_stats(deck_font_stats_t *stats) {
+  portENTER_CRITICAL(&font_stats_lock);
+  *stats = font_stats;
+  portEXIT_CRITICAL(&font_stats_lock);
+  stats->hits = stats->lookups - stats->misses;
+  stats->cache_bytes = glyph_cache ? lv_cache_get_size(glyph_cache, NULL) : 0;
+}
+
+const lv_font_t *deck_label_font(void) {
+  return label_font ? label_font : &lv_font_montserrat_14;
+}
+
+lv_font_t *deck_label_font_reload(void) {
+  lv_font_t *old = label_font;
+  label_font = NULL;
+  if (CONFIG_DECK_GL_FONT[0] != '\0')
+    label_font = deck_font_load(CONFIG_DECK_GL_FONT, CONFIG_DECK_GL_FONT_SIZE);
+  return old;
+}
@@ -1,6 +1,9 @@
 #include "deck_gl.h"
+#include "deck_gl_priv.h"
 #include "core/lv_obj_style.h"
+#include "deck_assets.h"
 #include "deck_hid.h"
+#include "deck_latency.h"
 #include "display/lv_display.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_ops.h"
@@ -32,31 +35,48 @@
 #define GREEN 0x0000FF
 
 ui_context_t ui_ctx;
+deck_state_t deck_state = DECK_STATE_INITIALIZER;
 static int slider_indices[] = {0, 1, 2};
+
+/* Marks the touch edge as handled, the object is what changes on screen */
+static void latency_handled(lv_obj_t *obj, bool hid) {
+  lv_area_t area;
+  lv_obj_get_coords(obj, &area);
+  deck_latency_handled(area.x1, area.y1, area.x2, area.y2, hid);
+}
+
+static void grid_button_pressed_event_cb(lv_event_t *e) {
+  latency_handled(lv_event_get_target(e), false);
+}
+
 static void grid_button_clicked_event_cb(lv_event_t *e) {
   lv_obj_t *btn = lv_event_get_target(e);
-  int btn_id = (int)lv_event_get_user_data(e);
+  const button_t *cfg = lv_event_get_user_data(e);
+  int btn_id = cfg->id;
   ESP_LOGI("GRID", "Button %d clicked", btn_id);
 
+  switch (cfg->action) {
+  case BUTTON_ACTION_OPEN_PAGE:
+    deck_show_page(cfg->target);
+    return;
+  case BUTTON_ACTION_BACK:
+    deck_page_back();
+    return;
+  default:
+    break;
+  }
+
+  latency_handled(btn, true);
   deck_input_report_t report = {0};
-  report.buttons =
-      (1 << (btn_id - 1)); // Set the bit corresponding to the button ID
-  report.slider1 = ui_ctx.slider_value_labels[0]
-                       ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[0]))
-                       : 0;
-  report.slider2 = ui_ctx.slider_value_labels[1]
-                       ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[1]))
-                       : 0;
-  report.slider3 = ui_ctx.slider_value_labels[2]
-                       ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[2]))
-                       : 0;
+  deck_report_press(&report, btn_id);
+  deck_state_fill_report(&deck_state, &report);
   deck_hid_send_state(&report);
 
   // Visual feedback - flash the button
   lv_obj_set_style_bg_color(btn, lv_color_hex(GREEN), LV_PART_MAIN);
   lv_obj_invalidate(btn);
   vTaskDelay(pdMS_TO_TICKS(100));
-  lv_obj_set_style_bg_color(btn, lv_color_hex(BLUE), LV_PART_MAIN);
+  lv_obj_set_style_bg_color(btn, cfg->bg_color, LV_PART_MAIN);
   lv_obj_invalidate(btn);
 }
 
@@ -71,24 +91,13 @@ static void slider_event_cb(lv_event_t *e) {
   char value_text[8];
   snprintf(value_text, sizeof(value_text), "%d", value);
   lv_label_set_text(ui_ctx.slider_value_labels[idx], value_text);
+  deck_state_set_slider(&deck_state, idx, value);
+  deck_persist_changed();
 
+  latency_handled(slider, true);
   // Build report from stored values
   deck_input_report_t report = {0};
-  report.slider1 =
-      idx == 0 ? value
-               : (ui_ctx.slider_value_labels[0]
-                      ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[0]))
-                      : 0);
-  report.slider2 =
-      idx == 1 ? value
-               : (ui_ctx.slider_value_labels[1]
-                      ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[1]))
-                      : 0);
-  report.slider3 =
-      idx == 2 ? value
-               : (ui_ctx.slider_value_labels[2]
-                      ? atoi(lv_label_get_text(ui_ctx.slider_value_labels[2]))
-                      : 0);
+  deck_state_fill_report(&deck_state, &report);
   deck_hid_send_state(&report);
 }
 
@@ -100,7 +109,8 @@ static lv_obj_t *create_label(lv_obj_t *parent, label_t *cfg) {
   return label;
 }
 
-static lv_obj_t *create_button(lv_obj_t *parent, button_t *cfg) {
+static lv_obj_t *create_button(lv_obj_t *parent, const button_t *cfg,
+                               ui_context_t *ctx) {
   lv_obj_t *btn = lv_button_create(parent);
   lv_obj_set_style_bg_color(btn, cfg->bg_color, LV_PART_MAIN);
   lv_obj_set_style_radius(btn, cfg->radius, 0);
@@ -110,12 +120,34 @@ static lv_obj_t *create_button(lv_obj_t *parent, button_t *cfg) {
   lv_obj_t *label =
       create_label(btn, &(label_t){.label = cfg->label,
                                    .text_color = lv_color_hex(WHITE),
-                                   .font = &lv_font_montserrat_14});
-
-  ui_ctx.btn_labels[cfg->id - 1] = label;
-  lv_obj_center(label);
+                                   .font = deck_label_font()});
+
+  ctx->btn_labels[cfg->id - 1] = label;
+
+  // Icons are drawn straight from the mapped asset partition
+  lv_obj_t *image = cfg->anim ? deck_anim_create(btn, cfg->anim) : NULL;
+  const lv_image_dsc_t *icon = deck_assets_image(cfg->icon);
+  if (image == NULL && icon != NULL) {
+    image = lv_image_create(btn);
+    lv_image_set_src(image, icon);
+    // Single color icons are stored as alpha only and tinted when drawn
+    if (icon->header.cf == LV_COLOR_FORMAT_A8) {
+      lv_obj_set_style_image_recolor(image, deck_assets_image_tint(cfg->icon),
+                                     0);
+      lv_obj_set_style_image_recolor_opa(image, LV_OPA_COVER, 0);
+    }
+  }
+  if (image != NULL) {
+    lv_obj_move_to_index(image, 0);
+    lv_obj_center(image);
+    lv_obj_align(label, LV_ALIGN_BOTTOM_MID, 0, 0);
+  } else {
+    lv_obj_center(label);
+  }
   lv_obj_add_event_cb(btn, grid_button_clicked_event_cb, LV_EVENT_CLICKED,
-                      (void *)cfg->id);
+                      (void *)cfg);
+  lv_obj_add_event_cb(btn, grid_button_pressed_event_cb, LV_EVENT_PRESSED,
+                      NULL);
   return btn;
 }
 
@@ -143,7 +175,8 @@ static void create_grid(lv_obj_t *obj) {
   lv_obj_set_style_pad_row(obj, 5, 0);
 }
 
-static void create_button_grid(lv_obj_t *scr) {
+static void create_button_grid(lv_obj_t *scr, const page_config_t *page,
+                               ui_context_t *ctx) {
   // control Create button grid container
   lv_obj_t *btn_container =
       create_container(scr, &(container_t){.width = 480,
@@ -156,18 +189,14 @@ static void create_button_grid(lv_obj_t *scr) {
 
   for (int row = 0; row < 2; row++) {
     for (int col = 0; col < 4; col++) {
-      int btn_id = row * 4 + col + 1;
-
-      char btn_text[8];
-      snprintf(btn_text, sizeof(btn_text), "Btn %d", btn_id);
-      lv_obj_t *btn = create_button(btn_container,
-                                    &(button_t){.id = btn_id,
-                                                .label = btn_text,
-                                                .bg_color = lv_color_hex(BLUE),
-                                                .radius = 8});
+      const button_t *cfg = &page->buttons[row * 4 + col];
+      if (cfg->id == 0)
+        continue; // empty cell
+
+      lv_obj_t *btn = create_button(btn_container, cfg, ctx);
       lv_obj_set_grid_cell(btn, LV_GRID_ALIGN_STRETCH, col, 1,
                            LV_GRID_ALIGN_STRETCH, row, 1);
-      ui_ctx.btn[btn_id - 1] = btn;
+      ctx->btn[cfg->id - 1] = btn;
     }
   }
 }
@@ -186,7 +215,8 @@ static lv_obj_t *create_slider(lv_obj_t *parent, slider_t *cfg) {
   return slider;
 }
 
-static void create_slider_grid(lv_obj_t *scr) {
+static void create_slider_grid(lv_obj_t *scr, const page_config_t *page,
+                               ui_context_t *ctx) {
   lv_obj_t *slider_container =
       create_container(scr, &(container_t){.width = 480,
                                            .height = 100,
@@ -199,6 +229,7 @@ static void create_slider_grid(lv_obj_t *scr) {
                         LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
 
   const char *slider_names[] = {"VOL", "BRT", "SPD"};
+  char value_text[8];
 
   for (int i = 0; i < 3; i++) {
     // Container for each slider + label
@@ -215,55 +246,126 @@ static void create_slider_grid(lv_obj_t *scr) {
     lv_obj_set_flex_align(slider_box, LV_FLEX_ALIGN_CENTER,
                           LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
 
-    lv_obj_t *name_label =
-        create_label(slider_box, &(label_t){.label = slider_names[i],
+    lv_obj_t *name_label = create_label(
+        slider_box, &(label_t){.label = page->slider_names[i]
+                                            ? page->slider_names[i]
+                                            : slider_names[i],
                                             .text_color = lv_color_hex(WHITE),
-                                            .font = &lv_font_montserrat_14});
-    ui_ctx.slider_name_labels[i] = name_label;
+                                            .font = deck_label_font()});
+    ctx->slider_name_labels[i] = name_label;
     lv_obj_t *slider = create_slider(
         slider_box, &(slider_t){.width = 100,
                                 .min = 0,
                                 .max = 100,
-                                .value = 50,
+                                .value = deck_state.sliders[i],
                                 .main_color = lv_color_hex(BLUE),
                                 .indicator_color = lv_color_hex(RED),
                                 .knob_color = lv_color_hex(GREEN)});
 
+    snprintf(value_text, sizeof(value_text), "%d", deck_state.sliders[i]);
     lv_obj_t *value_label =
-        create_label(slider_box, &(label_t){.label = "50",
+        create_label(slider_box, &(label_t){.label = value_text,
                                             .text_color = lv_color_hex(WHITE),
-                                            .font = &lv_font_montserrat_14});
-    ui_ctx.slider_value_labels[i] = value_label;
-    ui_ctx.sliders[i] = slider;
+                                            .font = deck_label_font()});
+    ctx->slider_value_labels[i] = value_label;
+    ctx->sliders[i] = slider;
     lv_obj_add_event_cb(slider, slider_event_cb, LV_EVENT_VALUE_CHANGED,
                         &slider_indices[i]);
   }
 }
 
 void update_slider_value(int slider_index, int value) {
+  deck_state_set_slider(&deck_state, slider_index, value);
+  deck_persist_changed();
   lv_slider_set_value(ui_ctx.sliders[slider_index], value, LV_ANIM_OFF);
   lv_label_set_text_fmt(ui_ctx.slider_value_labels[slider_index], "%d", value);
 }
 
+void deck_sync_sliders(const ui_context_t *ctx) {
+  for (int i = 0; i < DECK_SLIDER_COUNT; i++) {
+    if (lv_slider_get_value(ctx->sliders[i]) == deck_state.sliders[i])
+      continue;
+    lv_slider_set_value(ctx->sliders[i], deck_state.sliders[i], LV_ANIM_OFF);
+    lv_label_set_text_fmt(ctx->slider_value_labels[i], "%d",
+                          deck_state.sliders[i]);
+  }
+}
+
 void update_slider_text(int slider_index, const char *label) {
   lv_label_set_text(ui_ctx.slider_name_labels[slider_index], label);
 }
 
+/* Button of the shown page, NULL out of range and for an empty cell */
+static lv_obj_t *shown_button(int btn_index) {
+  if (btn_index < 0 || btn_index >= 8)
+    return NULL;
+  return ui_ctx.btn[btn_index];
+}
+
 void update_button_color(int btn_index, lv_color_t color) {
-  lv_obj_set_style_bg_color(ui_ctx.btn[btn_index], color, LV_PART_MAIN);
-  lv_obj_invalidate(ui_ctx.btn[btn_index]);
+  lv_obj_t *btn = shown_button(btn_index);
+  if (btn == NULL)
+    return;
+  lv_obj_set_style_bg_color(btn, color, LV_PART_MAIN);
+  lv_obj_invalidate(btn);
 }
 
 void update_button_text(int btn_index, const char *label) {
+  if (btn_index < 0 || btn_index >= 8 || ui_ctx.btn_labels[btn_index] == NULL)
+    return;
   lv_label_set_text(ui_ctx.btn_labels[btn_index], label);
   lv_obj_invalidate(ui_ctx.btn_labels[btn_index]);
 }
 
-void deck_create_ui(void) {
-  lv_obj_t *scr = lv_screen_active();
+void update_button_image(int btn_index, const lv_image_dsc_t *img) {
+  lv_obj_t *btn = shown_button(btn_index);
+  if (btn == NULL)
+    return;
+  lv_obj_t *image = lv_obj_get_child_by_type(btn, 0, &lv_image_class);
+
+  if (img == NULL) {
+    if (image != NULL)
+      lv_obj_delete(image);
+    return;
+  }
+  if (image == NULL) {
+    // Below the label so the text stays readable
+    image = lv_image_create(btn);
+    lv_obj_move_to_index(image, 0);
+    lv_obj_center(image);
+  }
+  lv_image_set_src(image, img);
+}
+
+void update_button_animation(int btn_index, const char *name) {
+  lv_obj_t *btn = shown_button(btn_index);
+  if (btn == NULL)
+    return;
+  lv_obj_t *image = lv_obj_get_child_by_type(btn, 0, &lv_image_class);
+  if (image != NULL)
+    lv_obj_delete(image);
+  if (name == NULL)
+    return;
+
+  image = deck_anim_create(btn, name);
+  if (image != NULL) {
+    lv_obj_move_to_index(image, 0);
+    lv_obj_center(image);
+  }
+}
+
+lv_obj_t *deck_build_page(const page_config_t *page, ui_context_t *ctx) {
+  lv_obj_t *scr = lv_obj_create(NULL);
 
   lv_obj_set_style_bg_color(scr, lv_color_hex(BLACK), LV_PART_MAIN);
 
-  create_button_grid(scr);
-  create_slider_grid(scr);
+  create_button_grid(scr, page, ctx);
+  create_slider_grid(scr, page, ctx);
+  return scr;
+}
+
+void deck_create_ui(void) {
+  deck_live_init();
+  deck_pages_start();
+  deck_hud_init();
 }
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "deck_live_proto.h"
+#include "deck_state.h"
+#include "esp_err.h"
 #include "esp_lcd_panel_io.h"
 #include "lvgl.h"
+#include "sdkconfig.h"
 #include <stdint.h>
 
 /* label configuration
@@ -34,17 +38,37 @@ typedef struct {
   uint32_t radius;
 } container_t;
 
+/* button action, what happens when a button is clicked
+ * - BUTTON_ACTION_HID: report the button to the host (default)
+ * - BUTTON_ACTION_OPEN_PAGE: switch to the page given by target (folders)
+ * - BUTTON_ACTION_BACK: return to the parent of the current page
+ */
+typedef enum {
+  BUTTON_ACTION_HID,
+  BUTTON_ACTION_OPEN_PAGE,
+  BUTTON_ACTION_BACK,
+} button_action_t;
+
 /* button configuration
  * - uint32_t id
  * - const char *label
  * - lv_color_t bg_color
  * - uint32_t radius
+ * - button_action_t action
+ * - uint32_t target: page index for BUTTON_ACTION_OPEN_PAGE
+ * - const char *icon: name of an image in the asset partition, or NULL
+ * - const char *anim: name of an animation in the asset partition, shown
+ *   instead of the icon, or NULL
  */
 typedef struct {
   uint32_t id;
   const char *label;
   lv_color_t bg_color;
   uint32_t radius;
+  button_action_t action;
+  uint32_t target;
+  const char *icon;
+  const char *anim;
 } button_t;
 
 /* slider configuration
@@ -69,6 +93,41 @@ typedef struct {
   lv_color_t text_color;
 } slider_t;
 
+/* Called to show data item index in a recycled list item. The item is a
+ * button whose first child is its label.
+ */
+typedef void (*list_bind_cb_t)(lv_obj_t *item, uint32_t index, void *user_data);
+
+/* Called when the list item showing data item index is clicked */
+typedef void (*list_click_cb_t)(uint32_t index, void *user_data);
+
+/* virtualized list configuration
+ * - uint32_t width
+ * - uint32_t height
+ * - uint32_t columns: 1 for a list, more for a grid
+ * - uint32_t row_height: including the gap between rows
+ * - uint32_t margin_rows: rows kept alive above and below the visible ones
+ * - uint32_t item_count: number of data items
+ * - lv_color_t bg_color
+ * - lv_color_t item_color
+ * - list_bind_cb_t bind_cb
+ * - list_click_cb_t click_cb
+ * - void *user_data: passed to bind_cb and click_cb
+ */
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t columns;
+  uint32_t row_height;
+  uint32_t margin_rows;
+  uint32_t item_count;
+  lv_color_t bg_color;
+  lv_color_t item_color;
+  list_bind_cb_t bind_cb;
+  list_click_cb_t click_cb;
+  void *user_data;
+} list_t;
+
 /* UI configuration to hold settings for all UI elements
  * - btn_configs[8]: Array of button configurations for 8 buttons
  * - slider_configs[3]: Array of slider configurations for 3 sliders
@@ -98,8 +157,296 @@ typedef struct {
   lv_obj_t *slider_value_labels[3];
 } ui_context_t;
 
+/* Memory budget (bytes) for the LVGL object trees of cached pages. Pages are
+ * evicted least recently used first once the budget is exceeded; the active
+ * page is never evicted.
+ */
+#ifndef DECK_PAGE_CACHE_BUDGET
+#define DECK_PAGE_CACHE_BUDGET (48 * 1024)
+#endif
+
+/* Value of page_config_t.parent for a root page */
+#define DECK_PAGE_ROOT UINT32_MAX
+
+/* page configuration, a page is one full screen of the deck
+ * - const char *name
+ * - button_t buttons[8]: the button grid, id is 1..8 within the page
+ * - const char *slider_names[3]: NULL keeps the default names
+ * - uint32_t parent: page opened by BUTTON_ACTION_BACK, or DECK_PAGE_ROOT
+ */
+typedef struct {
+  const char *name;
+  button_t buttons[8];
+  const char *slider_names[3];
+  uint32_t parent;
+} page_config_t;
+
+/* page cache statistics
+ * - hits / misses: page switches served from the cache or built on demand
+ * - evictions: pages torn down to stay within DECK_PAGE_CACHE_BUDGET
+ * - prefetches: pages built ahead of time while LVGL was idle
+ * - cache_bytes: current memory used by cached pages
+ * - last_switch_us / max_switch_us: time to make a page active
+ * - last_pixels_us: time from the switch request until the first refresh of
+ *   the new page has been flushed to the panel
+ */
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  uint32_t prefetches;
+  size_t cache_bytes;
+  uint32_t last_switch_us;
+  uint32_t max_switch_us;
+  uint32_t last_pixels_us;
+} deck_page_stats_t;
+
+/* Function to set the pages of the deck. The table must stay valid for the
+ * lifetime of the deck since evicted pages are rebuilt from it. Must be called
+ * before deck_create_ui, otherwise a single default page is used.
+ * Parameters:
+ * - pages: Array of page configurations, index 0 is the home page.
+ * - count: Number of pages (at most DECK_PAGE_MAX).
+ */
+void deck_set_pages(const page_config_t *pages, uint32_t count);
+
+/* Function to switch the active page. The page is built on first visit and
+ * kept in the page cache afterwards.
+ * Parameters:
+ * - page: Index of the page in the table given to deck_set_pages.
+ */
+void deck_show_page(uint32_t page);
+uint32_t deck_current_page(void);
+void deck_page_get_stats(deck_page_stats_t *stats);
+
+/* Memory budget (bytes) of the glyph cache shared by all TTF fonts. Glyphs
+ * are rasterized on first use and evicted least recently used first; glyphs
+ * being drawn are never evicted.
+ */
+#ifndef DECK_FONT_GLYPH_CACHE_BYTES
+#define DECK_FONT_GLYPH_CACHE_BYTES (CONFIG_DECK_GL_GLYPH_CACHE_KB * 1024)
+#endif
+
+/* glyph cache statistics
+ * - lookups: glyph bitmaps requested by the renderer
+ * - hits / misses: lookups served from the cache or rasterized
+ * - evictions: glyphs dropped for the budget or with their font
+ * - cache_bytes: current memory used by cached glyphs
+ * - raster_us / max_raster_us: total and longest time to rasterize a glyph
+ */
+typedef struct {
+  uint32_t lookups;
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  size_t cache_bytes;
+  uint64_t raster_us;
+  uint32_t max_raster_us;
+} deck_font_stats_t;
+
+/* Function to load a font from the asset partition. TTF/OTF fonts are drawn
+ * through the glyph cache and the printable ASCII set is rasterized right
+ * away; LVGL binary fonts are loaded into RAM as they are and ignore
+ * font_size. Glyphs the font lacks fall back to the built-in font. Must be
+ * called with the LVGL lock held, the font points into the mapped partition
+ * and must be destroyed before it is unmapped.
+ * Parameters:
+ * - name: Name of a font asset.
+ * - font_size: Size in pixels for TTF/OTF fonts.
+ * Returns NULL if there is no such font or it can't be loaded.
+ */
+lv_font_t *deck_font_load(const char *name, int32_t font_size);
+void deck_font_destroy(lv_font_t *font);
+
+/* Function to rasterize the glyphs of text into the glyph cache ahead of
+ * use, e.g. the labels of a page the host is about to show. Returns the
+ * number of glyphs now cached.
+ */
+uint32_t deck_font_prewarm(const lv_font_t *font, const char *text);
+void deck_font_get_stats(deck_font_stats_t *stats);
+
+/* Maximum number of animated keys, across all cached pages */
+#ifndef DECK_ANIM_MAX
+#define DECK_ANIM_MAX 8
+#endif
+
+/* animated key statistics
+ * - active: animated keys that exist
+ * - shown: frames swapped in on time
+ * - dropped: frame deadlines missed because the decoder was behind
+ * - decoded / errors: frames decoded, frames that failed to decode
+ * - decode_us / max_decode_us: total and longest time to decode a frame
+ */
+typedef struct {
+  uint32_t active;
+  uint32_t shown;
+  uint32_t dropped;
+  uint32_t decoded;
+  uint32_t errors;
+  uint64_t decode_us;
+  uint32_t max_decode_us;
+} deck_anim_stats_t;
+
+/* Function to create an image playing an animation from the asset
+ * partition. Frames are decoded by a worker on core 0 into a second buffer
+ * and swapped in by an LVGL timer at their deadline, so only the image is
+ * redrawn. Animations pause while their page is not shown and stop when the
+ * image is deleted.
+ * Parameters:
+ * - parent: Parent object of the image.
+ * - name: Name of an animation asset (built from a GIF by build_assets.py).
+ * Returns NULL if there is no such animation or DECK_ANIM_MAX keys are
+ * already animated.
+ */
+lv_obj_t *deck_anim_create(lv_obj_t *parent, const char *name);
+
+/* Function to stop all animations, their images are left empty. Called
+ * before the asset partition is unmapped.
+ */
+void deck_anim_stop_all(void);
+void deck_anim_get_stats(deck_anim_stats_t *stats);
+
+#if CONFIG_DECK_GL_HUD
+/* Performance HUD, a small overlay on the top layer with frame rate, CPU
+ * load per core, render and flush times, LVGL heap and touch rate. Toggled
+ * by DECK_HUD_HID_REPORT, a one byte output report (0 hides it, 1 shows it,
+ * 2 toggles it), or by a long press on the background between the keys.
+ * Refreshed every CONFIG_DECK_GL_HUD_PERIOD_MS; nothing is measured while it
+ * is hidden.
+ */
+#define DECK_HUD_HID_REPORT 9
+
+void deck_hud_show(bool show);
+bool deck_hud_is_shown(void);
+
+/* Function to toggle the HUD by a long press on indev, a pointer input
+ * device. The touch input is created after deck_create_ui, so it is
+ * attached by the caller that creates it.
+ */
+void deck_hud_attach_indev(lv_indev_t *indev);
+#endif
+
+#if CONFIG_DECK_GL_BOOT_FRAME
+/* Function to keep the active screen of disp as boot frame
+ * (deck_bootframe.h). A low priority task saves it once the screen has not
+ * been redrawn for CONFIG_DECK_GL_BOOT_FRAME_IDLE_S, at most every
+ * CONFIG_DECK_GL_BOOT_FRAME_INTERVAL_S and only when it changed.
+ * Parameters:
+ * - disp: Display of the screen, RGB565.
+ * - orientation: Orientation of the panel, as given to lcd_set_orientation.
+ */
+esp_err_t deck_bootframe_init(lv_display_t *disp, uint8_t orientation);
+#endif
+
+#if CONFIG_DECK_GL_PERSIST
+/* Function to restore the deck state and host configuration saved in NVS
+ * (deck_persist.h) and to save changes from then on. Call it after
+ * nvs_flash_init, deck_set_pages and deck_profiles_init and before
+ * deck_create_ui, so the first frame shows the restored state. Returns
+ * ESP_ERR_NOT_FOUND when nothing was saved yet, another error when it could
+ * not be restored; changes are saved in either case once NVS opened.
+ */
+esp_err_t deck_persist_init(void);
+#endif
+
+#if CONFIG_DECK_GL_PROFILES
+/* Function to map the profile partition (deck_profile.h), the page layouts
+ * of the host applications. The container is checked here, selecting a
+ * profile later reads its tables in place. Call it after deck_set_pages and
+ * before deck_persist_init, which selects the profile saved.
+ * Returns ESP_ERR_NOT_FOUND without partition or container, another error
+ * for a container that is damaged or of another version.
+ */
+esp_err_t deck_profiles_init(void);
+
+/* Function to show the pages of a profile instead of the current ones,
+ * starting at its page 0. The page shown is rebuilt right away, so the next
+ * frame shows the profile, unless it was built ahead as the profile likely
+ * shown next. Every profile keeps its own page switch counts and live keys
+ * (DECK_LIVE_HID_REPORT): records address the keys of the profile shown,
+ * the widgets of another profile come back with it. Call from the LVGL task
+ * or with the LVGL lock held.
+ * Parameters:
+ * - name: Profile name, NULL for the pages given to deck_set_pages.
+ * Returns ESP_ERR_NOT_FOUND if there is no such profile.
+ */
+esp_err_t deck_profile_select(const char *name);
+
+/* The host announces the application in focus with DECK_FOCUS_HID_REPORT,
+ * an output report of up to 63 bytes of UTF-8, NUL padded: an executable or
+ * bundle id as listed in the apps of a profile, or a profile name. The
+ * profile of the application is selected, one without profile keeps the
+ * current one. The switch latency (deck_page_get_stats) counts from the
+ * arrival of the report.
+ */
+#define DECK_FOCUS_HID_REPORT 11
+
+/* Function to select the profile of an application as if the host had
+ * announced it. Takes the LVGL lock itself.
+ * Returns ESP_ERR_NOT_FOUND if no profile is for app.
+ */
+esp_err_t deck_profile_focus(const char *app);
+
+/* Name of the profile shown, NULL for the pages given to deck_set_pages */
+const char *deck_profile_active(void);
+
+/* Profiles of the container, by index */
+uint32_t deck_profile_count(void);
+const char *deck_profile_name(uint32_t index);
+#endif
+
+/* Function to create a scrollable list or grid whose memory use does not
+ * depend on the number of items. Only the visible rows plus cfg->margin_rows
+ * on each side exist as LVGL objects; they are rebound to other data items as
+ * the list scrolls.
+ * Parameters:
+ * - parent: Parent object of the list.
+ * - cfg: List configuration, copied.
+ */
+lv_obj_t *deck_list_create(lv_obj_t *parent, const list_t *cfg);
+
+/* Function to change the number of items of a list, e.g. after the host
+ * pushed a new clip list. Bound items are refreshed.
+ */
+void deck_list_set_count(lv_obj_t *list, uint32_t item_count);
+
+/* Function to rebind all live items, e.g. after the data changed */
+void deck_list_refresh(lv_obj_t *list);
+
+#if CONFIG_DECK_GL_BENCHMARKS
+/* Benchmark of the virtualized list with 1000 items, logs heap use and the
+ * frame time while scrolling. Must be called after the display is created
+ * and before the LVGL task is started.
+ */
+void deck_list_run_benchmark(void);
+
+/* Benchmark of full page redraws and single key redraws, rendered as one
+ * tile and split into one tile per draw unit. Must be called after
+ * deck_create_ui and before the LVGL task is started.
+ */
+void deck_render_run_benchmark(void);
+
+/* Benchmark of CPU against GDMA copies of key images of several sizes into
+ * a draw buffer, and of redrawing a key showing an image with and without
+ * the blit unit. Must be called after deck_create_ui and before the LVGL
+ * task is started.
+ */
+void deck_blit_run_benchmark(void);
+#endif
+
 void deck_create_ui(void);
 void update_slider_value(int slider_index, int value);
 void update_slider_text(int slider_index, const char *label);
 void update_button_color(int btn_index, lv_color_t color);
 void update_button_text(int btn_index, const char *label);
+
+/* Function to show a cached key image on a button, NULL removes it. RGB565
+ * images in internal RAM are drawn by the GDMA blit unit of lvgl_driver
+ * (lvgl_blit_init). The image must stay valid while it is shown.
+ */
+void update_button_image(int btn_index, const lv_image_dsc_t *img);
+
+/* Function to play an animation from the asset partition on a button in
+ * place of its icon, NULL stops it.
+ */
+void update_button_animation(int btn_index, const char *name);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "deck_gl.h"
+#include "deck_persist.h"
+#include "lvgl.h"
+
+/* Internal interface shared between the deck_gl source files. */
+
+extern ui_context_t ui_ctx;
+/* Slider values and page switches, see deck_state.h */
+extern deck_state_t deck_state;
+
+/* Build the LVGL object tree of a page on a new (not loaded) screen and fill
+ * ctx with the created objects.
+ */
+lv_obj_t *deck_build_page(const page_config_t *page, ui_context_t *ctx);
+
+/* Bring the sliders of a cached page to the values of deck_state, which
+ * only the shown page follows. Called before a cached page is shown.
+ */
+void deck_sync_sliders(const ui_context_t *ctx);
+
+/* Memory currently used for LVGL objects. LVGL's own heap is measured when it
+ * is used, otherwise the system heap LVGL allocates from.
+ */
+size_t deck_mem_used(void);
+
+/* Build and load the home page, called by deck_create_ui */
+void deck_pages_start(void);
+
+/* Return to the parent of the current page */
+void deck_page_back(void);
+
+/* Objects of a built (cached or shown) page, NULL if it is not built */
+const ui_context_t *deck_page_context(uint32_t page);
+
+/* Create the live data widgets of a freshly built page */
+void deck_live_attach(uint32_t page, const ui_context_t *ctx);
+
+/* Register the live data report, called by deck_create_ui */
+void deck_live_init(void);
+
+/* Configurations of the keys showing live widgets, for deck_persist. out
+ * takes DECK_PERSIST_LIVE_MAX entries; returns how many were written.
+ */
+uint32_t deck_live_get_configs(deck_persist_live_t *out);
+
+/* Configure live widgets as saved by deck_persist, before the UI is built */
+void deck_live_restore(const deck_persist_live_t *keys, uint32_t count);
+
+/* Live keys of one page table. Keys are numbered by page and button, so
+ * every profile has its own; deck_profile keeps those of the profiles not
+ * shown.
+ */
+typedef struct deck_live_keys deck_live_keys_t;
+
+/* Function to allocate keys without widgets, NULL without memory */
+deck_live_keys_t *deck_live_keys_create(void);
+
+/* Function to make keys the ones reports and pages use, before the pages
+ * of their table are shown. Returns the keys used so far; at first those
+ * of the built-in pages.
+ */
+deck_live_keys_t *deck_live_use_keys(deck_live_keys_t *keys);
+
+/* Page deck_create_ui shows first, the home page unless restored */
+void deck_page_set_start(uint32_t page);
+
+/* Show page of another page table (a profile's), NULL for the one given to
+ * deck_set_pages. Before deck_create_ui only the table is taken. Tables must
+ * stay valid for good, the standby page may be built from any of them.
+ * start_us is when the switch was asked for, the latency is measured from
+ * it.
+ */
+void deck_pages_replace(const page_config_t *table, uint32_t count,
+                        uint32_t page, int64_t start_us);
+
+/* Page table likely given to deck_pages_replace next, NULL for the one given
+ * to deck_set_pages. Its page 0 is built as standby page while LVGL is idle
+ * and shown without being built again when the switch comes.
+ */
+void deck_pages_prepare(const page_config_t *table);
+
+/* Note a change of what deck_persist saves. Only records the time, so any
+ * path can call it; callers hold the LVGL lock.
+ */
+#if CONFIG_DECK_GL_PERSIST
+void deck_persist_changed(void);
+#else
+static inline void deck_persist_changed(void) {}
+#endif
+
+/* Register the HUD report, called by deck_create_ui */
+#if CONFIG_DECK_GL_HUD
+void deck_hud_init(void);
+#else
+static inline void deck_hud_init(void) {}
+#endif
+
+/* Font of all deck labels, the font asset CONFIG_DECK_GL_FONT or the
+ * built-in font when it is not set or not in the asset partition.
+ */
+const lv_font_t *deck_label_font(void);
+
+/* Load the label font from the current asset partition. Returns the previous
+ * label font (or NULL) for the caller to destroy once no page uses it.
+ */
+lv_font_t *deck_label_font_reload(void);
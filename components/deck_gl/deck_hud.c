@@ -0,0 +1,190 @@
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+
+#if CONFIG_DECK_GL_HUD
+
+#include "deck_hid.h"
+#include "deck_telemetry.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_private.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HUD_WIDTH 200
+#define HUD_TEXT_MAX 128
+
+/* Frame rate and render/flush times come from LVGL's performance monitor,
+ * whose own label stays hidden; its timer is slowed down to the HUD period
+ * and paused while the HUD is hidden. LVGL's CPU figure needs task switch
+ * hooks ESP-IDF does not install, so the load is taken from the FreeRTOS
+ * run time of each core's idle task instead.
+ */
+typedef struct {
+  lv_display_t *disp;
+  lv_obj_t *label;
+  char text[HUD_TEXT_MAX];
+  uint32_t touch_samples;
+  uint32_t touch_tick;
+#if configGENERATE_RUN_TIME_STATS
+  configRUN_TIME_COUNTER_TYPE idle[portNUM_PROCESSORS];
+  configRUN_TIME_COUNTER_TYPE total;
+#endif
+} hud_t;
+
+static hud_t hud;
+
+/* Load of every core in percent since the previous call, -1 without run
+ * time stats
+ */
+static void hud_cpu_load(int load[portNUM_PROCESSORS]) {
+#if configGENERATE_RUN_TIME_STATS
+  configRUN_TIME_COUNTER_TYPE total = portGET_RUN_TIME_COUNTER_VALUE();
+  configRUN_TIME_COUNTER_TYPE elapsed = total - hud.total;
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    TaskStatus_t status;
+    vTaskGetInfo(xTaskGetIdleTaskHandleForCore(core), &status, pdFALSE,
+                 eReady);
+    configRUN_TIME_COUNTER_TYPE idle = status.ulRunTimeCounter - hud.idle[core];
+    load[core] = elapsed ? 100 - LV_MIN(idle * 100 / elapsed, 100) : 0;
+    hud.idle[core] = status.ulRunTimeCounter;
+  }
+  hud.total = total;
+#else
+  for (int core = 0; core < portNUM_PROCESSORS; core++)
+    load[core] = -1;
+#endif
+}
+
+static uint32_t hud_touch_hz(void) {
+  uint32_t samples = deck_telemetry_touch_samples();
+  uint32_t elapsed = lv_tick_elaps(hud.touch_tick);
+  uint32_t hz = elapsed ? (samples - hud.touch_samples) * 1000 / elapsed : 0;
+  hud.touch_samples = samples;
+  hud.touch_tick = lv_tick_get();
+  return hz;
+}
+
+/* Called by the performance monitor every period. The label keeps a fixed
+ * size and is only touched when its text changed, so an idle deck redraws
+ * nothing but the figures that moved.
+ */
+static void hud_perf_observer_cb(lv_observer_t *observer,
+                                 lv_subject_t *subject) {
+  const lv_sysmon_perf_info_t *perf = lv_subject_get_pointer(subject);
+  lv_obj_t *label = lv_observer_get_target(observer);
+  if (lv_obj_has_flag(label, LV_OBJ_FLAG_HIDDEN))
+    return;
+
+  int load[portNUM_PROCESSORS];
+  hud_cpu_load(load);
+  char cpu[24] = "-";
+  int pos = 0;
+  for (int core = 0; core < portNUM_PROCESSORS && load[0] >= 0; core++)
+    pos += snprintf(cpu + pos, sizeof(cpu) - pos, "%s%d%%", core ? " " : "",
+                    load[core]);
+
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+
+  char text[HUD_TEXT_MAX];
+  snprintf(text, sizeof(text),
+           "%" LV_PRIu32 " FPS  CPU %s\n"
+           "render %" LV_PRIu32 " ms  flush %" LV_PRIu32 " ms\n"
+           "heap %u KB %u%%  frag %u%%\n"
+           "touch %" LV_PRIu32 " Hz",
+           perf->calculated.fps, cpu, perf->calculated.render_avg_time,
+           perf->calculated.flush_avg_time,
+           (unsigned)((mon.total_size - mon.free_size) / 1024),
+           (unsigned)mon.used_pct, (unsigned)mon.frag_pct, hud_touch_hz());
+  if (strcmp(text, hud.text) == 0)
+    return;
+  strcpy(hud.text, text);
+  lv_label_set_text_static(label, hud.text);
+}
+
+static void hud_create(void) {
+  lv_sysmon_show_performance(hud.disp);
+  lv_sysmon_hide_performance(hud.disp);
+  lv_timer_set_period(hud.disp->perf_sysmon_backend.timer,
+                      CONFIG_DECK_GL_HUD_PERIOD_MS);
+
+  lv_obj_t *label = lv_label_create(lv_display_get_layer_top(hud.disp));
+  lv_obj_set_size(label, HUD_WIDTH, LV_SIZE_CONTENT);
+  lv_obj_align(label, LV_ALIGN_TOP_RIGHT, 0, 0);
+  lv_obj_set_style_bg_color(label, lv_color_black(), 0);
+  lv_obj_set_style_bg_opa(label, LV_OPA_70, 0);
+  lv_obj_set_style_text_color(label, lv_color_white(), 0);
+  lv_obj_set_style_text_font(label, LV_FONT_DEFAULT, 0);
+  lv_obj_set_style_pad_all(label, 4, 0);
+  lv_obj_add_flag(label, LV_OBJ_FLAG_HIDDEN);
+  lv_label_set_text_static(label, "");
+  lv_subject_add_observer_obj(&hud.disp->perf_sysmon_backend.subject,
+                              hud_perf_observer_cb, label, NULL);
+  hud.label = label;
+}
+
+void deck_hud_show(bool show) {
+  if (hud.label == NULL) {
+    if (!show)
+      return;
+    hud_create();
+  }
+  if (show == deck_hud_is_shown())
+    return;
+
+  if (show) {
+    // Start every figure from now instead of from when it was hidden
+    int load[portNUM_PROCESSORS];
+    hud_cpu_load(load);
+    hud_touch_hz();
+    lv_sysmon_performance_dump(hud.disp);
+    hud.text[0] = '\0';
+    lv_label_set_text_static(hud.label, "...");
+    lv_obj_remove_flag(hud.label, LV_OBJ_FLAG_HIDDEN);
+    lv_sysmon_performance_resume(hud.disp);
+  } else {
+    lv_sysmon_performance_pause(hud.disp);
+    lv_obj_add_flag(hud.label, LV_OBJ_FLAG_HIDDEN);
+  }
+  ESP_LOGI("HUD", "%s", show ? "Shown" : "Hidden");
+}
+
+bool deck_hud_is_shown(void) {
+  return hud.label != NULL && !lv_obj_has_flag(hud.label, LV_OBJ_FLAG_HIDDEN);
+}
+
+static void hud_hid_set(uint8_t report_id, const uint8_t *data,
+                        uint16_t len) {
+  if (len < 1)
+    return;
+  lv_lock();
+  deck_hud_show(data[0] == 2 ? !deck_hud_is_shown() : data[0] != 0);
+  lv_unlock();
+}
+
+/* A long press on the screen or a key container, not on a key or slider */
+static void hud_long_press_event_cb(lv_event_t *e) {
+  lv_obj_t *obj = lv_event_get_param(e);
+  if (obj != NULL && lv_obj_check_type(obj, &lv_obj_class))
+    deck_hud_show(!deck_hud_is_shown());
+}
+
+void deck_hud_init(void) {
+  hud.disp = lv_display_get_default();
+  // LVGL shows its own label when the display is created, with hardware
+  // scrolling it would even be carried along by page slides
+  lv_sysmon_hide_performance(hud.disp);
+  lv_sysmon_performance_pause(hud.disp);
+  deck_hid_register_report(DECK_HUD_HID_REPORT, hud_hid_set, NULL);
+}
+
+void deck_hud_attach_indev(lv_indev_t *indev) {
+  if (indev != NULL && lv_indev_get_type(indev) == LV_INDEV_TYPE_POINTER)
+    lv_indev_add_event_cb(indev, hud_long_press_event_cb,
+                          LV_EVENT_LONG_PRESSED, NULL);
+}
+
+#endif
@@ -0,0 +1,228 @@
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define BLACK 0x000000
+#define WHITE 0xFFFFFF
+#define BLUE 0xFF0000
+
+#define UNBOUND UINT32_MAX
+
+/* Live state of a virtualized list. Pool items are assigned to rows round
+ * robin (row % pool_rows), so scrolling by one row rebinds exactly one row of
+ * items and leaves the others untouched.
+ */
+typedef struct {
+  list_t cfg;
+  lv_obj_t *spacer;
+  uint32_t pool_rows;
+  uint32_t item_width;
+  lv_obj_t **items;    // pool_rows * columns items
+  uint32_t *bound_row; // data row shown by each pool row, UNBOUND if none
+} list_state_t;
+
+static void list_item_clicked_event_cb(lv_event_t *e) {
+  list_state_t *state = lv_event_get_user_data(e);
+  lv_obj_t *item = lv_event_get_current_target(e);
+  uint32_t index = (uint32_t)(uintptr_t)lv_obj_get_user_data(item);
+  if (state->cfg.click_cb != NULL)
+    state->cfg.click_cb(index, state->cfg.user_data);
+}
+
+static lv_obj_t *create_list_item(lv_obj_t *list, list_state_t *state) {
+  lv_obj_t *item = lv_button_create(list);
+  lv_obj_set_size(item, state->item_width, state->cfg.row_height - 5);
+  lv_obj_set_style_bg_color(item, state->cfg.item_color, LV_PART_MAIN);
+  lv_obj_set_style_radius(item, 8, 0);
+  lv_obj_add_flag(item, LV_OBJ_FLAG_HIDDEN);
+
+  lv_obj_t *label = lv_label_create(item);
+  lv_obj_set_style_text_color(label, lv_color_hex(WHITE), 0);
+  lv_obj_set_style_text_font(label, &lv_font_montserrat_14, 0);
+  lv_label_set_long_mode(label, LV_LABEL_LONG_MODE_DOTS);
+  lv_obj_set_width(label, LV_PCT(100));
+  lv_obj_center(label);
+
+  lv_obj_add_event_cb(item, list_item_clicked_event_cb, LV_EVENT_CLICKED,
+                      state);
+  return item;
+}
+
+/* Bind pool row slot to data row, moving its items in place */
+static void bind_row(list_state_t *state, uint32_t slot, uint32_t row) {
+  uint32_t columns = state->cfg.columns;
+  for (uint32_t col = 0; col < columns; col++) {
+    lv_obj_t *item = state->items[slot * columns + col];
+    uint32_t index = row * columns + col;
+    if (row == UNBOUND || index >= state->cfg.item_count) {
+      lv_obj_add_flag(item, LV_OBJ_FLAG_HIDDEN);
+      continue;
+    }
+    lv_obj_set_pos(item, col * (state->item_width + 5),
+                   row * state->cfg.row_height);
+    lv_obj_set_user_data(item, (void *)(uintptr_t)index);
+    state->cfg.bind_cb(item, index, state->cfg.user_data);
+    lv_obj_remove_flag(item, LV_OBJ_FLAG_HIDDEN);
+  }
+  state->bound_row[slot] = row;
+}
+
+static void list_update(lv_obj_t *list, list_state_t *state, bool force) {
+  uint32_t row_count = (state->cfg.item_count + state->cfg.columns - 1) /
+                       state->cfg.columns;
+  int32_t first = lv_obj_get_scroll_y(list) / (int32_t)state->cfg.row_height -
+                  (int32_t)state->cfg.margin_rows;
+  if (first < 0)
+    first = 0;
+
+  for (uint32_t slot = 0; slot < state->pool_rows; slot++) {
+    // Data row in [first, first + pool_rows) that maps to this slot
+    uint32_t offset =
+        (slot + state->pool_rows - first % state->pool_rows) % state->pool_rows;
+    uint32_t row = first + offset;
+    if (row >= row_count)
+      row = UNBOUND;
+    if (force || state->bound_row[slot] != row)
+      bind_row(state, slot, row);
+  }
+}
+
+static void list_scroll_event_cb(lv_event_t *e) {
+  lv_obj_t *list = lv_event_get_current_target(e);
+  list_update(list, lv_event_get_user_data(e), false);
+}
+
+static void list_delete_event_cb(lv_event_t *e) {
+  list_state_t *state = lv_event_get_user_data(e);
+  lv_free(state->items);
+  lv_free(state->bound_row);
+  lv_free(state);
+}
+
+static void list_set_content_height(list_state_t *state) {
+  uint32_t row_count = (state->cfg.item_count + state->cfg.columns - 1) /
+                       state->cfg.columns;
+  lv_obj_set_pos(state->spacer, 0, row_count * state->cfg.row_height);
+}
+
+lv_obj_t *deck_list_create(lv_obj_t *parent, const list_t *cfg) {
+  list_state_t *state = lv_malloc_zeroed(sizeof(list_state_t));
+  state->cfg = *cfg;
+  if (state->cfg.columns == 0)
+    state->cfg.columns = 1;
+
+  lv_obj_t *list = lv_obj_create(parent);
+  lv_obj_set_size(list, cfg->width, cfg->height);
+  lv_obj_set_style_bg_color(list, cfg->bg_color, LV_PART_MAIN);
+  lv_obj_set_style_border_width(list, 0, 0);
+  lv_obj_set_style_pad_all(list, 0, 0);
+  lv_obj_set_scroll_dir(list, LV_DIR_VER);
+
+  // Zero sized object at the end of the content so LVGL scrolls over all rows
+  // without every row existing
+  state->spacer = lv_obj_create(list);
+  lv_obj_remove_style_all(state->spacer);
+  lv_obj_set_size(state->spacer, 1, 1);
+  lv_obj_remove_flag(state->spacer, LV_OBJ_FLAG_CLICKABLE);
+  list_set_content_height(state);
+
+  uint32_t columns = state->cfg.columns;
+  state->item_width = (cfg->width - (columns - 1) * 5) / columns;
+  state->pool_rows = (cfg->height + cfg->row_height - 1) / cfg->row_height +
+                     1 + 2 * cfg->margin_rows;
+  state->items = lv_malloc(state->pool_rows * columns * sizeof(lv_obj_t *));
+  state->bound_row = lv_malloc(state->pool_rows * sizeof(uint32_t));
+  for (uint32_t slot = 0; slot < state->pool_rows; slot++) {
+    state->bound_row[slot] = UNBOUND;
+    for (uint32_t col = 0; col < columns; col++)
+      state->items[slot * columns + col] = create_list_item(list, state);
+  }
+
+  lv_obj_add_event_cb(list, list_scroll_event_cb, LV_EVENT_SCROLL, state);
+  lv_obj_add_event_cb(list, list_delete_event_cb, LV_EVENT_DELETE, state);
+  lv_obj_set_user_data(list, state);
+
+  list_update(list, state, true);
+  return list;
+}
+
+void deck_list_set_count(lv_obj_t *list, uint32_t item_count) {
+  list_state_t *state = lv_obj_get_user_data(list);
+  state->cfg.item_count = item_count;
+  list_set_content_height(state);
+  lv_obj_update_layout(list);
+  list_update(list, state, true);
+}
+
+void deck_list_refresh(lv_obj_t *list) {
+  list_update(list, lv_obj_get_user_data(list), true);
+}
+
+#if CONFIG_DECK_GL_BENCHMARKS
+
+#define BENCH_ITEMS 1000
+#define BENCH_FRAMES 200
+
+static void bench_bind_cb(lv_obj_t *item, uint32_t index, void *user_data) {
+  lv_label_set_text_fmt(lv_obj_get_child(item, 0), "Clip %" PRIu32, index + 1);
+}
+
+static size_t bench_list_mem(lv_obj_t *scr, uint32_t item_count,
+                             lv_obj_t **out) {
+  size_t before = deck_mem_used();
+  *out = deck_list_create(scr, &(list_t){.width = 480,
+                                         .height = 320,
+                                         .columns = 2,
+                                         .row_height = 45,
+                                         .margin_rows = 2,
+                                         .item_count = item_count,
+                                         .bg_color = lv_color_hex(BLACK),
+                                         .item_color = lv_color_hex(BLUE),
+                                         .bind_cb = bench_bind_cb});
+  return deck_mem_used() - before;
+}
+
+void deck_list_run_benchmark(void) {
+  lv_display_t *disp = lv_display_get_default();
+  lv_obj_t *prev = lv_screen_active();
+  lv_obj_t *scr = lv_obj_create(NULL);
+  lv_screen_load(scr);
+
+  lv_obj_t *list;
+  size_t small_mem = bench_list_mem(scr, 10, &list);
+  lv_obj_delete(list);
+  size_t mem = bench_list_mem(scr, BENCH_ITEMS, &list);
+  ESP_LOGI("BENCH", "list: heap %u bytes for 10 items, %u bytes for %d items",
+           (unsigned)small_mem, (unsigned)mem, BENCH_ITEMS);
+
+  lv_refr_now(disp);
+  lv_obj_update_layout(list);
+  size_t scroll_mem = deck_mem_used();
+  int32_t step = lv_obj_get_scroll_bottom(list) / BENCH_FRAMES;
+  int64_t total_us = 0;
+  int64_t max_us = 0;
+  for (int frame = 1; frame <= BENCH_FRAMES; frame++) {
+    int64_t start = esp_timer_get_time();
+    lv_obj_scroll_to_y(list, frame * step, LV_ANIM_OFF);
+    lv_refr_now(disp);
+    int64_t elapsed = esp_timer_get_time() - start;
+    total_us += elapsed;
+    if (elapsed > max_us)
+      max_us = elapsed;
+  }
+  ESP_LOGI("BENCH",
+           "list: %d scroll frames, avg %" PRId64 " us, max %" PRId64 " us",
+           BENCH_FRAMES, total_us / BENCH_FRAMES, max_us);
+  ESP_LOGI("BENCH", "list: heap change while scrolling %d bytes",
+           (int)(deck_mem_used() - scroll_mem));
+
+  lv_screen_load(prev);
+  lv_obj_delete(scr);
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "deck_hid.h"
+#include "esp_log.h"
+#include "lvgl.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LIVE_KEY_COUNT (DECK_PAGE_MAX * 8)
+
+/* Live state of one key. The widget objects exist while the key's page is
+ * built; the state outlives them so a rebuilt page shows the same history.
+ */
+typedef struct {
+  uint8_t type;
+  uint8_t format;
+  uint8_t digits;
+  int16_t min;
+  int16_t max;
+  int32_t value;
+  int16_t samples[DECK_LIVE_POINTS];
+  uint8_t sample_next;
+  uint8_t sample_count;
+  lv_obj_t *obj;
+  lv_chart_series_t *ser;
+  lv_obj_t *cells[DECK_LIVE_DIGITS_MAX];
+  char text[DECK_LIVE_DIGITS_MAX];
+} live_key_t;
+
+struct deck_live_keys {
+  live_key_t *key[LIVE_KEY_COUNT];
+};
+
+static deck_live_keys_t builtin_keys;
+// Of the page table shown
+static deck_live_keys_t *shown = &builtin_keys;
+
+/* Only cells whose character changed are touched, so a counter ticking from
+ * 41 to 42 redraws one digit cell instead of the whole label.
+ */
+static void live_show_value(live_key_t *k) {
+  if (k->obj == NULL)
+    return;
+
+  switch (k->type) {
+  case DECK_LIVE_READOUT: {
+    char text[DECK_LIVE_DIGITS_MAX];
+    deck_live_format(k->format, k->digits, k->value, text);
+    for (int i = 0; i < k->digits; i++) {
+      if (text[i] == k->text[i])
+        continue;
+      char cell[2] = {text[i], '\0'};
+      lv_label_set_text(k->cells[i], cell);
+      k->text[i] = text[i];
+    }
+    break;
+  }
+  case DECK_LIVE_METER:
+    lv_bar_set_value(k->obj, k->value, LV_ANIM_OFF);
+    break;
+  default:
+    break;
+  }
+}
+
+static void live_add_sample(live_key_t *k, int16_t sample) {
+  k->samples[k->sample_next] = sample;
+  k->sample_next = (k->sample_next + 1) % DECK_LIVE_POINTS;
+  if (k->sample_count < DECK_LIVE_POINTS)
+    k->sample_count++;
+  k->value = sample;
+
+  // Circular mode overwrites one point in place and invalidates only the
+  // area around it, the sweep wraps around instead of scrolling
+  if (k->obj != NULL && k->type == DECK_LIVE_SPARKLINE)
+    lv_chart_set_next_value(k->obj, k->ser, sample);
+}
+
+static void live_delete_event_cb(lv_event_t *e) {
+  live_key_t *k = lv_event_get_user_data(e);
+  k->obj = NULL;
+  k->ser = NULL;
+}
+
+static int32_t live_cell_width(const lv_font_t *font) {
+  int32_t w = 0;
+  for (uint32_t c = '0'; c <= '9'; c++)
+    w = LV_MAX(w, (int32_t)lv_font_get_glyph_width(font, c, 0));
+  return w;
+}
+
+static void live_create(live_key_t *k, lv_obj_t *btn) {
+  lv_obj_t *obj;
+  switch (k->type) {
+  case DECK_LIVE_READOUT: {
+    const lv_font_t *font = deck_label_font();
+    int32_t cell_w = live_cell_width(font);
+    obj = lv_obj_create(btn);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_size(obj, cell_w * k->digits, lv_font_get_line_height(font));
+    lv_obj_align(obj, LV_ALIGN_CENTER, 0, -8);
+    // One label per digit cell, every cell as wide as the widest digit
+    for (int i = 0; i < k->digits; i++) {
+      lv_obj_t *cell = lv_label_create(obj);
+      lv_label_set_text_static(cell, "");
+      lv_obj_set_style_text_font(cell, font, 0);
+      lv_obj_set_style_text_color(cell, lv_color_white(), 0);
+      lv_obj_set_style_text_align(cell, LV_TEXT_ALIGN_CENTER, 0);
+      lv_obj_set_width(cell, cell_w);
+      lv_obj_set_pos(cell, cell_w * i, 0);
+      k->cells[i] = cell;
+    }
+    memset(k->text, 0, sizeof(k->text));
+    break;
+  }
+  case DECK_LIVE_SPARKLINE:
+    obj = lv_chart_create(btn);
+    lv_obj_remove_style_all(obj);
+    lv_obj_set_size(obj, LV_PCT(100), LV_PCT(55));
+    lv_obj_align(obj, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_style_line_width(obj, 2, LV_PART_ITEMS);
+    lv_obj_set_style_size(obj, 0, 0, LV_PART_INDICATOR);
+    lv_chart_set_type(obj, LV_CHART_TYPE_LINE);
+    lv_chart_set_div_line_count(obj, 0, 0);
+    lv_chart_set_update_mode(obj, LV_CHART_UPDATE_MODE_CIRCULAR);
+    lv_chart_set_point_count(obj, DECK_LIVE_POINTS);
+    lv_chart_set_axis_range(obj, LV_CHART_AXIS_PRIMARY_Y, k->min, k->max);
+    k->ser = lv_chart_add_series(obj, lv_color_white(),
+                                 LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_values(obj, k->ser, LV_CHART_POINT_NONE);
+    break;
+  case DECK_LIVE_METER:
+    obj = lv_bar_create(btn);
+    lv_obj_set_size(obj, LV_PCT(90), 8);
+    lv_obj_align(obj, LV_ALIGN_CENTER, 0, -8);
+    lv_bar_set_range(obj, k->min, k->max);
+    break;
+  default:
+    return;
+  }
+
+  lv_obj_remove_flag(obj, LV_OBJ_FLAG_CLICKABLE);
+  lv_obj_add_event_cb(obj, live_delete_event_cb, LV_EVENT_DELETE, k);
+  k->obj = obj;
+
+  lv_obj_t *label = lv_obj_get_child_by_type(btn, 0, &lv_label_class);
+  if (label != NULL)
+    lv_obj_align(label, LV_ALIGN_BOTTOM_MID, 0, 0);
+
+  // Replay the history kept while the page was not built
+  if (k->type == DECK_LIVE_SPARKLINE) {
+    uint32_t first = (k->sample_next + DECK_LIVE_POINTS - k->sample_count) %
+                     DECK_LIVE_POINTS;
+    for (uint32_t i = 0; i < k->sample_count; i++)
+      lv_chart_set_next_value(obj, k->ser,
+                              k->samples[(first + i) % DECK_LIVE_POINTS]);
+  }
+  live_show_value(k);
+}
+
+static lv_obj_t *live_key_button(uint32_t key) {
+  const ui_context_t *ctx = deck_page_context(key / 8);
+  return ctx ? ctx->btn[key % 8] : NULL;
+}
+
+static void live_config(uint32_t key, const deck_live_config_t *cfg) {
+  live_key_t *k = shown->key[key];
+  if (k == NULL) {
+    k = calloc(1, sizeof(live_key_t));
+    if (k == NULL)
+      return;
+    shown->key[key] = k;
+  } else if (k->obj != NULL) {
+    lv_obj_delete(k->obj);
+  }
+
+  k->type = cfg->type;
+  k->format = cfg->format;
+  k->digits = LV_CLAMP(1, cfg->digits, DECK_LIVE_DIGITS_MAX);
+  k->min = cfg->min;
+  k->max = cfg->max;
+  if (k->max <= k->min)
+    k->max = k->min + 1;
+  k->sample_count = 0;
+  k->sample_next = 0;
+  k->value = 0;
+
+  lv_obj_t *btn = live_key_button(key);
+  if (btn != NULL)
+    live_create(k, btn);
+  deck_persist_changed();
+}
+
+static void live_remove(uint32_t key) {
+  live_key_t *k = shown->key[key];
+  if (k == NULL)
+    return;
+  if (k->obj != NULL) {
+    lv_obj_t *label = lv_obj_get_child_by_type(lv_obj_get_parent(k->obj), 0,
+                                               &lv_label_class);
+    lv_obj_delete(k->obj);
+    if (label != NULL)
+      lv_obj_center(label);
+  }
+  free(k);
+  shown->key[key] = NULL;
+  deck_persist_changed();
+}
+
+/* Applies the records of a report, see DECK_LIVE_HID_REPORT */
+static void live_hid_set(uint8_t report_id, const uint8_t *data,
+                         uint16_t len) {
+  deck_live_reader_t reader;
+  deck_live_record_t rec;
+  deck_live_reader_init(&reader, data, len);
+
+  lv_lock();
+  while (true) {
+    uint16_t pos = reader.pos;
+    deck_live_read_t res = deck_live_read(&reader, &rec);
+    if (res == DECK_LIVE_READ_END)
+      break;
+    if (res == DECK_LIVE_READ_BAD || rec.key >= LIVE_KEY_COUNT) {
+      ESP_LOGW("LIVE", "Bad record at %u (key %u op %u)", pos, rec.key,
+               rec.op);
+      break;
+    }
+
+    uint8_t key = rec.key;
+    const uint8_t *args = rec.args;
+    live_key_t *k = shown->key[key];
+    deck_live_config_t cfg;
+    switch (rec.op) {
+    case DECK_LIVE_OP_CONFIG:
+      deck_live_get_config(args, &cfg);
+      live_config(key, &cfg);
+      break;
+    case DECK_LIVE_OP_VALUE:
+      if (k == NULL)
+        break;
+      if (k->type == DECK_LIVE_SPARKLINE) {
+        live_add_sample(k, (int16_t)LV_CLAMP(INT16_MIN,
+                                             deck_live_get_le32(args),
+                                             INT16_MAX));
+      } else {
+        k->value = deck_live_get_le32(args);
+        live_show_value(k);
+      }
+      break;
+    case DECK_LIVE_OP_SAMPLES:
+      if (k == NULL)
+        break;
+      for (int i = 0; i < args[0]; i++)
+        live_add_sample(k, deck_live_get_le16(args + 1 + 2 * i));
+      live_show_value(k);
+      break;
+    case DECK_LIVE_OP_REMOVE:
+      live_remove(key);
+      break;
+    }
+  }
+  lv_unlock();
+}
+
+deck_live_keys_t *deck_live_keys_create(void) {
+  return calloc(1, sizeof(deck_live_keys_t));
+}
+
+/* Widgets of the keys given up stay on the screens of their pages until
+ * those are deleted, which clears them
+ */
+deck_live_keys_t *deck_live_use_keys(deck_live_keys_t *keys) {
+  deck_live_keys_t *used = shown;
+  shown = keys;
+  return used;
+}
+
+void deck_live_attach(uint32_t page, const ui_context_t *ctx) {
+  for (uint32_t b = 0; b < 8; b++) {
+    live_key_t *k = shown->key[page * 8 + b];
+    if (k == NULL || ctx->btn[b] == NULL)
+      continue;
+    // Still on a screen of the previous page table, deleted later
+    if (k->obj != NULL &&
+        lv_obj_get_screen(k->obj) != lv_obj_get_screen(ctx->btn[b]))
+      lv_obj_delete(k->obj);
+    if (k->obj == NULL)
+      live_create(k, ctx->btn[b]);
+  }
+}
+
+uint32_t deck_live_get_configs(deck_persist_live_t *out) {
+  uint32_t n = 0;
+  for (uint32_t key = 0; key < LIVE_KEY_COUNT; key++) {
+    live_key_t *k = shown->key[key];
+    if (k == NULL)
+      continue;
+    out[n++] = (deck_persist_live_t){
+        .key = key,
+        .cfg = {.type = k->type,
+                .format = k->format,
+                .digits = k->digits,
+                .min = k->min,
+                .max = k->max}};
+  }
+  return n;
+}
+
+void deck_live_restore(const deck_persist_live_t *keys, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (keys[i].key < LIVE_KEY_COUNT)
+      live_config(keys[i].key, &keys[i].cfg);
+  }
+}
+
+void deck_live_init(void) {
+  deck_hid_register_report(DECK_LIVE_HID_REPORT, live_hid_set, NULL);
+}
@@ -0,0 +1,502 @@
+#include "deck_assets.h"
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "lvgl_driver.h"
+#include "lvgl_private.h"
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BLUE 0xFF0000
+
+/* Prefetch runs from an LVGL timer and only builds a page when LVGL has been
+ * idle for at least this share of the last measurement period.
+ */
+#define PREFETCH_PERIOD_MS 100
+#define PREFETCH_MIN_IDLE_PCT 60
+
+/* Duration of the slide between pages when the display scrolls in hardware */
+#define PAGE_SLIDE_MS 200
+
+typedef struct {
+  lv_obj_t *screen;
+  ui_context_t ctx;
+  size_t mem_cost;
+  uint32_t last_used;
+} page_slot_t;
+
+static const page_config_t *pages;
+static uint32_t page_count;
+// The table given to deck_set_pages, pages may be a profile's instead
+static const page_config_t *builtin_pages;
+static uint32_t builtin_count;
+static bool started;
+static page_slot_t slots[DECK_PAGE_MAX];
+static uint32_t current_page;
+static uint32_t start_page;
+static uint32_t use_clock;
+
+// Page 0 of the page table most likely given to deck_pages_replace next,
+// built ahead while idle
+static const page_config_t *standby_pages;
+static page_slot_t standby;
+
+static deck_page_stats_t stats;
+static int64_t switch_start_us;
+static bool switch_replaced;
+
+static lv_obj_t *sliding_screen;
+static int32_t slide_pos;
+static int32_t slide_dir;
+
+// Single page matching the original fixed layout, used when no page table
+// has been given
+static page_config_t default_page = {.name = "Home", .parent = DECK_PAGE_ROOT};
+
+size_t deck_mem_used(void) {
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  return mon.total_size - mon.free_size;
+#else
+  return heap_caps_get_total_size(MALLOC_CAP_DEFAULT) -
+         heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+#endif
+}
+
+static void page_evict(uint32_t page) {
+  page_slot_t *slot = &slots[page];
+  // Deferred, a switch can be triggered from an event of the evicted page
+  lv_obj_delete_async(slot->screen);
+  stats.cache_bytes -= slot->mem_cost;
+  stats.evictions++;
+  ESP_LOGD("PAGE", "Evicted page %" PRIu32 " (%u bytes)", page,
+           (unsigned)slot->mem_cost);
+  memset(slot, 0, sizeof(*slot));
+}
+
+/* Evict least recently used pages until the cache fits its budget, never
+ * touching the active page or the page about to be shown.
+ */
+static void page_cache_trim(uint32_t keep) {
+  while (stats.cache_bytes > DECK_PAGE_CACHE_BUDGET) {
+    uint32_t victim = UINT32_MAX;
+    for (uint32_t i = 0; i < page_count; i++) {
+      if (slots[i].screen == NULL || i == current_page || i == keep)
+        continue;
+      if (victim == UINT32_MAX ||
+          slots[i].last_used < slots[victim].last_used)
+        victim = i;
+    }
+    if (victim == UINT32_MAX)
+      return;
+    page_evict(victim);
+  }
+}
+
+static page_slot_t *page_build(uint32_t page) {
+  page_slot_t *slot = &slots[page];
+  size_t before = deck_mem_used();
+  slot->screen = deck_build_page(&pages[page], &slot->ctx);
+  deck_live_attach(page, &slot->ctx);
+  size_t after = deck_mem_used();
+  slot->mem_cost = after > before ? after - before : 0;
+  stats.cache_bytes += slot->mem_cost;
+  ESP_LOGD("PAGE", "Built page %" PRIu32 " '%s' (%u bytes)", page,
+           pages[page].name, (unsigned)slot->mem_cost);
+  page_cache_trim(page);
+  return slot;
+}
+
+/* Most likely next page: the most frequent transition out of the current
+ * page, otherwise the first folder reachable from it.
+ */
+static uint32_t page_predict_next(void) {
+  uint32_t best = deck_state_likely_next(&deck_state, current_page, page_count);
+  if (best != UINT32_MAX)
+    return best;
+
+  const page_config_t *cfg = &pages[current_page];
+  for (int i = 0; i < 8; i++) {
+    if (cfg->buttons[i].action == BUTTON_ACTION_OPEN_PAGE &&
+        cfg->buttons[i].target < page_count)
+      return cfg->buttons[i].target;
+  }
+  return cfg->parent < page_count ? cfg->parent : UINT32_MAX;
+}
+
+static void standby_drop(void) {
+  if (standby.screen == NULL)
+    return;
+  lv_obj_delete_async(standby.screen);
+  stats.cache_bytes -= standby.mem_cost;
+  memset(&standby, 0, sizeof(standby));
+}
+
+/* Builds the standby page. Live data widgets are only moved to it once it
+ * is shown, their keys are those of the current pages until then.
+ */
+static void standby_build(void) {
+  size_t before = deck_mem_used();
+  standby.screen = deck_build_page(&standby_pages[0], &standby.ctx);
+  size_t after = deck_mem_used();
+  standby.mem_cost = after > before ? after - before : 0;
+  stats.cache_bytes += standby.mem_cost;
+  stats.prefetches++;
+  ESP_LOGD("PAGE", "Built standby page '%s' (%u bytes)", standby_pages[0].name,
+           (unsigned)standby.mem_cost);
+}
+
+static void prefetch_timer_cb(lv_timer_t *timer) {
+  if (lv_timer_get_idle() < PREFETCH_MIN_IDLE_PCT)
+    return;
+
+  uint32_t next = page_predict_next();
+  if (next != UINT32_MAX && slots[next].screen == NULL) {
+    page_build(next);
+    // Prefetched pages must not push out pages that were actually visited
+    slots[next].last_used = 0;
+    stats.prefetches++;
+    return;
+  }
+
+  // Pages of the current table come first, the standby page only takes
+  // what is left of the budget
+  if (standby_pages != NULL && standby.screen == NULL &&
+      stats.cache_bytes < DECK_PAGE_CACHE_BUDGET)
+    standby_build();
+}
+
+static void refr_ready_event_cb(lv_event_t *e) {
+  if (switch_start_us == 0)
+    return;
+  stats.last_pixels_us = (uint32_t)(esp_timer_get_time() - switch_start_us);
+  switch_start_us = 0;
+  if (switch_replaced)
+    ESP_LOGI("PAGE", "Page table on screen after %" PRIu32 " us",
+             stats.last_pixels_us);
+  else
+    ESP_LOGD("PAGE", "Page %" PRIu32 " on screen after %" PRIu32 " us",
+             current_page, stats.last_pixels_us);
+}
+
+/* Move the areas still waiting to be rendered along with the page, by dx
+ * pixels. They were invalidated where the page was before the step; left
+ * in place LVGL would render the wrong part of the page into them.
+ */
+static void slide_shift_invalid(lv_display_t *disp, int32_t dx) {
+  lv_area_t screen;
+  lv_area_set(&screen, 0, 0, lv_display_get_horizontal_resolution(disp) - 1,
+              lv_display_get_vertical_resolution(disp) - 1);
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < disp->inv_p; i++) {
+    if (disp->inv_area_joined[i])
+      continue;
+    lv_area_t area = disp->inv_areas[i];
+    lv_area_move(&area, dx, 0);
+    // Parts pushed off the panel are gone, the scroll wraps them into the
+    // band rendered anyway
+    if (!lv_area_intersect(&disp->inv_areas[kept], &area, &screen))
+      continue;
+    disp->inv_area_joined[kept++] = 0;
+  }
+  disp->inv_p = kept;
+}
+
+/* Slide step: the panel shifts the old page out, LVGL only renders the
+ * columns of the new page that were scrolled into view and the areas
+ * invalidated meanwhile, moved along.
+ */
+static void slide_anim_cb(void *var, int32_t pos) {
+  lv_obj_t *scr = var;
+  lv_display_t *disp = lv_obj_get_display(scr);
+  int32_t hor_res = lv_display_get_horizontal_resolution(disp);
+  int32_t delta = pos - slide_pos;
+  slide_pos = pos;
+
+  lv_display_enable_invalidation(disp, false);
+  lv_obj_set_x(scr, slide_dir > 0 ? hor_res - pos : pos - hor_res);
+  lv_obj_update_layout(scr);
+  slide_shift_invalid(disp, -slide_dir * delta);
+  lv_display_enable_invalidation(disp, true);
+  lvgl_scroll_by(disp, slide_dir * delta);
+}
+
+static void slide_completed_cb(lv_anim_t *a) { sliding_screen = NULL; }
+
+static void slide_finish(void) {
+  if (sliding_screen == NULL)
+    return;
+  lv_anim_delete(sliding_screen, slide_anim_cb);
+  lv_obj_set_x(sliding_screen, 0);
+  lv_obj_invalidate(sliding_screen);
+  sliding_screen = NULL;
+}
+
+/* Make scr the active screen. With horizontal hardware scrolling the page
+ * slides in, forward pages from the right and parents from the left.
+ */
+static void page_load(lv_obj_t *scr, bool animate, bool forward) {
+  lv_display_t *disp = lv_obj_get_display(scr);
+  bool along_x = false;
+  slide_finish();
+#if CONFIG_DECK_GL_HUD
+  // The panel scroll would carry the HUD along with the page
+  if (deck_hud_is_shown())
+    animate = false;
+#endif
+  if (!animate || !lvgl_scroll_is_enabled(disp, &along_x) || !along_x ||
+      scr == lv_screen_active()) {
+    lv_screen_load(scr);
+    return;
+  }
+
+  int32_t hor_res = lv_display_get_horizontal_resolution(disp);
+  lv_display_enable_invalidation(disp, false);
+  lv_obj_set_x(scr, forward ? hor_res : -hor_res);
+  lv_screen_load(scr);
+  lv_obj_update_layout(scr);
+  lv_display_enable_invalidation(disp, true);
+  // Areas of the old page not rendered yet would now render the new one;
+  // the old page slides out as the panel shows it
+  lv_inv_area(disp, NULL);
+
+  sliding_screen = scr;
+  slide_pos = 0;
+  slide_dir = forward ? 1 : -1;
+
+  lv_anim_t a;
+  lv_anim_init(&a);
+  lv_anim_set_var(&a, scr);
+  lv_anim_set_exec_cb(&a, slide_anim_cb);
+  lv_anim_set_values(&a, 0, hor_res);
+  lv_anim_set_duration(&a, PAGE_SLIDE_MS);
+  lv_anim_set_path_cb(&a, lv_anim_path_ease_out);
+  lv_anim_set_completed_cb(&a, slide_completed_cb);
+  lv_anim_start(&a);
+}
+
+/* Drop every cached page and show page of table in place of the active
+ * screen, without a slide. The standby page is shown if it is that page,
+ * page 0 of a table left becomes the standby page.
+ */
+static void pages_rebuild(const page_config_t *table, uint32_t count,
+                          uint32_t page) {
+  slide_finish();
+  page_slot_t next = {0};
+  if (standby.screen != NULL && standby_pages == table && page == 0) {
+    next = standby;
+    memset(&standby, 0, sizeof(standby));
+  }
+
+  lv_obj_t *old = slots[current_page].screen;
+  if (table != pages && slots[0].screen != NULL) {
+    standby_drop();
+    standby = slots[0];
+    standby_pages = pages;
+    memset(&slots[0], 0, sizeof(slots[0]));
+    if (current_page == 0)
+      old = NULL;
+  }
+  for (uint32_t i = 0; i < page_count; i++) {
+    if (slots[i].screen != NULL && i != current_page)
+      page_evict(i);
+  }
+  page_slot_t *slot = &slots[current_page];
+  stats.cache_bytes -= slot->mem_cost;
+  memset(slot, 0, sizeof(*slot));
+
+  pages = table;
+  page_count = count;
+  current_page = page;
+  if (next.screen != NULL) {
+    slot = &slots[current_page];
+    *slot = next;
+    deck_live_attach(current_page, &slot->ctx);
+    deck_sync_sliders(&slot->ctx);
+  } else {
+    slot = page_build(current_page);
+  }
+  slot->last_used = ++use_clock;
+  ui_ctx = slot->ctx;
+  lv_screen_load(slot->screen);
+  // Deferred, the caller may run from one of its events
+  if (old != NULL)
+    lv_obj_delete_async(old);
+}
+
+/* The pages show icons, animations and the label font from the asset
+ * partition; when it is remapped every page is dropped and the active one
+ * rebuilt in place.
+ */
+static void assets_changed_cb(bool loaded, void *user_data) {
+  deck_anim_stop_all();
+  lv_font_t *old_font = deck_label_font_reload();
+  // Built again by the prefetch
+  standby_drop();
+  pages_rebuild(pages, page_count, current_page);
+  // Deleting objects doesn't measure text, the pending deletes don't need it
+  deck_font_destroy(old_font);
+  ESP_LOGI("PAGE", "Pages rebuilt, assets %s", loaded ? "loaded" : "unloaded");
+}
+
+void deck_set_pages(const page_config_t *page_table, uint32_t count) {
+  if (count > DECK_PAGE_MAX) {
+    ESP_LOGW("PAGE", "Only %d of %" PRIu32 " pages used", DECK_PAGE_MAX, count);
+    count = DECK_PAGE_MAX;
+  }
+  pages = builtin_pages = page_table;
+  page_count = builtin_count = count;
+}
+
+/* The built-in table, the single default page when none or an empty one
+ * was set; its buttons are filled in by deck_pages_start.
+ */
+static const page_config_t *builtin_table(uint32_t *count) {
+  if (builtin_pages == NULL || builtin_count == 0) {
+    *count = 1;
+    return &default_page;
+  }
+  *count = builtin_count;
+  return builtin_pages;
+}
+
+void deck_pages_replace(const page_config_t *table, uint32_t count,
+                        uint32_t page, int64_t start_us) {
+  if (table == NULL || count == 0)
+    table = builtin_table(&count);
+  count = LV_MIN(count, DECK_PAGE_MAX);
+  if (!started) {
+    pages = table;
+    page_count = count;
+    return;
+  }
+
+  page = page < count ? page : 0;
+  bool ready = standby.screen != NULL && standby_pages == table && page == 0;
+  if (ready)
+    stats.hits++;
+  else
+    stats.misses++;
+  pages_rebuild(table, count, page);
+  deck_persist_changed();
+
+  int64_t end = esp_timer_get_time();
+  stats.last_switch_us = (uint32_t)(end - start_us);
+  if (stats.last_switch_us > stats.max_switch_us)
+    stats.max_switch_us = stats.last_switch_us;
+  switch_start_us = start_us;
+  switch_replaced = true;
+  ESP_LOGI("PAGE",
+           "%" PRIu32 " pages bound, page %" PRIu32 " '%s' %s after %" PRIu32
+           " us",
+           count, current_page, pages[current_page].name,
+           ready ? "shown from standby" : "built", stats.last_switch_us);
+}
+
+void deck_pages_prepare(const page_config_t *table) {
+  if (table == NULL) {
+    uint32_t count;
+    table = builtin_table(&count);
+  }
+  if (table == standby_pages)
+    return;
+  standby_drop();
+  // Built by the prefetch once LVGL is idle
+  standby_pages = table != pages ? table : NULL;
+}
+
+static void page_switch(uint32_t page, bool animate) {
+  if (page >= page_count) {
+    ESP_LOGW("PAGE", "Invalid page %" PRIu32, page);
+    return;
+  }
+
+  int64_t start = esp_timer_get_time();
+  page_slot_t *slot = &slots[page];
+  bool hit = slot->screen != NULL;
+  if (hit) {
+    stats.hits++;
+    deck_sync_sliders(&slot->ctx);
+  } else {
+    stats.misses++;
+    slot = page_build(page);
+  }
+
+  deck_state_page_switch(&deck_state, current_page, page);
+  deck_persist_changed();
+
+  bool forward = page != pages[current_page].parent;
+  slot->last_used = ++use_clock;
+  current_page = page;
+  ui_ctx = slot->ctx;
+  page_load(slot->screen, animate, forward);
+
+  int64_t end = esp_timer_get_time();
+  stats.last_switch_us = (uint32_t)(end - start);
+  if (stats.last_switch_us > stats.max_switch_us)
+    stats.max_switch_us = stats.last_switch_us;
+  switch_start_us = start;
+  switch_replaced = false;
+
+  ESP_LOGI("PAGE", "Page %" PRIu32 " '%s' shown in %" PRIu32 " us (%s)", page,
+           pages[page].name, stats.last_switch_us, hit ? "cached" : "built");
+  page_cache_trim(page);
+}
+
+void deck_show_page(uint32_t page) { page_switch(page, true); }
+
+void deck_page_back(void) {
+  uint32_t parent = pages[current_page].parent;
+  if (parent != DECK_PAGE_ROOT)
+    deck_show_page(parent);
+}
+
+uint32_t deck_current_page(void) { return current_page; }
+
+const ui_context_t *deck_page_context(uint32_t page) {
+  if (page >= page_count || slots[page].screen == NULL)
+    return NULL;
+  return &slots[page].ctx;
+}
+
+void deck_page_get_stats(deck_page_stats_t *out) { *out = stats; }
+
+void deck_page_set_start(uint32_t page) { start_page = page; }
+
+void deck_pages_start(void) {
+  if (builtin_pages == NULL || builtin_count == 0) {
+    for (int i = 0; i < 8; i++) {
+      static char btn_text[8][8];
+      snprintf(btn_text[i], sizeof(btn_text[i]), "Btn %d", i + 1);
+      default_page.buttons[i] = (button_t){.id = i + 1,
+                                           .label = btn_text[i],
+                                           .bg_color = lv_color_hex(BLUE),
+                                           .radius = 8};
+    }
+    builtin_pages = &default_page;
+    builtin_count = 1;
+  }
+  // Unless a profile was selected already
+  if (pages == NULL) {
+    pages = builtin_pages;
+    page_count = builtin_count;
+  }
+
+  lv_display_add_event_cb(lv_display_get_default(), refr_ready_event_cb,
+                          LV_EVENT_REFR_READY, NULL);
+  lv_timer_create(prefetch_timer_cb, PREFETCH_PERIOD_MS, NULL);
+  deck_assets_set_change_cb(assets_changed_cb, NULL);
+  deck_label_font_reload();
+
+  lv_obj_t *initial = lv_screen_active();
+  started = true;
+  current_page = start_page < page_count ? start_page : 0;
+  page_switch(current_page, false);
+  lv_obj_delete(initial);
+}
@@ -0,0 +1,172 @@
+#include "deck_gl.h"
+
+#if CONFIG_DECK_GL_PERSIST
+
+#include "deck_gl_priv.h"
+#include "deck_persist.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PERSIST_NAMESPACE "deck"
+#define PERSIST_KEY "state"
+#define PERSIST_TASK_PRIO 1
+
+/* A change only notes its time and wakes the persist task, which runs below
+ * everything else. It writes once nothing changed for the quiet period, no
+ * sooner than the interval after its previous write and no later than the
+ * maximum delay after the first unsaved change, so a slider drag costs one
+ * write. The state is copied under the LVGL lock, encoding and the NVS write
+ * happen outside of it, and a blob equal to the saved one is not written.
+ */
+typedef struct {
+  nvs_handle_t nvs;
+  TaskHandle_t task;
+  // The times are 64 bit, read and written under the lock so they don't tear
+  portMUX_TYPE lock;
+  int64_t changed_us; // last change
+  int64_t dirty_us;   // first change not saved, 0 when none
+  int64_t written_us;          // last write, 0 before the first
+  deck_persist_t snapshot;
+  uint8_t saved[DECK_PERSIST_SIZE_MAX];
+  size_t saved_len;
+  uint8_t blob[DECK_PERSIST_SIZE_MAX];
+} persist_t;
+
+static persist_t persist = {.lock = portMUX_INITIALIZER_UNLOCKED};
+
+void deck_persist_changed(void) {
+  if (persist.task == NULL)
+    return;
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL(&persist.lock);
+  if (persist.dirty_us == 0)
+    persist.dirty_us = now;
+  persist.changed_us = now;
+  portEXIT_CRITICAL(&persist.lock);
+  xTaskNotifyGive(persist.task);
+}
+
+/* Time until the state is due to be written, -1 when nothing is unsaved */
+static int64_t persist_due_in_us(void) {
+  portENTER_CRITICAL(&persist.lock);
+  int64_t dirty_us = persist.dirty_us;
+  int64_t changed_us = persist.changed_us;
+  portEXIT_CRITICAL(&persist.lock);
+  if (dirty_us == 0)
+    return -1;
+  int64_t due = changed_us + CONFIG_DECK_GL_PERSIST_QUIET_MS * 1000LL;
+  int64_t latest = dirty_us + CONFIG_DECK_GL_PERSIST_MAX_DELAY_S * 1000000LL;
+  if (due > latest)
+    due = latest;
+  int64_t earliest =
+      persist.written_us + CONFIG_DECK_GL_PERSIST_INTERVAL_S * 1000000LL;
+  if (persist.written_us != 0 && due < earliest)
+    due = earliest;
+  int64_t now = esp_timer_get_time();
+  return due > now ? due - now : 0;
+}
+
+static void persist_save(void) {
+  lv_lock();
+  persist.snapshot.state = deck_state;
+  persist.snapshot.page = deck_current_page();
+#if CONFIG_DECK_GL_PROFILES
+  const char *profile = deck_profile_active();
+  snprintf(persist.snapshot.profile, sizeof(persist.snapshot.profile), "%s",
+           profile != NULL ? profile : "");
+#endif
+  persist.snapshot.live_count = deck_live_get_configs(persist.snapshot.live);
+  portENTER_CRITICAL(&persist.lock);
+  persist.dirty_us = 0;
+  portEXIT_CRITICAL(&persist.lock);
+  lv_unlock();
+
+  size_t len = deck_persist_encode(&persist.snapshot, persist.blob,
+                                   sizeof(persist.blob));
+  // E.g. a slider dragged away and back
+  if (len == persist.saved_len && memcmp(persist.blob, persist.saved, len) == 0)
+    return;
+
+  int64_t start = esp_timer_get_time();
+  esp_err_t err = nvs_set_blob(persist.nvs, PERSIST_KEY, persist.blob, len);
+  if (err == ESP_OK)
+    err = nvs_commit(persist.nvs);
+  persist.written_us = esp_timer_get_time();
+  if (err != ESP_OK) {
+    ESP_LOGW("PERSIST", "Saving the deck state failed: %s",
+             esp_err_to_name(err));
+    return;
+  }
+  memcpy(persist.saved, persist.blob, len);
+  persist.saved_len = len;
+  ESP_LOGI("PERSIST", "Deck state saved, %u bytes in %lu us", (unsigned)len,
+           (unsigned long)(persist.written_us - start));
+}
+
+static void persist_task(void *arg) {
+  while (1) {
+    int64_t due_in_us = persist_due_in_us();
+    if (due_in_us < 0)
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    else if (due_in_us > 0)
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(due_in_us / 1000) + 1);
+    else
+      persist_save();
+  }
+}
+
+esp_err_t deck_persist_init(void) {
+  esp_err_t err = nvs_open(PERSIST_NAMESPACE, NVS_READWRITE, &persist.nvs);
+  if (err != ESP_OK)
+    return err;
+
+  size_t len = sizeof(persist.saved);
+  err = nvs_get_blob(persist.nvs, PERSIST_KEY, persist.saved, &len);
+  if (err == ESP_OK) {
+    // Sections it does not have keep the current values
+    persist.snapshot = (deck_persist_t){.state = deck_state};
+    if (deck_persist_decode(persist.saved, len, &persist.snapshot)) {
+      persist.saved_len = len;
+      deck_state = persist.snapshot.state;
+      bool pages = true;
+#if CONFIG_DECK_GL_PROFILES
+      // The page and its switch counts are those of the profile, the
+      // built-in pages start over
+      if (persist.snapshot.profile[0] != '\0') {
+        memset(deck_state.transitions, 0, sizeof(deck_state.transitions));
+        if (deck_profile_select(persist.snapshot.profile) == ESP_OK) {
+          memcpy(deck_state.transitions, persist.snapshot.state.transitions,
+                 sizeof(deck_state.transitions));
+        } else {
+          ESP_LOGW("PERSIST", "Profile '%s' is gone",
+                   persist.snapshot.profile);
+          pages = false;
+        }
+      }
+#endif
+      if (pages)
+        deck_page_set_start(persist.snapshot.page);
+      deck_live_restore(persist.snapshot.live, persist.snapshot.live_count);
+      ESP_LOGI("PERSIST", "Deck state restored, page %u, %u live keys",
+               persist.snapshot.page, persist.snapshot.live_count);
+    } else {
+      ESP_LOGW("PERSIST", "Saved deck state of another version ignored");
+      err = ESP_ERR_INVALID_VERSION;
+    }
+  } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+    err = ESP_ERR_NOT_FOUND;
+  }
+
+  if (xTaskCreate(persist_task, "persist", 3072, NULL, PERSIST_TASK_PRIO,
+                  &persist.task) != pdPASS)
+    return ESP_ERR_NO_MEM;
+  return err;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include "deck_gl.h"
+
+#if CONFIG_DECK_GL_PROFILES
+
+#include "deck_gl_priv.h"
+#include "deck_hid.h"
+#include "deck_profile.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* The container is checked once, when it is mapped. A profile is bound
+ * the first time it is needed: a page_config_t table whose strings point
+ * into the mapping, without copying or parsing anything, kept from then on.
+ * A switch rebuilds the page shown, the other pages of the profile are
+ * built when visited or prefetched. Every switch goes into the history,
+ * which gives the profile likely shown next; page 0 of that one is built
+ * as standby page while LVGL is idle.
+ */
+typedef struct {
+  page_config_t *pages; // NULL for the built-in pages
+  uint32_t page_count;
+  // deck_state.transitions and the live keys while another profile is shown
+  uint8_t transitions[DECK_PAGE_MAX][DECK_PAGE_MAX];
+  deck_live_keys_t *live;
+} profile_slot_t;
+
+typedef struct {
+  const esp_partition_t *part;
+  esp_partition_mmap_handle_t map_handle;
+  const uint8_t *base; // NULL without container
+  int active;          // -1 for the built-in pages
+  // By profile index, the built-in pages last; allocated when first shown
+  // or predicted
+  profile_slot_t **slots;
+  deck_profile_history_t history;
+} profiles_t;
+
+static profiles_t profiles = {.active = -1};
+
+static const char *profile_string(uint32_t offset, const char *none) {
+  const char *s = deck_profile_string(profiles.base, offset);
+  return s != NULL ? s : none;
+}
+
+static void profile_bind_page(const deck_profile_page_t *src,
+                              page_config_t *dst) {
+  dst->name = profile_string(src->name, "");
+  dst->parent =
+      src->parent == DECK_PROFILE_ROOT ? DECK_PAGE_ROOT : src->parent;
+  for (int i = 0; i < DECK_SLIDER_COUNT; i++)
+    dst->slider_names[i] = profile_string(src->slider_names[i], NULL);
+  for (int i = 0; i < 8; i++) {
+    const deck_profile_button_t *b = &src->buttons[i];
+    dst->buttons[i] = (button_t){
+        .id = i + 1,
+        .label = profile_string(b->label, ""),
+        .bg_color = lv_color_make(b->color[0], b->color[1], b->color[2]),
+        .radius = b->radius,
+        .action = b->action,
+        .target = b->target,
+        .icon = profile_string(b->icon, NULL),
+        .anim = profile_string(b->anim, NULL),
+    };
+  }
+}
+
+/* Slot of a profile, -1 for the built-in pages; bound on first use */
+static profile_slot_t *profile_slot(int index) {
+  uint32_t count = deck_profile_header(profiles.base)->count;
+  uint32_t i = index >= 0 ? (uint32_t)index : count;
+  if (profiles.slots[i] != NULL)
+    return profiles.slots[i];
+
+  profile_slot_t *slot = calloc(1, sizeof(*slot));
+  if (slot == NULL)
+    return NULL;
+  if (index >= 0) {
+    const deck_profile_entry_t *e = deck_profile_entry(profiles.base, index);
+    const deck_profile_page_t *src = deck_profile_pages(profiles.base, e);
+    slot->pages = calloc(e->page_count, sizeof(page_config_t));
+    slot->live = deck_live_keys_create();
+    if (slot->pages == NULL || slot->live == NULL) {
+      free(slot->pages);
+      free(slot->live);
+      free(slot);
+      return NULL;
+    }
+    for (uint32_t p = 0; p < e->page_count; p++)
+      profile_bind_page(&src[p], &slot->pages[p]);
+    slot->page_count = e->page_count;
+  }
+  profiles.slots[i] = slot;
+  return slot;
+}
+
+static uint8_t history_id(int index) {
+  return index >= 0 ? (uint8_t)index : DECK_PROFILE_BUILTIN;
+}
+
+/* Show profile index, -1 for the built-in pages. start_us is when the switch
+ * was asked for.
+ */
+static esp_err_t profile_switch(int index, int64_t start_us) {
+  if (index == profiles.active)
+    return ESP_OK;
+  // Without container only the built-in pages are ever shown
+  if (profiles.base == NULL)
+    return ESP_ERR_NOT_FOUND;
+  profile_slot_t *from = profile_slot(profiles.active);
+  profile_slot_t *to = profile_slot(index);
+  if (from == NULL || to == NULL)
+    return ESP_ERR_NO_MEM;
+
+  // Switch counts and live keys are by page number, every profile keeps its
+  // own. The built-in pages get theirs the first time they are left.
+  memcpy(from->transitions, deck_state.transitions,
+         sizeof(deck_state.transitions));
+  memcpy(deck_state.transitions, to->transitions,
+         sizeof(deck_state.transitions));
+  from->live = deck_live_use_keys(to->live);
+  if (profiles.history.count == 0)
+    deck_profile_history_push(&profiles.history, history_id(profiles.active));
+  deck_profile_history_push(&profiles.history, history_id(index));
+  profiles.active = index;
+  deck_pages_replace(to->pages, to->page_count, 0, start_us);
+
+  uint32_t next = deck_profile_history_likely_next(&profiles.history,
+                                                   history_id(index));
+  if (next != UINT32_MAX) {
+    int next_index = next != DECK_PROFILE_BUILTIN ? (int)next : -1;
+    profile_slot_t *slot = profile_slot(next_index);
+    if (slot != NULL) {
+      deck_pages_prepare(slot->pages);
+      ESP_LOGD("PROFILE", "Profile '%s' prepared",
+               next_index >= 0 ? deck_profile_name(next_index) : "built-in");
+    }
+  }
+  return ESP_OK;
+}
+
+esp_err_t deck_profile_select(const char *name) {
+  int index = -1;
+  if (name != NULL) {
+    index = profiles.base != NULL ? deck_profile_find(profiles.base, name)
+                                  : -1;
+    if (index < 0)
+      return ESP_ERR_NOT_FOUND;
+  }
+  return profile_switch(index, esp_timer_get_time());
+}
+
+/* Selects the profile of an application, keeps the current one if there is
+ * none. With the LVGL lock held.
+ */
+static esp_err_t profile_focus(const char *app, size_t len,
+                               int64_t start_us) {
+  int index = profiles.base != NULL
+                  ? deck_profile_find_app(profiles.base, app, len)
+                  : -1;
+  if (index < 0) {
+    ESP_LOGD("PROFILE", "No profile for '%.*s'", (int)len, app);
+    return ESP_ERR_NOT_FOUND;
+  }
+  esp_err_t err = profile_switch(index, start_us);
+  ESP_LOGI("PROFILE", "'%.*s' focused, profile '%s'", (int)len, app,
+           deck_profile_name(index));
+  return err;
+}
+
+esp_err_t deck_profile_focus(const char *app) {
+  int64_t start = esp_timer_get_time();
+  lv_lock();
+  esp_err_t err = profile_focus(app, strlen(app), start);
+  lv_unlock();
+  return err;
+}
+
+static void focus_hid_set(uint8_t report_id, const uint8_t *data,
+                          uint16_t len) {
+  // Latency counts from here, the LVGL lock may be held for a frame
+  int64_t start = esp_timer_get_time();
+  size_t n = strnlen((const char *)data, len);
+  if (n == 0)
+    return;
+  lv_lock();
+  profile_focus((const char *)data, n, start);
+  lv_unlock();
+}
+
+const char *deck_profile_active(void) {
+  if (profiles.active < 0)
+    return NULL;
+  return deck_profile_string(
+      profiles.base, deck_profile_entry(profiles.base, profiles.active)->name);
+}
+
+uint32_t deck_profile_count(void) {
+  return profiles.base != NULL ? deck_profile_header(profiles.base)->count
+                               : 0;
+}
+
+const char *deck_profile_name(uint32_t index) {
+  if (index >= deck_profile_count())
+    return NULL;
+  return deck_profile_string(profiles.base,
+                             deck_profile_entry(profiles.base, index)->name);
+}
+
+esp_err_t deck_profiles_init(void) {
+  profiles.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                           DECK_PROFILE_SUBTYPE, NULL);
+  if (profiles.part == NULL)
+    return ESP_ERR_NOT_FOUND;
+
+  deck_profile_header_t hdr;
+  esp_err_t err = esp_partition_read(profiles.part, 0, &hdr, sizeof(hdr));
+  if (err != ESP_OK)
+    return err;
+  if (hdr.magic != DECK_PROFILE_MAGIC || hdr.size > profiles.part->size ||
+      hdr.size < sizeof(hdr))
+    return ESP_ERR_NOT_FOUND;
+  if (hdr.version != DECK_PROFILE_VERSION)
+    return ESP_ERR_INVALID_VERSION;
+
+  const void *ptr;
+  err = esp_partition_mmap(profiles.part, 0, hdr.size,
+                           ESP_PARTITION_MMAP_DATA, &ptr, &profiles.map_handle);
+  if (err != ESP_OK)
+    return err;
+  const uint8_t *base = ptr;
+  if (esp_rom_crc32_le(0, base + sizeof(hdr), hdr.size - sizeof(hdr)) !=
+      hdr.crc32)
+    err = ESP_ERR_INVALID_CRC;
+  else if (!deck_profile_check(base, hdr.size))
+    err = ESP_ERR_INVALID_STATE;
+  if (err != ESP_OK) {
+    ESP_LOGW("PROFILE", "Invalid profile container: %s",
+             esp_err_to_name(err));
+    esp_partition_munmap(profiles.map_handle);
+    return err;
+  }
+
+  profiles.slots = calloc(hdr.count + 1, sizeof(profile_slot_t *));
+  if (profiles.slots == NULL) {
+    esp_partition_munmap(profiles.map_handle);
+    return ESP_ERR_NO_MEM;
+  }
+  // Mapped for good, the bound page tables point into it
+  profiles.base = base;
+  deck_hid_register_report(DECK_FOCUS_HID_REPORT, focus_hid_set, NULL);
+  ESP_LOGI("PROFILE", "%u profiles, %u pages, %lu bytes mapped", hdr.count,
+           hdr.page_count, (unsigned long)hdr.size);
+  return ESP_OK;
+}
+
+#endif
@@ -1,18 +1,45 @@
 #include "deck_hid.h"
 #include "common/tusb_types.h"
+#include "deck_boot.h"
 #include "deck_hid_desc.h"
+#include "deck_latency.h"
+#include "deck_telemetry.h"
+#include "deck_touchrec.h"
+#include "deck_trace.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_private/usb_phy.h"
+#include "freertos/FreeRTOS.h"
 #include "hal/usb_phy_types.h"
 #include "hal/usb_serial_jtag_ll.h"
 #include "soc/usb_serial_jtag_reg.h"
 #include "tinyusb_default_config.h"
 #include "tusb.h"
 
+// The USB task keeps core 0 above LVGL's draw units so reports leave on time
+// while both cores render
+#define DECK_HID_TASK_CORE 0
+#define DECK_HID_TASK_PRIO 6
+
+typedef struct {
+  deck_hid_set_cb_t set_cb;
+  deck_hid_get_cb_t get_cb;
+} report_handler_t;
+
+static report_handler_t report_handlers[DECK_HID_REPORT_ID_MAX + 1];
+
+/* A state report that found the endpoint busy, sent when the report in
+ * flight completes. Later reports are merged into it, see deck_report_merge.
+ */
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static deck_input_report_t pending;
+static bool has_pending;
+
 static void device_event_handler(tinyusb_event_t *event, void *arg) {
   switch (event->id) {
   case TINYUSB_EVENT_ATTACHED:
+    // Mounted, the host finished enumerating
+    deck_boot_mark("hid enumerated");
     ESP_LOGI("USB", "Device attached");
     break;
   case TINYUSB_EVENT_DETACHED:
@@ -68,6 +95,8 @@ void deck_hid_init(void) {
   tusb_cfg.descriptor.string_count = 4;
   tusb_cfg.descriptor.full_speed_config = deck_hid_config_descriptor;
   tusb_cfg.phy.skip_setup = true; // Skip USB PHY setup since we do it manually
+  tusb_cfg.task.priority = DECK_HID_TASK_PRIO;
+  tusb_cfg.task.xCoreID = DECK_HID_TASK_CORE;
 
   esp_err_t err = tinyusb_driver_install(&tusb_cfg);
   if (err != ESP_OK) {
@@ -75,7 +104,17 @@ void deck_hid_init(void) {
              esp_err_to_name(err));
     return;
   }
+  deck_boot_mark("usb started");
   ESP_LOGI("HID", "HID device initialized");
+
+  deck_hid_register_report(DECK_TRACE_HID_REPORT, deck_trace_hid_set,
+                           deck_trace_hid_get);
+  deck_hid_register_report(DECK_LATENCY_HID_REPORT, deck_latency_hid_set,
+                           deck_latency_hid_get);
+  deck_hid_register_report(DECK_TELEMETRY_HID_REPORT, deck_telemetry_hid_set,
+                           deck_telemetry_hid_get);
+  deck_hid_register_report(DECK_TOUCHREC_HID_REPORT, deck_touchrec_hid_set,
+                           deck_touchrec_hid_get);
 }
 
 const uint8_t *tud_hid_descriptor_report_cb(uint8_t instance) {
@@ -87,9 +126,11 @@ uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id,
                                hid_report_type_t report_type, uint8_t *buffer,
                                uint16_t reqlen) {
   (void)instance;
-  (void)report_id;
   (void)report_type;
-  (void)reqlen;
+  if (report_id <= DECK_HID_REPORT_ID_MAX &&
+      report_handlers[report_id].get_cb != NULL)
+    return report_handlers[report_id].get_cb(report_id, buffer, reqlen);
+
   // Fill buffer with current state if needed
   buffer[0] = 0; // buttons
   buffer[1] = 0; // s1
@@ -103,20 +144,83 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
                            hid_report_type_t report_type, const uint8_t *buffer,
                            uint16_t bufsize) {
   (void)instance;
-  ESP_LOGI("HID", "SET_REPORT id=%d type=%d len=%d", report_id, report_type,
+  ESP_LOGD("HID", "SET_REPORT id=%d type=%d len=%d", report_id, report_type,
            bufsize);
-  // Handle host -> device data here (e.g. LED feedback)
+  if (report_id <= DECK_HID_REPORT_ID_MAX &&
+      report_handlers[report_id].set_cb != NULL)
+    report_handlers[report_id].set_cb(report_id, buffer, bufsize);
+}
+
+static bool send_report(const deck_input_report_t *report) {
+  // Cast to raw bytes, skip the report ID (TinyUSB adds it)
+  if (!tud_hid_report(1, (const uint8_t *)report, sizeof(*report)))
+    return false;
+  deck_trace(DECK_TRACE_HID_ARMED, 1, deck_report_state(report));
+  return true;
+}
+
+/* Merges report into the pending one, or makes it pending */
+static void queue_report(const deck_input_report_t *report) {
+  portENTER_CRITICAL(&pending_lock);
+  bool merged = has_pending;
+  if (merged) {
+    deck_report_merge(&pending, report);
+  } else {
+    pending = *report;
+    has_pending = true;
+  }
+  portEXIT_CRITICAL(&pending_lock);
+  if (merged)
+    deck_telemetry_hid(DECK_TELEMETRY_HID_MERGED);
+}
+
+static bool take_pending(deck_input_report_t *report) {
+  portENTER_CRITICAL(&pending_lock);
+  bool taken = has_pending;
+  *report = pending;
+  has_pending = false;
+  portEXIT_CRITICAL(&pending_lock);
+  return taken;
 }
 
 // Called after tud_hid_report() completes successfully
 void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report,
                                 uint16_t len) {
-  ESP_LOGD("HID", "Report sent, len=%d", len);
+  deck_trace(DECK_TRACE_HID_SENT, report[0], len);
+  deck_latency_hid_sent();
+  deck_telemetry_hid(DECK_TELEMETRY_HID_SENT);
+
+  deck_input_report_t next;
+  if (take_pending(&next) && !send_report(&next))
+    queue_report(&next);
 }
 
 void deck_hid_send_state(deck_input_report_t *report) {
-  if (!tud_hid_ready())
+  if (!tud_mounted()) {
+    deck_trace(DECK_TRACE_HID_DROPPED, 1, deck_report_state(report));
+    deck_telemetry_hid(DECK_TELEMETRY_HID_DROPPED);
     return;
-  // Cast to raw bytes, skip the report ID (TinyUSB adds it)
-  tud_hid_report(1, (uint8_t *)report, sizeof(deck_input_report_t));
+  }
+
+  portENTER_CRITICAL(&pending_lock);
+  bool busy = has_pending;
+  portEXIT_CRITICAL(&pending_lock);
+  if (!busy && tud_hid_ready() && send_report(report))
+    return;
+
+  // Behind the report in flight. If it completed meanwhile, nobody else is
+  // going to send the pending one.
+  queue_report(report);
+  deck_input_report_t next;
+  if (tud_hid_ready() && take_pending(&next) && !send_report(&next))
+    queue_report(&next);
+}
+
+void deck_hid_register_report(uint8_t report_id, deck_hid_set_cb_t set_cb,
+                              deck_hid_get_cb_t get_cb) {
+  if (report_id == 0 || report_id > DECK_HID_REPORT_ID_MAX) {
+    ESP_LOGE("HID", "Report ID %d out of range", report_id);
+    return;
+  }
+  report_handlers[report_id] = (report_handler_t){set_cb, get_cb};
 }
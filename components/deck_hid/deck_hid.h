@@ -1,27 +1,28 @@
 #pragma once
+#include "deck_report.h"
 #include <stdint.h>
 
-typedef struct __attribute__((packed)) {
-  // Report ID 1 — sent automatically by deck_hid_send_state
-  // 8 buttons packed into 1 byte (bit 0 = button 1, bit 7 = button 8)
-  union {
-    uint8_t buttons;
-    struct {
-      uint8_t btn1 : 1;
-      uint8_t btn2 : 1;
-      uint8_t btn3 : 1;
-      uint8_t btn4 : 1;
-      uint8_t btn5 : 1;
-      uint8_t btn6 : 1;
-      uint8_t btn7 : 1;
-      uint8_t btn8 : 1;
-    };
-  };
-  // 3 sliders, 0–100
-  uint8_t slider1;
-  uint8_t slider2;
-  uint8_t slider3;
-} deck_input_report_t;
+/* Highest report ID a handler can be registered for */
+#define DECK_HID_REPORT_ID_MAX 15
+
+/* Handler of a report sent by the host (SET_REPORT or OUTPUT), called from
+ * the USB task. data excludes the report ID.
+ */
+typedef void (*deck_hid_set_cb_t)(uint8_t report_id, const uint8_t *data,
+                                  uint16_t len);
+
+/* Handler of a GET_REPORT request, called from the USB task. Fills buf with
+ * at most reqlen bytes (excluding the report ID) and returns their number.
+ */
+typedef uint16_t (*deck_hid_get_cb_t)(uint8_t report_id, uint8_t *buf,
+                                      uint16_t reqlen);
 
 void deck_hid_init(void);
+/* Function to send the input report (ID 1, deck_report.h) */
 void deck_hid_send_state(deck_input_report_t *report);
+
+/* Function to handle a report ID in another component, so deck_hid does not
+ * depend on its users. Either callback can be NULL.
+ */
+void deck_hid_register_report(uint8_t report_id, deck_hid_set_cb_t set_cb,
+                              deck_hid_get_cb_t get_cb);
@@ -66,18 +66,135 @@ static const uint8_t deck_hid_report_descriptor[] = {
     0x95, 0x40,       //   Report Count (64 bytes)
     0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
 
+    // =====================================================
+    // FEATURE REPORT (ID 4) - Asset partition write
+    // 63 bytes so report ID + data fit the 64 byte control buffer
+    // =====================================================
+    0x85, 0x04, //   Report ID (4)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x20,       //   Usage (Asset Write)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // FEATURE REPORT (ID 5) - Live data records for key widgets
+    // =====================================================
+    0x85, 0x05, //   Report ID (5)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x21,       //   Usage (Live Data)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // FEATURE REPORT (ID 6) - Trace ring dump
+    // =====================================================
+    0x85, 0x06, //   Report ID (6)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x22,       //   Usage (Trace)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // FEATURE REPORT (ID 7) - Input latency histograms
+    // =====================================================
+    0x85, 0x07, //   Report ID (7)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x23,       //   Usage (Latency)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // FEATURE REPORT (ID 8) - Telemetry counters
+    // =====================================================
+    0x85, 0x08, //   Report ID (8)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x24,       //   Usage (Telemetry)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // OUTPUT REPORT (ID 9) - Performance HUD
+    // =====================================================
+    0x85, 0x09, //   Report ID (9)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x25,       //   Usage (HUD)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x01,       //   Report Count (1 byte)
+    0x91, 0x02,       //   Output (Data, Variable, Absolute)
+
+    // =====================================================
+    // FEATURE REPORT (ID 10) - Touch recording and replay
+    // =====================================================
+    0x85, 0x0A, //   Report ID (10)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x26,       //   Usage (Touch Recording)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0xB1, 0x02,       //   Feature (Data, Variable, Absolute)
+
+    // =====================================================
+    // OUTPUT REPORT (ID 11) - Focused host application
+    // =====================================================
+    0x85, 0x0B, //   Report ID (11)
+
+    0x06, 0x00, 0xFF, //   Usage Page (Vendor Defined)
+    0x09, 0x27,       //   Usage (Focus)
+    0x15, 0x00,       //   Logical Minimum (0)
+    0x26, 0xFF, 0x00, //   Logical Maximum (255)
+    0x75, 0x08,       //   Report Size (8 bits)
+    0x95, 0x3F,       //   Report Count (63 bytes)
+    0x91, 0x02,       //   Output (Data, Variable, Absolute)
+
     0xC0 // End Collection
 };
 
 #define DECK_HID_REPORT_DESC_LEN sizeof(deck_hid_report_descriptor)
 
+// Vendor interface with a bulk endpoint pair, used by the screen mirror
+#if CFG_TUD_VENDOR
+#define DECK_VENDOR_ITF 1
+#define DECK_VENDOR_EP_OUT 0x02
+#define DECK_VENDOR_EP_IN 0x82
+#define DECK_ITF_COUNT 2
+#define DECK_VENDOR_DESC_LEN TUD_VENDOR_DESC_LEN
+#else
+#define DECK_ITF_COUNT 1
+#define DECK_VENDOR_DESC_LEN 0
+#endif
+
 // The full USB config descriptor
 static const uint8_t deck_hid_config_descriptor[] = {
     // Config descriptor (9 bytes)
     9,
     TUSB_DESC_CONFIGURATION,
-    U16_TO_U8S_LE(9 + 9 + 9 + 7), // total length
-    1,                            // num interfaces
+    U16_TO_U8S_LE(9 + 9 + 9 + 7 + DECK_VENDOR_DESC_LEN), // total length
+    DECK_ITF_COUNT,                                       // num interfaces
     1,                            // config number
     0,                            // string index
     0x80,                         // attributes (bus powered)
@@ -110,6 +227,12 @@ static const uint8_t deck_hid_config_descriptor[] = {
     TUSB_XFER_INTERRUPT, // interrupt transfer
     U16_TO_U8S_LE(64),   // max packet size
     10,                  // polling interval (10ms)
+
+#if CFG_TUD_VENDOR
+    // Vendor interface (23 bytes)
+    TUD_VENDOR_DESCRIPTOR(DECK_VENDOR_ITF, 0, DECK_VENDOR_EP_OUT,
+                          DECK_VENDOR_EP_IN, 64),
+#endif
 };
 
 // Report ID 1:
@@ -0,0 +1,406 @@
+#include "deck_mirror.h"
+#include "deck_area.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_driver.h"
+#include "tusb.h"
+#if LV_USE_LZ4_INTERNAL
+#include "src/libs/lz4/lz4.h"
+#endif
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !CFG_TUD_VENDOR
+#warning "No USB vendor interface, the screen mirror is disabled"
+#endif
+
+/* Compression and USB writes run below the anim decoder on core 0, so the
+ * mirror only gets the time nothing else on the deck wants
+ */
+#define MIRROR_TASK_CORE 0
+#define MIRROR_TASK_PRIO 1
+/* Period of the LVGL timer handling host commands and resending tiles */
+#define MIRROR_TIMER_MS 100
+/* Longest wait for room in the USB FIFO before checking the state again */
+#define MIRROR_WRITE_WAIT_MS 20
+
+#define TILE_BYTES (DECK_MIRROR_TILE_W * DECK_MIRROR_TILE_H * 2)
+/* Room for the RLE and LZ4 encodings of a tile */
+#if LV_USE_LZ4_INTERNAL
+#define OUT_BYTES (TILE_BYTES + LZ4_COMPRESSBOUND(TILE_BYTES))
+#else
+#define OUT_BYTES TILE_BYTES
+#endif
+/* Queue space a full tile takes, including the ring buffer's item header */
+#define TILE_ITEM_BYTES (sizeof(deck_mirror_record_t) + TILE_BYTES + 8)
+
+static portMUX_TYPE mirror_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static deck_mirror_stats_t mirror_stats;
+
+#if CFG_TUD_VENDOR
+
+/* What the host was last sent for a tile: the hash of the pixels and the
+ * part of the tile they covered (x, y offset and size, one byte each).
+ * rect 0 never matches a flushed area, it marks the tile as unknown.
+ */
+typedef struct {
+  uint32_t hash;
+  uint32_t rect;
+} mirror_tile_t;
+
+static lv_display_t *mirror_disp;
+static mirror_tile_t *tiles;
+static uint8_t *dirty; // tiles the host has stale pixels of
+static uint32_t tiles_x;
+static uint32_t tiles_y;
+static uint32_t dirty_next;
+static volatile bool active;
+static volatile int command = -1;
+static RingbufHandle_t queue;
+static TaskHandle_t mirror_worker;
+static uint8_t *out_buf;
+#if LV_USE_LZ4_INTERNAL
+static void *lz4_state;
+#endif
+
+static void mirror_mark_all(bool stale) {
+  for (uint32_t i = 0; i < tiles_x * tiles_y; i++) {
+    tiles[i].rect = 0;
+    dirty[i] = stale;
+  }
+}
+
+/* Queues a record without payload, false if the queue is full */
+static bool mirror_queue_record(const deck_mirror_record_t *rec) {
+  return xRingbufferSend(queue, rec, sizeof(*rec), 0) == pdTRUE;
+}
+
+/* Flush tap, runs in the LVGL task right after the area went to the panel.
+ * Never waits for the queue: a tile that does not fit is dropped and marked
+ * dirty for mirror_timer_cb to render again.
+ */
+static void mirror_flush_tap(lv_display_t *disp, const lv_area_t *area,
+                             const uint8_t *px_map, bool last,
+                             void *user_data) {
+  if (!active)
+    return;
+
+  int64_t start = esp_timer_get_time();
+  int32_t stride = lv_area_get_width(area) * 2;
+  uint32_t queued = 0;
+  uint32_t skipped = 0;
+  uint32_t dropped = 0;
+  uint32_t raw_bytes = 0;
+
+  for (int32_t ty = area->y1 / DECK_MIRROR_TILE_H;
+       ty <= area->y2 / DECK_MIRROR_TILE_H; ty++) {
+    for (int32_t tx = area->x1 / DECK_MIRROR_TILE_W;
+         tx <= area->x2 / DECK_MIRROR_TILE_W; tx++) {
+      int32_t x1 = LV_MAX(area->x1, tx * DECK_MIRROR_TILE_W);
+      int32_t y1 = LV_MAX(area->y1, ty * DECK_MIRROR_TILE_H);
+      int32_t x2 = LV_MIN(area->x2, (tx + 1) * DECK_MIRROR_TILE_W - 1);
+      int32_t y2 = LV_MIN(area->y2, (ty + 1) * DECK_MIRROR_TILE_H - 1);
+      int32_t w = x2 - x1 + 1;
+      int32_t h = y2 - y1 + 1;
+      const uint8_t *px =
+          px_map + (y1 - area->y1) * stride + (x1 - area->x1) * 2;
+
+      mirror_tile_t *tile = &tiles[ty * tiles_x + tx];
+      uint32_t rect = (x1 - tx * DECK_MIRROR_TILE_W) |
+                      (y1 - ty * DECK_MIRROR_TILE_H) << 8 | w << 16 |
+                      h << 24;
+      uint32_t hash = deck_tile_hash(px, stride, w, h);
+      if (tile->rect == rect && tile->hash == hash) {
+        skipped++;
+        continue;
+      }
+
+      deck_mirror_record_t *rec;
+      size_t len = w * h * 2;
+      if (xRingbufferSendAcquire(queue, (void **)&rec, sizeof(*rec) + len,
+                                 0) != pdTRUE) {
+        tile->rect = 0;
+        dirty[ty * tiles_x + tx] = true;
+        dropped++;
+        continue;
+      }
+      *rec = (deck_mirror_record_t){
+          .magic = DECK_MIRROR_MAGIC,
+          .type = DECK_MIRROR_TILE,
+          .method = DECK_MIRROR_RAW,
+          .x = x1,
+          .y = y1,
+          .w = w,
+          .h = h,
+          .len = len,
+      };
+      uint8_t *dst = (uint8_t *)(rec + 1);
+      for (int32_t y = 0; y < h; y++)
+        memcpy(dst + y * w * 2, px + y * stride, w * 2);
+      xRingbufferSendComplete(queue, rec);
+
+      tile->hash = hash;
+      tile->rect = rect;
+      queued++;
+      raw_bytes += len;
+    }
+  }
+
+  if (last) {
+    deck_mirror_record_t rec = {.magic = DECK_MIRROR_MAGIC,
+                                .type = DECK_MIRROR_FRAME_END};
+    mirror_queue_record(&rec);
+  }
+
+  uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+  portENTER_CRITICAL(&mirror_stats_lock);
+  mirror_stats.tiles += queued;
+  mirror_stats.skipped += skipped;
+  mirror_stats.dropped += dropped;
+  mirror_stats.raw_bytes += raw_bytes;
+  mirror_stats.hash_us += us;
+  portEXIT_CRITICAL(&mirror_stats_lock);
+}
+
+/* The panel shifted pixels the host has, so it has to shift them as well */
+static void mirror_scroll_tap(lv_display_t *disp, bool along_x, int32_t start,
+                              int32_t length, int32_t delta,
+                              void *user_data) {
+  if (!active)
+    return;
+
+  deck_mirror_record_t rec = {
+      .magic = DECK_MIRROR_MAGIC,
+      .type = DECK_MIRROR_SCROLL,
+      .method = along_x,
+      .x = start,
+      .y = (uint16_t)(int16_t)delta,
+      .w = length,
+  };
+  // Hashes no longer match the pixels under the tiles. When the host missed
+  // the shift, its whole copy of the screen is off.
+  mirror_mark_all(!mirror_queue_record(&rec));
+}
+
+/* Stores the tile's payload in out_buf the smallest way, updates rec */
+static const uint8_t *mirror_compress(deck_mirror_record_t *rec) {
+  const uint8_t *raw = (const uint8_t *)(rec + 1);
+  size_t best = rec->len;
+  uint8_t method = DECK_MIRROR_RAW;
+
+  size_t rle = deck_rle_encode((const uint16_t *)raw, rec->len / 2,
+                               out_buf, best - 1);
+  if (rle > 0) {
+    best = rle;
+    method = DECK_MIRROR_RLE;
+  }
+#if LV_USE_LZ4_INTERNAL
+  uint8_t *lz4_out = out_buf + TILE_BYTES;
+  int lz4 = LZ4_compress_fast_extState(lz4_state, (const char *)raw,
+                                       (char *)lz4_out, rec->len, best - 1, 1);
+  if (lz4 > 0) {
+    rec->method = DECK_MIRROR_LZ4;
+    rec->len = lz4;
+    return lz4_out;
+  }
+#endif
+
+  rec->method = method;
+  rec->len = best;
+  return method == DECK_MIRROR_RLE ? out_buf : raw;
+}
+
+static bool mirror_write(const void *data, size_t len) {
+  const uint8_t *p = data;
+  while (len > 0) {
+    if (!active || !tud_vendor_mounted())
+      return false;
+    uint32_t n = tud_vendor_write(p, len);
+    tud_vendor_write_flush();
+    p += n;
+    len -= n;
+    // FIFO full, tud_vendor_tx_cb wakes the worker when a packet went out
+    if (n == 0)
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MIRROR_WRITE_WAIT_MS));
+  }
+  return true;
+}
+
+static void mirror_task(void *arg) {
+  while (1) {
+    size_t size;
+    deck_mirror_record_t *rec =
+        xRingbufferReceive(queue, &size, portMAX_DELAY);
+    if (rec == NULL)
+      continue;
+
+    // Records queued before a STOP are thrown away
+    if (active) {
+      const uint8_t *payload = (const uint8_t *)(rec + 1);
+      if (rec->type == DECK_MIRROR_TILE)
+        payload = mirror_compress(rec);
+      if (mirror_write(rec, sizeof(*rec)) && mirror_write(payload, rec->len)) {
+        portENTER_CRITICAL(&mirror_stats_lock);
+        mirror_stats.sent_bytes += sizeof(*rec) + rec->len;
+        portEXIT_CRITICAL(&mirror_stats_lock);
+      }
+    }
+    vRingbufferReturnItem(queue, rec);
+  }
+}
+
+static bool mirror_alloc(void) {
+  if (mirror_worker != NULL)
+    return true;
+
+  // What was allocated is kept for the next START when something is missing
+  bool ok = true;
+  if (out_buf == NULL)
+    out_buf = heap_caps_malloc(OUT_BYTES, MALLOC_CAP_INTERNAL);
+  ok &= out_buf != NULL;
+#if LV_USE_LZ4_INTERNAL
+  if (lz4_state == NULL)
+    lz4_state = heap_caps_malloc(LZ4_sizeofState(), MALLOC_CAP_INTERNAL);
+  ok &= lz4_state != NULL;
+#endif
+  if (queue == NULL)
+    queue = xRingbufferCreate(CONFIG_DECK_MIRROR_QUEUE_KB * 1024,
+                              RINGBUF_TYPE_NOSPLIT);
+  ok &= queue != NULL;
+  if (!ok) {
+    ESP_LOGE("MIRROR", "No memory for the mirror queue");
+    return false;
+  }
+
+  xTaskCreatePinnedToCore(mirror_task, "mirror", 3072, NULL, MIRROR_TASK_PRIO,
+                          &mirror_worker, MIRROR_TASK_CORE);
+  return true;
+}
+
+static void mirror_invalidate_all(void) {
+  lv_obj_invalidate(lv_display_get_layer_top(mirror_disp));
+}
+
+static void mirror_handle_command(int cmd) {
+  switch (cmd) {
+  case DECK_MIRROR_CMD_START: {
+    // Memory is only taken once a host asked for the mirror
+    if (!mirror_alloc())
+      return;
+    mirror_mark_all(false);
+    active = true;
+    deck_mirror_record_t rec = {
+        .magic = DECK_MIRROR_MAGIC,
+        .type = DECK_MIRROR_HELLO,
+        .w = lv_display_get_horizontal_resolution(mirror_disp),
+        .h = lv_display_get_vertical_resolution(mirror_disp),
+    };
+    xRingbufferSend(queue, &rec, sizeof(rec), pdMS_TO_TICKS(MIRROR_TIMER_MS));
+    mirror_invalidate_all();
+    ESP_LOGI("MIRROR", "Mirror started");
+    break;
+  }
+  case DECK_MIRROR_CMD_REFRESH:
+    if (!active)
+      return;
+    mirror_mark_all(false);
+    mirror_invalidate_all();
+    break;
+  case DECK_MIRROR_CMD_STOP: {
+    if (!active)
+      return;
+    active = false;
+    deck_mirror_stats_t s;
+    deck_mirror_get_stats(&s);
+    ESP_LOGI("MIRROR",
+             "Mirror stopped, %" PRIu32 " tiles sent, %" PRIu32
+             " unchanged, %" PRIu32 " dropped, %" PRIu32 " KB -> %" PRIu32
+             " KB",
+             s.tiles, s.skipped, s.dropped, (uint32_t)(s.raw_bytes / 1024),
+             (uint32_t)(s.sent_bytes / 1024));
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/* Handles host commands and has dropped tiles rendered again, as many as the
+ * queue has room for, so the host catches up once it reads fast enough
+ */
+static void mirror_timer_cb(lv_timer_t *timer) {
+  int cmd = command;
+  if (cmd >= 0) {
+    command = -1;
+    mirror_handle_command(cmd);
+  }
+  if (!active)
+    return;
+
+  size_t room = xRingbufferGetCurFreeSize(queue);
+  uint32_t count = tiles_x * tiles_y;
+  for (uint32_t n = 0; n < count && room >= TILE_ITEM_BYTES; n++) {
+    uint32_t i = (dirty_next + n) % count;
+    if (!dirty[i])
+      continue;
+    dirty[i] = false;
+    room -= TILE_ITEM_BYTES;
+    dirty_next = i + 1;
+
+    lv_area_t area;
+    lv_area_set(&area, i % tiles_x * DECK_MIRROR_TILE_W,
+                i / tiles_x * DECK_MIRROR_TILE_H,
+                (i % tiles_x + 1) * DECK_MIRROR_TILE_W - 1,
+                (i / tiles_x + 1) * DECK_MIRROR_TILE_H - 1);
+    lv_obj_invalidate_area(lv_display_get_layer_top(mirror_disp), &area);
+  }
+}
+
+/* Commands from the host, called from the USB task */
+void tud_vendor_rx_cb(uint8_t itf, uint8_t const *buffer, uint16_t bufsize) {
+  if (bufsize > 0)
+    command = buffer[bufsize - 1];
+  tud_vendor_read_flush();
+}
+
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes) {
+  if (mirror_worker != NULL)
+    xTaskNotifyGive(mirror_worker);
+}
+
+#endif // CFG_TUD_VENDOR
+
+esp_err_t deck_mirror_init(lv_display_t *disp) {
+#if CFG_TUD_VENDOR
+  tiles_x = (lv_display_get_horizontal_resolution(disp) + DECK_MIRROR_TILE_W -
+             1) / DECK_MIRROR_TILE_W;
+  tiles_y = (lv_display_get_vertical_resolution(disp) + DECK_MIRROR_TILE_H -
+             1) / DECK_MIRROR_TILE_H;
+  tiles = calloc(tiles_x * tiles_y, sizeof(mirror_tile_t));
+  dirty = calloc(tiles_x * tiles_y, 1);
+  if (tiles == NULL || dirty == NULL) {
+    free(tiles);
+    free(dirty);
+    return ESP_ERR_NO_MEM;
+  }
+
+  mirror_disp = disp;
+  lv_timer_create(mirror_timer_cb, MIRROR_TIMER_MS, NULL);
+  lvgl_display_set_flush_tap(disp, mirror_flush_tap, mirror_scroll_tap, NULL);
+  return ESP_OK;
+#else
+  return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void deck_mirror_get_stats(deck_mirror_stats_t *stats) {
+  portENTER_CRITICAL(&mirror_stats_lock);
+  *stats = mirror_stats;
+  portEXIT_CRITICAL(&mirror_stats_lock);
+}
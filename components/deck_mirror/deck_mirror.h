@@ -0,0 +1,80 @@
+#pragma once
+#include "esp_err.h"
+#include "lvgl.h"
+#include <stdint.h>
+
+/* Screen mirror over the vendor bulk interface (see deck_hid_desc.h).
+ *
+ * The host starts and stops the mirror with one byte commands on the OUT
+ * endpoint. The deck answers on the IN endpoint with a stream of records, a
+ * deck_mirror_record_t header followed by len bytes of payload:
+ * - HELLO: w, h are the screen size, sent first after START.
+ * - TILE: pixels of the rectangle x, y, w, h, RGB565 little endian rows,
+ *   stored as given by method.
+ * - SCROLL: the panel shifted its scrolling region, see lvgl_scroll_by.
+ *   method is 1 when the region runs along x, x is its start, w its length
+ *   and y the signed shift towards the start. Tiles of the band scrolled
+ *   into view follow.
+ * - FRAME_END: the tiles of a refresh are complete.
+ * Tiles that did not change since they were last sent are skipped. When the
+ * host falls behind, tiles are dropped and sent again once it caught up.
+ */
+#define DECK_MIRROR_MAGIC 0x4D44 // "DM"
+
+/* Tile size the screen is split into for change detection */
+#define DECK_MIRROR_TILE_W 32
+#define DECK_MIRROR_TILE_H 16
+
+enum {
+  DECK_MIRROR_CMD_STOP = 0,
+  DECK_MIRROR_CMD_START = 1,
+  DECK_MIRROR_CMD_REFRESH = 2, // resend the whole screen
+};
+
+enum {
+  DECK_MIRROR_HELLO = 1,
+  DECK_MIRROR_TILE = 2,
+  DECK_MIRROR_SCROLL = 3,
+  DECK_MIRROR_FRAME_END = 4,
+};
+
+enum {
+  DECK_MIRROR_RAW = 0,
+  DECK_MIRROR_RLE = 1, // LVGL RLE with 2 byte blocks
+  DECK_MIRROR_LZ4 = 2, // LZ4 block
+};
+
+typedef struct __attribute__((packed)) {
+  uint16_t magic;
+  uint8_t type;
+  uint8_t method;
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+  uint32_t len;
+} deck_mirror_record_t;
+
+/* mirror statistics
+ * - tiles: tiles queued for the host
+ * - skipped: tiles unchanged since they were last sent
+ * - dropped: tiles that did not fit the queue
+ * - raw_bytes: pixel bytes of the sent tiles
+ * - sent_bytes: bytes written to the host, headers included
+ * - hash_us: time spent hashing and queueing in the flush path
+ */
+typedef struct {
+  uint32_t tiles;
+  uint32_t skipped;
+  uint32_t dropped;
+  uint64_t raw_bytes;
+  uint64_t sent_bytes;
+  uint64_t hash_us;
+} deck_mirror_stats_t;
+
+/* Function to make the display mirrorable. The mirror stays idle, costing a
+ * pointer check per flush, until the host sends START.
+ * Must be called after lvgl_create_display and deck_hid_init.
+ */
+esp_err_t deck_mirror_init(lv_display_t *disp);
+void deck_mirror_get_stats(deck_mirror_stats_t *stats);
@@ -0,0 +1,89 @@
+#include "deck_boot.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_rtc_time.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+#define WAIT_POLL_MS 5
+
+typedef struct {
+  const char *stage;
+  int64_t us; // esp_timer time
+  char task[configMAX_TASK_NAME_LEN];
+  uint8_t core;
+} boot_mark_t;
+
+static portMUX_TYPE boot_lock = portMUX_INITIALIZER_UNLOCKED;
+static boot_mark_t marks[DECK_BOOT_STAGES];
+static int mark_count;
+// Power on to esp_timer's start, what the ROM and bootloader took
+static int64_t before_app_us = -1;
+
+static int find_mark(const char *stage) {
+  for (int i = 0; i < mark_count; i++) {
+    if (marks[i].stage == stage || strcmp(marks[i].stage, stage) == 0)
+      return i;
+  }
+  return -1;
+}
+
+void deck_boot_mark(const char *stage) {
+  int64_t now = esp_timer_get_time();
+  const char *task = xPortInIsrContext() ? "ISR" : pcTaskGetName(NULL);
+  portENTER_CRITICAL_SAFE(&boot_lock);
+  if (before_app_us < 0)
+    before_app_us = (int64_t)esp_rtc_get_time_us() - now;
+  if (find_mark(stage) < 0 && mark_count < DECK_BOOT_STAGES) {
+    boot_mark_t *m = &marks[mark_count++];
+    m->stage = stage;
+    m->us = now;
+    m->core = esp_cpu_get_core_id();
+    strlcpy(m->task, task, sizeof(m->task));
+  }
+  portEXIT_CRITICAL_SAFE(&boot_lock);
+}
+
+bool deck_boot_wait(const char *stage, uint32_t timeout_ms) {
+  for (uint32_t waited = 0;; waited += WAIT_POLL_MS) {
+    portENTER_CRITICAL(&boot_lock);
+    bool marked = find_mark(stage) >= 0;
+    portEXIT_CRITICAL(&boot_lock);
+    if (marked)
+      return true;
+    if (waited >= timeout_ms)
+      return false;
+    vTaskDelay(pdMS_TO_TICKS(WAIT_POLL_MS));
+  }
+}
+
+void deck_boot_print(void) {
+  boot_mark_t copy[DECK_BOOT_STAGES];
+  portENTER_CRITICAL(&boot_lock);
+  int n = mark_count;
+  memcpy(copy, marks, n * sizeof(copy[0]));
+  int64_t offset = before_app_us > 0 ? before_app_us : 0;
+  portEXIT_CRITICAL(&boot_lock);
+
+  // Marks are kept in order, but a task can be preempted between taking its
+  // time and the lock
+  for (int i = 1; i < n; i++) {
+    for (int j = i; j > 0 && copy[j].us < copy[j - 1].us; j--) {
+      boot_mark_t t = copy[j];
+      copy[j] = copy[j - 1];
+      copy[j - 1] = t;
+    }
+  }
+
+  ESP_LOGI("BOOT", "Timeline, ms since power on (%.1f before app start):",
+           offset / 1000.0);
+  int64_t prev = 0;
+  for (int i = 0; i < n; i++) {
+    ESP_LOGI("BOOT", "%8.1f %+7.1f  %-20s %s/%d",
+             (offset + copy[i].us) / 1000.0, (copy[i].us - prev) / 1000.0,
+             copy[i].stage, copy[i].task, copy[i].core);
+    prev = copy[i].us;
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Boot timeline. Bring-up stages mark when they are reached, from any task
+ * or ISR, and the timeline is printed once the deck is up: time since power
+ * on (the ROM and bootloader included), the gap to the previous mark and the
+ * task and core that got there, so stages running in parallel show as such.
+ *
+ * A stage is named by a string literal and counts the first time it is
+ * marked, so hooks that run again later (e.g. every USB attach) cost a
+ * lookup and nothing else.
+ */
+#define DECK_BOOT_STAGES 24
+
+void deck_boot_mark(const char *stage);
+
+/* Function to wait until a stage is marked, returns false on timeout */
+bool deck_boot_wait(const char *stage, uint32_t timeout_ms);
+
+/* Function to log the timeline so far */
+void deck_boot_print(void);
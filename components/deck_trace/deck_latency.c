@@ -0,0 +1,193 @@
+#include "deck_latency.h"
+#include "deck_trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define STAGE_BIT(stage) (1u << (stage))
+
+/* The edge in flight and the stages it still has to pass */
+typedef struct {
+  uint32_t id;
+  int64_t start_us;
+  bool pressed;
+  uint8_t pending;
+  bool photon_armed; // an overlapping area is on its way to the panel
+  int32_t x1, y1, x2, y2;
+} latency_edge_t;
+
+typedef struct {
+  uint16_t buckets[DECK_LATENCY_BUCKETS];
+  uint16_t count;
+  uint32_t max_us;
+} latency_hist_t;
+
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool enabled;
+static latency_edge_t edge;
+static latency_hist_t hists[DECK_LATENCY_STAGES];
+
+#if CONFIG_DECK_LATENCY
+
+static bool last_pressed;
+
+/* Records a stage of the edge, called with latency_lock held */
+static void latency_record(deck_latency_stage_t stage) {
+  if (!(edge.pending & STAGE_BIT(stage)))
+    return;
+  edge.pending &= ~STAGE_BIT(stage);
+
+  uint32_t us = (uint32_t)(esp_timer_get_time() - edge.start_us);
+  latency_hist_t *h = &hists[stage];
+  uint32_t bucket = us / DECK_LATENCY_BUCKET_US;
+  if (bucket >= DECK_LATENCY_BUCKETS)
+    bucket = DECK_LATENCY_BUCKETS - 1;
+  // Counts saturate instead of wrapping into a wrong distribution
+  if (h->count < UINT16_MAX) {
+    h->buckets[bucket]++;
+    h->count++;
+  }
+  if (us > h->max_us)
+    h->max_us = us;
+  deck_trace(DECK_TRACE_LATENCY, edge.id, (uint32_t)stage << 24 | us);
+}
+
+void deck_latency_sample(bool pressed) {
+  if (!enabled || pressed == last_pressed)
+    return;
+  last_pressed = pressed;
+  portENTER_CRITICAL(&latency_lock);
+  edge = (latency_edge_t){
+      .id = edge.id + 1,
+      .start_us = esp_timer_get_time(),
+      .pressed = pressed,
+      .pending = STAGE_BIT(DECK_LATENCY_READ),
+  };
+  portEXIT_CRITICAL(&latency_lock);
+}
+
+void deck_latency_read(bool pressed) {
+  if (!enabled)
+    return;
+  portENTER_CRITICAL(&latency_lock);
+  if (pressed == edge.pressed &&
+      (edge.pending & STAGE_BIT(DECK_LATENCY_READ))) {
+    latency_record(DECK_LATENCY_READ);
+    // LVGL dispatches the edge's events right after this read
+    edge.pending |= STAGE_BIT(DECK_LATENCY_HANDLED);
+  }
+  portEXIT_CRITICAL(&latency_lock);
+}
+
+void deck_latency_handled(int32_t x1, int32_t y1, int32_t x2, int32_t y2,
+                          bool hid) {
+  if (!enabled)
+    return;
+  portENTER_CRITICAL(&latency_lock);
+  if (edge.pending & STAGE_BIT(DECK_LATENCY_HANDLED)) {
+    latency_record(DECK_LATENCY_HANDLED);
+    edge.pending |= STAGE_BIT(DECK_LATENCY_PHOTON);
+    if (hid)
+      edge.pending |= STAGE_BIT(DECK_LATENCY_HOST);
+    edge.x1 = x1;
+    edge.y1 = y1;
+    edge.x2 = x2;
+    edge.y2 = y2;
+  }
+  portEXIT_CRITICAL(&latency_lock);
+}
+
+void deck_latency_flush(int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+  if (!enabled)
+    return;
+  portENTER_CRITICAL(&latency_lock);
+  if ((edge.pending & STAGE_BIT(DECK_LATENCY_PHOTON)) && !edge.photon_armed &&
+      x1 <= edge.x2 && x2 >= edge.x1 && y1 <= edge.y2 && y2 >= edge.y1)
+    edge.photon_armed = true;
+  portEXIT_CRITICAL(&latency_lock);
+}
+
+void deck_latency_flush_done(void) {
+  if (!enabled)
+    return;
+  // Called once per refresh, the first after arming is the one of the
+  // overlapping area
+  portENTER_CRITICAL_SAFE(&latency_lock);
+  if (edge.photon_armed) {
+    edge.photon_armed = false;
+    latency_record(DECK_LATENCY_PHOTON);
+  }
+  portEXIT_CRITICAL_SAFE(&latency_lock);
+}
+
+void deck_latency_hid_sent(void) {
+  if (!enabled)
+    return;
+  portENTER_CRITICAL(&latency_lock);
+  latency_record(DECK_LATENCY_HOST);
+  portEXIT_CRITICAL(&latency_lock);
+}
+
+#endif
+
+static uint32_t hist_percentile(const latency_hist_t *h, uint32_t permille) {
+  uint32_t rank = (h->count * permille + 999) / 1000;
+  uint32_t seen = 0;
+  for (uint32_t b = 0; b < DECK_LATENCY_BUCKETS; b++) {
+    seen += h->buckets[b];
+    if (seen >= rank && seen > 0)
+      return b == DECK_LATENCY_BUCKETS - 1 ? h->max_us
+                                           : (b + 1) * DECK_LATENCY_BUCKET_US;
+  }
+  return 0;
+}
+
+void deck_latency_get_summary(
+    deck_latency_summary_t summary[DECK_LATENCY_STAGES]) {
+  static latency_hist_t copy[DECK_LATENCY_STAGES];
+  portENTER_CRITICAL(&latency_lock);
+  memcpy(copy, hists, sizeof(copy));
+  portEXIT_CRITICAL(&latency_lock);
+
+  for (int s = 0; s < DECK_LATENCY_STAGES; s++) {
+    summary[s] = (deck_latency_summary_t){
+        .count = copy[s].count,
+        .p50_us = hist_percentile(&copy[s], 500),
+        .p99_us = hist_percentile(&copy[s], 990),
+        .max_us = copy[s].max_us,
+    };
+  }
+}
+
+void deck_latency_enable(bool enable) {
+  portENTER_CRITICAL(&latency_lock);
+  if (enable) {
+    memset(hists, 0, sizeof(hists));
+    edge.pending = 0;
+    edge.photon_armed = false;
+  }
+  portEXIT_CRITICAL(&latency_lock);
+  enabled = enable;
+}
+
+void deck_latency_hid_set(uint8_t report_id, const uint8_t *data,
+                          uint16_t len) {
+  if (len < 1)
+    return;
+  deck_latency_enable(data[0] == DECK_LATENCY_CMD_START);
+  ESP_LOGI("LATENCY", "Measuring %s", enabled ? "started" : "stopped");
+}
+
+uint16_t deck_latency_hid_get(uint8_t report_id, uint8_t *buf,
+                              uint16_t reqlen) {
+  deck_latency_summary_t summary[DECK_LATENCY_STAGES];
+  if (reqlen < 1 + sizeof(summary))
+    return 0;
+  deck_latency_get_summary(summary);
+  memset(buf, 0, reqlen);
+  buf[0] = enabled;
+  memcpy(buf + 1, summary, sizeof(summary));
+  return reqlen;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Input latency measurement. Every change of the touch state (an edge) gets
+ * an ID when the GT911 sample shows it, and the stages it passes are timed
+ * from that sample:
+ * - READ: LVGL's pointer read delivered it.
+ * - HANDLED: a deck_gl handler acted on it.
+ * - PHOTON: the panel transfer of the first flushed area overlapping the
+ *   handler's object finished.
+ * - HOST: the HID report the handler sent left the endpoint.
+ * A new edge replaces one still in flight. Stages are also traced as
+ * DECK_TRACE_LATENCY events (edge ID, stage << 24 | us).
+ *
+ * Feature report, SET: one byte command. GET: enabled byte followed by
+ * DECK_LATENCY_STAGES deck_latency_summary_t.
+ */
+#define DECK_LATENCY_HID_REPORT 7
+
+/* Histogram resolution and range, slower edges land in the last bucket */
+#define DECK_LATENCY_BUCKET_US 250
+#define DECK_LATENCY_BUCKETS 200
+
+enum {
+  DECK_LATENCY_CMD_STOP = 0,
+  DECK_LATENCY_CMD_START = 1, // clears the histograms
+};
+
+typedef enum {
+  DECK_LATENCY_READ,
+  DECK_LATENCY_HANDLED,
+  DECK_LATENCY_PHOTON,
+  DECK_LATENCY_HOST,
+  DECK_LATENCY_STAGES,
+} deck_latency_stage_t;
+
+/* Percentiles are the upper bound of their bucket */
+typedef struct __attribute__((packed)) {
+  uint16_t count;
+  uint32_t p50_us;
+  uint32_t p99_us;
+  uint32_t max_us;
+} deck_latency_summary_t;
+
+#if CONFIG_DECK_LATENCY
+
+/* Hooks of the stages, cheap no-ops while measuring is off.
+ * - deck_latency_sample: every touch sample, from the sampling task.
+ * - deck_latency_read: every pointer read, from the LVGL task.
+ * - deck_latency_handled: from an event handler, with the area of the object
+ *   that changes and whether a HID report is sent for the edge.
+ * - deck_latency_flush: every flushed area, deck_latency_flush_done once the
+ *   last area of the refresh has been sent to the panel (also from the DMA
+ *   done ISR).
+ * - deck_latency_hid_sent: report complete callback.
+ */
+void deck_latency_sample(bool pressed);
+void deck_latency_read(bool pressed);
+void deck_latency_handled(int32_t x1, int32_t y1, int32_t x2, int32_t y2,
+                          bool hid);
+void deck_latency_flush(int32_t x1, int32_t y1, int32_t x2, int32_t y2);
+void deck_latency_flush_done(void);
+void deck_latency_hid_sent(void);
+
+#else
+
+static inline void deck_latency_sample(bool pressed) {}
+static inline void deck_latency_read(bool pressed) {}
+static inline void deck_latency_handled(int32_t x1, int32_t y1, int32_t x2,
+                                        int32_t y2, bool hid) {}
+static inline void deck_latency_flush(int32_t x1, int32_t y1, int32_t x2,
+                                      int32_t y2) {}
+static inline void deck_latency_flush_done(void) {}
+static inline void deck_latency_hid_sent(void) {}
+
+#endif
+
+/* Function to start or stop measuring, see DECK_LATENCY_CMD_START */
+void deck_latency_enable(bool enabled);
+void deck_latency_get_summary(deck_latency_summary_t summary[DECK_LATENCY_STAGES]);
+
+/* deck_hid handlers of DECK_LATENCY_HID_REPORT */
+void deck_latency_hid_set(uint8_t report_id, const uint8_t *data,
+                          uint16_t len);
+uint16_t deck_latency_hid_get(uint8_t report_id, uint8_t *buf,
+                              uint16_t reqlen);
@@ -0,0 +1,250 @@
+#include "deck_telemetry.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Render and flush time histograms, 100 us buckets up to 50 ms */
+#define TIME_BUCKET_US 100
+#define TIME_BUCKETS 500
+
+typedef struct {
+  uint32_t buckets[TIME_BUCKETS];
+  uint32_t max_us;
+} time_hist_t;
+
+/* Written by any task or ISR with atomic adds, never reset. Snapshots work
+ * on the difference to the previous snapshot.
+ */
+typedef struct {
+  uint32_t frames;
+  uint32_t touch_samples;
+  uint32_t hid[3];
+  time_hist_t render;
+  time_hist_t flush;
+} counters_t;
+
+#if configUSE_TRACE_FACILITY
+typedef struct {
+  TaskHandle_t handle;
+  uint32_t run_time;
+} task_time_t;
+#endif
+
+static counters_t counters;
+// State of the previous snapshot, only touched by the reader (USB task)
+static counters_t last;
+static int64_t last_us;
+#if configUSE_TRACE_FACILITY
+static task_time_t last_tasks[DECK_TELEMETRY_TASKS_MAX];
+static uint32_t last_task_total;
+#endif
+static deck_telemetry_task_t tasks[DECK_TELEMETRY_TASKS_MAX];
+static uint8_t task_count;
+static uint8_t tasks_total;
+static uint8_t next_page;
+
+static inline void counter_add(uint32_t *counter, uint32_t n) {
+  __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+}
+
+static void hist_add(time_hist_t *h, uint32_t us) {
+  uint32_t b = us / TIME_BUCKET_US;
+  counter_add(&h->buckets[b < TIME_BUCKETS ? b : TIME_BUCKETS - 1], 1);
+  // Max only grows, a lost race leaves the larger value in place
+  uint32_t max = __atomic_load_n(&h->max_us, __ATOMIC_RELAXED);
+  while (us > max && !__atomic_compare_exchange_n(&h->max_us, &max, us, true,
+                                                  __ATOMIC_RELAXED,
+                                                  __ATOMIC_RELAXED))
+    ;
+}
+
+void deck_telemetry_render(uint32_t us) {
+  counter_add(&counters.frames, 1);
+  hist_add(&counters.render, us);
+}
+
+void deck_telemetry_flush(uint32_t us) { hist_add(&counters.flush, us); }
+
+void deck_telemetry_touch_sample(void) {
+  counter_add(&counters.touch_samples, 1);
+}
+
+uint32_t deck_telemetry_touch_samples(void) {
+  return __atomic_load_n(&counters.touch_samples, __ATOMIC_RELAXED);
+}
+
+void deck_telemetry_hid(deck_telemetry_hid_t what) {
+  counter_add(&counters.hid[what], 1);
+}
+
+uint32_t deck_telemetry_hid_reports(void) {
+  uint32_t n = 0;
+  for (int i = 0; i < 3; i++)
+    n += __atomic_load_n(&counters.hid[i], __ATOMIC_RELAXED);
+  return n;
+}
+
+/* Percentiles of the samples added to cur since prev, max is the largest
+ * since boot when the window has samples beyond the last bucket
+ */
+static void hist_window(const time_hist_t *cur, const time_hist_t *prev,
+                        uint32_t *p50, uint32_t *p99, uint32_t *max) {
+  uint32_t total = 0;
+  uint32_t top = 0;
+  for (int b = 0; b < TIME_BUCKETS; b++) {
+    uint32_t n = cur->buckets[b] - prev->buckets[b];
+    total += n;
+    if (n > 0)
+      top = b;
+  }
+  *p50 = *p99 = *max = 0;
+  if (total == 0)
+    return;
+
+  uint32_t r50 = (total + 1) / 2;
+  uint32_t r99 = (total * 99 + 99) / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < TIME_BUCKETS; b++) {
+    uint32_t n = cur->buckets[b] - prev->buckets[b];
+    if (seen < r50 && seen + n >= r50)
+      *p50 = (b + 1) * TIME_BUCKET_US;
+    if (seen < r99 && seen + n >= r99)
+      *p99 = (b + 1) * TIME_BUCKET_US;
+    seen += n;
+  }
+  *max = top == TIME_BUCKETS - 1 ? cur->max_us : (top + 1) * TIME_BUCKET_US;
+}
+
+static void snapshot_tasks(void) {
+#if configUSE_TRACE_FACILITY
+  // uxTaskGetSystemState fills nothing into an array too small for all
+  // tasks, leave room for a few created meanwhile
+  UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+  TaskStatus_t *status = malloc(size * sizeof(TaskStatus_t));
+  if (status == NULL)
+    return;
+  configRUN_TIME_COUNTER_TYPE total = 0;
+  UBaseType_t all = uxTaskGetSystemState(status, size, &total);
+  UBaseType_t n = LV_MIN(all, DECK_TELEMETRY_TASKS_MAX);
+  uint32_t elapsed = total - last_task_total;
+  task_time_t times[DECK_TELEMETRY_TASKS_MAX];
+  (void)elapsed;
+
+  for (UBaseType_t i = 0; i < n; i++) {
+    deck_telemetry_task_t *t = &tasks[i];
+    strncpy(t->name, status[i].pcTaskName, DECK_TELEMETRY_TASK_NAME);
+    t->stack_free = LV_MIN(status[i].usStackHighWaterMark * sizeof(StackType_t),
+                           UINT16_MAX);
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t prev = 0;
+    for (int j = 0; j < DECK_TELEMETRY_TASKS_MAX; j++) {
+      if (last_tasks[j].handle == status[i].xHandle)
+        prev = last_tasks[j].run_time;
+    }
+    uint32_t ran = status[i].ulRunTimeCounter - prev;
+    t->cpu_permille = elapsed ? LV_MIN((uint64_t)ran * 1000 / elapsed, 1000)
+                              : 0;
+    times[i] = (task_time_t){status[i].xHandle, status[i].ulRunTimeCounter};
+#else
+    t->cpu_permille = UINT16_MAX;
+    times[i] = (task_time_t){status[i].xHandle, 0};
+#endif
+  }
+  free(status);
+  memset(last_tasks, 0, sizeof(last_tasks));
+  memcpy(last_tasks, times, n * sizeof(task_time_t));
+  last_task_total = total;
+  task_count = n;
+  tasks_total = LV_MIN(all, UINT8_MAX);
+#endif
+}
+
+void deck_telemetry_snapshot(deck_telemetry_summary_t *s) {
+  // One pass over the counters with interrupts off on this core; the other
+  // core can only add a few events while the copy is taken
+  static counters_t now;
+  portDISABLE_INTERRUPTS();
+  memcpy(&now, &counters, sizeof(now));
+  int64_t now_us = esp_timer_get_time();
+  portENABLE_INTERRUPTS();
+
+  uint32_t window_ms = (uint32_t)((now_us - last_us) / 1000);
+  if (window_ms == 0)
+    window_ms = 1;
+  memset(s, 0, sizeof(*s));
+  s->window_ms = LV_MIN(window_ms, UINT16_MAX);
+  s->fps_x10 = (uint64_t)(now.frames - last.frames) * 10000 / window_ms;
+  s->touch_hz =
+      (uint64_t)(now.touch_samples - last.touch_samples) * 1000 / window_ms;
+  // The summary is packed, its fields cannot be written through pointers
+  uint32_t p50, p99, max;
+  hist_window(&now.render, &last.render, &p50, &p99, &max);
+  s->render_p50_us = p50;
+  s->render_p99_us = p99;
+  s->render_max_us = max;
+  hist_window(&now.flush, &last.flush, &p50, &p99, &max);
+  s->flush_p50_us = p50;
+  s->flush_p99_us = p99;
+  s->flush_max_us = max;
+  s->hid_sent = now.hid[DECK_TELEMETRY_HID_SENT];
+  s->hid_merged = now.hid[DECK_TELEMETRY_HID_MERGED];
+  s->hid_dropped = now.hid[DECK_TELEMETRY_HID_DROPPED];
+
+  // The USB task runs from before lv_init, the heap reads zero until then.
+  // The monitor walks the heap, allocations must wait for it.
+  if (lv_is_initialized()) {
+    lv_mem_monitor_t mon;
+    lv_lock();
+    lv_mem_monitor(&mon);
+    lv_unlock();
+    s->lv_heap_used = mon.total_size - mon.free_size;
+    s->lv_heap_largest_free = mon.free_biggest_size;
+    s->lv_heap_used_pct = mon.used_pct;
+    s->lv_heap_frag_pct = mon.frag_pct;
+  }
+  s->internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+  snapshot_tasks();
+  s->task_count = task_count;
+  s->tasks_total = tasks_total;
+  last = now;
+  last_us = now_us;
+}
+
+void deck_telemetry_hid_set(uint8_t report_id, const uint8_t *data,
+                            uint16_t len) {
+  if (len >= 1)
+    next_page = data[0];
+}
+
+uint16_t deck_telemetry_hid_get(uint8_t report_id, uint8_t *buf,
+                                uint16_t reqlen) {
+  if (reqlen < sizeof(deck_telemetry_summary_t) ||
+      reqlen < sizeof(deck_telemetry_tasks_t))
+    return 0;
+  memset(buf, 0, reqlen);
+
+  uint8_t pages = 1 + (task_count + DECK_TELEMETRY_TASKS_PER_PAGE - 1) /
+                          DECK_TELEMETRY_TASKS_PER_PAGE;
+  if (next_page == 0 || next_page >= pages) {
+    deck_telemetry_summary_t s;
+    deck_telemetry_snapshot(&s);
+    memcpy(buf, &s, sizeof(s));
+    next_page = 1;
+    return reqlen;
+  }
+
+  deck_telemetry_tasks_t *page = (deck_telemetry_tasks_t *)buf;
+  page->page = next_page;
+  page->task_count = task_count;
+  page->first = (next_page - 1) * DECK_TELEMETRY_TASKS_PER_PAGE;
+  page->count = LV_MIN(task_count - page->first, DECK_TELEMETRY_TASKS_PER_PAGE);
+  memcpy(page->tasks, &tasks[page->first],
+         page->count * sizeof(deck_telemetry_task_t));
+  next_page++;
+  return reqlen;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Health counters for the host, read through a feature report without any
+ * driver. SET_REPORT: one byte, the page the next GET_REPORT returns. Every
+ * GET_REPORT returns a page and moves on to the next, so a host can also
+ * just keep reading. Page 0 takes a new snapshot and returns
+ * deck_telemetry_summary_t; pages 1.. return deck_telemetry_tasks_t of that
+ * snapshot. Rates and percentiles cover the time since the previous
+ * snapshot.
+ */
+#define DECK_TELEMETRY_HID_REPORT 8
+
+#define DECK_TELEMETRY_TASKS_PER_PAGE 4
+#define DECK_TELEMETRY_TASKS_MAX 24
+#define DECK_TELEMETRY_TASK_NAME 10
+
+typedef struct __attribute__((packed)) {
+  uint8_t page; // 0
+  uint8_t task_count;
+  uint16_t window_ms;
+  uint16_t fps_x10;
+  uint32_t render_p50_us;
+  uint32_t render_p99_us;
+  uint32_t render_max_us;
+  uint32_t flush_p50_us;
+  uint32_t flush_p99_us;
+  uint32_t flush_max_us;
+  uint32_t lv_heap_used;
+  uint32_t lv_heap_largest_free;
+  uint8_t lv_heap_used_pct;
+  uint8_t lv_heap_frag_pct;
+  uint32_t internal_free; // heap_caps internal RAM
+  uint16_t touch_hz;
+  uint32_t hid_sent;    // since boot
+  uint32_t hid_merged;  // queued behind a report in flight and merged
+  uint32_t hid_dropped; // sent while not mounted
+  uint8_t tasks_total;  // more than task_count when the list was cut off
+} deck_telemetry_summary_t;
+
+typedef struct __attribute__((packed)) {
+  char name[DECK_TELEMETRY_TASK_NAME];
+  uint16_t cpu_permille; // of one core, 0xFFFF without run time stats
+  uint16_t stack_free;   // bytes, the high-water mark
+} deck_telemetry_task_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t page;
+  uint8_t task_count;
+  uint8_t first;
+  uint8_t count;
+  deck_telemetry_task_t tasks[DECK_TELEMETRY_TASKS_PER_PAGE];
+} deck_telemetry_tasks_t;
+
+/* Counters, lock-free (one atomic add each) and callable from ISRs.
+ * - deck_telemetry_render: a refresh of the invalid areas took us.
+ * - deck_telemetry_flush: an area took us from flush_cb to its release.
+ * - deck_telemetry_hid: a report was sent, merged into one waiting or
+ *   dropped.
+ */
+void deck_telemetry_render(uint32_t us);
+void deck_telemetry_flush(uint32_t us);
+void deck_telemetry_touch_sample(void);
+
+/* Touch samples since boot */
+uint32_t deck_telemetry_touch_samples(void);
+
+typedef enum {
+  DECK_TELEMETRY_HID_SENT,
+  DECK_TELEMETRY_HID_MERGED,
+  DECK_TELEMETRY_HID_DROPPED,
+} deck_telemetry_hid_t;
+
+void deck_telemetry_hid(deck_telemetry_hid_t what);
+
+/* Input reports since boot, sent, merged or dropped */
+uint32_t deck_telemetry_hid_reports(void);
+
+/* Function to take a snapshot, also used by the HID report. Takes the LVGL
+ * lock for the heap figures, which are zero before lv_init.
+ */
+void deck_telemetry_snapshot(deck_telemetry_summary_t *summary);
+
+/* deck_hid handlers of DECK_TELEMETRY_HID_REPORT */
+void deck_telemetry_hid_set(uint8_t report_id, const uint8_t *data,
+                            uint16_t len);
+uint16_t deck_telemetry_hid_get(uint8_t report_id, uint8_t *buf,
+                                uint16_t reqlen);
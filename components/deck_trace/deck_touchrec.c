@@ -0,0 +1,408 @@
+#include "deck_touchrec.h"
+#include "deck_telemetry.h"
+#include "deck_trace.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The replay task of CMD_REPLAY runs where the LVGL task would */
+#define REPLAY_TASK_CORE 1
+#define REPLAY_TASK_PRIO 4
+#define REPLAY_MAX_INDEVS 4
+
+_Static_assert(sizeof(deck_touchrec_record_t) == 6, "record is 6 bytes");
+
+/* The ring is written by the LVGL task only, the host reads it while
+ * recording is stopped
+ */
+typedef struct {
+  uint32_t head; // records ever written
+  bool last_pressed;
+  int32_t last_x, last_y;
+  int64_t last_us;
+  deck_touchrec_record_t records[DECK_TOUCHREC_RECORDS];
+} recorder_t;
+
+static recorder_t rec;
+#if CONFIG_DECK_TOUCHREC
+static volatile bool recording = true;
+#else
+static volatile bool recording;
+#endif
+
+/* Read position of the host in the trace */
+static uint32_t read_pos;
+
+/* State of CMD_REPLAY */
+static volatile bool replay_running;
+static size_t replay_len;
+static deck_touchrec_result_t replay_result;
+
+/* State of deck_touchrec_replay. The tick callback takes no argument, so
+ * there is only one replay at a time.
+ */
+typedef struct {
+  const uint8_t *records;
+  uint32_t count;
+  uint32_t next;    // record to apply next
+  uint32_t next_ms; // when it applies
+  uint32_t base_tick;
+  uint32_t now_ms;
+  bool pressed;
+  int16_t x, y;
+  bool delivered; // pressed state LVGL has seen
+  // The edge waiting for its frame
+  bool waiting;
+  bool drawn;
+  uint32_t edge_ms;
+  int64_t edge_us;
+  uint32_t edge_hid;
+  deck_touchrec_event_t *events;
+  size_t max_events;
+  uint64_t latency_sum;
+  uint32_t latency_count;
+  deck_touchrec_result_t *result;
+} replay_t;
+
+static replay_t replay;
+
+#if CONFIG_DECK_TOUCHREC
+
+void deck_touchrec_read(bool pressed, int32_t x, int32_t y) {
+  if (!recording)
+    return;
+  // Only changes are kept, LVGL reads the same touch many times
+  if (pressed == rec.last_pressed &&
+      (!pressed || (x == rec.last_x && y == rec.last_y)))
+    return;
+  int64_t now = esp_timer_get_time();
+  int64_t dt = (now - rec.last_us) / 1000;
+  rec.records[rec.head % DECK_TOUCHREC_RECORDS] = (deck_touchrec_record_t){
+      .dt_ms = dt < UINT16_MAX ? dt : UINT16_MAX,
+      .x = (uint16_t)x | (pressed ? DECK_TOUCHREC_PRESSED : 0),
+      .y = (uint16_t)y,
+  };
+  rec.head++;
+  rec.last_pressed = pressed;
+  rec.last_x = x;
+  rec.last_y = y;
+  rec.last_us = now;
+}
+
+#endif
+
+void deck_touchrec_enable(bool enabled) {
+  if (enabled && !recording) {
+    rec.head = 0;
+    rec.last_pressed = false;
+    rec.last_us = esp_timer_get_time();
+  }
+  recording = enabled;
+}
+
+static uint32_t trace_count(void) {
+  return rec.head < DECK_TOUCHREC_RECORDS ? rec.head : DECK_TOUCHREC_RECORDS;
+}
+
+static size_t trace_len(void) {
+  return sizeof(deck_touchrec_header_t) +
+         trace_count() * sizeof(deck_touchrec_record_t);
+}
+
+/* Copies up to len bytes of the trace from pos, the ring unrolled behind
+ * its header. Returns the number copied.
+ */
+static size_t trace_read(size_t pos, uint8_t *buf, size_t len) {
+  uint32_t count = trace_count();
+  deck_touchrec_header_t header = {DECK_TOUCHREC_MAGIC, count};
+  size_t n = 0;
+  while (n < len && pos < trace_len()) {
+    if (pos < sizeof(header)) {
+      buf[n++] = ((const uint8_t *)&header)[pos++];
+      continue;
+    }
+    size_t offset = pos - sizeof(header);
+    uint32_t i = rec.head - count + offset / sizeof(deck_touchrec_record_t);
+    const uint8_t *record =
+        (const uint8_t *)&rec.records[i % DECK_TOUCHREC_RECORDS];
+    buf[n++] = record[offset % sizeof(deck_touchrec_record_t)];
+    pos++;
+  }
+  return n;
+}
+
+size_t deck_touchrec_copy(uint8_t *buf) {
+  if (buf == NULL)
+    return trace_len();
+  return trace_read(0, buf, trace_len());
+}
+
+static uint32_t replay_tick(void) { return replay.base_tick + replay.now_ms; }
+
+static void replay_apply(void) {
+  while (replay.next < replay.count && replay.next_ms <= replay.now_ms) {
+    deck_touchrec_record_t r;
+    memcpy(&r, replay.records + replay.next * sizeof(r), sizeof(r));
+    replay.pressed = r.x & DECK_TOUCHREC_PRESSED;
+    replay.x = r.x & ~DECK_TOUCHREC_PRESSED;
+    replay.y = r.y;
+    if (++replay.next < replay.count) {
+      memcpy(&r, replay.records + replay.next * sizeof(r), sizeof(r));
+      replay.next_ms += r.dt_ms;
+    }
+  }
+}
+
+/* Closes the edge in flight with the HID reports it caused */
+static void replay_close_edge(void) {
+  deck_touchrec_result_t *res = replay.result;
+  if (res->events == 0 || res->events > replay.max_events)
+    return;
+  replay.events[res->events - 1].hid_reports =
+      deck_telemetry_hid_reports() - replay.edge_hid;
+}
+
+static void replay_read(lv_indev_t *indev, lv_indev_data_t *data) {
+  replay_apply();
+  data->point.x = replay.x;
+  data->point.y = replay.y;
+  data->state =
+      replay.pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+  deck_trace(DECK_TRACE_INPUT_READ, replay.pressed,
+             (uint32_t)data->point.x << 16 | (uint16_t)data->point.y);
+  if (replay.pressed == replay.delivered)
+    return;
+
+  replay_close_edge();
+  replay.delivered = replay.pressed;
+  replay.waiting = true;
+  replay.drawn = false;
+  replay.edge_ms = replay.now_ms;
+  replay.edge_us = esp_timer_get_time();
+  replay.edge_hid = deck_telemetry_hid_reports();
+  deck_touchrec_result_t *res = replay.result;
+  if (res->events < replay.max_events) {
+    replay.events[res->events] = (deck_touchrec_event_t){
+        .at_ms = replay.now_ms,
+        .pressed = replay.pressed,
+        .x = replay.x,
+        .y = replay.y,
+        .frame_ms = UINT32_MAX,
+        .frame_us = UINT32_MAX,
+    };
+  }
+  res->events++;
+}
+
+static void replay_display_cb(lv_event_t *e) {
+  deck_touchrec_result_t *res = replay.result;
+  if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+    res->frames++;
+    replay.drawn = true;
+    return;
+  }
+  // LV_EVENT_REFR_READY, the areas of the refresh are flushed
+  if (!replay.waiting || !replay.drawn)
+    return;
+  replay.waiting = false;
+  uint32_t us = (uint32_t)(esp_timer_get_time() - replay.edge_us);
+  replay.latency_sum += us;
+  replay.latency_count++;
+  if (us > res->latency_max_us)
+    res->latency_max_us = us;
+  if (res->events <= replay.max_events) {
+    deck_touchrec_event_t *ev = &replay.events[res->events - 1];
+    ev->frame_ms = replay.now_ms - replay.edge_ms;
+    ev->frame_us = us;
+  }
+}
+
+esp_err_t deck_touchrec_replay(const uint8_t *trace, size_t len,
+                               deck_touchrec_event_t *events,
+                               size_t max_events,
+                               deck_touchrec_result_t *result) {
+  deck_touchrec_header_t header;
+  if (len < sizeof(header))
+    return ESP_ERR_INVALID_SIZE;
+  memcpy(&header, trace, sizeof(header));
+  if (header.magic != DECK_TOUCHREC_MAGIC)
+    return ESP_ERR_INVALID_ARG;
+  if (len < sizeof(header) + header.count * sizeof(deck_touchrec_record_t))
+    return ESP_ERR_INVALID_SIZE;
+  // Asked for from the USB task, which may run before lv_init is done
+  if (!lv_is_initialized())
+    return ESP_ERR_INVALID_STATE;
+  lv_display_t *disp = lv_display_get_default();
+  if (disp == NULL)
+    return ESP_ERR_INVALID_STATE;
+
+  memset(result, 0, sizeof(*result));
+  replay = (replay_t){
+      .records = trace + sizeof(header),
+      .count = header.count,
+      .events = events,
+      .max_events = events != NULL ? max_events : 0,
+      .result = result,
+  };
+  uint32_t end_ms = DECK_TOUCHREC_SETTLE_MS;
+  for (uint32_t i = 0; i < header.count; i++) {
+    deck_touchrec_record_t r;
+    memcpy(&r, replay.records + i * sizeof(r), sizeof(r));
+    // The first record starts the replay, its gap is to a record before it
+    if (i > 0)
+      end_ms += r.dt_ms;
+  }
+
+  bool was_recording = recording;
+  recording = false;
+  int64_t start_us = esp_timer_get_time();
+  uint32_t hid_start = deck_telemetry_hid_reports();
+
+  lv_lock();
+  lv_indev_t *disabled[REPLAY_MAX_INDEVS];
+  int disabled_count = 0;
+  for (lv_indev_t *indev = lv_indev_get_next(NULL); indev != NULL;
+       indev = lv_indev_get_next(indev)) {
+    if (disabled_count < REPLAY_MAX_INDEVS) {
+      lv_indev_enable(indev, false);
+      disabled[disabled_count++] = indev;
+    }
+  }
+  lv_indev_t *indev = lv_indev_create();
+  lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+  lv_indev_set_read_cb(indev, replay_read);
+  lv_display_add_event_cb(disp, replay_display_cb, LV_EVENT_RENDER_START,
+                          &replay);
+  lv_display_add_event_cb(disp, replay_display_cb, LV_EVENT_REFR_READY,
+                          &replay);
+
+  // Virtual time jumps to whatever is due next, a timer or a record. The
+  // timers start over with it, when they ran last in real time would show in
+  // the frames otherwise.
+  lv_tick_get_cb_t tick_cb = lv_tick_get_cb();
+  replay.base_tick = lv_tick_get();
+  lv_tick_set_cb(replay_tick);
+  for (lv_timer_t *t = lv_timer_get_next(NULL); t != NULL;
+       t = lv_timer_get_next(t))
+    lv_timer_reset(t);
+  while (replay.now_ms < end_ms) {
+    uint32_t step = lv_timer_handler();
+    if (replay.next < replay.count && replay.next_ms > replay.now_ms &&
+        replay.next_ms - replay.now_ms < step)
+      step = replay.next_ms - replay.now_ms;
+    if (end_ms - replay.now_ms < step)
+      step = end_ms - replay.now_ms;
+    replay.now_ms += step > 0 ? step : 1;
+  }
+  replay_close_edge();
+  lv_tick_set_cb(tick_cb);
+
+  lv_display_remove_event_cb_with_user_data(disp, replay_display_cb, &replay);
+  lv_indev_delete(indev);
+  for (int i = 0; i < disabled_count; i++)
+    lv_indev_enable(disabled[i], true);
+  lv_unlock();
+
+  result->duration_ms = end_ms;
+  result->wall_us = (uint32_t)(esp_timer_get_time() - start_us);
+  result->hid_reports = deck_telemetry_hid_reports() - hid_start;
+  if (replay.latency_count > 0)
+    result->latency_mean_us = replay.latency_sum / replay.latency_count;
+  recording = was_recording;
+  return ESP_OK;
+}
+
+static void replay_task(void *arg) {
+  uint8_t *trace = arg;
+  esp_err_t err =
+      deck_touchrec_replay(trace, replay_len, NULL, 0, &replay_result);
+  free(trace);
+  if (err != ESP_OK) {
+    ESP_LOGE("TOUCHREC", "Replay failed: %s", esp_err_to_name(err));
+  } else {
+    ESP_LOGI("TOUCHREC",
+             "Replayed %" PRIu32 " ms in %" PRIu32 " us: %u edges, %u frames, "
+             "%u HID reports, frame latency mean %" PRIu32 " max %" PRIu32
+             " us",
+             replay_result.duration_ms, replay_result.wall_us,
+             replay_result.events, replay_result.frames,
+             replay_result.hid_reports, replay_result.latency_mean_us,
+             replay_result.latency_max_us);
+  }
+  replay_running = false;
+  vTaskDelete(NULL);
+}
+
+/* Replays the recording as it is, recording stays stopped */
+static void replay_start(void) {
+  if (replay_running)
+    return;
+  recording = false;
+  replay_len = deck_touchrec_copy(NULL);
+  uint8_t *trace = malloc(replay_len);
+  if (trace == NULL) {
+    ESP_LOGE("TOUCHREC", "No memory for a replay of %u bytes",
+             (unsigned)replay_len);
+    return;
+  }
+  deck_touchrec_copy(trace);
+  memset(&replay_result, 0, sizeof(replay_result));
+  replay_running = true;
+  if (xTaskCreatePinnedToCore(replay_task, "replay", 4096, trace,
+                              REPLAY_TASK_PRIO, NULL,
+                              REPLAY_TASK_CORE) != pdPASS) {
+    free(trace);
+    replay_running = false;
+  }
+}
+
+static enum { READ_TRACE, READ_RESULT } read_what;
+
+void deck_touchrec_hid_set(uint8_t report_id, const uint8_t *data,
+                           uint16_t len) {
+  if (len < 1)
+    return;
+  switch (data[0]) {
+  case DECK_TOUCHREC_CMD_STOP:
+    deck_touchrec_enable(false);
+    read_what = READ_TRACE;
+    read_pos = 0;
+    ESP_LOGI("TOUCHREC", "Stopped with %u records", (unsigned)trace_count());
+    break;
+  case DECK_TOUCHREC_CMD_START:
+    // Not while the replay task has recording stopped
+    if (!replay_running)
+      deck_touchrec_enable(true);
+    break;
+  case DECK_TOUCHREC_CMD_REPLAY:
+    read_what = READ_RESULT;
+    replay_start();
+    break;
+  default:
+    break;
+  }
+}
+
+uint16_t deck_touchrec_hid_get(uint8_t report_id, uint8_t *buf,
+                               uint16_t reqlen) {
+  if (reqlen < 2 + sizeof(deck_touchrec_result_t))
+    return 0;
+  memset(buf, 0, reqlen);
+  if (read_what == READ_RESULT) {
+    buf[0] = replay_running;
+    if (!replay_running)
+      memcpy(buf + 2, &replay_result, sizeof(replay_result));
+    return reqlen;
+  }
+  // The ring changes under the reader while recording
+  if (!recording && !replay_running) {
+    buf[0] = trace_read(read_pos, buf + 2, reqlen - 2);
+    read_pos += buf[0];
+  }
+  return reqlen;
+}
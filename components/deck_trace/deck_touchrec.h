@@ -0,0 +1,120 @@
+#pragma once
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Touch recording and replay. The recorder keeps what LVGL's pointer read
+ * delivered in a ring of compact records, one per change, so touches that
+ * led to a bug or a stutter can be taken off the deck and fed back into
+ * LVGL later, on the deck or in the simulator (sim/), as often as needed.
+ * Recording runs from boot.
+ *
+ * A trace, as the host saves it, is a deck_touchrec_header_t followed by
+ * count deck_touchrec_record_t, oldest first. Gaps over 65 s between
+ * records shrink to that.
+ *
+ * Feature report, SET: one byte command. GET after STOP: {n, 0} followed by
+ * n bytes of the trace, n = 0 at its end. GET after REPLAY: {running, 0}
+ * followed by the deck_touchrec_result_t of the replay.
+ */
+#define DECK_TOUCHREC_HID_REPORT 10
+
+#define DECK_TOUCHREC_MAGIC 0x31525444 // "DTR1"
+#define DECK_TOUCHREC_PRESSED 0x8000
+
+#ifndef CONFIG_DECK_TOUCHREC_RECORDS
+#define CONFIG_DECK_TOUCHREC_RECORDS 1
+#endif
+#define DECK_TOUCHREC_RECORDS CONFIG_DECK_TOUCHREC_RECORDS
+
+/* Virtual time a replay runs on after the last record, for animations and
+ * page slides to finish
+ */
+#define DECK_TOUCHREC_SETTLE_MS 1000
+
+enum {
+  DECK_TOUCHREC_CMD_STOP = 0, // and rewind the reader
+  DECK_TOUCHREC_CMD_START = 1, // clears the recording
+  DECK_TOUCHREC_CMD_REPLAY = 2, // replays the recording on the deck
+};
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic; // DECK_TOUCHREC_MAGIC
+  uint32_t count;
+} deck_touchrec_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint16_t dt_ms; // since the previous record
+  uint16_t x;     // screen coordinates, DECK_TOUCHREC_PRESSED in x
+  uint16_t y;
+} deck_touchrec_record_t;
+
+/* Outcome of a replay. Times in ms are virtual, the same on every replay of
+ * a trace with the same firmware; wall times tell how fast the deck (or
+ * host) ran it. Frame latency is the wall time from the read that delivered
+ * a press or release to the end of the first refresh that drew after it.
+ */
+typedef struct __attribute__((packed)) {
+  uint32_t duration_ms;
+  uint32_t wall_us;
+  uint16_t events;      // press and release edges
+  uint16_t frames;      // refreshes that drew something
+  uint16_t hid_reports; // input reports sent, merged or dropped
+  uint32_t latency_mean_us;
+  uint32_t latency_max_us;
+} deck_touchrec_result_t;
+
+/* One press or release of a replay
+ * - at_ms: virtual time of the read that delivered it
+ * - frame_ms / frame_us: virtual and wall time until the first refresh that
+ *   drew after it was done, UINT32_MAX if none did before the next edge
+ * - hid_reports: input reports from it until the next edge
+ */
+typedef struct {
+  uint32_t at_ms;
+  bool pressed;
+  int16_t x;
+  int16_t y;
+  uint32_t frame_ms;
+  uint32_t frame_us;
+  uint16_t hid_reports;
+} deck_touchrec_event_t;
+
+#if CONFIG_DECK_TOUCHREC
+
+/* Hook of the pointer read, with what it hands LVGL */
+void deck_touchrec_read(bool pressed, int32_t x, int32_t y);
+
+#else
+
+static inline void deck_touchrec_read(bool pressed, int32_t x, int32_t y) {}
+
+#endif
+
+/* Function to start (clearing the recording) or stop recording */
+void deck_touchrec_enable(bool enabled);
+
+/* Function to copy the recording as a trace into buf, which takes at least
+ * the length returned with buf NULL. Stop recording first.
+ */
+size_t deck_touchrec_copy(uint8_t *buf);
+
+/* Function to replay a trace into LVGL's default display. The replay takes
+ * the LVGL lock for its whole length, so the LVGL task waits; it switches
+ * LVGL to a virtual clock and steps it from one timer or record to the next,
+ * with the other input devices disabled and recording stopped. events (can
+ * be NULL) receives the first max_events edges. Call it from a task other
+ * than the LVGL task.
+ */
+esp_err_t deck_touchrec_replay(const uint8_t *trace, size_t len,
+                               deck_touchrec_event_t *events,
+                               size_t max_events,
+                               deck_touchrec_result_t *result);
+
+/* deck_hid handlers of DECK_TOUCHREC_HID_REPORT */
+void deck_touchrec_hid_set(uint8_t report_id, const uint8_t *data,
+                           uint16_t len);
+uint16_t deck_touchrec_hid_get(uint8_t report_id, uint8_t *buf,
+                               uint16_t reqlen);
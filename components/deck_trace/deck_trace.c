@@ -0,0 +1,81 @@
+#include "deck_trace.h"
+#include "esp_log.h"
+#include <string.h>
+
+_Static_assert((DECK_TRACE_RECORDS & (DECK_TRACE_RECORDS - 1)) == 0,
+               "DECK_TRACE_RECORDS must be a power of two");
+
+/* Records per GET_REPORT, header and records fill the 63 byte report */
+#define TRACE_REPORT_RECORDS 5
+
+deck_trace_ring_t deck_trace_rings[SOC_CPU_CORES_NUM];
+volatile bool deck_trace_frozen;
+
+/* Read position of the host while frozen */
+static uint8_t read_core;
+static uint32_t read_pos;
+static uint32_t read_end;
+
+static void trace_rewind(uint8_t core) {
+  read_core = core;
+  if (core >= SOC_CPU_CORES_NUM)
+    return;
+  uint32_t head = deck_trace_rings[core].head;
+  read_end = head;
+  read_pos = head > DECK_TRACE_RECORDS ? head - DECK_TRACE_RECORDS : 0;
+}
+
+void deck_trace_freeze(void) {
+  deck_trace_frozen = true;
+  trace_rewind(0);
+}
+
+void deck_trace_resume(void) { deck_trace_frozen = false; }
+
+void deck_trace_hid_set(uint8_t report_id, const uint8_t *data,
+                        uint16_t len) {
+  if (len < 1)
+    return;
+  switch (data[0]) {
+  case DECK_TRACE_CMD_FREEZE:
+    deck_trace_freeze();
+    ESP_LOGI("TRACE", "Frozen for reading");
+    break;
+  case DECK_TRACE_CMD_RESUME:
+    deck_trace_resume();
+    break;
+  default:
+    break;
+  }
+}
+
+uint16_t deck_trace_hid_get(uint8_t report_id, uint8_t *buf,
+                            uint16_t reqlen) {
+  if (reqlen < 3 + sizeof(deck_trace_record_t) * TRACE_REPORT_RECORDS)
+    return 0;
+  memset(buf, 0, reqlen);
+
+  // Rings that are not frozen change under the reader, report the end
+  while (deck_trace_frozen && read_core < SOC_CPU_CORES_NUM &&
+         read_pos == read_end)
+    trace_rewind(read_core + 1);
+  if (!deck_trace_frozen || read_core >= SOC_CPU_CORES_NUM) {
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    buf[0] = 0xFF;
+    memcpy(buf + 3, &now, sizeof(now));
+    return reqlen;
+  }
+
+  const deck_trace_ring_t *ring = &deck_trace_rings[read_core];
+  uint8_t n = 0;
+  while (n < TRACE_REPORT_RECORDS && read_pos < read_end) {
+    memcpy(buf + 3 + n * sizeof(deck_trace_record_t),
+           &ring->records[read_pos & (DECK_TRACE_RECORDS - 1)],
+           sizeof(deck_trace_record_t));
+    read_pos++;
+    n++;
+  }
+  buf[0] = read_core;
+  buf[1] = n;
+  return reqlen;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Feature report the host reads the rings through.
+ * SET_REPORT: one byte, DECK_TRACE_CMD_FREEZE or DECK_TRACE_CMD_RESUME.
+ * GET_REPORT, after FREEZE: {core, n, 0} followed by n deck_trace_record_t,
+ * oldest first, core 0 then core 1. Core 0xFF ends the dump and is followed
+ * by the current time (uint32_t, us) to unwrap the timestamps against.
+ */
+#define DECK_TRACE_HID_REPORT 6
+
+#ifndef CONFIG_DECK_TRACE_RECORDS
+#define CONFIG_DECK_TRACE_RECORDS 1
+#endif
+#define DECK_TRACE_RECORDS CONFIG_DECK_TRACE_RECORDS
+
+enum {
+  DECK_TRACE_CMD_FREEZE = 1,
+  DECK_TRACE_CMD_RESUME = 2,
+};
+
+/* Events and their arguments */
+typedef enum {
+  DECK_TRACE_TOUCH_SAMPLE = 1, // GT911 sampled: pressed, x << 16 | y
+  DECK_TRACE_INPUT_READ,       // LVGL read the pointer: pressed, x << 16 | y
+  DECK_TRACE_RENDER_START,     // refresh of the invalid areas: 0, 0
+  DECK_TRACE_RENDER_END,       // 0, 0
+  DECK_TRACE_FLUSH_START,      // area to the panel: last, w << 16 | h
+  DECK_TRACE_FLUSH_DONE,       // buffer released: released by DMA, 0
+  DECK_TRACE_HID_ARMED,        // report queued: report ID, first data bytes
+  DECK_TRACE_HID_SENT,         // report went out: report ID, length
+  DECK_TRACE_HID_DROPPED,      // endpoint busy: report ID, first data bytes
+  DECK_TRACE_MARK,             // free for debugging
+  DECK_TRACE_LATENCY,          // stage of an input edge, see deck_latency.h
+} deck_trace_event_t;
+
+typedef struct {
+  uint32_t ts; // esp_timer_get_time, low 32 bits
+  uint16_t event;
+  uint16_t arg0;
+  uint32_t arg1;
+} deck_trace_record_t;
+
+typedef struct {
+  uint32_t head; // records ever written, the ring holds the last ones
+  deck_trace_record_t records[DECK_TRACE_RECORDS];
+} deck_trace_ring_t;
+
+extern deck_trace_ring_t deck_trace_rings[SOC_CPU_CORES_NUM];
+extern volatile bool deck_trace_frozen;
+
+/* Function to record an event, from tasks and ISRs. Each core writes its own
+ * ring; the atomic add gives an interrupting writer (or a task that just
+ * moved to the other core) its own slot without taking a lock.
+ */
+static inline void deck_trace(deck_trace_event_t event, uint16_t arg0,
+                              uint32_t arg1) {
+#if CONFIG_DECK_TRACE
+  if (deck_trace_frozen)
+    return;
+  deck_trace_ring_t *ring = &deck_trace_rings[esp_cpu_get_core_id()];
+  uint32_t i = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED) &
+               (DECK_TRACE_RECORDS - 1);
+  ring->records[i] = (deck_trace_record_t){
+      .ts = (uint32_t)esp_timer_get_time(),
+      .event = event,
+      .arg0 = arg0,
+      .arg1 = arg1,
+  };
+#endif
+}
+
+/* Function to stop recording, e.g. right after an outlier was detected so
+ * the events leading up to it stay in the rings until the host read them.
+ */
+void deck_trace_freeze(void);
+void deck_trace_resume(void);
+
+/* deck_hid handlers of DECK_TRACE_HID_REPORT */
+void deck_trace_hid_set(uint8_t report_id, const uint8_t *data, uint16_t len);
+uint16_t deck_trace_hid_get(uint8_t report_id, uint8_t *buf, uint16_t reqlen);
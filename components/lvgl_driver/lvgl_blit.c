@@ -0,0 +1,258 @@
+#include "esp_async_memcpy.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lvgl_driver.h"
+#include "lvgl_private.h"
+#include <string.h>
+
+/* Draw unit ID of the blit unit, the software units use 1 */
+#define BLIT_UNIT_ID 90
+/* Preference score of plain image copies, 100 is the software renderer */
+#define BLIT_PREF_SCORE 30
+/* Rows queued on the GDMA engine at a time */
+#define BLIT_BACKLOG 16
+/* The worker only queues rows and waits, it runs above the draw threads */
+#define BLIT_TASK_PRIO 4
+
+typedef struct {
+  lv_draw_unit_t base;
+  lv_draw_task_t *volatile task_act;
+  TaskHandle_t worker;
+} blit_unit_t;
+
+static async_memcpy_handle_t blit_mcp;
+static SemaphoreHandle_t blit_lock;
+static volatile bool blit_enabled;
+static portMUX_TYPE blit_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static lvgl_blit_stats_t blit_stats;
+
+static bool IRAM_ATTR blit_done_isr(async_memcpy_handle_t mcp,
+                                    async_memcpy_event_t *event,
+                                    void *cb_args) {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR((TaskHandle_t)cb_args, &woken);
+  return woken == pdTRUE;
+}
+
+static void copy_cpu(uint8_t *dst, size_t dst_stride, const uint8_t *src,
+                     size_t src_stride, size_t row_bytes, uint32_t rows) {
+  for (uint32_t row = 0; row < rows; row++) {
+    memcpy(dst + row * dst_stride, src + row * src_stride, row_bytes);
+  }
+}
+
+/* Copy the rows with the GDMA engine, BLIT_BACKLOG rows at a time. Returns
+ * the number of rows copied, the caller copies the rest on the CPU.
+ */
+static uint32_t copy_dma(uint8_t *dst, size_t dst_stride, const uint8_t *src,
+                         size_t src_stride, size_t row_bytes, uint32_t rows) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  uint32_t row = 0;
+
+  while (row < rows) {
+    uint32_t queued = 0;
+    esp_err_t err = ESP_OK;
+    while (queued < BLIT_BACKLOG && row + queued < rows) {
+      uint32_t r = row + queued;
+      err = esp_async_memcpy(blit_mcp, dst + r * dst_stride,
+                             (void *)(src + r * src_stride), row_bytes,
+                             blit_done_isr, self);
+      if (err != ESP_OK)
+        break;
+      queued++;
+    }
+
+    // Every row notifies once, wait until the whole chunk landed
+    uint32_t done = 0;
+    while (done < queued) {
+      done += ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    row += queued;
+
+    if (err != ESP_OK) {
+      ESP_LOGW("BLIT", "GDMA copy failed (%s), finishing on the CPU",
+               esp_err_to_name(err));
+      break;
+    }
+  }
+  return row;
+}
+
+bool lvgl_blit_copy(void *dst, size_t dst_stride, const void *src,
+                    size_t src_stride, size_t row_bytes, uint32_t rows,
+                    bool use_dma) {
+  // Rows contiguous on both sides go out as a single transfer
+  if (dst_stride == row_bytes && src_stride == row_bytes) {
+    row_bytes *= rows;
+    dst_stride = src_stride = row_bytes;
+    rows = 1;
+  }
+
+  // GDMA reads and writes internal RAM in whole words
+  bool aligned = (((uintptr_t)dst | (uintptr_t)src | dst_stride | src_stride |
+                   row_bytes) &
+                  3) == 0;
+  use_dma = use_dma && blit_mcp != NULL && aligned &&
+            esp_ptr_dma_capable(dst) && esp_ptr_dma_capable(src);
+
+  uint32_t dma_rows = 0;
+  if (use_dma) {
+    xSemaphoreTake(blit_lock, portMAX_DELAY);
+    dma_rows = copy_dma(dst, dst_stride, src, src_stride, row_bytes, rows);
+    xSemaphoreGive(blit_lock);
+  }
+  copy_cpu((uint8_t *)dst + dma_rows * dst_stride, dst_stride,
+           (const uint8_t *)src + dma_rows * src_stride, src_stride,
+           row_bytes, rows - dma_rows);
+
+  bool by_dma = dma_rows == rows;
+  portENTER_CRITICAL(&blit_stats_lock);
+  if (by_dma)
+    blit_stats.dma_blits++;
+  else
+    blit_stats.cpu_blits++;
+  blit_stats.bytes += (uint64_t)row_bytes * rows;
+  portEXIT_CRITICAL(&blit_stats_lock);
+  return by_dma;
+}
+
+/* Whether the image task is a plain copy of the image data into the layer */
+static bool blit_is_copy(const lv_draw_task_t *t) {
+  const lv_draw_image_dsc_t *dsc = t->draw_dsc;
+
+  if (dsc->header.cf != LV_COLOR_FORMAT_RGB565 ||
+      t->target_layer->color_format != LV_COLOR_FORMAT_RGB565 ||
+      lv_image_src_get_type(dsc->src) != LV_IMAGE_SRC_VARIABLE)
+    return false;
+
+  if (dsc->opa < LV_OPA_MAX || dsc->recolor_opa > LV_OPA_MIN ||
+      dsc->rotation != 0 || dsc->scale_x != LV_SCALE_NONE ||
+      dsc->scale_y != LV_SCALE_NONE || dsc->skew_x != 0 || dsc->skew_y != 0 ||
+      dsc->clip_radius != 0 || dsc->tile || dsc->colorkey != NULL ||
+      dsc->sup != NULL || dsc->bitmap_mask_src != NULL ||
+      dsc->blend_mode != LV_BLEND_MODE_NORMAL)
+    return false;
+
+  const lv_image_dsc_t *img = dsc->src;
+  if (!lv_area_is_equal(&t->area, &dsc->image_area) ||
+      lv_area_get_width(&t->area) != (int32_t)img->header.w ||
+      lv_area_get_height(&t->area) != (int32_t)img->header.h)
+    return false;
+
+  // Small images are cheaper to copy than to set up a transfer for
+  if ((size_t)img->header.w * img->header.h * 2 < LVGL_BLIT_MIN_BYTES)
+    return false;
+  return esp_ptr_dma_capable(img->data);
+}
+
+static int32_t blit_evaluate(lv_draw_unit_t *draw_unit, lv_draw_task_t *t) {
+  if (!blit_enabled || t->type != LV_DRAW_TASK_TYPE_IMAGE || !blit_is_copy(t))
+    return 0;
+
+  if (t->preference_score > BLIT_PREF_SCORE) {
+    t->preference_score = BLIT_PREF_SCORE;
+    t->preferred_draw_unit_id = BLIT_UNIT_ID;
+  }
+  return 1;
+}
+
+static int32_t blit_dispatch(lv_draw_unit_t *draw_unit, lv_layer_t *layer) {
+  blit_unit_t *u = (blit_unit_t *)draw_unit;
+  // One copy at a time, the worker requests a dispatch when it is done
+  if (u->task_act != NULL)
+    return 0;
+
+  lv_draw_task_t *t = lv_draw_get_available_task(layer, NULL, BLIT_UNIT_ID);
+  if (t == NULL || t->preferred_draw_unit_id != BLIT_UNIT_ID)
+    return LV_DRAW_UNIT_IDLE;
+  if (lv_draw_layer_alloc_buf(layer) == NULL)
+    return LV_DRAW_UNIT_IDLE;
+
+  t->state = LV_DRAW_TASK_STATE_IN_PROGRESS;
+  t->draw_unit = draw_unit;
+  u->task_act = t;
+  xTaskNotifyGive(u->worker);
+  return 1;
+}
+
+static void blit_execute(lv_draw_task_t *t) {
+  const lv_draw_image_dsc_t *dsc = t->draw_dsc;
+  const lv_image_dsc_t *img = dsc->src;
+  lv_layer_t *layer = t->target_layer;
+  lv_draw_buf_t *buf = layer->draw_buf;
+
+  lv_area_t area;
+  if (!lv_area_intersect(&area, &t->area, &t->clip_area))
+    return;
+
+  size_t src_stride =
+      img->header.stride ? img->header.stride : img->header.w * 2;
+  const uint8_t *src = img->data +
+                       (area.y1 - dsc->image_area.y1) * src_stride +
+                       (area.x1 - dsc->image_area.x1) * 2;
+  uint8_t *dst = lv_draw_buf_goto_xy(buf, area.x1 - layer->buf_area.x1,
+                                     area.y1 - layer->buf_area.y1);
+
+  lvgl_blit_copy(dst, buf->header.stride, src, src_stride,
+                 lv_area_get_width(&area) * 2, lv_area_get_height(&area),
+                 true);
+}
+
+/* Runs the copies handed over by blit_dispatch while the draw threads render
+ * the other tasks of the layer.
+ */
+static void blit_task(void *arg) {
+  blit_unit_t *u = arg;
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    lv_draw_task_t *t = u->task_act;
+    if (t == NULL)
+      continue;
+
+    blit_execute(t);
+
+    t->state = LV_DRAW_TASK_STATE_FINISHED;
+    u->task_act = NULL;
+    lv_draw_dispatch_request();
+  }
+}
+
+esp_err_t lvgl_blit_init(void) {
+  if (blit_mcp != NULL)
+    return ESP_OK;
+
+  async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+  config.backlog = BLIT_BACKLOG;
+  esp_err_t err = esp_async_memcpy_install(&config, &blit_mcp);
+  if (err != ESP_OK) {
+    ESP_LOGW("BLIT", "No GDMA channel for blits (%s)", esp_err_to_name(err));
+    blit_mcp = NULL;
+    return err;
+  }
+  blit_lock = xSemaphoreCreateMutex();
+
+  blit_unit_t *u = lv_draw_create_unit(sizeof(blit_unit_t));
+  u->base.name = "GDMA_BLIT";
+  u->base.evaluate_cb = blit_evaluate;
+  u->base.dispatch_cb = blit_dispatch;
+  xTaskCreate(blit_task, "blit", 3072, u, BLIT_TASK_PRIO, &u->worker);
+
+  blit_enabled = true;
+  ESP_LOGI("BLIT", "Image copies offloaded to GDMA");
+  return ESP_OK;
+}
+
+void lvgl_blit_set_enabled(bool enabled) {
+  blit_enabled = enabled && blit_mcp != NULL;
+}
+
+void lvgl_blit_get_stats(lvgl_blit_stats_t *stats) {
+  portENTER_CRITICAL(&blit_stats_lock);
+  *stats = blit_stats;
+  portEXIT_CRITICAL(&blit_stats_lock);
+}
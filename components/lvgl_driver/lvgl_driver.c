@@ -1,16 +1,113 @@
+#include "lvgl_driver.h"
+#include "bsp_waveshare.h"
+#include "deck_area.h"
+#include "deck_latency.h"
+#include "deck_telemetry.h"
+#include "deck_touch.h"
+#include "deck_touchrec.h"
+#include "deck_trace.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_vendor.h"
 #include "esp_lcd_touch.h"
 #include "esp_lcd_touch_gt911.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "lvgl.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if LV_USE_OS != LV_OS_FREERTOS || LV_DRAW_SW_DRAW_UNIT_CNT < 2
+#warning "LVGL renders on one core, see sdkconfig.defaults"
+#endif
+
+/* Number of tiles each refreshed area is split into, one per draw unit.
+ * LVGL creates the draw unit threads itself, with xTaskCreate, so they are
+ * not pinned: ESP-IDF's FreeRTOS can only set the core when a task is
+ * created (vTaskCoreAffinitySet needs CONFIG_FREERTOS_SMP), and pinning them
+ * would mean replacing LVGL's FreeRTOS OS layer with an LV_OS_CUSTOM copy.
+ * Unpinned tasks run on whichever core is free, so the two tiles still
+ * render in parallel whenever core 0 is not busy with touch or USB. Pinned,
+ * the draw unit of core 0 would wait out those tasks instead of moving to
+ * core 1.
+ */
+#define LVGL_RENDER_TILES LV_DRAW_SW_DRAW_UNIT_CNT
+
+/* GT911 sampling runs in its own task so touch input keeps its rate while
+ * both cores render. It shares core 0 with the USB task.
+ */
+#define TOUCH_TASK_CORE 0
+#define TOUCH_TASK_PRIO 5
+#define TOUCH_SAMPLE_PERIOD_MS 10
 
 typedef struct {
   esp_lcd_touch_handle_t handle;
-  uint16_t lcd_width;
-  uint16_t lcd_height;
+  deck_touch_map_t map;
+  portMUX_TYPE lock;
+  bool pressed;
+  uint16_t raw_x;
+  uint16_t raw_y;
 } touch_driver_ctx_t;
 
+/* Display state, the user data of the LVGL display.
+ * In scrolling mode the panel shows frame memory shifted by scroll_offset
+ * lines inside [scroll_start, scroll_start + scroll_length) along the scroll
+ * axis, so flushed areas are shifted by the same amount (wrapping inside the
+ * region) before they are written.
+ */
+typedef struct {
+  esp_lcd_panel_handle_t panel;
+  esp_lcd_panel_io_handle_t io;
+  size_t buf_size;
+  bool scroll_enabled;
+  bool scroll_along_x;
+  bool scroll_reversed;
+  int32_t scroll_start;
+  int32_t scroll_length;
+  int32_t scroll_offset;
+  uint16_t scroll_top_fixed;
+  uint8_t *scratch; // column splits when scrolling along x
+  bool flush_disabled;
+  int64_t render_start_us;
+  int64_t flush_start_us; // of the area being transferred
+  bool photon_pending; // the area released next ends a refresh
+  lvgl_flush_tap_cb_t flush_tap;
+  lvgl_scroll_tap_cb_t scroll_tap;
+  void *tap_user_data;
+} display_driver_ctx_t;
+
+static void touch_sample_task(void *arg) {
+  touch_driver_ctx_t *ctx = arg;
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    esp_lcd_touch_read_data(ctx->handle);
+
+    uint16_t touch_x[1];
+    uint16_t touch_y[1];
+    uint16_t touch_strength[1];
+    uint8_t touch_count = 0;
+
+    bool touched = esp_lcd_touch_get_coordinates(
+        ctx->handle, touch_x, touch_y, touch_strength, &touch_count, 1);
+
+    portENTER_CRITICAL(&ctx->lock);
+    ctx->pressed = touched && touch_count > 0;
+    if (ctx->pressed) {
+      ctx->raw_x = touch_x[0];
+      ctx->raw_y = touch_y[0];
+    }
+    portEXIT_CRITICAL(&ctx->lock);
+    // Only this task writes the sample, it can be read back unlocked
+    deck_trace(DECK_TRACE_TOUCH_SAMPLE, ctx->pressed,
+               (uint32_t)ctx->raw_x << 16 | ctx->raw_y);
+    deck_latency_sample(ctx->pressed);
+    deck_telemetry_touch_sample();
+
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TOUCH_SAMPLE_PERIOD_MS));
+  }
+}
+
 static void touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
   touch_driver_ctx_t *ctx = lv_indev_get_user_data(indev);
   if (ctx->handle == NULL) {
@@ -18,48 +115,155 @@ static void touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
     return;
   }
 
-  esp_lcd_touch_read_data(ctx->handle);
+  // Latest sample of touch_sample_task
+  portENTER_CRITICAL(&ctx->lock);
+  bool pressed = ctx->pressed;
+  uint16_t raw_x = ctx->raw_x;
+  uint16_t raw_y = ctx->raw_y;
+  portEXIT_CRITICAL(&ctx->lock);
+
+  if (pressed) {
+    deck_touch_transform(&ctx->map, raw_x, raw_y, &data->point.x,
+                         &data->point.y);
+    data->state = LV_INDEV_STATE_PRESSED;
+  } else {
+    data->state = LV_INDEV_STATE_RELEASED;
+  }
+  // Traced instead of logged, a log line per sample costs more than a frame
+  deck_trace(DECK_TRACE_INPUT_READ, pressed,
+             (uint32_t)data->point.x << 16 | (uint16_t)data->point.y);
+  deck_latency_read(pressed);
+  deck_touchrec_read(pressed, data->point.x, data->point.y);
+}
+
+/* Write the part [a1, a2] (along the scroll axis, screen coordinates) of the
+ * flushed area to panel position q1 along the axis. Returns whether the
+ * pixels were copied by the panel IO, see lcd_io_draw_window.
+ */
+static bool flush_segment(display_driver_ctx_t *ctx, const lv_area_t *area,
+                          uint8_t *px_map, int32_t a1, int32_t a2, int32_t q1,
+                          size_t *scratch_used) {
+  int32_t w = lv_area_get_width(area);
+  int32_t h = lv_area_get_height(area);
+  int32_t n = a2 - a1 + 1;
 
-  uint16_t touch_x[1];
-  uint16_t touch_y[1];
-  uint16_t touch_strength[1];
-  uint8_t touch_count = 0;
+  if (!ctx->scroll_along_x) {
+    // Rows are contiguous in the draw buffer
+    return lcd_io_draw_window(ctx->io, area->x1, q1, area->x2 + 1, q1 + n,
+                              px_map + (a1 - area->y1) * w * 2);
+  }
+  if (n == w) {
+    return lcd_io_draw_window(ctx->io, q1, area->y1, q1 + n, area->y2 + 1,
+                              px_map);
+  }
 
-  bool touched = esp_lcd_touch_get_coordinates(ctx->handle, touch_x, touch_y,
-                                               touch_strength, &touch_count, 1);
+  // Columns are not, gather them into the scratch buffer. Every segment of
+  // one flush gets its own part of it since the transfers are still queued.
+  uint8_t *dst = ctx->scratch + *scratch_used;
+  for (int32_t row = 0; row < h; row++) {
+    memcpy(dst + row * n * 2, px_map + (row * w + a1 - area->x1) * 2, n * 2);
+  }
+  *scratch_used += n * h * 2;
+  return lcd_io_draw_window(ctx->io, q1, area->y1, q1 + n, area->y2 + 1, dst);
+}
 
-  if (touched && touch_count > 0) {
-    uint16_t raw_x = touch_x[0];
-    uint16_t raw_y = touch_y[0];
+static bool flush_scrolled(display_driver_ctx_t *ctx, const lv_area_t *area,
+                           uint8_t *px_map) {
+  int32_t a1 = ctx->scroll_along_x ? area->x1 : area->y1;
+  int32_t a2 = ctx->scroll_along_x ? area->x2 : area->y2;
+  int32_t shift = ctx->scroll_reversed ? -ctx->scroll_offset
+                                       : ctx->scroll_offset;
+  deck_span_t spans[DECK_SCROLL_SPANS_MAX];
+  uint32_t n = deck_scroll_split(ctx->scroll_start, ctx->scroll_length, shift,
+                                 a1, a2, spans);
+  size_t scratch_used = 0;
+  bool copied = true;
 
-    data->point.x = raw_y;
-    data->point.y = ctx->lcd_height - raw_x;
+  for (uint32_t i = 0; i < n; i++)
+    copied &= flush_segment(ctx, area, px_map, spans[i].a1, spans[i].a2,
+                            spans[i].q1, &scratch_used);
+  return copied;
+}
 
-    data->state = LV_INDEV_STATE_PRESSED;
-    ESP_LOGI("TOUCH", "Raw: (%d, %d) -> Transformed: (%d, %d)", raw_x, raw_y,
-             data->point.x, data->point.y);
-  } else {
-    data->state = LV_INDEV_STATE_RELEASED;
+/* Release the buffer of the area flushed, from the LVGL task or the DMA done
+ * ISR. LVGL only flushes the next area after it.
+ */
+static void flush_done(lv_display_t *disp, bool from_isr) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (ctx->photon_pending) {
+    ctx->photon_pending = false;
+    deck_latency_flush_done();
   }
+  deck_trace(DECK_TRACE_FLUSH_DONE, from_isr, 0);
+  deck_telemetry_flush(esp_timer_get_time() - ctx->flush_start_us);
+  lv_display_flush_ready(disp);
 }
 
 static void lvgl_flush_cb(lv_display_t *disp, const lv_area_t *area,
                           uint8_t *px_map) {
-  esp_lcd_panel_handle_t panel =
-      (esp_lcd_panel_handle_t)lv_display_get_user_data(disp);
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  bool copied;
 
-  esp_lcd_panel_draw_bitmap(panel, area->x1, area->y1, area->x2 + 1,
-                            area->y2 + 1, px_map);
+  if (ctx->flush_disabled) {
+    lv_display_flush_ready(disp);
+    return;
+  }
 
-  lv_display_flush_ready(disp);
+  bool last = lv_display_flush_is_last(disp);
+  deck_trace(DECK_TRACE_FLUSH_START, last,
+             (uint32_t)lv_area_get_width(area) << 16 |
+                 lv_area_get_height(area));
+  deck_latency_flush(area->x1, area->y1, area->x2, area->y2);
+  ctx->flush_start_us = esp_timer_get_time();
+
+  if (ctx->scroll_enabled) {
+    copied = flush_scrolled(ctx, area, px_map);
+  } else {
+    copied = lcd_io_draw_window(ctx->io, area->x1, area->y1, area->x2 + 1,
+                                area->y2 + 1, px_map);
+  }
+
+  // Small areas are batched until the last area of the refresh
+  if (last)
+    lcd_io_commit(ctx->io);
+
+  // The panel transfer is already queued, the tap reads the buffer alongside
+  if (ctx->flush_tap != NULL)
+    ctx->flush_tap(disp, area, px_map, last, ctx->tap_user_data);
+
+  // A buffer still read by DMA is released from color_trans_done_cb, and so
+  // is the last area of a refresh: copied areas are only staged in the batch
+  // until it has been sent, the refresh is on the panel after that
+  if (!copied || last) {
+    ctx->photon_pending = last;
+    if (lcd_io_notify_when_done(ctx->io))
+      return;
+  }
+  flush_done(disp, false);
+}
+
+static bool color_trans_done_cb(esp_lcd_panel_io_handle_t io,
+                                esp_lcd_panel_io_event_data_t *edata,
+                                void *user_ctx) {
+  flush_done(user_ctx, true);
+  return false;
 }
 
 lv_indev_t *lvgl_create_touch(esp_lcd_touch_handle_t touch_handle,
                               uint16_t lcd_width, uint16_t lcd_height) {
-  touch_driver_ctx_t *ctx = malloc(sizeof(touch_driver_ctx_t));
+  touch_driver_ctx_t *ctx = calloc(1, sizeof(touch_driver_ctx_t));
   ctx->handle = touch_handle;
-  ctx->lcd_width = lcd_width;
-  ctx->lcd_height = lcd_height;
+  // The GT911 reports portrait coordinates on the landscape panel
+  ctx->map = (deck_touch_map_t){.width = lcd_width,
+                                .height = lcd_height,
+                                .swap_xy = true,
+                                .mirror_y = true};
+  ctx->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+
+  if (touch_handle != NULL) {
+    xTaskCreatePinnedToCore(touch_sample_task, "touch", 3072, ctx,
+                            TOUCH_TASK_PRIO, NULL, TOUCH_TASK_CORE);
+  }
 
   lv_indev_t *indev = lv_indev_create();
   lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
@@ -69,22 +273,159 @@ lv_indev_t *lvgl_create_touch(esp_lcd_touch_handle_t touch_handle,
   return indev;
 }
 
-lv_display_t *lvgl_create_display(esp_lcd_panel_handle_t panel, uint16_t width,
+static void render_event_cb(lv_event_t *e) {
+  display_driver_ctx_t *ctx = lv_event_get_user_data(e);
+  if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+    deck_trace(DECK_TRACE_RENDER_START, 0, 0);
+    ctx->render_start_us = esp_timer_get_time();
+  } else {
+    deck_trace(DECK_TRACE_RENDER_END, 0, 0);
+    deck_telemetry_render(esp_timer_get_time() - ctx->render_start_us);
+  }
+}
+
+lv_display_t *lvgl_create_display(esp_lcd_panel_handle_t panel,
+                                  esp_lcd_panel_io_handle_t io, uint16_t width,
                                   uint16_t height) {
+  display_driver_ctx_t *ctx = calloc(1, sizeof(display_driver_ctx_t));
+  ctx->panel = panel;
+  ctx->io = io;
+
   lv_display_t *disp = lv_display_create(width, height);
   lv_display_set_flush_cb(disp, lvgl_flush_cb);
-  lv_display_set_user_data(disp, panel);
   lv_display_set_color_format(disp, LV_COLOR_FORMAT_RGB565);
 
   // Two smaller buffers for smoother rendering
   size_t buf_size = width * 30 * sizeof(lv_color_t);
   void *buf1 = heap_caps_malloc(buf_size, MALLOC_CAP_DMA);
   void *buf2 = heap_caps_malloc(buf_size, MALLOC_CAP_DMA);
+  ctx->buf_size = buf_size;
 
   lv_display_set_buffers(disp, buf1, buf2, buf_size,
                          LV_DISPLAY_RENDER_MODE_PARTIAL);
+  // Each area is rendered as tiles in parallel by the draw units
+  lv_display_set_tile_cnt(disp, LVGL_RENDER_TILES);
+
+  lv_display_set_user_data(disp, ctx);
+  lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_START, ctx);
+  lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_READY, ctx);
 
-  lv_display_set_user_data(disp, panel);
+  const esp_lcd_panel_io_callbacks_t cbs = {
+      .on_color_trans_done = color_trans_done_cb,
+  };
+  esp_lcd_panel_io_register_event_callbacks(io, &cbs, disp);
 
   return disp;
 }
+
+void lvgl_display_set_flush_enabled(lv_display_t *disp, bool enabled) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  ctx->flush_disabled = !enabled;
+}
+
+void lvgl_display_set_flush_tap(lv_display_t *disp,
+                                lvgl_flush_tap_cb_t flush_cb,
+                                lvgl_scroll_tap_cb_t scroll_cb,
+                                void *user_data) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  ctx->flush_tap = flush_cb;
+  ctx->scroll_tap = scroll_cb;
+  ctx->tap_user_data = user_data;
+}
+
+esp_err_t lvgl_scroll_enable(lv_display_t *disp, int32_t start,
+                             int32_t length) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  bool along_x;
+  bool reversed;
+  lcd_get_scroll_axis(lcd_get_orientation(), &along_x, &reversed);
+
+  int32_t extent = along_x ? lv_display_get_horizontal_resolution(disp)
+                           : lv_display_get_vertical_resolution(disp);
+  if (extent != LCD_SCROLL_LINES || start < 0 || length <= 0 ||
+      start + length > extent) {
+    ESP_LOGE("SCROLL", "Region %ld+%ld not scrollable along %c", (long)start,
+             (long)length, along_x ? 'x' : 'y');
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (along_x && ctx->scratch == NULL) {
+    ctx->scratch = heap_caps_malloc(ctx->buf_size, MALLOC_CAP_DMA);
+    if (ctx->scratch == NULL)
+      return ESP_ERR_NO_MEM;
+  }
+
+  // Frame memory lines run backwards along the screen axis when reversed
+  uint16_t top_fixed = reversed ? extent - start - length : start;
+  uint16_t bottom_fixed = extent - top_fixed - length;
+  esp_err_t err =
+      lcd_set_scroll_area(ctx->io, top_fixed, length, bottom_fixed);
+  if (err == ESP_OK)
+    err = lcd_set_scroll_start(ctx->io, top_fixed);
+  if (err != ESP_OK)
+    return err;
+
+  ctx->scroll_along_x = along_x;
+  ctx->scroll_reversed = reversed;
+  ctx->scroll_start = start;
+  ctx->scroll_length = length;
+  ctx->scroll_offset = 0;
+  ctx->scroll_top_fixed = top_fixed;
+  ctx->scroll_enabled = true;
+  ESP_LOGI("SCROLL", "Hardware scrolling along %c, lines %d+%ld+%d",
+           along_x ? 'x' : 'y', top_fixed, (long)length, bottom_fixed);
+  return ESP_OK;
+}
+
+void lvgl_scroll_by(lv_display_t *disp, int32_t delta) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (!ctx->scroll_enabled || delta == 0)
+    return;
+
+  int32_t start = ctx->scroll_start;
+  int32_t length = ctx->scroll_length;
+  int32_t dir = ctx->scroll_reversed ? -1 : 1;
+  if (LV_ABS(delta) < length) {
+    ctx->scroll_offset = deck_scroll_wrap(ctx->scroll_offset + dir * delta,
+                                          length);
+    lcd_set_scroll_start(ctx->io, ctx->scroll_top_fixed + ctx->scroll_offset);
+    if (ctx->scroll_tap != NULL)
+      ctx->scroll_tap(disp, ctx->scroll_along_x, start, length, delta,
+                      ctx->tap_user_data);
+  }
+
+  // Only the band scrolled into view has to be rendered
+  int32_t band1 = delta > 0 ? start + length - delta : start;
+  int32_t band2 = delta > 0 ? start + length - 1 : start - delta - 1;
+  band1 = LV_MAX(band1, start);
+  band2 = LV_MIN(band2, start + length - 1);
+
+  lv_area_t band;
+  if (ctx->scroll_along_x) {
+    lv_area_set(&band, band1, 0, band2,
+                lv_display_get_vertical_resolution(disp) - 1);
+  } else {
+    lv_area_set(&band, 0, band1,
+                lv_display_get_horizontal_resolution(disp) - 1, band2);
+  }
+  lv_obj_invalidate_area(lv_display_get_layer_top(disp), &band);
+}
+
+bool lvgl_scroll_is_enabled(lv_display_t *disp, bool *along_x) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (along_x != NULL)
+    *along_x = ctx->scroll_along_x;
+  return ctx->scroll_enabled;
+}
+
+void lvgl_scroll_disable(lv_display_t *disp) {
+  display_driver_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (!ctx->scroll_enabled)
+    return;
+
+  lcd_set_scroll_area(ctx->io, 0, LCD_SCROLL_LINES, 0);
+  lcd_set_scroll_start(ctx->io, 0);
+  ctx->scroll_enabled = false;
+  // Frame memory holds the shifted image, redraw it in place
+  lv_obj_invalidate(lv_display_get_screen_active(disp));
+}
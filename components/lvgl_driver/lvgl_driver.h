@@ -4,7 +4,125 @@
 #include "esp_lcd_touch.h"
 #include "lvgl.h"
 
-lv_display_t *lvgl_create_display(esp_lcd_panel_handle_t panel, uint16_t width,
+/* Function to create the LVGL display. Areas are written through the panel
+ * IO created by bsp_lcd_io_new, which batches small areas.
+ * Parameters:
+ * - panel: Handle of the initialized LCD panel.
+ * - io: Panel IO of the LCD panel.
+ * - width, height: Resolution in the current orientation.
+ */
+lv_display_t *lvgl_create_display(esp_lcd_panel_handle_t panel,
+                                  esp_lcd_panel_io_handle_t io, uint16_t width,
                                   uint16_t height);
+/* Function to stop writing rendered areas to the panel, e.g. to time
+ * rendering alone. Areas rendered while disabled are lost.
+ */
+void lvgl_display_set_flush_enabled(lv_display_t *disp, bool enabled);
+
+/* Called with every area written to the panel, after its transfer has been
+ * queued. px_map stays valid until the callback returns and the call delays
+ * the rendering of the next area, so keep it short.
+ * - area: Flushed area in screen coordinates.
+ * - px_map: RGB565 pixels of the area, rows of lv_area_get_width(area).
+ * - last: Whether this is the last area of the refresh.
+ */
+typedef void (*lvgl_flush_tap_cb_t)(lv_display_t *disp, const lv_area_t *area,
+                                    const uint8_t *px_map, bool last,
+                                    void *user_data);
+
+/* Called when the content of the scrolling region was shifted by the panel
+ * (lvgl_scroll_by), since only the band scrolled into view is flushed.
+ * - along_x, start, length: Scrolling region, see lvgl_scroll_enable.
+ * - delta: Pixels the content moved towards the start of the region.
+ */
+typedef void (*lvgl_scroll_tap_cb_t)(lv_display_t *disp, bool along_x,
+                                     int32_t start, int32_t length,
+                                     int32_t delta, void *user_data);
+
+/* Function to observe what is written to the panel, e.g. to mirror the
+ * screen. Pass NULL callbacks to remove the tap.
+ */
+void lvgl_display_set_flush_tap(lv_display_t *disp,
+                                lvgl_flush_tap_cb_t flush_cb,
+                                lvgl_scroll_tap_cb_t scroll_cb,
+                                void *user_data);
+
 lv_indev_t *lvgl_create_touch(esp_lcd_touch_handle_t touch_handle,
                               uint16_t lcd_width, uint16_t lcd_height);
+
+/* Function to enable the hardware scrolling mode of the display. In this mode
+ * content moved along the panel's scroll axis (see lcd_get_scroll_axis, x in
+ * landscape, y in portrait) is shifted by the panel itself and only the band
+ * scrolled into view is rendered and transferred.
+ * Parameters:
+ * - disp: Display created with lvgl_create_display.
+ * - start: First screen line/column of the scrolling region along the axis.
+ * - length: Size of the scrolling region along the axis. The region spans
+ *   the whole screen across the axis.
+ */
+esp_err_t lvgl_scroll_enable(lv_display_t *disp, int32_t start,
+                             int32_t length);
+
+/* Function to scroll the content of the scrolling region. Call it after
+ * moving the LVGL objects by -delta along the axis with invalidation disabled
+ * (lv_display_enable_invalidation); it shifts the panel and invalidates only
+ * the revealed band.
+ * Parameters:
+ * - disp: Display in scrolling mode.
+ * - delta: Pixels the content moved towards the start of the region,
+ *   negative when it moved towards the end.
+ */
+void lvgl_scroll_by(lv_display_t *disp, int32_t delta);
+
+/* Returns whether scrolling mode is enabled and, if along_x is not NULL,
+ * whether it scrolls horizontally.
+ */
+bool lvgl_scroll_is_enabled(lv_display_t *disp, bool *along_x);
+
+/* Function to leave scrolling mode, the region is redrawn unshifted */
+void lvgl_scroll_disable(lv_display_t *disp);
+
+/* Images of at least this many bytes are copied by GDMA, smaller ones are
+ * cheaper to draw on the CPU than to set up a transfer for.
+ */
+#ifndef LVGL_BLIT_MIN_BYTES
+#define LVGL_BLIT_MIN_BYTES 2048
+#endif
+
+/* blit statistics
+ * - dma_blits: copies done by the GDMA engine
+ * - cpu_blits: copies done on the CPU (fallback)
+ * - bytes: total bytes copied
+ */
+typedef struct {
+  uint32_t dma_blits;
+  uint32_t cpu_blits;
+  uint64_t bytes;
+} lvgl_blit_stats_t;
+
+/* Function to offload image blits to the GDMA async memcpy engine. A draw
+ * unit takes the image draw tasks that are plain copies (cached RGB565 key
+ * images in internal RAM, drawn opaque and untransformed) and copies them in
+ * the background while the software draw units render the rest of the area.
+ * Without a free GDMA channel images keep being drawn on the CPU.
+ * Must be called after lv_init.
+ */
+esp_err_t lvgl_blit_init(void);
+
+/* Function to route image copies back to the CPU, e.g. for benchmarks */
+void lvgl_blit_set_enabled(bool enabled);
+void lvgl_blit_get_stats(lvgl_blit_stats_t *stats);
+
+/* Function to copy a rectangle of pixels, blocking until it is done. Uses
+ * GDMA when use_dma is set and the buffers allow it (internal RAM, word
+ * aligned), the CPU otherwise.
+ * Parameters:
+ * - dst, dst_stride: First destination row and bytes between rows.
+ * - src, src_stride: First source row and bytes between rows.
+ * - row_bytes, rows: Size of the rectangle.
+ * - use_dma: Whether GDMA may be used.
+ * Returns whether the copy was done by GDMA.
+ */
+bool lvgl_blit_copy(void *dst, size_t dst_stride, const void *src,
+                    size_t src_stride, size_t row_bytes, uint32_t rows,
+                    bool use_dma);
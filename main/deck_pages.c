@@ -0,0 +1,46 @@
+#include "deck_pages.h"
+#include "lvgl.h"
+
+// Static initializers need LV_COLOR_MAKE, lv_color_hex(0xFF0000) equivalent
+#define BTN_BLUE LV_COLOR_MAKE(0xFF, 0x00, 0x00)
+#define BTN_GREY LV_COLOR_MAKE(0x40, 0x40, 0x40)
+
+#define HID_BUTTON(n, text)                                                    \
+  {.id = n, .label = text, .bg_color = BTN_BLUE, .radius = 8}
+#define PAGE_BUTTON(n, text, page)                                             \
+  {.id = n,                                                                    \
+   .label = text,                                                              \
+   .bg_color = BTN_GREY,                                                       \
+   .radius = 8,                                                                \
+   .action = BUTTON_ACTION_OPEN_PAGE,                                          \
+   .target = page}
+#define BACK_BUTTON(n)                                                         \
+  {.id = n,                                                                    \
+   .label = LV_SYMBOL_LEFT " Back",                                            \
+   .bg_color = BTN_GREY,                                                       \
+   .radius = 8,                                                                \
+   .action = BUTTON_ACTION_BACK}
+
+// Page 0 is the home page, the other pages are folders opened from it
+const page_config_t deck_pages[DECK_PAGE_COUNT] = {
+    {.name = "Home",
+     .parent = DECK_PAGE_ROOT,
+     .buttons = {HID_BUTTON(1, "Btn 1"), HID_BUTTON(2, "Btn 2"),
+                 HID_BUTTON(3, "Btn 3"), HID_BUTTON(4, "Btn 4"),
+                 HID_BUTTON(5, "Btn 5"), HID_BUTTON(6, "Btn 6"),
+                 PAGE_BUTTON(7, LV_SYMBOL_AUDIO " Media", 1),
+                 PAGE_BUTTON(8, LV_SYMBOL_VIDEO " Scenes", 2)}},
+    {.name = "Media",
+     .parent = 0,
+     .buttons = {HID_BUTTON(1, LV_SYMBOL_PREV), HID_BUTTON(2, LV_SYMBOL_PLAY),
+                 HID_BUTTON(3, LV_SYMBOL_PAUSE), HID_BUTTON(4, LV_SYMBOL_NEXT),
+                 HID_BUTTON(5, LV_SYMBOL_MUTE),
+                 HID_BUTTON(6, LV_SYMBOL_VOLUME_MID),
+                 HID_BUTTON(7, LV_SYMBOL_VOLUME_MAX), BACK_BUTTON(8)}},
+    {.name = "Scenes",
+     .parent = 0,
+     .buttons = {HID_BUTTON(1, "Scene 1"), HID_BUTTON(2, "Scene 2"),
+                 HID_BUTTON(3, "Scene 3"), HID_BUTTON(4, "Scene 4"),
+                 HID_BUTTON(5, "Live"), HID_BUTTON(6, "BRB"),
+                 HID_BUTTON(7, "Record"), BACK_BUTTON(8)}},
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "deck_gl.h"
+
+#define DECK_PAGE_COUNT 3
+
+/* The deck's pages, given to deck_set_pages. Shared with the simulator in
+ * sim/, which builds the same UI on the host.
+ */
+extern const page_config_t deck_pages[DECK_PAGE_COUNT];
@@ -1,6 +1,10 @@
 #include "bsp_waveshare.h"
+#include "deck_assets.h"
+#include "deck_boot.h"
 #include "deck_gl.h"
 #include "deck_hid.h"
+#include "deck_mirror.h"
+#include "deck_pages.h"
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
 #include "esp_err.h"
@@ -14,10 +18,12 @@
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "lvgl.h"
 #include "lvgl_driver.h"
+#include "nvs_flash.h"
 #include <stdint.h>
 #include <stdio.h>
 
@@ -35,7 +41,9 @@
 #define C_SCL 7
 #define C_INT 17
 #define C_RST 16
-
+// LVGL's timer task runs on core 1, its unpinned draw units on both cores
+// while core 0 also serves the USB and touch tasks at higher priority
+#define LVGL_TASK_CORE 1
 static bsp_config_t lcd_config = {.lcd_host = LCD_HOST,
                                   .spi_miso = SPI_MISO,
                                   .spi_mosi = SPI_MOSI,
@@ -69,34 +77,157 @@ static void lvgl_timer_task(void *arg) {
   }
 }
 
-void app_main(void) {
+/* Bring-up runs in parallel where the hardware allows it. The panel (with
+ * its reset and sleep-out waits), the GT911 reset (close to 200 ms of
+ * waiting) and TinyUSB each start on a task of their own while app_main
+ * initializes LVGL, and app_main waits for what its next step needs: the
+ * panel for the display, USB and touch only once the UI runs.
+ */
+#define BOOT_LCD_DONE BIT0
+#define BOOT_TOUCH_DONE BIT1
+#define BOOT_USB_DONE BIT2
+#define BOOT_TASK_PRIO 5
+#define BOOT_REPORT_TIMEOUT_MS 3000
 
-  esp_err_t err = bsp_init(&lcd_config, &handles);
+static EventGroupHandle_t boot_events;
+static esp_err_t lcd_err;
 
-  if (err != ESP_OK || handles.lcd_panel == NULL || handles.lcd_io == NULL) {
-    ESP_LOGE("MAIN", "❌ LCD panel NOT initialized!");
-    return;
+static void lcd_init_task(void *arg) {
+  lcd_err = bsp_lcd_init(&lcd_config, &handles);
+  if (lcd_err == ESP_OK) {
+    lcd_set_orientation(&handles.lcd_panel, INVERTED_LANDSCAPE);
+    deck_boot_mark("lcd ready");
+    // The deck as last shown until LVGL draws the live UI over it. Without
+    // it the backlight waits for that first frame.
+    if (bsp_lcd_draw_boot_frame(&handles) == ESP_OK) {
+      lcd_backlight_on(LCD_BL);
+      deck_boot_mark("boot frame");
+    }
   }
-  ESP_LOGI("MAIN", "✓ LCD panel initialized");
+  xEventGroupSetBits(boot_events, BOOT_LCD_DONE);
+  vTaskDelete(NULL);
+}
+
+static void touch_init_task(void *arg) {
+  esp_err_t err = bsp_touch_init(&lcd_config, &handles);
+  if (err != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ Touch panel not initialized: %s",
+             esp_err_to_name(err));
+    handles.touch_panel = NULL;
+  } else {
+    deck_boot_mark("touch ready");
+  }
+  xEventGroupSetBits(boot_events, BOOT_TOUCH_DONE);
+  vTaskDelete(NULL);
+}
+
+/* TinyUSB serves reports while app_main is still in lv_init. The handlers
+ * deck_hid_init registers check lv_is_initialized before they touch LVGL.
+ * app_main holds the LVGL lock from lv_init until the LVGL task starts, so
+ * every handler that takes it, those of deck_assets and deck_gl included,
+ * waits until the UI is built.
+ */
+static void usb_init_task(void *arg) {
+  deck_hid_init();
+  xEventGroupSetBits(boot_events, BOOT_USB_DONE);
+  vTaskDelete(NULL);
+}
 
+static void first_frame_cb(lv_event_t *e) {
   lcd_backlight_on(LCD_BL);
-  vTaskDelay(pdMS_TO_TICKS(100));
-  lcd_set_orientation(&handles.lcd_panel, INVERTED_LANDSCAPE);
-  vTaskDelay(pdMS_TO_TICKS(100));
+  deck_boot_mark("first frame");
+  lv_display_remove_event_cb_with_user_data(lv_event_get_target(e),
+                                            first_frame_cb, NULL);
+}
+
+void app_main(void) {
+  deck_boot_mark("app_main");
+  boot_events = xEventGroupCreate();
+  // The panel gets the core LVGL renders on, touch and USB the one their
+  // tasks run on later
+  xTaskCreatePinnedToCore(lcd_init_task, "lcd_init", 4096, NULL,
+                          BOOT_TASK_PRIO, NULL, LVGL_TASK_CORE);
+  xTaskCreatePinnedToCore(touch_init_task, "touch_init", 4096, NULL,
+                          BOOT_TASK_PRIO, NULL, 0);
+  xTaskCreatePinnedToCore(usb_init_task, "usb_init", 4096, NULL,
+                          BOOT_TASK_PRIO, NULL, 0);
 
   lv_init();
+  // Held while the UI is built, report handlers wait for it
+  lv_lock();
+  if (deck_assets_init() == ESP_OK) {
+    ESP_LOGI("MAIN", "✓ Assets mapped");
+  }
+  esp_err_t err = nvs_flash_init();
+  if (err == ESP_ERR_NVS_NO_FREE_PAGES ||
+      err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+    ESP_ERROR_CHECK(nvs_flash_erase());
+    err = nvs_flash_init();
+  }
+  if (err != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ NVS not available: %s", esp_err_to_name(err));
+  }
+  deck_boot_mark("lvgl init");
 
-  lvgl_create_display(handles.lcd_panel, LCD_HOR_RES, LCD_VER_RES);
-  lvgl_create_touch(handles.touch_panel, LCD_HOR_RES, LCD_VER_RES);
+  xEventGroupWaitBits(boot_events, BOOT_LCD_DONE, pdFALSE, pdTRUE,
+                      portMAX_DELAY);
+  if (lcd_err != ESP_OK || handles.lcd_panel == NULL ||
+      handles.lcd_io == NULL) {
+    ESP_LOGE("MAIN", "❌ LCD panel NOT initialized!");
+    lv_unlock();
+    return;
+  }
+  ESP_LOGI("MAIN", "✓ LCD panel initialized");
 
-  ESP_LOGI("MAIN", "✓ LVGL display and touch drivers initialized");
-  deck_hid_init();
-  ESP_LOGI("MAIN", "✓ HID device initialized");
+  lv_display_t *disp = lvgl_create_display(handles.lcd_panel, handles.lcd_io,
+                                           LCD_HOR_RES, LCD_VER_RES);
+  // Page slides scroll the whole width in hardware
+  if (lvgl_scroll_enable(disp, 0, LCD_HOR_RES) != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ Hardware scrolling not available");
+  }
+  // Cached key images are copied by GDMA, the CPU draws them otherwise
+  if (lvgl_blit_init() != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ GDMA image blits not available");
+  }
+  lv_display_add_event_cb(disp, first_frame_cb, LV_EVENT_RENDER_READY, NULL);
+  ESP_LOGI("MAIN", "✓ LVGL display driver initialized");
+#if CONFIG_DECK_GL_BOOT_FRAME
+  if (deck_bootframe_init(disp, INVERTED_LANDSCAPE) != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ Boot frame not saved, no bootframe partition");
+  }
+#endif
+  // Idle until a host starts it over the vendor interface
+  if (deck_mirror_init(disp) != ESP_OK) {
+    ESP_LOGW("MAIN", "⚠ Screen mirror not available");
+  }
+#if CONFIG_DECK_GL_BENCHMARKS
+  deck_list_run_benchmark();
+#endif
+  deck_set_pages(deck_pages, DECK_PAGE_COUNT);
+#if CONFIG_DECK_GL_PROFILES
+  if (deck_profiles_init() == ESP_OK) {
+    ESP_LOGI("MAIN", "✓ %lu profiles mapped",
+             (unsigned long)deck_profile_count());
+  }
+#endif
+  // The deck as it was left, in place before the first frame
+  bool restored = false;
+#if CONFIG_DECK_GL_PERSIST
+  restored = deck_persist_init() == ESP_OK;
+#endif
   deck_create_ui();
 
-  update_slider_value(0, 30);
-  update_slider_value(1, 70);
-  update_slider_value(2, 90);
+  if (!restored) {
+    update_slider_value(0, 30);
+    update_slider_value(1, 70);
+    update_slider_value(2, 90);
+  }
+  deck_boot_mark("ui built");
+
+#if CONFIG_DECK_GL_BENCHMARKS
+  deck_render_run_benchmark();
+  deck_blit_run_benchmark();
+#endif
 
   const esp_timer_create_args_t tick_timer_args = {
       .callback = &lvgl_tick_inc_cb,
@@ -107,7 +238,25 @@ void app_main(void) {
   ESP_ERROR_CHECK(esp_timer_create(&tick_timer_args, &tick_timer));
   ESP_ERROR_CHECK(esp_timer_start_periodic(tick_timer, 10 * 1000)); // 10ms
 
-  xTaskCreate(lvgl_timer_task, "lvgl", 6144, NULL, 4, NULL);
+  lv_unlock();
+  xTaskCreatePinnedToCore(lvgl_timer_task, "lvgl", 6144, NULL, 4, NULL,
+                          LVGL_TASK_CORE);
 
+  // Touch joins the running UI, under the LVGL lock from here on
+  xEventGroupWaitBits(boot_events, BOOT_TOUCH_DONE | BOOT_USB_DONE, pdFALSE,
+                      pdTRUE, portMAX_DELAY);
+  lv_lock();
+  lv_indev_t *touch =
+      lvgl_create_touch(handles.touch_panel, LCD_HOR_RES, LCD_VER_RES);
+#if CONFIG_DECK_GL_HUD
+  deck_hud_attach_indev(touch);
+#endif
+  lv_unlock();
   ESP_LOGI("MAIN", "✓ System initialized");
+
+  // Without a host (a charger) there is no enumeration to wait for
+  deck_boot_wait("first frame", BOOT_REPORT_TIMEOUT_MS);
+  deck_boot_wait("hid enumerated", BOOT_REPORT_TIMEOUT_MS);
+  deck_boot_print();
+  vEventGroupDelete(boot_events);
 }
@@ -0,0 +1,35 @@
+/* LVGL configuration of the simulator. Mirrors the firmware's sdkconfig
+ * (LVGL Kconfig defaults plus sdkconfig.defaults) with pthreads in place of
+ * FreeRTOS; everything not set here keeps LVGL's default.
+ */
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#define LV_COLOR_DEPTH 16
+/* The device's 64 KB, doubled for the 64 bit pointers of the host */
+#define LV_MEM_SIZE (128 * 1024U)
+#define LV_DEF_REFR_PERIOD 33
+
+#define LV_USE_OS LV_OS_PTHREAD
+#define LV_DRAW_SW_DRAW_UNIT_CNT 2
+
+#define LV_USE_LOG 1
+#define LV_LOG_LEVEL LV_LOG_LEVEL_WARN
+#define LV_LOG_PRINTF 1
+
+#define LV_USE_OBSERVER 1
+#define LV_USE_SYSMON 1
+#define LV_USE_PERF_MONITOR 1
+
+#define LV_FONT_MONTSERRAT_14 1
+#define LV_FONT_DEFAULT &lv_font_montserrat_14
+
+#define LV_BIN_DECODER_RAM_LOAD 1
+#define LV_USE_RLE 1
+#define LV_USE_LZ4 1
+#define LV_USE_LZ4_INTERNAL 1
+#define LV_USE_TINY_TTF 1
+#define LV_USE_FS_MEMFS 1
+#define LV_FS_MEMFS_LETTER 'M'
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+/* Core the calling task is pinned to, see xTaskCreatePinnedToCore. Threads
+ * not created by it run as core 0.
+ */
+int esp_cpu_get_core_id(void);
@@ -0,0 +1,4 @@
+#pragma once
+
+/* The simulator's touch input is injected by sim_main, see sim_display.h */
+typedef struct esp_lcd_touch_s *esp_lcd_touch_handle_t;
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Handles of the panel drivers, opaque to the components built into the
+ * simulator; sim_display replaces lvgl_driver on top of them.
+ */
+typedef struct esp_lcd_panel_t *esp_lcd_panel_handle_t;
+typedef struct esp_lcd_panel_io_t *esp_lcd_panel_io_handle_t;
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "esp_timer.h"
+#include <stdio.h>
+
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+/* Lines as ESP-IDF prints them, "I (1234) TAG: text". Debug and verbose
+ * logs are dropped like with the default log level.
+ */
+#define ESP_LOG_LEVEL(level, tag, format, ...)                                 \
+  do {                                                                         \
+    if ((level) <= ESP_LOG_INFO)                                               \
+      fprintf(stderr, "%c (%u) %s: " format "\n", " EWIDV"[level],             \
+              (unsigned)(esp_timer_get_time() / 1000), tag, ##__VA_ARGS__);    \
+  } while (0)
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  ESP_LOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  ESP_LOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  ESP_LOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  ESP_LOG_LEVEL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)                                             \
+  ESP_LOG_LEVEL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32 as computed by the ESP32 ROM (and zlib): pass 0 to start, the
+ * previous result to continue
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
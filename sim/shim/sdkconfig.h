@@ -0,0 +1,30 @@
+#pragma once
+
+/* Configuration of the firmware components built into the simulator, their
+ * Kconfig defaults unless noted. DECK_GL_BENCHMARKS stays off, the
+ * benchmarks time the panel transfer and the GDMA blit.
+ */
+#define CONFIG_IDF_TARGET "linux"
+
+#define CONFIG_DECK_GL_FONT ""
+#define CONFIG_DECK_GL_FONT_SIZE 16
+#define CONFIG_DECK_GL_GLYPH_CACHE_KB 48
+#define CONFIG_DECK_GL_HUD 1
+#define CONFIG_DECK_GL_HUD_PERIOD_MS 500
+#define CONFIG_DECK_GL_BOOT_FRAME 1
+#define CONFIG_DECK_GL_BOOT_FRAME_IDLE_S 10
+#define CONFIG_DECK_GL_BOOT_FRAME_INTERVAL_S 900
+#define CONFIG_DECK_GL_PERSIST 1
+#define CONFIG_DECK_GL_PERSIST_QUIET_MS 2000
+#define CONFIG_DECK_GL_PERSIST_INTERVAL_S 10
+#define CONFIG_DECK_GL_PERSIST_MAX_DELAY_S 60
+#define CONFIG_DECK_GL_PROFILES 1
+
+#define CONFIG_DECK_TRACE 1
+#define CONFIG_DECK_TRACE_RECORDS 1024
+#define CONFIG_DECK_LATENCY 1
+#define CONFIG_DECK_TOUCHREC 1
+#define CONFIG_DECK_TOUCHREC_RECORDS 2048
+
+#define CONFIG_DECK_ASSETS_ICON_SIZE 64
+#define CONFIG_DECK_ASSETS_MIN_PSNR 36
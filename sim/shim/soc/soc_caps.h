@@ -0,0 +1,4 @@
+#pragma once
+
+/* The ESP32-S3 the simulator stands in for */
+#define SOC_CPU_CORES_NUM 2
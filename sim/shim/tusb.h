@@ -0,0 +1,17 @@
+#pragma once
+
+/* The descriptor constants deck_hid_desc.h uses, values of TinyUSB. The
+ * simulator has no vendor interface.
+ */
+#define CFG_TUD_VENDOR 0
+
+#define U16_TO_U8S_LE(n) (uint8_t)((n) & 0xff), (uint8_t)(((n) >> 8) & 0xff)
+
+#define TUSB_DESC_CONFIGURATION 0x02
+#define TUSB_DESC_INTERFACE 0x04
+#define TUSB_DESC_ENDPOINT 0x05
+#define TUSB_CLASS_HID 3
+#define TUSB_XFER_INTERRUPT 3
+#define HID_ITF_PROTOCOL_NONE 0
+#define HID_DESC_TYPE_HID 0x21
+#define HID_DESC_TYPE_REPORT 0x22
@@ -0,0 +1,346 @@
+#include "sim_display.h"
+#include "deck_latency.h"
+#include "deck_telemetry.h"
+#include "deck_touchrec.h"
+#include "deck_trace.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Same as lvgl_driver: a render tile per draw unit, touch sampled by its
+ * own task every 10 ms
+ */
+#define SIM_RENDER_TILES LV_DRAW_SW_DRAW_UNIT_CNT
+#define TOUCH_TASK_CORE 0
+#define TOUCH_TASK_PRIO 5
+#define TOUCH_SAMPLE_PERIOD_MS 10
+
+typedef struct {
+  portMUX_TYPE lock;
+  bool injected_pressed; // set by sim_touch_set
+  int32_t injected_x;
+  int32_t injected_y;
+  bool pressed; // the latest sample
+  int32_t x;
+  int32_t y;
+} touch_sim_ctx_t;
+
+/* The panel: fb holds what is on screen. In scrolling mode the content of
+ * [scroll_start, scroll_start + scroll_length) along x is shifted by
+ * lvgl_scroll_by, as the panel does with its frame memory offset.
+ */
+typedef struct {
+  uint16_t *fb;
+  int32_t width;
+  int32_t height;
+  bool scroll_enabled;
+  int32_t scroll_start;
+  int32_t scroll_length;
+  bool flush_disabled;
+  int64_t render_start_us;
+  lvgl_flush_tap_cb_t flush_tap;
+  lvgl_scroll_tap_cb_t scroll_tap;
+  void *tap_user_data;
+} display_sim_ctx_t;
+
+static touch_sim_ctx_t touch = {.lock = portMUX_INITIALIZER_UNLOCKED};
+
+void sim_touch_set(bool pressed, int32_t x, int32_t y) {
+  portENTER_CRITICAL(&touch.lock);
+  touch.injected_pressed = pressed;
+  if (pressed) {
+    touch.injected_x = x;
+    touch.injected_y = y;
+  }
+  portEXIT_CRITICAL(&touch.lock);
+}
+
+static void touch_sample_task(void *arg) {
+  TickType_t last_wake = xTaskGetTickCount();
+  while (1) {
+    portENTER_CRITICAL(&touch.lock);
+    touch.pressed = touch.injected_pressed;
+    touch.x = touch.injected_x;
+    touch.y = touch.injected_y;
+    portEXIT_CRITICAL(&touch.lock);
+    deck_trace(DECK_TRACE_TOUCH_SAMPLE, touch.pressed,
+               (uint32_t)touch.x << 16 | (uint16_t)touch.y);
+    deck_latency_sample(touch.pressed);
+    deck_telemetry_touch_sample();
+
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TOUCH_SAMPLE_PERIOD_MS));
+  }
+}
+
+static void touchpad_read(lv_indev_t *indev, lv_indev_data_t *data) {
+  portENTER_CRITICAL(&touch.lock);
+  bool pressed = touch.pressed;
+  data->point.x = touch.x;
+  data->point.y = touch.y;
+  portEXIT_CRITICAL(&touch.lock);
+
+  data->state = pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+  deck_trace(DECK_TRACE_INPUT_READ, pressed,
+             (uint32_t)data->point.x << 16 | (uint16_t)data->point.y);
+  deck_latency_read(pressed);
+  deck_touchrec_read(pressed, data->point.x, data->point.y);
+}
+
+lv_indev_t *lvgl_create_touch(esp_lcd_touch_handle_t touch_handle,
+                              uint16_t lcd_width, uint16_t lcd_height) {
+  xTaskCreatePinnedToCore(touch_sample_task, "touch", 3072, NULL,
+                          TOUCH_TASK_PRIO, NULL, TOUCH_TASK_CORE);
+
+  lv_indev_t *indev = lv_indev_create();
+  lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+  lv_indev_set_read_cb(indev, touchpad_read);
+  return indev;
+}
+
+/* The transfer is a copy, the area is done when the callback returns */
+static void sim_flush_cb(lv_display_t *disp, const lv_area_t *area,
+                         uint8_t *px_map) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (ctx->flush_disabled) {
+    lv_display_flush_ready(disp);
+    return;
+  }
+
+  bool last = lv_display_flush_is_last(disp);
+  int32_t w = lv_area_get_width(area);
+  deck_trace(DECK_TRACE_FLUSH_START, last,
+             (uint32_t)w << 16 | lv_area_get_height(area));
+  deck_latency_flush(area->x1, area->y1, area->x2, area->y2);
+  int64_t start = esp_timer_get_time();
+
+  for (int32_t y = area->y1; y <= area->y2; y++) {
+    memcpy(ctx->fb + y * ctx->width + area->x1,
+           px_map + (y - area->y1) * w * 2, w * 2);
+  }
+  if (ctx->flush_tap != NULL)
+    ctx->flush_tap(disp, area, px_map, last, ctx->tap_user_data);
+
+  deck_trace(DECK_TRACE_FLUSH_DONE, 0, 0);
+  // On the panel at the end of the refresh, as with the batched panel IO
+  if (last)
+    deck_latency_flush_done();
+  deck_telemetry_flush(esp_timer_get_time() - start);
+  lv_display_flush_ready(disp);
+}
+
+static void render_event_cb(lv_event_t *e) {
+  display_sim_ctx_t *ctx = lv_event_get_user_data(e);
+  if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+    deck_trace(DECK_TRACE_RENDER_START, 0, 0);
+    ctx->render_start_us = esp_timer_get_time();
+  } else {
+    deck_trace(DECK_TRACE_RENDER_END, 0, 0);
+    deck_telemetry_render(esp_timer_get_time() - ctx->render_start_us);
+  }
+}
+
+lv_display_t *lvgl_create_display(esp_lcd_panel_handle_t panel,
+                                  esp_lcd_panel_io_handle_t io, uint16_t width,
+                                  uint16_t height) {
+  display_sim_ctx_t *ctx = calloc(1, sizeof(display_sim_ctx_t));
+  ctx->width = width;
+  ctx->height = height;
+  ctx->fb = calloc((size_t)width * height, sizeof(uint16_t));
+
+  lv_display_t *disp = lv_display_create(width, height);
+  lv_display_set_flush_cb(disp, sim_flush_cb);
+  lv_display_set_color_format(disp, LV_COLOR_FORMAT_RGB565);
+
+  // The firmware's buffers, 30 lines each
+  size_t buf_size = width * 30 * sizeof(lv_color16_t);
+  void *buf1 = heap_caps_malloc(buf_size, MALLOC_CAP_DMA);
+  void *buf2 = heap_caps_malloc(buf_size, MALLOC_CAP_DMA);
+  lv_display_set_buffers(disp, buf1, buf2, buf_size,
+                         LV_DISPLAY_RENDER_MODE_PARTIAL);
+  lv_display_set_tile_cnt(disp, SIM_RENDER_TILES);
+
+  lv_display_set_user_data(disp, ctx);
+  lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_START, ctx);
+  lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_READY, ctx);
+  return disp;
+}
+
+void lvgl_display_set_flush_enabled(lv_display_t *disp, bool enabled) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  ctx->flush_disabled = !enabled;
+}
+
+void lvgl_display_set_flush_tap(lv_display_t *disp,
+                                lvgl_flush_tap_cb_t flush_cb,
+                                lvgl_scroll_tap_cb_t scroll_cb,
+                                void *user_data) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  ctx->flush_tap = flush_cb;
+  ctx->scroll_tap = scroll_cb;
+  ctx->tap_user_data = user_data;
+}
+
+/* The landscape panel scrolls along x, like the deck's in both landscape
+ * orientations
+ */
+esp_err_t lvgl_scroll_enable(lv_display_t *disp, int32_t start,
+                             int32_t length) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (ctx->width < ctx->height || start < 0 || length <= 0 ||
+      start + length > ctx->width) {
+    ESP_LOGE("SCROLL", "Region %ld+%ld not scrollable along x", (long)start,
+             (long)length);
+    return ESP_ERR_INVALID_ARG;
+  }
+  ctx->scroll_start = start;
+  ctx->scroll_length = length;
+  ctx->scroll_enabled = true;
+  return ESP_OK;
+}
+
+void lvgl_scroll_by(lv_display_t *disp, int32_t delta) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (!ctx->scroll_enabled || delta == 0)
+    return;
+
+  int32_t start = ctx->scroll_start;
+  int32_t length = ctx->scroll_length;
+  if (LV_ABS(delta) < length) {
+    int32_t kept = length - LV_ABS(delta);
+    for (int32_t y = 0; y < ctx->height; y++) {
+      uint16_t *row = ctx->fb + y * ctx->width + start;
+      if (delta > 0)
+        memmove(row, row + delta, kept * 2);
+      else
+        memmove(row - delta, row, kept * 2);
+    }
+    if (ctx->scroll_tap != NULL)
+      ctx->scroll_tap(disp, true, start, length, delta, ctx->tap_user_data);
+  }
+
+  // Only the band scrolled into view has to be rendered
+  int32_t band1 = delta > 0 ? start + length - delta : start;
+  int32_t band2 = delta > 0 ? start + length - 1 : start - delta - 1;
+  band1 = LV_MAX(band1, start);
+  band2 = LV_MIN(band2, start + length - 1);
+
+  lv_area_t band;
+  lv_area_set(&band, band1, 0, band2, ctx->height - 1);
+  lv_obj_invalidate_area(lv_display_get_layer_top(disp), &band);
+}
+
+bool lvgl_scroll_is_enabled(lv_display_t *disp, bool *along_x) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (along_x != NULL)
+    *along_x = true;
+  return ctx->scroll_enabled;
+}
+
+void lvgl_scroll_disable(lv_display_t *disp) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  if (!ctx->scroll_enabled)
+    return;
+  ctx->scroll_enabled = false;
+  lv_obj_invalidate(lv_display_get_screen_active(disp));
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void png_chunk(FILE *f, const char *type, const uint8_t *data,
+                      uint32_t len) {
+  uint8_t hdr[8];
+  put_be32(hdr, len);
+  memcpy(hdr + 4, type, 4);
+  uint32_t crc = esp_rom_crc32_le(0, hdr + 4, 4);
+  crc = esp_rom_crc32_le(crc, data, len);
+  uint8_t tail[4];
+  put_be32(tail, crc);
+  fwrite(hdr, 1, 8, f);
+  fwrite(data, 1, len, f);
+  fwrite(tail, 1, 4, f);
+}
+
+/* An uncompressed PNG: the rows (filter byte 0, RGB888) in stored deflate
+ * blocks, so no zlib is needed
+ */
+esp_err_t sim_display_save_png(lv_display_t *disp, const char *path) {
+  display_sim_ctx_t *ctx = lv_display_get_user_data(disp);
+  size_t row_len = 1 + (size_t)ctx->width * 3;
+  size_t raw_len = row_len * ctx->height;
+  size_t blocks = (raw_len + 0xFFFF - 1) / 0xFFFF;
+  size_t idat_len = 2 + raw_len + blocks * 5 + 4;
+  uint8_t *raw = malloc(raw_len);
+  uint8_t *idat = malloc(idat_len);
+  if (raw == NULL || idat == NULL) {
+    free(raw);
+    free(idat);
+    return ESP_ERR_NO_MEM;
+  }
+
+  for (int32_t y = 0; y < ctx->height; y++) {
+    uint8_t *out = raw + y * row_len;
+    *out++ = 0;
+    for (int32_t x = 0; x < ctx->width; x++) {
+      uint16_t v = ctx->fb[y * ctx->width + x];
+      *out++ = (v >> 8 & 0xF8) | v >> 13;
+      *out++ = (v >> 3 & 0xFC) | (v >> 9 & 0x03);
+      *out++ = (v << 3 & 0xF8) | (v >> 2 & 0x07);
+    }
+  }
+
+  uint8_t *p = idat;
+  *p++ = 0x78;
+  *p++ = 0x01;
+  uint32_t a = 1, b = 0;
+  for (size_t pos = 0; pos < raw_len;) {
+    uint16_t n = LV_MIN(raw_len - pos, 0xFFFF);
+    *p++ = pos + n == raw_len;
+    *p++ = n;
+    *p++ = n >> 8;
+    *p++ = ~n;
+    *p++ = (uint16_t)~n >> 8;
+    memcpy(p, raw + pos, n);
+    for (uint32_t i = 0; i < n; i++) {
+      a = (a + raw[pos + i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    p += n;
+    pos += n;
+  }
+  put_be32(p, b << 16 | a);
+
+  esp_err_t err = ESP_OK;
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    err = ESP_FAIL;
+  } else {
+    static const uint8_t signature[] = {0x89, 'P',  'N',  'G',
+                                        '\r', '\n', 0x1A, '\n'};
+    uint8_t ihdr[13] = {0};
+    put_be32(ihdr, ctx->width);
+    put_be32(ihdr + 4, ctx->height);
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = 2; // RGB
+    fwrite(signature, 1, sizeof(signature), f);
+    png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(f, "IDAT", idat, idat_len);
+    png_chunk(f, "IEND", NULL, 0);
+    if (fclose(f) != 0)
+      err = ESP_FAIL;
+  }
+  free(raw);
+  free(idat);
+  return err;
+}
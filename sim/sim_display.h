@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl_driver.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The simulator's lvgl_driver: lvgl_create_display renders into a frame
+ * buffer in memory that stands in for the panel's frame memory, hardware
+ * scrolling included, and lvgl_create_touch reads the touch set here. The
+ * panel and touch handles are ignored.
+ */
+
+/* Function to set the touch as the touch task samples it next, in screen
+ * coordinates
+ */
+void sim_touch_set(bool pressed, int32_t x, int32_t y);
+
+/* Function to write what the panel shows to an RGB PNG file. Call it with
+ * the LVGL lock held.
+ */
+esp_err_t sim_display_save_png(lv_display_t *disp, const char *path);
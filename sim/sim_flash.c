@@ -0,0 +1,167 @@
+#include "sim_flash.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FLASH_SECTOR 4096
+
+/* The data partitions of partitions.csv. Each is a file <label>.bin in the
+ * flash directory, created erased, or anonymous memory without one.
+ */
+typedef struct {
+  esp_partition_t part;
+  uint8_t *mem;
+} sim_partition_t;
+
+static sim_partition_t partitions[] = {
+    {.part = {.type = ESP_PARTITION_TYPE_DATA,
+              .subtype = ESP_PARTITION_SUBTYPE_DATA_NVS,
+              .address = 0x9000,
+              .size = 0x6000,
+              .label = "nvs"}},
+    {.part = {.type = ESP_PARTITION_TYPE_DATA,
+              .subtype = 0x40,
+              .address = 0x310000,
+              .size = 4 * 1024 * 1024,
+              .label = "assets"}},
+    {.part = {.type = ESP_PARTITION_TYPE_DATA,
+              .subtype = 0x41,
+              .address = 0x710000,
+              .size = 320 * 1024,
+              .label = "bootframe"}},
+    {.part = {.type = ESP_PARTITION_TYPE_DATA,
+              .subtype = 0x42,
+              .address = 0x760000,
+              .size = 128 * 1024,
+              .label = "profiles"}},
+};
+
+#define PARTITION_COUNT (sizeof(partitions) / sizeof(partitions[0]))
+
+static const char *flash_dir;
+
+void sim_flash_set_dir(const char *dir) { flash_dir = dir; }
+
+static uint8_t *partition_map_file(const esp_partition_t *part) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s.bin", flash_dir, part->label);
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    ESP_LOGE("FLASH", "%s: %s", path, strerror(errno));
+    return NULL;
+  }
+
+  struct stat st;
+  bool fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+  if (ftruncate(fd, part->size) != 0) {
+    ESP_LOGE("FLASH", "%s: %s", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  uint8_t *mem =
+      mmap(NULL, part->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED)
+    return NULL;
+  if (fresh)
+    memset(mem, 0xFF, part->size);
+  ESP_LOGI("FLASH", "Partition '%s' in %s", part->label, path);
+  return mem;
+}
+
+static sim_partition_t *partition_open(sim_partition_t *p) {
+  if (p->mem != NULL)
+    return p;
+  p->part.erase_size = FLASH_SECTOR;
+  if (flash_dir != NULL) {
+    p->mem = partition_map_file(&p->part);
+  } else {
+    p->mem = mmap(NULL, p->part.size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p->mem == MAP_FAILED)
+      p->mem = NULL;
+    else
+      memset(p->mem, 0xFF, p->part.size);
+  }
+  return p->mem != NULL ? p : NULL;
+}
+
+static sim_partition_t *partition_get(const esp_partition_t *part) {
+  return (sim_partition_t *)part;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  for (size_t i = 0; i < PARTITION_COUNT; i++) {
+    sim_partition_t *p = &partitions[i];
+    if (type != ESP_PARTITION_TYPE_ANY && p->part.type != type)
+      continue;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && p->part.subtype != subtype)
+      continue;
+    if (label != NULL && strcmp(p->part.label, label) != 0)
+      continue;
+    p = partition_open(p);
+    return p != NULL ? &p->part : NULL;
+  }
+  return NULL;
+}
+
+static bool range_valid(const esp_partition_t *part, size_t offset,
+                        size_t size) {
+  return offset <= part->size && size <= part->size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset,
+                             void *dst, size_t size) {
+  if (!range_valid(part, offset, size))
+    return ESP_ERR_INVALID_SIZE;
+  memcpy(dst, partition_get(part)->mem + offset, size);
+  return ESP_OK;
+}
+
+/* Programming can only clear bits, writing over unerased data shows up as
+ * corrupted content like on the device
+ */
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset,
+                              const void *src, size_t size) {
+  if (!range_valid(part, offset, size))
+    return ESP_ERR_INVALID_SIZE;
+  uint8_t *dst = partition_get(part)->mem + offset;
+  const uint8_t *s = src;
+  for (size_t i = 0; i < size; i++)
+    dst[i] &= s[i];
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part,
+                                    size_t offset, size_t size) {
+  if (offset % FLASH_SECTOR != 0 || size % FLASH_SECTOR != 0)
+    return ESP_ERR_INVALID_ARG;
+  if (!range_valid(part, offset, size))
+    return ESP_ERR_INVALID_SIZE;
+  memset(partition_get(part)->mem + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *part, size_t offset,
+                             size_t size,
+                             esp_partition_mmap_memory_t memory,
+                             const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+  if (!range_valid(part, offset, size))
+    return ESP_ERR_INVALID_ARG;
+  *out_ptr = partition_get(part)->mem + offset;
+  *out_handle = 0;
+  return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+  (void)handle;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+/* Function to keep the flash partitions in files, DIR/<label>.bin. Without
+ * a directory every run starts with erased partitions in memory. Must be
+ * called before the first partition is looked up.
+ */
+void sim_flash_set_dir(const char *dir);
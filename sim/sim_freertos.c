@@ -0,0 +1,225 @@
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* A task is a detached thread. Its notification value is the only state
+ * kept besides the core it was pinned to.
+ */
+struct sim_task {
+  TaskFunction_t fn;
+  void *arg;
+  int core;
+  char name[configMAX_TASK_NAME_LEN];
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t notify;
+};
+
+/* A mutex, binary or counting semaphore: a count up to max */
+struct sim_semaphore {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  UBaseType_t count;
+  UBaseType_t max;
+};
+
+static __thread struct sim_task *current_task;
+static pthread_mutex_t interrupts_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static struct timespec deadline_after(TickType_t ticks) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t ns = (uint64_t)ticks * (1000000000ULL / configTICK_RATE_HZ);
+  ts.tv_sec += ns / 1000000000ULL;
+  ts.tv_nsec += ns % 1000000000ULL;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  return ts;
+}
+
+/* Waits on cond until ready() or the timeout, lock held */
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock,
+                       TickType_t timeout, bool (*ready)(void *),
+                       void *arg) {
+  struct timespec deadline = deadline_after(timeout);
+  while (!ready(arg)) {
+    if (timeout == 0)
+      return false;
+    if (timeout == portMAX_DELAY) {
+      pthread_cond_wait(cond, lock);
+    } else if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+      return ready(arg);
+    }
+  }
+  return true;
+}
+
+static void *task_main(void *arg) {
+  struct sim_task *task = arg;
+  current_task = task;
+  pthread_setname_np(pthread_self(), task->name);
+  task->fn(task->arg);
+  return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stack_depth, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  struct sim_task *task = calloc(1, sizeof(*task));
+  if (task == NULL)
+    return pdFAIL;
+  task->fn = fn;
+  task->arg = arg;
+  task->core = core < 0 || core >= portNUM_PROCESSORS ? 0 : core;
+  strncpy(task->name, name, sizeof(task->name) - 1);
+  pthread_mutex_init(&task->lock, NULL);
+  pthread_cond_init(&task->cond, NULL);
+  if (handle != NULL)
+    *handle = task;
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int err = pthread_create(&thread, &attr, task_main, task);
+  pthread_attr_destroy(&attr);
+  if (err != 0) {
+    ESP_LOGE("SIM", "Task %s not started: %s", name, strerror(err));
+    if (handle != NULL)
+      *handle = NULL;
+    free(task);
+    return pdFAIL;
+  }
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task != NULL && task != current_task) {
+    ESP_LOGE("SIM", "vTaskDelete of another task is not supported");
+    return;
+  }
+  pthread_exit(NULL);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)(esp_timer_get_time() * configTICK_RATE_HZ / 1000000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  struct timespec ts = {
+      .tv_sec = ticks / configTICK_RATE_HZ,
+      .tv_nsec = (long)(ticks % configTICK_RATE_HZ) *
+                 (1000000000L / configTICK_RATE_HZ),
+  };
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    ;
+}
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t period) {
+  *prev_wake += period;
+  TickType_t now = xTaskGetTickCount();
+  if ((int32_t)(*prev_wake - now) > 0)
+    vTaskDelay(*prev_wake - now);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return current_task; }
+
+void xTaskNotifyGive(TaskHandle_t task) {
+  pthread_mutex_lock(&task->lock);
+  task->notify++;
+  pthread_cond_signal(&task->cond);
+  pthread_mutex_unlock(&task->lock);
+}
+
+static bool task_notified(void *arg) {
+  return ((struct sim_task *)arg)->notify != 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+  struct sim_task *task = current_task;
+  if (task == NULL) {
+    ESP_LOGE("SIM", "ulTaskNotifyTake outside a task");
+    abort();
+  }
+  pthread_mutex_lock(&task->lock);
+  uint32_t value = 0;
+  if (wait_until(&task->cond, &task->lock, timeout, task_notified, task)) {
+    value = task->notify;
+    task->notify = clear ? 0 : value - 1;
+  }
+  pthread_mutex_unlock(&task->lock);
+  return value;
+}
+
+static SemaphoreHandle_t semaphore_create(UBaseType_t max,
+                                          UBaseType_t initial) {
+  struct sim_semaphore *sem = calloc(1, sizeof(*sem));
+  if (sem == NULL)
+    return NULL;
+  pthread_mutex_init(&sem->lock, NULL);
+  pthread_cond_init(&sem->cond, NULL);
+  sem->max = max;
+  sem->count = initial;
+  return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return semaphore_create(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return semaphore_create(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max,
+                                           UBaseType_t initial) {
+  return semaphore_create(max, initial);
+}
+
+static bool semaphore_available(void *arg) {
+  return ((struct sim_semaphore *)arg)->count != 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t timeout) {
+  pthread_mutex_lock(&sem->lock);
+  bool taken =
+      wait_until(&sem->cond, &sem->lock, timeout, semaphore_available, sem);
+  if (taken)
+    sem->count--;
+  pthread_mutex_unlock(&sem->lock);
+  return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  pthread_mutex_lock(&sem->lock);
+  bool given = sem->count < sem->max;
+  if (given) {
+    sem->count++;
+    pthread_cond_signal(&sem->cond);
+  }
+  pthread_mutex_unlock(&sem->lock);
+  return given ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+  pthread_mutex_destroy(&sem->lock);
+  pthread_cond_destroy(&sem->cond);
+  free(sem);
+}
+
+void sim_interrupts_disable(void) { pthread_mutex_lock(&interrupts_lock); }
+
+void sim_interrupts_enable(void) { pthread_mutex_unlock(&interrupts_lock); }
+
+int esp_cpu_get_core_id(void) {
+  return current_task != NULL ? current_task->core : 0;
+}
@@ -0,0 +1,191 @@
+#include "deck_hid.h"
+#include "deck_hid_desc.h"
+#include "deck_latency.h"
+#include "deck_telemetry.h"
+#include "deck_touchrec.h"
+#include "deck_trace.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim_hid.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uhid.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* deck_hid on top of the kernel's uhid driver: the simulated deck shows up
+ * as a hidraw device with the firmware's VID/PID and report descriptor, so
+ * the host tools talk to it unchanged. The USB task reads the uhid events,
+ * reports are written as the device would send them.
+ */
+#define DECK_HID_TASK_CORE 0
+#define DECK_HID_TASK_PRIO 6
+#define UHID_PATH "/dev/uhid"
+
+typedef struct {
+  deck_hid_set_cb_t set_cb;
+  deck_hid_get_cb_t get_cb;
+} report_handler_t;
+
+static report_handler_t report_handlers[DECK_HID_REPORT_ID_MAX + 1];
+static int uhid_fd = -1;
+static portMUX_TYPE write_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool started;
+
+static bool uhid_write(const struct uhid_event *ev) {
+  portENTER_CRITICAL(&write_lock);
+  ssize_t n = write(uhid_fd, ev, sizeof(*ev));
+  portEXIT_CRITICAL(&write_lock);
+  if (n != sizeof(*ev)) {
+    ESP_LOGE("HID", "uhid write: %s", n < 0 ? strerror(errno) : "short");
+    return false;
+  }
+  return true;
+}
+
+/* Reports the host reads and writes start with their ID */
+static void handle_get_report(const struct uhid_get_report_req *req,
+                              struct uhid_event *reply) {
+  reply->type = UHID_GET_REPORT_REPLY;
+  reply->u.get_report_reply.id = req->id;
+  reply->u.get_report_reply.err = EIO;
+
+  uint8_t id = req->rnum;
+  if (id > DECK_HID_REPORT_ID_MAX || report_handlers[id].get_cb == NULL)
+    return;
+  uint8_t *data = reply->u.get_report_reply.data;
+  data[0] = id;
+  uint16_t len = report_handlers[id].get_cb(id, data + 1, 63);
+  reply->u.get_report_reply.size = 1 + len;
+  reply->u.get_report_reply.err = 0;
+}
+
+static void handle_set(uint8_t id, const uint8_t *data, uint16_t len) {
+  ESP_LOGD("HID", "SET_REPORT id=%d len=%d", id, len);
+  if (id <= DECK_HID_REPORT_ID_MAX && report_handlers[id].set_cb != NULL)
+    report_handlers[id].set_cb(id, data, len);
+}
+
+static void usb_task(void *arg) {
+  struct uhid_event ev;
+  struct uhid_event reply;
+  while (1) {
+    ssize_t n = read(uhid_fd, &ev, sizeof(ev));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      ESP_LOGE("HID", "uhid read: %s", n < 0 ? strerror(errno) : "closed");
+      started = false;
+      return;
+    }
+
+    memset(&reply, 0, sizeof(reply));
+    switch (ev.type) {
+    case UHID_START:
+      ESP_LOGI("USB", "Device attached");
+      started = true;
+      break;
+    case UHID_STOP:
+      ESP_LOGI("USB", "Device detached");
+      started = false;
+      break;
+    case UHID_OUTPUT:
+      if (ev.u.output.size > 0)
+        handle_set(ev.u.output.data[0], ev.u.output.data + 1,
+                   ev.u.output.size - 1);
+      break;
+    case UHID_GET_REPORT:
+      handle_get_report(&ev.u.get_report, &reply);
+      uhid_write(&reply);
+      break;
+    case UHID_SET_REPORT:
+      if (ev.u.set_report.size > 0)
+        handle_set(ev.u.set_report.rnum, ev.u.set_report.data + 1,
+                   ev.u.set_report.size - 1);
+      reply.type = UHID_SET_REPORT_REPLY;
+      reply.u.set_report_reply.id = ev.u.set_report.id;
+      reply.u.set_report_reply.err = 0;
+      uhid_write(&reply);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void sim_hid_set_report(uint8_t report_id, const uint8_t *data,
+                        uint16_t len) {
+  handle_set(report_id, data, len);
+}
+
+void deck_hid_init(void) {
+  uhid_fd = open(UHID_PATH, O_RDWR | O_CLOEXEC);
+  if (uhid_fd < 0) {
+    ESP_LOGW("HID", "%s: %s, running without a host", UHID_PATH,
+             strerror(errno));
+  } else {
+    struct uhid_event ev = {.type = UHID_CREATE2};
+    struct uhid_create2_req *req = &ev.u.create2;
+    snprintf((char *)req->name, sizeof(req->name), "ESP32 Stream Deck (sim)");
+    snprintf((char *)req->uniq, sizeof(req->uniq), "1234567890AB");
+    req->rd_size = sizeof(deck_hid_report_descriptor);
+    memcpy(req->rd_data, deck_hid_report_descriptor,
+           sizeof(deck_hid_report_descriptor));
+    req->bus = BUS_USB;
+    req->vendor = 0x303A;
+    req->product = 0x4001;
+    req->version = 0x0100;
+    if (!uhid_write(&ev)) {
+      close(uhid_fd);
+      uhid_fd = -1;
+    } else {
+      xTaskCreatePinnedToCore(usb_task, "usb", 4096, NULL, DECK_HID_TASK_PRIO,
+                              NULL, DECK_HID_TASK_CORE);
+      ESP_LOGI("HID", "HID device initialized");
+    }
+  }
+
+  deck_hid_register_report(DECK_TRACE_HID_REPORT, deck_trace_hid_set,
+                           deck_trace_hid_get);
+  deck_hid_register_report(DECK_LATENCY_HID_REPORT, deck_latency_hid_set,
+                           deck_latency_hid_get);
+  deck_hid_register_report(DECK_TELEMETRY_HID_REPORT, deck_telemetry_hid_set,
+                           deck_telemetry_hid_get);
+  deck_hid_register_report(DECK_TOUCHREC_HID_REPORT, deck_touchrec_hid_set,
+                           deck_touchrec_hid_get);
+}
+
+/* The write hands the report to the host right away, there is no endpoint
+ * busy with an earlier one to merge into
+ */
+void deck_hid_send_state(deck_input_report_t *report) {
+  if (!started) {
+    deck_trace(DECK_TRACE_HID_DROPPED, 1, deck_report_state(report));
+    deck_telemetry_hid(DECK_TELEMETRY_HID_DROPPED);
+    return;
+  }
+
+  struct uhid_event ev = {.type = UHID_INPUT2};
+  ev.u.input2.size = 1 + sizeof(*report);
+  ev.u.input2.data[0] = 1;
+  memcpy(ev.u.input2.data + 1, report, sizeof(*report));
+  deck_trace(DECK_TRACE_HID_ARMED, 1, deck_report_state(report));
+  if (!uhid_write(&ev)) {
+    deck_telemetry_hid(DECK_TELEMETRY_HID_DROPPED);
+    return;
+  }
+  deck_trace(DECK_TRACE_HID_SENT, 1, sizeof(*report));
+  deck_latency_hid_sent();
+  deck_telemetry_hid(DECK_TELEMETRY_HID_SENT);
+}
+
+void deck_hid_register_report(uint8_t report_id, deck_hid_set_cb_t set_cb,
+                              deck_hid_get_cb_t get_cb) {
+  if (report_id == 0 || report_id > DECK_HID_REPORT_ID_MAX) {
+    ESP_LOGE("HID", "Report ID %d out of range", report_id);
+    return;
+  }
+  report_handlers[report_id] = (report_handler_t){set_cb, get_cb};
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+/* Function to hand the deck an output report as if the host had sent it,
+ * without uhid. data excludes the report ID.
+ */
+void sim_hid_set_report(uint8_t report_id, const uint8_t *data, uint16_t len);
@@ -0,0 +1,335 @@
+/* Rokkit deck simulator: the firmware's UI, HID, trace and asset code on a
+ * Linux host.
+ *
+ *   deck_sim [--script FILE] [--flash DIR]
+ *
+ * Touch input and snapshots are driven by commands, one per line, read from
+ * the script or stdin:
+ *
+ *   down X Y     press at screen position X, Y
+ *   move X Y     move the pressed finger
+ *   up           release
+ *   tap X Y      press, hold for 100 ms and release
+ *   wait MS      let the deck run for MS milliseconds
+ *   page N       show page N, like a page button
+ *   profile NAME show the pages of a profile, - for the built-in ones
+ *   focus APP    announce the application in focus, like the host's
+ *                focus report
+ *   hud on|off   show or hide the performance HUD
+ *   report ID HEX
+ *                send output report ID with the bytes HEX (e.g. 01ff), as
+ *                the host would
+ *   live         print the live keys of the profile shown as JSON
+ *   png FILE     write the screen to an RGB PNG file
+ *   record FILE  write the touches recorded since start as a touch trace
+ *   replay FILE  replay a touch trace, recorded here or on the deck, and
+ *                print its frames, HID reports and latencies as JSON
+ *   quit         exit
+ *
+ * Lines starting with # are ignored. A script exits at its end, stdin keeps
+ * the deck running until interrupted so host tools can talk to it. With
+ * --flash the partitions are kept in DIR (see sim_flash.h): copy a container
+ * of tools/assets/build_assets.py to DIR/assets.bin to see its icons. The
+ * boot frame the deck would show at its next power-up is saved to
+ * DIR/bootframe.bin, the slider values, page and live widgets it restores
+ * to DIR/nvs.bin. Profiles are read from DIR/profiles.bin, built by
+ * tools/profiles/deck_profiles.py.
+ *
+ * A replay runs on LVGL's virtual clock (deck_touchrec.h): frames, reports
+ * and the ms fields come out the same on every replay of a trace, so a
+ * trace recorded in the field and its JSON make a regression test.
+ *
+ * The deck appears to the host as a HID device through /dev/uhid (needs
+ * access to it, e.g. root), so tools/trace and tools/live work with it as
+ * with the device. Without uhid it runs on its own.
+ */
+#include "deck_assets.h"
+#include "deck_gl.h"
+#include "deck_gl_priv.h"
+#include "deck_hid.h"
+#include "deck_pages.h"
+#include "deck_touchrec.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "nvs_flash.h"
+#include "sim_display.h"
+#include "sim_flash.h"
+#include "sim_hid.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LCD_HOR_RES 480
+#define LCD_VER_RES 320
+#define LVGL_TASK_CORE 1
+#define TAP_HOLD_MS 100
+#define REPLAY_MAX_EVENTS 1024
+// INVERTED_LANDSCAPE, as the deck sets its panel
+#define LCD_ORIENTATION 3
+
+static lv_display_t *disp;
+
+static uint32_t tick_get_cb(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void lvgl_timer_task(void *arg) {
+  ESP_LOGI("LVGL", "Timer task started");
+  while (1) {
+    lv_timer_handler();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+static void save_recording(const char *path) {
+  deck_touchrec_enable(false);
+  size_t len = deck_touchrec_copy(NULL);
+  uint8_t *trace = malloc(len);
+  deck_touchrec_copy(trace);
+  deck_touchrec_enable(true);
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL || fwrite(trace, 1, len, f) != len) {
+    ESP_LOGE("SIM", "Writing %s failed", path);
+  } else {
+    ESP_LOGI("SIM", "%u touch records written to %s",
+             (unsigned)((len - sizeof(deck_touchrec_header_t)) /
+                        sizeof(deck_touchrec_record_t)),
+             path);
+  }
+  if (f != NULL)
+    fclose(f);
+  free(trace);
+}
+
+/* Times that never came are null */
+static void print_ms(const char *name, uint32_t value) {
+  if (value == UINT32_MAX)
+    printf(", \"%s\": null", name);
+  else
+    printf(", \"%s\": %u", name, (unsigned)value);
+}
+
+static void replay_trace(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    ESP_LOGE("SIM", "Opening %s failed", path);
+    return;
+  }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  rewind(f);
+  uint8_t *trace = malloc(len > 0 ? len : 1);
+  size_t got = fread(trace, 1, len, f);
+  fclose(f);
+
+  static deck_touchrec_event_t events[REPLAY_MAX_EVENTS];
+  deck_touchrec_result_t r;
+  esp_err_t err =
+      deck_touchrec_replay(trace, got, events, REPLAY_MAX_EVENTS, &r);
+  free(trace);
+  if (err != ESP_OK) {
+    ESP_LOGE("SIM", "Replaying %s failed: %s", path, esp_err_to_name(err));
+    return;
+  }
+
+  printf("{\"trace\": \"%s\", \"duration_ms\": %u, \"wall_us\": %u, "
+         "\"frames\": %u, \"hid_reports\": %u, \"latency_mean_us\": %u, "
+         "\"latency_max_us\": %u,\n \"events\": [",
+         path, (unsigned)r.duration_ms, (unsigned)r.wall_us, r.frames,
+         r.hid_reports, (unsigned)r.latency_mean_us,
+         (unsigned)r.latency_max_us);
+  for (size_t i = 0; i < r.events && i < REPLAY_MAX_EVENTS; i++) {
+    const deck_touchrec_event_t *ev = &events[i];
+    printf("%s\n  {\"at_ms\": %u, \"pressed\": %s, \"x\": %d, \"y\": %d",
+           i > 0 ? "," : "", (unsigned)ev->at_ms,
+           ev->pressed ? "true" : "false", ev->x, ev->y);
+    print_ms("frame_ms", ev->frame_ms);
+    print_ms("frame_us", ev->frame_us);
+    printf(", \"hid_reports\": %u}", ev->hid_reports);
+  }
+  printf("]}\n");
+  fflush(stdout);
+}
+
+static bool send_report(int id, const char *hex) {
+  uint8_t data[63];
+  size_t len = 0;
+  unsigned byte;
+  // Two digits per byte, sscanf alone would take "0x" or a lone last digit
+  while (len < sizeof(data) && isxdigit((unsigned char)hex[0]) &&
+         isxdigit((unsigned char)hex[1]) && sscanf(hex, "%2x", &byte) == 1) {
+    data[len++] = byte;
+    hex += 2;
+  }
+  if (id <= 0 || id > 255 || len == 0 || *hex != '\0')
+    return false;
+  sim_hid_set_report(id, data, len);
+  return true;
+}
+
+static void print_live(void) {
+  static deck_persist_live_t keys[DECK_PERSIST_LIVE_MAX];
+  lv_lock();
+  const char *profile = deck_profile_active();
+  uint32_t n = deck_live_get_configs(keys);
+  lv_unlock();
+
+  if (profile != NULL)
+    printf("{\"profile\": \"%s\", \"live\": [", profile);
+  else
+    printf("{\"profile\": null, \"live\": [");
+  for (uint32_t i = 0; i < n; i++)
+    printf("%s{\"key\": %u, \"type\": %u}", i > 0 ? ", " : "", keys[i].key,
+           keys[i].cfg.type);
+  printf("]}\n");
+  fflush(stdout);
+}
+
+static bool run_command(char *line) {
+  char cmd[16] = "";
+  char arg[256] = "";
+  int x = 0, y = 0;
+  if (sscanf(line, "%15s", cmd) != 1 || cmd[0] == '#')
+    return true;
+
+  if (strcmp(cmd, "down") == 0 || strcmp(cmd, "move") == 0) {
+    if (sscanf(line, "%*s %d %d", &x, &y) != 2)
+      goto usage;
+    sim_touch_set(true, x, y);
+  } else if (strcmp(cmd, "up") == 0) {
+    sim_touch_set(false, 0, 0);
+  } else if (strcmp(cmd, "tap") == 0) {
+    if (sscanf(line, "%*s %d %d", &x, &y) != 2)
+      goto usage;
+    sim_touch_set(true, x, y);
+    vTaskDelay(pdMS_TO_TICKS(TAP_HOLD_MS));
+    sim_touch_set(false, 0, 0);
+  } else if (strcmp(cmd, "wait") == 0) {
+    if (sscanf(line, "%*s %d", &x) != 1 || x < 0)
+      goto usage;
+    vTaskDelay(pdMS_TO_TICKS(x));
+  } else if (strcmp(cmd, "page") == 0) {
+    if (sscanf(line, "%*s %d", &x) != 1 || x < 0)
+      goto usage;
+    lv_lock();
+    deck_show_page(x);
+    lv_unlock();
+  } else if (strcmp(cmd, "profile") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    lv_lock();
+    esp_err_t err = deck_profile_select(strcmp(arg, "-") ? arg : NULL);
+    lv_unlock();
+    if (err != ESP_OK)
+      ESP_LOGW("SIM", "Profile %s: %s", arg, esp_err_to_name(err));
+  } else if (strcmp(cmd, "focus") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    if (deck_profile_focus(arg) != ESP_OK)
+      ESP_LOGW("SIM", "No profile for %s", arg);
+  } else if (strcmp(cmd, "hud") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    lv_lock();
+    deck_hud_show(strcmp(arg, "on") == 0);
+    lv_unlock();
+  } else if (strcmp(cmd, "report") == 0) {
+    if (sscanf(line, "%*s %d %255s", &x, arg) != 2 || !send_report(x, arg))
+      goto usage;
+  } else if (strcmp(cmd, "live") == 0) {
+    print_live();
+  } else if (strcmp(cmd, "png") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    // Whatever is invalidated is drawn first, as the next frame would
+    lv_lock();
+    lv_refr_now(disp);
+    esp_err_t err = sim_display_save_png(disp, arg);
+    lv_unlock();
+    if (err != ESP_OK)
+      ESP_LOGE("SIM", "Writing %s failed: %s", arg, esp_err_to_name(err));
+    else
+      ESP_LOGI("SIM", "Screen written to %s", arg);
+  } else if (strcmp(cmd, "record") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    save_recording(arg);
+  } else if (strcmp(cmd, "replay") == 0) {
+    if (sscanf(line, "%*s %255s", arg) != 1)
+      goto usage;
+    replay_trace(arg);
+  } else if (strcmp(cmd, "quit") == 0) {
+    return false;
+  } else {
+    goto usage;
+  }
+  return true;
+
+usage:
+  ESP_LOGW("SIM", "Bad command: %s", line);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *script = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+      script = argv[++i];
+    } else if (strcmp(argv[i], "--flash") == 0 && i + 1 < argc) {
+      sim_flash_set_dir(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--script FILE] [--flash DIR]\n", argv[0]);
+      return 2;
+    }
+  }
+  FILE *in = script != NULL ? fopen(script, "r") : stdin;
+  if (in == NULL) {
+    perror(script);
+    return 1;
+  }
+
+  // The order of app_main, without the panel and touch controller
+  lv_init();
+  lv_tick_set_cb(tick_get_cb);
+  disp = lvgl_create_display(NULL, NULL, LCD_HOR_RES, LCD_VER_RES);
+  if (lvgl_scroll_enable(disp, 0, LCD_HOR_RES) != ESP_OK) {
+    ESP_LOGW("MAIN", "Hardware scrolling not available");
+  }
+  lv_indev_t *touch = lvgl_create_touch(NULL, LCD_HOR_RES, LCD_VER_RES);
+  deck_bootframe_init(disp, LCD_ORIENTATION);
+  deck_hid_init();
+  if (deck_assets_init() == ESP_OK) {
+    ESP_LOGI("MAIN", "Assets mapped");
+  }
+  nvs_flash_init();
+  deck_set_pages(deck_pages, DECK_PAGE_COUNT);
+  if (deck_profiles_init() == ESP_OK) {
+    ESP_LOGI("MAIN", "%u profiles mapped", (unsigned)deck_profile_count());
+  }
+  bool restored = deck_persist_init() == ESP_OK;
+  deck_create_ui();
+  deck_hud_attach_indev(touch);
+
+  if (!restored) {
+    update_slider_value(0, 30);
+    update_slider_value(1, 70);
+    update_slider_value(2, 90);
+  }
+
+  xTaskCreatePinnedToCore(lvgl_timer_task, "lvgl", 6144, NULL, 4, NULL,
+                          LVGL_TASK_CORE);
+  ESP_LOGI("MAIN", "Simulator running");
+
+  char line[512];
+  bool running = true;
+  while (running && fgets(line, sizeof(line), in) != NULL)
+    running = run_command(line);
+  while (running && script == NULL)
+    vTaskDelay(pdMS_TO_TICKS(1000));
+  return 0;
+}
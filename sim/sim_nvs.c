@@ -0,0 +1,190 @@
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "nvs_flash.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_NAME_MAX 16
+#define NVS_ENTRIES 32
+#define NVS_MAGIC 0x31564e53 // "SNV1"
+
+/* Blobs by namespace and key, kept in the nvs partition of sim_flash. Not
+ * the page format of ESP-IDF's NVS: the partition holds NVS_MAGIC and the
+ * entries one after the other, {namespace, key (NVS_NAME_MAX each), length
+ * (u32), data}, rewritten as a whole by nvs_commit.
+ */
+typedef struct {
+  char ns[NVS_NAME_MAX];
+  char key[NVS_NAME_MAX];
+  uint32_t len;
+} entry_header_t;
+
+typedef struct {
+  entry_header_t hdr;
+  uint8_t *data;
+} entry_t;
+
+static const esp_partition_t *part;
+static entry_t entries[NVS_ENTRIES];
+static int entry_count;
+static char namespaces[NVS_ENTRIES][NVS_NAME_MAX];
+static int namespace_count;
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void nvs_load(void) {
+  uint32_t magic;
+  size_t pos = sizeof(magic);
+  if (esp_partition_read(part, 0, &magic, sizeof(magic)) != ESP_OK ||
+      magic != NVS_MAGIC)
+    return;
+  while (entry_count < NVS_ENTRIES) {
+    entry_t *e = &entries[entry_count];
+    if (esp_partition_read(part, pos, &e->hdr, sizeof(e->hdr)) != ESP_OK ||
+        e->hdr.len == UINT32_MAX || e->hdr.len > part->size)
+      break;
+    pos += sizeof(e->hdr);
+    e->data = malloc(e->hdr.len ? e->hdr.len : 1);
+    if (esp_partition_read(part, pos, e->data, e->hdr.len) != ESP_OK) {
+      free(e->data);
+      break;
+    }
+    pos += e->hdr.len;
+    entry_count++;
+  }
+}
+
+esp_err_t nvs_flash_init(void) {
+  part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                  ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+  if (part == NULL)
+    return ESP_ERR_NOT_FOUND;
+  pthread_mutex_lock(&nvs_lock);
+  if (entry_count == 0)
+    nvs_load();
+  pthread_mutex_unlock(&nvs_lock);
+  return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+  if (part == NULL)
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  pthread_mutex_lock(&nvs_lock);
+  for (int i = 0; i < entry_count; i++)
+    free(entries[i].data);
+  entry_count = 0;
+  esp_err_t err = esp_partition_erase_range(part, 0, part->size);
+  pthread_mutex_unlock(&nvs_lock);
+  return err;
+}
+
+/* Handles are namespace indices plus one */
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode,
+                   nvs_handle_t *out_handle) {
+  if (part == NULL)
+    return ESP_ERR_NVS_NOT_INITIALIZED;
+  if (strlen(name) >= NVS_NAME_MAX)
+    return ESP_ERR_INVALID_ARG;
+  pthread_mutex_lock(&nvs_lock);
+  int i = 0;
+  while (i < namespace_count && strcmp(namespaces[i], name) != 0)
+    i++;
+  esp_err_t err = ESP_OK;
+  if (i == NVS_ENTRIES)
+    err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  else if (i == namespace_count)
+    strcpy(namespaces[namespace_count++], name);
+  pthread_mutex_unlock(&nvs_lock);
+  *out_handle = i + 1;
+  return err;
+}
+
+void nvs_close(nvs_handle_t handle) { (void)handle; }
+
+static entry_t *entry_find(nvs_handle_t handle, const char *key) {
+  if (handle == 0 || handle > (nvs_handle_t)namespace_count)
+    return NULL;
+  for (int i = 0; i < entry_count; i++) {
+    if (strcmp(entries[i].hdr.ns, namespaces[handle - 1]) == 0 &&
+        strcmp(entries[i].hdr.key, key) == 0)
+      return &entries[i];
+  }
+  return NULL;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value,
+                       size_t *length) {
+  pthread_mutex_lock(&nvs_lock);
+  entry_t *e = entry_find(handle, key);
+  esp_err_t err = ESP_OK;
+  if (e == NULL) {
+    err = ESP_ERR_NVS_NOT_FOUND;
+  } else if (out_value != NULL && *length < e->hdr.len) {
+    err = ESP_ERR_NVS_INVALID_LENGTH;
+  } else {
+    if (out_value != NULL)
+      memcpy(out_value, e->data, e->hdr.len);
+    *length = e->hdr.len;
+  }
+  pthread_mutex_unlock(&nvs_lock);
+  return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value,
+                       size_t length) {
+  if (handle == 0 || handle > (nvs_handle_t)namespace_count ||
+      strlen(key) >= NVS_NAME_MAX)
+    return ESP_ERR_INVALID_ARG;
+  pthread_mutex_lock(&nvs_lock);
+  entry_t *e = entry_find(handle, key);
+  esp_err_t err = ESP_OK;
+  if (e == NULL && entry_count == NVS_ENTRIES) {
+    err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  } else {
+    if (e == NULL) {
+      e = &entries[entry_count++];
+      memset(&e->hdr, 0, sizeof(e->hdr));
+      strcpy(e->hdr.ns, namespaces[handle - 1]);
+      strcpy(e->hdr.key, key);
+      e->data = NULL;
+    }
+    free(e->data);
+    e->data = malloc(length ? length : 1);
+    memcpy(e->data, value, length);
+    e->hdr.len = length;
+  }
+  pthread_mutex_unlock(&nvs_lock);
+  return err;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  (void)handle;
+  pthread_mutex_lock(&nvs_lock);
+  size_t size = sizeof(uint32_t);
+  for (int i = 0; i < entry_count; i++)
+    size += sizeof(entry_header_t) + entries[i].hdr.len;
+  esp_err_t err = ESP_OK;
+  if (size > part->size)
+    err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  if (err == ESP_OK)
+    err = esp_partition_erase_range(part, 0, part->size);
+
+  uint32_t magic = NVS_MAGIC;
+  size_t pos = 0;
+  if (err == ESP_OK)
+    err = esp_partition_write(part, pos, &magic, sizeof(magic));
+  pos += sizeof(magic);
+  for (int i = 0; i < entry_count && err == ESP_OK; i++) {
+    err = esp_partition_write(part, pos, &entries[i].hdr,
+                              sizeof(entries[i].hdr));
+    pos += sizeof(entries[i].hdr);
+    if (err == ESP_OK)
+      err = esp_partition_write(part, pos, entries[i].data,
+                                entries[i].hdr.len);
+    pos += entries[i].hdr.len;
+  }
+  pthread_mutex_unlock(&nvs_lock);
+  if (err != ESP_OK)
+    ESP_LOGE("NVS", "Commit failed: %s", esp_err_to_name(err));
+  return err;
+}
@@ -0,0 +1,26 @@
+# Runs a simulator script on fresh partitions with the example profiles and
+# compares what it prints to stdout with the expected output:
+#
+#   cmake -DSIM=deck_sim -DPYTHON=python3 -DPROFILES=deck_profiles.py
+#         -DJSON=example.json -DSCRIPT=test.txt -DEXPECTED=test.out
+#         -DWORK_DIR=dir -P run_script.cmake
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(
+  COMMAND ${PYTHON} ${PROFILES} build ${JSON} ${WORK_DIR}/profiles.bin
+  RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "Building the profiles failed: ${result}")
+endif()
+
+execute_process(
+  COMMAND ${SIM} --flash ${WORK_DIR} --script ${SCRIPT}
+  RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE log
+  TIMEOUT 60)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${SIM} failed: ${result}\n${log}")
+endif()
+file(READ ${EXPECTED} expected)
+if(NOT output STREQUAL expected)
+  message(FATAL_ERROR "Expected:\n${expected}Got:\n${output}")
+endif()
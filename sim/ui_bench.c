@@ -0,0 +1,312 @@
+/* Render benchmark of the deck's UI: deck_gl on the host with LVGL and the
+ * simulator's in-memory display, no panel, touch or USB.
+ *
+ *   deck_ui_bench [--rounds N] [--budgets FILE] [--budget NAME=MAX]...
+ *
+ * For a home page with 1, 2, 4 and 8 keys it measures
+ *
+ *   build_us     deck_create_ui, page build and screen load
+ *   objects      LVGL objects on the screen and layers afterwards
+ *   lv_bytes     LVGL heap in use afterwards, beyond what lv_init took
+ *   render_us    refresh of the whole invalidated screen
+ *   render_px    pixels flushed by it
+ *   label_us     refresh after update_button_text of the first key
+ *   color_us     refresh after update_button_color of the first key
+ *   slider_us    refresh after update_slider_value of the first slider
+ *
+ * and the pixels flushed by the updates as label_px, color_px, slider_px.
+ * Times are the median of the rounds in microseconds. Every key count runs
+ * in its own process, so the UI is built from scratch on a fresh LVGL.
+ *
+ * The results are printed as JSON to stdout. A budget is a maximum for one
+ * result, named "keys<N>.<result>" (e.g. keys8.lv_bytes); a budget file
+ * lists one per line as "NAME MAX", # starts a comment. The exit status is
+ * 1 when any result is over its budget. Counts of objects, bytes and pixels
+ * are the same on every run of a build, times only compare on one machine.
+ */
+#include "deck_gl.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include "sim_display.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define LCD_HOR_RES 480
+#define LCD_VER_RES 320
+#define DEFAULT_ROUNDS 32
+#define MAX_ROUNDS 1024
+#define MAX_BUDGETS 64
+
+static const uint32_t key_counts[] = {1, 2, 4, 8};
+#define CONFIG_COUNT (sizeof(key_counts) / sizeof(key_counts[0]))
+
+typedef struct {
+  bool done;
+  uint32_t build_us;
+  uint32_t objects;
+  uint32_t lv_bytes;
+  uint32_t render_us;
+  uint32_t render_px;
+  uint32_t label_us;
+  uint32_t label_px;
+  uint32_t color_us;
+  uint32_t color_px;
+  uint32_t slider_us;
+  uint32_t slider_px;
+} result_t;
+
+typedef struct {
+  char name[48];
+  uint32_t max;
+} budget_t;
+
+static budget_t budgets[MAX_BUDGETS];
+static int budget_count;
+static uint32_t flushed_px;
+
+static uint32_t tick_get_cb(void) {
+  return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void count_flush(lv_display_t *disp, const lv_area_t *area,
+                        const uint8_t *px_map, bool last, void *user_data) {
+  flushed_px += lv_area_get_size(area);
+}
+
+static uint32_t count_objects(lv_obj_t *obj) {
+  uint32_t n = 1;
+  for (uint32_t i = 0; i < lv_obj_get_child_count(obj); i++)
+    n += count_objects(lv_obj_get_child(obj, i));
+  return n;
+}
+
+static size_t lv_heap_used(void) {
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  return mon.total_size - mon.free_size;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t median(uint32_t *samples, int n) {
+  qsort(samples, n, sizeof(*samples), cmp_u32);
+  return samples[n / 2];
+}
+
+/* Refreshes whatever the update invalidated, round after round, and keeps
+ * the median time. Each round alternates between two values so there always
+ * is a change to draw.
+ */
+static void bench_update(lv_display_t *disp, int rounds,
+                         void (*update)(int round), uint32_t *us,
+                         uint32_t *px) {
+  uint32_t samples[MAX_ROUNDS];
+  for (int i = 0; i < rounds; i++) {
+    update(i);
+    flushed_px = 0;
+    int64_t start = esp_timer_get_time();
+    lv_refr_now(disp);
+    samples[i] = (uint32_t)(esp_timer_get_time() - start);
+  }
+  *us = median(samples, rounds);
+  *px = flushed_px;
+}
+
+static lv_display_t *bench_disp;
+
+static void update_full(int round) {
+  lv_obj_invalidate(lv_screen_active());
+}
+
+static void update_label(int round) {
+  update_button_text(0, round % 2 ? "Key 1" : "Key one");
+}
+
+static void update_color(int round) {
+  update_button_color(0, round % 2 ? lv_color_hex(0x2060ff)
+                                   : lv_color_hex(0xff2020));
+}
+
+static void update_slider(int round) {
+  update_slider_value(0, round % 2 ? 20 : 80);
+}
+
+static void run_config(uint32_t keys, int rounds, result_t *r) {
+  page_config_t page = {.name = "Bench", .parent = DECK_PAGE_ROOT};
+  static char labels[8][8];
+  for (uint32_t i = 0; i < keys; i++) {
+    snprintf(labels[i], sizeof(labels[i]), "Key %lu", (unsigned long)i + 1);
+    page.buttons[i] = (button_t){.id = i + 1,
+                                 .label = labels[i],
+                                 .bg_color = lv_color_hex(0xff0000),
+                                 .radius = 8};
+  }
+
+  lv_init();
+  lv_tick_set_cb(tick_get_cb);
+  bench_disp = lvgl_create_display(NULL, NULL, LCD_HOR_RES, LCD_VER_RES);
+  lvgl_display_set_flush_tap(bench_disp, count_flush, NULL, NULL);
+  lv_refr_now(bench_disp);
+  size_t heap_before = lv_heap_used();
+
+  int64_t start = esp_timer_get_time();
+  deck_set_pages(&page, 1);
+  deck_create_ui();
+  r->build_us = (uint32_t)(esp_timer_get_time() - start);
+  r->lv_bytes = lv_heap_used() - heap_before;
+  r->objects = count_objects(lv_screen_active()) +
+               count_objects(lv_layer_top()) + count_objects(lv_layer_sys());
+
+  bench_update(bench_disp, rounds, update_full, &r->render_us, &r->render_px);
+  bench_update(bench_disp, rounds, update_label, &r->label_us, &r->label_px);
+  bench_update(bench_disp, rounds, update_color, &r->color_us, &r->color_px);
+  bench_update(bench_disp, rounds, update_slider, &r->slider_us,
+               &r->slider_px);
+  r->done = true;
+}
+
+static bool add_budget(const char *name, const char *max) {
+  char *end;
+  unsigned long value = strtoul(max, &end, 10);
+  if (budget_count == MAX_BUDGETS || strlen(name) >= sizeof(budgets[0].name) ||
+      *max == '\0' || *end != '\0')
+    return false;
+  strcpy(budgets[budget_count].name, name);
+  budgets[budget_count].max = value;
+  budget_count++;
+  return true;
+}
+
+static bool load_budgets(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+  char line[128], name[64], max[32];
+  int lineno = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    char *hash = strchr(line, '#');
+    if (hash != NULL)
+      *hash = '\0';
+    int n = sscanf(line, "%63s %31s", name, max);
+    if (n <= 0)
+      continue;
+    if (n != 2 || !add_budget(name, max)) {
+      fprintf(stderr, "%s:%d: bad budget\n", path, lineno);
+      ok = false;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+/* Prints the results of one key count, checks them against the budgets and
+ * returns the number over budget
+ */
+static int print_result(uint32_t keys, const result_t *r, bool last) {
+  const struct {
+    const char *name;
+    uint32_t value;
+  } fields[] = {
+      {"build_us", r->build_us},   {"objects", r->objects},
+      {"lv_bytes", r->lv_bytes},   {"render_us", r->render_us},
+      {"render_px", r->render_px}, {"label_us", r->label_us},
+      {"label_px", r->label_px},   {"color_us", r->color_us},
+      {"color_px", r->color_px},   {"slider_us", r->slider_us},
+      {"slider_px", r->slider_px},
+  };
+  int over = 0;
+  printf("    {\"keys\": %lu", (unsigned long)keys);
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    printf(", \"%s\": %lu", fields[i].name, (unsigned long)fields[i].value);
+
+    char name[48];
+    snprintf(name, sizeof(name), "keys%lu.%s", (unsigned long)keys,
+             fields[i].name);
+    for (int b = 0; b < budget_count; b++) {
+      if (strcmp(budgets[b].name, name) == 0 &&
+          fields[i].value > budgets[b].max) {
+        fprintf(stderr, "%s: %lu over budget %lu\n", name,
+                (unsigned long)fields[i].value, (unsigned long)budgets[b].max);
+        over++;
+      }
+    }
+  }
+  printf("}%s\n", last ? "" : ",");
+  return over;
+}
+
+int main(int argc, char **argv) {
+  int rounds = DEFAULT_ROUNDS;
+  for (int i = 1; i < argc; i++) {
+    char *eq;
+    if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      rounds = atoi(argv[++i]);
+      if (rounds < 1 || rounds > MAX_ROUNDS)
+        goto usage;
+    } else if (strcmp(argv[i], "--budgets") == 0 && i + 1 < argc) {
+      if (!load_budgets(argv[++i]))
+        return 2;
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc &&
+               (eq = strchr(argv[++i], '=')) != NULL) {
+      *eq = '\0';
+      if (!add_budget(argv[i], eq + 1))
+        goto usage;
+    } else {
+      goto usage;
+    }
+  }
+
+  // deck_gl keeps its UI in globals and LVGL cannot be initialized twice,
+  // so each key count is built by a child writing to shared memory
+  result_t *results = mmap(NULL, sizeof(result_t) * CONFIG_COUNT,
+                           PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                           -1, 0);
+  if (results == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(results, 0, sizeof(result_t) * CONFIG_COUNT);
+
+  int over = 0;
+  printf("{\n  \"display\": [%d, %d],\n  \"rounds\": %d,\n  \"results\": [\n",
+         LCD_HOR_RES, LCD_VER_RES, rounds);
+  fflush(stdout);
+  for (size_t c = 0; c < CONFIG_COUNT; c++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pid == 0) {
+      run_config(key_counts[c], rounds, &results[c]);
+      _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!results[c].done) {
+      fprintf(stderr, "keys%lu: benchmark failed\n",
+              (unsigned long)key_counts[c]);
+      return 1;
+    }
+    over += print_result(key_counts[c], &results[c], c + 1 == CONFIG_COUNT);
+  }
+  printf("  ],\n  \"over_budget\": %d\n}\n", over);
+  return over > 0 ? 1 : 0;
+
+usage:
+  fprintf(stderr,
+          "usage: %s [--rounds N] [--budgets FILE] [--budget NAME=MAX]...\n",
+          argv[0]);
+  return 2;
+}
@@ -0,0 +1,357 @@
+#!/usr/bin/env python3
+"""Convert a directory of PNG/SVG icons into an asset container.
+
+  build_assets.py SRC_DIR OUT [--size 64] [--manifest OUT.json]
+
+Every icon is scaled to fit a size x size key cell and stored in the smallest
+LVGL format that still looks like the source (PSNR >= --min-psnr):
+
+  A8        single color icons, drawn in the color stored as the entry tint
+  I4 / I8   icons with few colors, palette + indices
+  RGB565 / ARGB8565, raw or compressed with RLE or LZ4
+
+GIFs become animations of full RGB565 frames for animated keys, each frame
+compressed with whatever of RLE and LZ4 is smallest. Fonts (.ttf/.otf/.font)
+and other files in SRC_DIR are packed unchanged.
+Besides the JSON manifest a "_manifest" blob is packed that tells the
+firmware how large the image cache must be to hold one page of decoded
+icons. Needs Pillow, cairosvg for SVG and lz4 for LZ4 compression.
+"""
+
+import argparse
+import io
+import json
+import math
+import os
+import struct
+import sys
+
+from PIL import Image
+
+import deck_assets
+
+try:
+    import lz4.block
+except ImportError:
+    lz4 = None
+
+# LVGL 9 color formats and image flags (lv_color.h, lv_image_dsc.h)
+CF_I4 = 0x09
+CF_I8 = 0x0A
+CF_A8 = 0x0E
+CF_RGB565 = 0x12
+CF_ARGB8565 = 0x13
+CF_NAMES = {CF_I4: "I4", CF_I8: "I8", CF_A8: "A8", CF_RGB565: "RGB565",
+            CF_ARGB8565: "ARGB8565"}
+FLAG_COMPRESSED = 0x0008
+COMPRESS_NONE = 0
+COMPRESS_RLE = 1
+COMPRESS_LZ4 = 2
+COMPRESS_NAMES = {COMPRESS_NONE: "", COMPRESS_RLE: "+RLE",
+                  COMPRESS_LZ4: "+LZ4"}
+
+# Keys on one page, the image cache holds the decoded icons of a full page
+KEYS_PER_PAGE = 8
+# Per entry overhead of LVGL's image cache (draw buffer and cache node)
+CACHE_ENTRY_OVERHEAD = 96
+
+MANIFEST_NAME = "_manifest"
+MANIFEST = struct.Struct("<IIHH")
+
+ICON_EXTS = (".png", ".svg")
+ANIM_EXTS = (".gif",)
+
+# Animation container (deck_assets.h)
+ANIM_MAGIC = 0x4E414B44  # "DKAN"
+ANIM_HEADER = struct.Struct("<IHHHH")
+ANIM_FRAME = struct.Struct("<IIHBB")
+# Shortest frame delay, the firmware swaps frames on a 5 ms timer
+ANIM_MIN_DELAY_MS = 20
+
+
+def load_icon(path, size):
+    """Load an icon scaled to fit a size x size cell, as RGBA."""
+    if path.lower().endswith(".svg"):
+        import cairosvg
+
+        png = cairosvg.svg2png(url=path, output_width=size * 2)
+        img = Image.open(io.BytesIO(png))
+    else:
+        img = Image.open(path)
+    img = img.convert("RGBA")
+    img.thumbnail((size, size), Image.LANCZOS)
+    return img
+
+
+def psnr(a, b):
+    """PSNR of two lists of premultiplied RGBA tuples."""
+    err = 0
+    for (r1, g1, b1, a1), (r2, g2, b2, a2) in zip(a, b):
+        err += ((r1 * a1 - r2 * a2) / 255) ** 2
+        err += ((g1 * a1 - g2 * a2) / 255) ** 2
+        err += ((b1 * a1 - b2 * a2) / 255) ** 2
+        err += (a1 - a2) ** 2
+    if err == 0:
+        return math.inf
+    return 10 * math.log10(255 ** 2 * 4 * len(a) / err)
+
+
+def image_header(cf, w, h, stride, flags=0):
+    return struct.pack("<BBHHHHH", 0x19, cf, flags, w, h, stride, 0)
+
+
+def rle_compress(data, blk, threshold=16):
+    """LVGL's RLE (lv_rle.c): a control byte with bit 7 set is followed by
+    that many literal pixels, otherwise by one pixel repeated that often."""
+    out = bytearray()
+    n = len(data) // blk
+    px = [bytes(data[i * blk:(i + 1) * blk]) for i in range(n)]
+    i = 0
+    while i < n:
+        run = 1
+        while i + run < n and run < 127 and px[i + run] == px[i]:
+            run += 1
+        if run >= threshold:
+            out.append(run)
+            out += px[i]
+            i += run
+            continue
+        # Literals until the next run worth encoding
+        j = i
+        while j < n and j - i < 127:
+            k = 1
+            while j + k < n and k <= threshold and px[j + k] == px[j]:
+                k += 1
+            if k > threshold:
+                break
+            j += 1
+        out.append(0x80 | (j - i))
+        for p in px[i:j]:
+            out += p
+        i = j
+    return bytes(out)
+
+
+def compress(data, method, blk):
+    if method == COMPRESS_RLE:
+        pad = -len(data) % blk
+        payload = rle_compress(data + b"\0" * pad, blk)
+    else:
+        payload = lz4.block.compress(bytes(data), store_size=False)
+    return struct.pack("<III", method, len(payload), len(data)) + payload
+
+
+def encode_a8(px, w, h):
+    alpha = bytes(a for _, _, _, a in px)
+    weight = sum(alpha) or 1
+    tint = tuple(round(sum(p[c] * p[3] for p in px) / weight)
+                 for c in range(3))
+    decoded = [tint + (a,) for a in alpha]
+    return CF_A8, w, alpha, tint, decoded
+
+
+def encode_indexed(img, w, h, colors):
+    q = img.quantize(colors, method=Image.Quantize.FASTOCTREE)
+    palette = q.getpalette("RGBA")[:colors * 4]
+    palette += [0] * (colors * 4 - len(palette))
+    entries = [tuple(palette[i:i + 4]) for i in range(0, len(palette), 4)]
+    indices = list(q.getdata())
+
+    data = bytearray()
+    for r, g, b, a in entries:
+        data += bytes((b, g, r, a))
+    if colors == 16:
+        stride = (w + 1) // 2
+        for y in range(h):
+            row = indices[y * w:(y + 1) * w] + [0]
+            data += bytes((row[x] << 4) | row[x + 1] for x in range(0, w, 2))
+        cf = CF_I4
+    else:
+        stride = w
+        data += bytes(indices)
+        cf = CF_I8
+    decoded = [entries[i] for i in indices]
+    return cf, stride, bytes(data), None, decoded
+
+
+def encode_rgb565(px, w, h, alpha):
+    data = bytearray()
+    decoded = []
+    for r, g, b, a in px:
+        if alpha and a == 0:
+            r = g = b = 0
+        v = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
+        data += struct.pack("<H", v)
+        if alpha:
+            data.append(a)
+        r5, g6, b5 = v >> 11, (v >> 5) & 0x3F, v & 0x1F
+        decoded.append(((r5 << 3) | (r5 >> 2), (g6 << 2) | (g6 >> 4),
+                        (b5 << 3) | (b5 >> 2), a if alpha else 255))
+    if alpha:
+        return CF_ARGB8565, w * 3, bytes(data), None, decoded
+    return CF_RGB565, w * 2, bytes(data), None, decoded
+
+
+def candidates(img):
+    """Yield (cf, stride, data, tint, decoded pixels, compression)."""
+    w, h = img.size
+    px = list(img.getdata())
+    alpha = any(a < 255 for _, _, _, a in px)
+
+    if alpha:
+        yield encode_a8(px, w, h) + (COMPRESS_NONE,)
+    for colors in (16, 256):
+        yield encode_indexed(img, w, h, colors) + (COMPRESS_NONE,)
+
+    cf, stride, data, tint, decoded = encode_rgb565(px, w, h, alpha)
+    yield cf, stride, data, tint, decoded, COMPRESS_NONE
+    yield cf, stride, data, tint, decoded, COMPRESS_RLE
+    if lz4 is not None:
+        yield cf, stride, data, tint, decoded, COMPRESS_LZ4
+
+
+def convert(path, size, min_psnr):
+    img = load_icon(path, size)
+    w, h = img.size
+    source = list(img.getdata())
+
+    best = None
+    for cf, stride, data, tint, decoded, method in candidates(img):
+        quality = psnr(source, decoded)
+        # RGB565 is the display format, it is always acceptable
+        if quality < min_psnr and cf not in (CF_RGB565, CF_ARGB8565):
+            continue
+        flags = 0
+        payload = data
+        if method != COMPRESS_NONE:
+            flags = FLAG_COMPRESSED
+            payload = compress(data, method, {CF_RGB565: 2}.get(cf, 3))
+        blob = image_header(cf, w, h, stride, flags) + payload
+        if best is None or len(blob) < len(best["blob"]):
+            # Images LVGL can't draw in place are decoded into the cache
+            direct = cf in (CF_A8, CF_RGB565, CF_ARGB8565) and not flags
+            best = {
+                "blob": blob,
+                "tint": tint,
+                "cf": CF_NAMES[cf] + COMPRESS_NAMES[method],
+                "w": w,
+                "h": h,
+                "bytes": len(blob),
+                "decoded_bytes": 0 if direct else (
+                    w * h * 4 if cf in (CF_I4, CF_I8) else len(data)),
+                "psnr": None if math.isinf(quality) else round(quality, 1),
+            }
+    return best
+
+
+def convert_anim(path, size):
+    """Convert a GIF into an animation container, frames composited onto
+    black and scaled like icons."""
+    from PIL import ImageSequence
+
+    src = Image.open(path)
+    frames = []
+    box = None
+    for frame in ImageSequence.Iterator(src):
+        rgba = frame.convert("RGBA")
+        if box is None:
+            scaled = rgba.copy()
+            scaled.thumbnail((size, size), Image.LANCZOS)
+            box = scaled.size
+        bg = Image.new("RGBA", rgba.size, (0, 0, 0, 255))
+        bg.alpha_composite(rgba)
+        img = bg.resize(box, Image.LANCZOS)
+        _, _, data, _, _ = encode_rgb565(list(img.getdata()), *box, False)
+        delay = max(frame.info.get("duration", 100), ANIM_MIN_DELAY_MS)
+        frames.append((data, delay))
+
+    w, h = box
+    table_end = ANIM_HEADER.size + ANIM_FRAME.size * len(frames)
+    table = b""
+    body = b""
+    for data, delay in frames:
+        best = (COMPRESS_NONE, data)
+        options = [COMPRESS_RLE] + ([COMPRESS_LZ4] if lz4 is not None else [])
+        for method in options:
+            # Only the payload, the frame table carries method and size
+            payload = compress(data, method, 2)[12:]
+            if len(payload) < len(best[1]):
+                best = (method, payload)
+        body += b"\0" * (-len(body) % 4)
+        table += ANIM_FRAME.pack(table_end + len(body), len(best[1]),
+                                 min(delay, 0xFFFF), best[0], 0)
+        body += best[1]
+
+    blob = ANIM_HEADER.pack(ANIM_MAGIC, w, h, len(frames), 0) + table + body
+    return {
+        "blob": blob,
+        "cf": "ANIM",
+        "w": w,
+        "h": h,
+        "frames": len(frames),
+        "bytes": len(blob),
+        "frame_bytes": w * h * 2,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("src")
+    parser.add_argument("out")
+    parser.add_argument("--size", type=int, default=64,
+                        help="key cell size in pixels (default 64)")
+    parser.add_argument("--min-psnr", type=float, default=36.0,
+                        help="quality an encoding must reach (default 36 dB)")
+    parser.add_argument("--manifest", help="JSON manifest to write")
+    args = parser.parse_args()
+
+    assets = []
+    manifest = []
+    for root, _, files in os.walk(args.src):
+        for f in sorted(files):
+            path = os.path.join(root, f)
+            name, ext = os.path.splitext(f)
+            if ext.lower() in ANIM_EXTS:
+                anim = convert_anim(path, args.size)
+                assets.append((name, deck_assets.TYPE_ANIM, anim.pop("blob")))
+                manifest.append(dict(name=name, source=f, **anim))
+            elif ext.lower() in ICON_EXTS:
+                icon = convert(path, args.size, args.min_psnr)
+                assets.append((name, deck_assets.TYPE_IMAGE, icon.pop("blob"),
+                               icon.pop("tint") or (0, 0, 0)))
+                manifest.append(dict(name=name, source=f, **icon))
+            else:
+                with open(path, "rb") as fp:
+                    data = fp.read()
+                assets.append((name, deck_assets.asset_type(path, data), data))
+                manifest.append(dict(name=name, source=f, bytes=len(data)))
+
+    decoded = sorted((m.get("decoded_bytes", 0) for m in manifest),
+                     reverse=True)
+    page = [d + CACHE_ENTRY_OVERHEAD for d in decoded[:KEYS_PER_PAGE] if d]
+    cache_bytes = sum(page)
+    icons = sum(1 for m in manifest if "cf" in m and "frames" not in m)
+    assets.append((MANIFEST_NAME, deck_assets.TYPE_BLOB,
+                   MANIFEST.pack(cache_bytes, decoded[0] if decoded else 0,
+                                 args.size, icons)))
+
+    container = deck_assets.pack(assets)
+    with open(args.out, "wb") as f:
+        f.write(container)
+
+    if args.manifest:
+        with open(args.manifest, "w") as f:
+            json.dump({"icon_size": args.size,
+                       "image_cache_bytes": cache_bytes,
+                       "container_bytes": len(container),
+                       "assets": manifest}, f, indent=2)
+
+    for m in manifest:
+        print("%-24s %-14s %7d bytes" % (m["name"], m.get("cf", ""),
+                                         m["bytes"]))
+    print("%s: %d assets, %d bytes, image cache %d bytes" %
+          (args.out, len(manifest), len(container), cache_bytes))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""Build and upload the deck's asset partition.
+
+The container format is described in components/deck_assets/deck_assets.h.
+
+  deck_assets.py pack OUT FILE...   build a container from asset files
+  deck_assets.py upload CONTAINER   write a container to the deck over USB
+  deck_assets.py list CONTAINER     print the index of a container
+
+Asset names are the file names without extension. LVGL binary images
+(.bin, e.g. from LVGLImage.py) become images, .ttf/.otf/.font files fonts,
+.anim files (from build_assets.py) animations, anything else a blob. A container can also be flashed directly:
+
+  parttool.py write_partition --partition-name assets --input OUT
+
+Icons are converted to LVGL images by build_assets.py, which the build runs
+on the project's assets directory.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x53414B44  # "DKAS"
+VERSION = 1
+NAME_MAX = 24
+ALIGN = 4
+
+HEADER = struct.Struct("<IHHII")
+ENTRY = struct.Struct("<%dsB3sII" % NAME_MAX)
+
+TYPE_IMAGE = 1
+TYPE_FONT = 2
+TYPE_BLOB = 3
+TYPE_ANIM = 4
+TYPE_NAMES = {TYPE_IMAGE: "image", TYPE_FONT: "font", TYPE_BLOB: "blob",
+              TYPE_ANIM: "anim"}
+FONT_EXTS = (".ttf", ".otf", ".font")
+
+LV_IMAGE_HEADER_MAGIC = 0x19
+ANIM_MAGIC = b"DKAN"
+
+USB_VID = 0x303A
+USB_PID = 0x4001
+HID_REPORT = 4
+HID_REPORT_LEN = 63
+OP_BEGIN = 1
+OP_DATA = 2
+OP_COMMIT = 3
+DATA_MAX = HID_REPORT_LEN - 6
+# ASSETS_QUEUE_LEN of deck_assets.c, operations the deck holds unapplied
+QUEUE_LEN = 32
+
+
+def asset_type(path, data):
+    ext = os.path.splitext(path)[1].lower()
+    if ext == ".bin":
+        if not data or data[0] != LV_IMAGE_HEADER_MAGIC:
+            sys.exit("%s: not an LVGL v9 binary image" % path)
+        return TYPE_IMAGE
+    if ext in FONT_EXTS:
+        return TYPE_FONT
+    if ext == ".anim":
+        if data[:4] != ANIM_MAGIC:
+            sys.exit("%s: not a deck animation" % path)
+        return TYPE_ANIM
+    return TYPE_BLOB
+
+
+def pack(assets):
+    """Build a container from (name, type, data[, tint]) tuples. tint is the
+    (r, g, b) color A8 images are drawn in."""
+    assets = sorted(assets, key=lambda a: a[0].encode())
+    names = [a[0] for a in assets]
+    if len(set(names)) != len(names):
+        sys.exit("duplicate asset names")
+
+    offset = HEADER.size + ENTRY.size * len(assets)
+    index = b""
+    body = b""
+    for asset in assets:
+        name, kind, data = asset[:3]
+        tint = bytes(asset[3]) if len(asset) > 3 else b"\0\0\0"
+        encoded = name.encode()
+        if len(encoded) > NAME_MAX:
+            sys.exit("asset name too long: %s" % name)
+        pad = -(offset + len(body)) % ALIGN
+        body += b"\0" * pad
+        index += ENTRY.pack(encoded, kind, tint, offset + len(body),
+                            len(data))
+        body += data
+
+    payload = index + body
+    header = HEADER.pack(MAGIC, VERSION, len(assets),
+                         HEADER.size + len(payload), zlib.crc32(payload))
+    return header + payload
+
+
+def parse(container):
+    magic, version, count, size, crc = HEADER.unpack_from(container)
+    if magic != MAGIC or version != VERSION:
+        sys.exit("not an asset container")
+    if zlib.crc32(container[HEADER.size:size]) != crc:
+        sys.exit("CRC mismatch")
+    for i in range(count):
+        raw, kind, _, offset, length = ENTRY.unpack_from(
+            container, HEADER.size + i * ENTRY.size)
+        yield raw.rstrip(b"\0").decode(), kind, offset, length
+
+
+def cmd_pack(args):
+    assets = []
+    for path in args.files:
+        with open(path, "rb") as f:
+            data = f.read()
+        name = os.path.splitext(os.path.basename(path))[0]
+        assets.append((name, asset_type(path, data), data))
+    container = pack(assets)
+    with open(args.out, "wb") as f:
+        f.write(container)
+    print("%s: %d assets, %d bytes" % (args.out, len(assets), len(container)))
+
+
+def cmd_list(args):
+    with open(args.container, "rb") as f:
+        container = f.read()
+    for name, kind, offset, length in parse(container):
+        print("%-24s %-5s %8d bytes @ 0x%06x" %
+              (name, TYPE_NAMES.get(kind, "?"), length, offset))
+
+
+class Deck:
+    def __init__(self):
+        import hid  # pip install hidapi
+
+        self.dev = hid.device()
+        self.dev.open(USB_VID, USB_PID)
+
+    def send(self, payload):
+        report = bytes([HID_REPORT]) + payload
+        report += b"\0" * (1 + HID_REPORT_LEN - len(report))
+        self.dev.send_feature_report(report)
+
+    def status(self):
+        r = bytes(self.dev.get_feature_report(HID_REPORT, 1 + HID_REPORT_LEN))
+        # Some platforms return the report ID in front
+        if len(r) > 14 and r[0] == HID_REPORT:
+            r = r[1:]
+        return struct.unpack_from("<BiIIB", r)
+
+    def wait(self, queued_max=0):
+        """Poll the status until at most queued_max operations are queued."""
+        while True:
+            status = self.status()
+            if status[4] <= queued_max:
+                return status
+            time.sleep(0.005)
+
+
+def cmd_upload(args):
+    with open(args.container, "rb") as f:
+        container = f.read()
+    list(parse(container))  # validate before touching the deck
+
+    deck = Deck()
+    _, _, _, part_size, _ = deck.status()
+    if len(container) > part_size:
+        sys.exit("container (%d bytes) larger than the partition (%d bytes)" %
+                 (len(container), part_size))
+
+    deck.send(struct.pack("<BI", OP_BEGIN, len(container)))
+    start = time.time()
+    offset = 0
+    sent = 0
+    while offset < len(container):
+        chunk = container[offset:offset + DATA_MAX]
+        deck.send(struct.pack("<BIB", OP_DATA, offset, len(chunk)) + chunk)
+        offset += len(chunk)
+        sent += 1
+        # The deck erases and writes behind, half its queue stays in flight
+        if sent % (QUEUE_LEN // 2) == 0 or offset == len(container):
+            done = offset == len(container)
+            _, err, written, _, _ = deck.wait(0 if done else QUEUE_LEN // 2)
+            if err != 0 or (done and written != offset):
+                sys.exit("write failed at %d: error 0x%x" % (written, err))
+            if offset % (64 * 1024) < (QUEUE_LEN // 2) * DATA_MAX or done:
+                print("\r%d / %d bytes" % (offset, len(container)), end="")
+    print()
+
+    deck.send(bytes([OP_COMMIT]))
+    _, err, _, _, _ = deck.wait()
+    if err != 0:
+        sys.exit("commit failed: error 0x%x" % err)
+    print("uploaded %d bytes in %.1f s" % (len(container), time.time() - start))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("pack", help="build a container")
+    p.add_argument("out")
+    p.add_argument("files", nargs="+")
+    p.set_defaults(func=cmd_pack)
+
+    p = sub.add_parser("list", help="print the index of a container")
+    p.add_argument("container")
+    p.set_defaults(func=cmd_list)
+
+    p = sub.add_parser("upload", help="write a container over USB")
+    p.add_argument("container")
+    p.set_defaults(func=cmd_upload)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Push live values to key widgets of the deck.
+
+The record format is described in components/deck_core/deck_live_proto.h.
+
+  deck_live.py config KEY TYPE [--min 0] [--max 100] [--digits 4]
+                               [--format int|duration|tenths]
+  deck_live.py value KEY VALUE
+  deck_live.py remove KEY
+  deck_live.py demo [--rate 20]
+
+KEY is page * 8 + button id - 1, TYPE one of readout, sparkline, meter. The
+demo shows the CPU load as sparkline, meter and readout plus an uptime
+counter on the keys of the home page, all updates of a tick in one report.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+USB_VID = 0x303A
+USB_PID = 0x4001
+HID_REPORT = 5
+HID_REPORT_LEN = 63
+
+OP_CONFIG = 1
+OP_VALUE = 2
+OP_SAMPLES = 3
+OP_REMOVE = 4
+
+TYPES = {"readout": 1, "sparkline": 2, "meter": 3}
+FORMATS = {"int": 0, "duration": 1, "tenths": 2}
+
+
+def config(key, kind, fmt="int", digits=4, lo=0, hi=100):
+    return struct.pack("<BBBBBhh", key, OP_CONFIG, TYPES[kind], FORMATS[fmt],
+                       digits, lo, hi)
+
+
+def value(key, v):
+    return struct.pack("<BBi", key, OP_VALUE, v)
+
+
+def samples(key, values):
+    return struct.pack("<BBB%dh" % len(values), key, OP_SAMPLES,
+                       len(values), *values)
+
+
+def remove(key):
+    return struct.pack("<BB", key, OP_REMOVE)
+
+
+class Deck:
+    def __init__(self):
+        import hid  # pip install hidapi
+
+        self.dev = hid.device()
+        self.dev.open(USB_VID, USB_PID)
+
+    def send(self, records):
+        """Send records, as few reports as they fit in."""
+        report = b""
+        for record in records:
+            if len(report) + len(record) > HID_REPORT_LEN:
+                self._send(report)
+                report = b""
+            report += record
+        if report:
+            self._send(report)
+
+    def _send(self, payload):
+        # Zero padding reads as an END record
+        report = bytes([HID_REPORT]) + payload
+        report += b"\0" * (1 + HID_REPORT_LEN - len(report))
+        self.dev.send_feature_report(report)
+
+
+def cpu_load():
+    """CPU load in percent since the previous call, from /proc/stat."""
+    with open("/proc/stat") as f:
+        fields = [int(x) for x in f.readline().split()[1:]]
+    idle, total = fields[3] + fields[4], sum(fields)
+    prev_idle, prev_total = getattr(cpu_load, "prev", (idle, total))
+    cpu_load.prev = (idle, total)
+    if total == prev_total:
+        return 0
+    return round(100 * (1 - (idle - prev_idle) / (total - prev_total)))
+
+
+def cmd_demo(args):
+    deck = Deck()
+    deck.send([config(0, "sparkline"), config(1, "meter"),
+               config(2, "readout", digits=3),
+               config(3, "readout", "duration", digits=7, hi=0)])
+    start = time.time()
+    while True:
+        load = cpu_load()
+        deck.send([value(0, load), value(1, load), value(2, load),
+                   value(3, int(time.time() - start))])
+        time.sleep(1 / args.rate)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("config", help="show a widget on a key")
+    p.add_argument("key", type=int)
+    p.add_argument("type", choices=TYPES)
+    p.add_argument("--min", type=int, default=0)
+    p.add_argument("--max", type=int, default=100)
+    p.add_argument("--digits", type=int, default=4)
+    p.add_argument("--format", choices=FORMATS, default="int")
+
+    p = sub.add_parser("value", help="set the value of a key")
+    p.add_argument("key", type=int)
+    p.add_argument("value", type=int)
+
+    p = sub.add_parser("remove", help="remove the widget of a key")
+    p.add_argument("key", type=int)
+
+    p = sub.add_parser("demo", help="show the CPU load on the home page")
+    p.add_argument("--rate", type=float, default=20, help="updates per second")
+
+    args = parser.parse_args()
+    if args.cmd == "demo":
+        if not os.path.exists("/proc/stat"):
+            sys.exit("the demo reads the CPU load from /proc/stat")
+        return cmd_demo(args)
+
+    deck = Deck()
+    if args.cmd == "config":
+        deck.send([config(args.key, args.type, args.format, args.digits,
+                          args.min, args.max)])
+    elif args.cmd == "value":
+        deck.send([value(args.key, args.value)])
+    else:
+        deck.send([remove(args.key)])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Mirror the deck's screen over its USB vendor interface.
+
+The record stream is described in components/deck_mirror/deck_mirror.h.
+
+  deck_mirror.py [--png mirror.png] [--record DIR] [--seconds N]
+
+The latest complete frame is written to the --png file, at most --fps times
+a second. With --record every frame is saved as a numbered PNG in DIR, e.g.
+for ffmpeg -framerate 30 -i DIR/%06d.png. Needs pyusb, lz4 for LZ4 tiles and
+Pillow to write PNGs.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+USB_VID = 0x303A
+USB_PID = 0x4001
+VENDOR_ITF = 1
+EP_OUT = 0x02
+EP_IN = 0x82
+
+MAGIC = 0x4D44
+RECORD = struct.Struct("<HBBHHHHI")
+
+CMD_STOP = 0
+CMD_START = 1
+CMD_REFRESH = 2
+
+HELLO = 1
+TILE = 2
+SCROLL = 3
+FRAME_END = 4
+
+RAW = 0
+RLE = 1
+LZ4 = 2
+
+
+def rle_decode(data, size):
+    """LVGL RLE with 2 byte blocks, see lv_rle_decompress."""
+    out = bytearray()
+    pos = 0
+    while pos < len(data) and len(out) < size:
+        ctrl = data[pos]
+        pos += 1
+        if ctrl & 0x80:
+            n = (ctrl & 0x7F) * 2
+            out += data[pos:pos + n]
+            pos += n
+        else:
+            out += data[pos:pos + 2] * ctrl
+            pos += 2
+    if len(out) != size:
+        raise ValueError("RLE tile decodes to %d bytes, %d expected" %
+                         (len(out), size))
+    return bytes(out)
+
+
+def decode_tile(method, payload, size):
+    if method == RAW:
+        return payload
+    if method == RLE:
+        return rle_decode(payload, size)
+    if method == LZ4:
+        import lz4.block  # pip install lz4
+        return lz4.block.decompress(payload, uncompressed_size=size)
+    raise ValueError("unknown tile encoding %d" % method)
+
+
+class Screen:
+    """The host's copy of the panel, RGB565 little endian."""
+
+    def __init__(self, w, h):
+        self.w = w
+        self.h = h
+        self.fb = bytearray(w * h * 2)
+
+    def put(self, x, y, w, h, pixels):
+        for row in range(h):
+            o = ((y + row) * self.w + x) * 2
+            self.fb[o:o + w * 2] = pixels[row * w * 2:(row + 1) * w * 2]
+
+    def scroll(self, along_x, start, length, delta):
+        """Shift the region's content by delta towards its start, like the
+        panel did. The band scrolled into view follows as tiles."""
+        if delta == 0 or abs(delta) >= length:
+            return
+        if along_x:
+            for row in range(self.h):
+                o = (row * self.w + start) * 2
+                line = self.fb[o:o + length * 2]
+                if delta > 0:
+                    line[:-delta * 2] = line[delta * 2:]
+                else:
+                    line[-delta * 2:] = line[:delta * 2]
+                self.fb[o:o + length * 2] = line
+        else:
+            stride = self.w * 2
+            o = start * stride
+            region = self.fb[o:o + length * stride]
+            if delta > 0:
+                region[:-delta * stride] = region[delta * stride:]
+            else:
+                region[-delta * stride:] = region[:delta * stride]
+            self.fb[o:o + length * stride] = region
+
+    def save(self, path):
+        from PIL import Image  # pip install Pillow
+
+        rgb = bytearray(self.w * self.h * 3)
+        px = memoryview(self.fb).cast("H")
+        for i, v in enumerate(px):
+            rgb[i * 3] = (v >> 8) & 0xF8 | v >> 13
+            rgb[i * 3 + 1] = (v >> 3) & 0xFC | (v >> 9) & 0x03
+            rgb[i * 3 + 2] = (v << 3) & 0xF8 | (v >> 2) & 0x07
+        tmp = path + ".tmp.png"
+        Image.frombytes("RGB", (self.w, self.h), bytes(rgb)).save(tmp)
+        os.replace(tmp, path)
+
+
+class Deck:
+    def __init__(self):
+        import usb.core  # pip install pyusb
+        import usb.util
+
+        self.usb = usb
+        self.dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+        if self.dev is None:
+            sys.exit("deck not found")
+        usb.util.claim_interface(self.dev, VENDOR_ITF)
+
+    def command(self, cmd):
+        self.dev.write(EP_OUT, bytes([cmd]))
+
+    def read(self, timeout_ms=100):
+        try:
+            return bytes(self.dev.read(EP_IN, 16384, timeout=timeout_ms))
+        except self.usb.core.USBTimeoutError:
+            return b""
+
+    def close(self):
+        self.command(CMD_STOP)
+        self.usb.util.release_interface(self.dev, VENDOR_ITF)
+
+
+def records(deck, deadline):
+    """Yield (header, payload) from the stream. Bytes up to the first HELLO
+    belong to an earlier session and are skipped."""
+    buf = bytearray()
+    synced = False
+    while deadline is None or time.time() < deadline:
+        buf += deck.read()
+        while len(buf) >= RECORD.size:
+            hdr = RECORD.unpack_from(buf)
+            if hdr[0] != MAGIC or not synced and hdr[1] != HELLO:
+                del buf[0]
+                continue
+            if len(buf) < RECORD.size + hdr[7]:
+                break
+            synced = True
+            payload = bytes(buf[RECORD.size:RECORD.size + hdr[7]])
+            del buf[:RECORD.size + hdr[7]]
+            yield hdr, payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--png", default="mirror.png",
+                        help="file the latest frame is written to")
+    parser.add_argument("--fps", type=float, default=2,
+                        help="how often the --png file is updated")
+    parser.add_argument("--record", metavar="DIR",
+                        help="save every frame as a numbered PNG")
+    parser.add_argument("--seconds", type=float,
+                        help="stop after this many seconds")
+    args = parser.parse_args()
+
+    if args.record:
+        os.makedirs(args.record, exist_ok=True)
+    deck = Deck()
+    deck.command(CMD_START)
+    start = time.time()
+    deadline = start + args.seconds if args.seconds else None
+
+    screen = None
+    frames = 0
+    saved = 0.0
+    wire = 0
+    raw = 0
+    try:
+        for hdr, payload in records(deck, deadline):
+            _, kind, method, x, y, w, h, length = hdr
+            wire += RECORD.size + length
+            if kind == HELLO:
+                screen = Screen(w, h)
+                print("mirroring %dx%d" % (w, h))
+            elif kind == TILE:
+                screen.put(x, y, w, h, decode_tile(method, payload, w * h * 2))
+                raw += w * h * 2
+            elif kind == SCROLL:
+                screen.scroll(method == 1, x, w, struct.unpack("<h",
+                              struct.pack("<H", y))[0])
+            elif kind == FRAME_END:
+                frames += 1
+                if args.record:
+                    screen.save(os.path.join(args.record, "%06d.png" % frames))
+                now = time.time()
+                if now - saved >= 1 / args.fps:
+                    screen.save(args.png)
+                    saved = now
+                    print("\r%d frames, %d KB of pixels in %d KB" %
+                          (frames, raw // 1024, wire // 1024), end="")
+    except KeyboardInterrupt:
+        pass
+    finally:
+        print()
+        deck.close()
+    if screen is not None:
+        screen.save(args.png)
+    print("%d frames in %.1f s" % (frames, time.time() - start))
+
+
+if __name__ == "__main__":
+    main()
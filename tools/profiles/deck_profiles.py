@@ -0,0 +1,386 @@
+#!/usr/bin/env python3
+"""Build and check the deck's profile partition, switch profiles from the host.
+
+The container format is described in components/deck_core/deck_profile.h.
+
+  deck_profiles.py build JSON OUT   build a container from a profile list
+  deck_profiles.py check CONTAINER  check a container as the firmware does
+  deck_profiles.py list CONTAINER   print the profiles and pages of a container
+  deck_profiles.py focus APP        tell the deck which application has focus
+
+The JSON holds a list of profiles, one per host application:
+
+  {"profiles": [
+    {"name": "OBS", "apps": ["obs64.exe", "obs"],
+     "pages": [
+       {"name": "Scenes", "sliders": ["Mic", "Desktop", "Music"],
+        "buttons": [
+          {"label": "Live", "color": "#ff0000", "icon": "live"},
+          {"label": "Audio", "page": "Audio"},
+          ...]},
+       {"name": "Audio", "buttons": [..., {"label": "Back", "back": true}]}
+     ]}
+  ]}
+
+Button i of a page (up to 8) has id i + 1 and reports it to the host unless
+it opens a page ("page": name or index) or goes back ("back": true).
+"color" is the background as lv_color_hex takes it, "radius" defaults to 8,
+"icon" and "anim" name assets of the asset partition. The first page of a
+profile is its root, the others open from it unless "parent" names another
+page or is null for another root. Slider names left out keep the default.
+A container can be flashed directly:
+
+  parttool.py write_partition --partition-name profiles --input OUT
+
+The build does that with the project's profiles.json.
+
+focus sends the focus output report: the deck selects the profile listing APP
+among its apps (ASCII case ignored) or called APP, and keeps the current one
+for an application without profile. A host agent watching the foreground
+window sends it on every focus change.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import zlib
+
+MAGIC = 0x46504B44  # "DKPF"
+VERSION = 1
+ALIGN = 4
+NAME_MAX = 31
+# DECK_PAGE_MAX and DECK_SLIDER_COUNT of deck_state.h
+PAGE_MAX = 16
+SLIDER_COUNT = 3
+BUTTON_COUNT = 8
+ROOT = 0xFF
+
+HEADER = struct.Struct("<IHHIIIHHII")
+ENTRY = struct.Struct("<IIHH")
+BUTTON = struct.Struct("<III3sBBB2x")
+PAGE = struct.Struct("<I%dIB3x" % SLIDER_COUNT)
+PAGE_SIZE = PAGE.size + BUTTON_COUNT * BUTTON.size
+
+ACTION_HID = 0
+ACTION_OPEN_PAGE = 1
+ACTION_BACK = 2
+ACTION_NAMES = {ACTION_HID: "hid", ACTION_OPEN_PAGE: "page",
+                ACTION_BACK: "back"}
+
+USB_VID = 0x303A
+USB_PID = 0x4001
+# DECK_FOCUS_HID_REPORT of deck_gl.h, 63 bytes of UTF-8, NUL padded
+FOCUS_REPORT = 11
+FOCUS_LEN = 63
+
+
+class StringPool:
+    """Strings referenced by their offset from the start of the container,
+    each stored once."""
+
+    def __init__(self):
+        self.data = bytearray(b"\0")  # offset 0 is no string
+        self.offsets = {}
+
+    def add(self, s):
+        if s is None:
+            return None
+        if s not in self.offsets:
+            self.offsets[s] = len(self.data)
+            self.data += s.encode() + b"\0"
+        return self.offsets[s]
+
+
+def fail(where, msg):
+    sys.exit("%s: %s" % (where, msg))
+
+
+def page_index(profile, pages, ref, where):
+    if isinstance(ref, int) and not isinstance(ref, bool):
+        if 0 <= ref < len(pages):
+            return ref
+    else:
+        for i, page in enumerate(pages):
+            if page.get("name") == ref:
+                return i
+    fail(where, "no page %r in profile %r" % (ref, profile["name"]))
+
+
+def parse_color(value, where):
+    if isinstance(value, str):
+        value = int(value.lstrip("#"), 16)
+    if not isinstance(value, int) or not 0 <= value <= 0xFFFFFF:
+        fail(where, "bad color %r" % (value,))
+    return bytes([value >> 16, (value >> 8) & 0xFF, value & 0xFF])
+
+
+def build(profiles):
+    """Build a container from the profile list of the JSON. Strings are
+    pool offsets relative to the pool until the layout is known."""
+    names = [p.get("name") for p in profiles]
+    if len(set(names)) != len(names):
+        sys.exit("duplicate profile names")
+    if len(profiles) > 0xFFFF:
+        sys.exit("too many profiles")
+
+    pool = StringPool()
+    entries = []
+    pages = []  # (name, slider names, parent, buttons) in pool offsets
+    for profile in profiles:
+        name = profile.get("name")
+        if not isinstance(name, str) or not name or \
+                len(name.encode()) > NAME_MAX:
+            sys.exit("profile name must have 1 to %d bytes: %r" %
+                     (NAME_MAX, name))
+        src = profile.get("pages", [])
+        if not 1 <= len(src) <= PAGE_MAX:
+            fail(name, "needs 1 to %d pages" % PAGE_MAX)
+        apps = profile.get("apps", [])
+        entries.append((pool.add(name),
+                        pool.add("\n".join(apps)) if apps else None,
+                        len(pages), len(src)))
+
+        for i, page in enumerate(src):
+            where = "%s/%s" % (name, page.get("name", i))
+            if "parent" in page:
+                parent = page["parent"]
+                parent = ROOT if parent is None else \
+                    page_index(profile, src, parent, where)
+            else:
+                parent = ROOT if i == 0 else 0
+            sliders = list(page.get("sliders", []))
+            if len(sliders) > SLIDER_COUNT:
+                fail(where, "at most %d sliders" % SLIDER_COUNT)
+            sliders += [None] * (SLIDER_COUNT - len(sliders))
+
+            buttons = []
+            if len(page.get("buttons", [])) > BUTTON_COUNT:
+                fail(where, "at most %d buttons" % BUTTON_COUNT)
+            for b in page.get("buttons", []):
+                action, target = ACTION_HID, 0
+                if "page" in b:
+                    action = ACTION_OPEN_PAGE
+                    target = page_index(profile, src, b["page"], where)
+                elif b.get("back"):
+                    action = ACTION_BACK
+                radius = b.get("radius", 8)
+                if not 0 <= radius <= 255:
+                    fail(where, "bad radius %r" % radius)
+                buttons.append((pool.add(b.get("label", "")),
+                                pool.add(b.get("icon")),
+                                pool.add(b.get("anim")),
+                                parse_color(b.get("color", 0x404040), where),
+                                action, target, radius))
+            pages.append((pool.add(page.get("name")),
+                          [pool.add(s) for s in sliders], parent, buttons))
+
+    pages_offset = HEADER.size + ENTRY.size * len(entries)
+    pages_offset += -pages_offset % ALIGN
+    strings = pages_offset + PAGE_SIZE * len(pages)
+
+    def ref(offset):
+        return 0 if offset is None else strings + offset
+
+    body = b"".join(ENTRY.pack(ref(n), ref(a), first, count)
+                    for n, a, first, count in entries)
+    body += b"\0" * (pages_offset - HEADER.size - len(body))
+    for name, sliders, parent, buttons in pages:
+        body += PAGE.pack(ref(name), *[ref(s) for s in sliders], parent)
+        for i in range(BUTTON_COUNT):
+            if i >= len(buttons):
+                body += BUTTON.pack(0, 0, 0, b"\0\0\0", 0, 0, 0)
+                continue
+            label, icon, anim, color, action, target, radius = buttons[i]
+            body += BUTTON.pack(ref(label), ref(icon), ref(anim), color,
+                                action, target, radius)
+    body += pool.data
+
+    header = HEADER.pack(MAGIC, VERSION, len(entries), HEADER.size + len(body),
+                         zlib.crc32(body), pages_offset, len(pages), 0,
+                         strings, len(pool.data))
+    return header + body
+
+
+def string(container, offset):
+    if offset == 0:
+        return None
+    return container[offset:container.index(b"\0", offset)].decode()
+
+
+def check(container):
+    """The checks of deck_profile_check and the CRC. Returns a list of
+    problems, empty for a container the firmware accepts."""
+    if len(container) < HEADER.size:
+        return ["shorter than the header"]
+    (magic, version, count, size, crc, pages_offset, page_count, _,
+     strings, strings_size) = HEADER.unpack_from(container)
+    if magic != MAGIC:
+        return ["not a profile container"]
+    if version != VERSION:
+        return ["version %d, the firmware reads %d" % (version, VERSION)]
+    if not HEADER.size <= size <= len(container):
+        return ["size %d, %d bytes present" % (size, len(container))]
+    if zlib.crc32(container[HEADER.size:size]) != crc:
+        return ["CRC mismatch"]
+
+    entries_end = HEADER.size + count * ENTRY.size
+    if entries_end > size or pages_offset < entries_end or \
+            pages_offset % ALIGN or \
+            pages_offset + page_count * PAGE_SIZE > size or \
+            strings < HEADER.size or strings + strings_size > size:
+        return ["tables out of bounds"]
+    if strings_size and container[strings + strings_size - 1] != 0:
+        return ["string pool not terminated"]
+
+    problems = []
+
+    def string_ok(offset, where):
+        if offset and not strings <= offset < strings + strings_size:
+            problems.append("%s: string 0x%x outside the pool" %
+                            (where, offset))
+            return False
+        return True
+
+    names = set()
+    for i in range(count):
+        name, apps, first, n = ENTRY.unpack_from(
+            container, HEADER.size + i * ENTRY.size)
+        where = "profile %d" % i
+        if not name or not string_ok(name, where) or \
+                not string_ok(apps, where):
+            problems.append("%s: bad name" % where)
+            continue
+        name = string(container, name)
+        if len(name.encode()) > NAME_MAX or name in names:
+            problems.append("%s: name %r too long or not unique" %
+                            (where, name))
+        names.add(name)
+        if not 1 <= n <= PAGE_MAX or first + n > page_count:
+            problems.append("%s: pages %d..%d out of range" %
+                            (name, first, first + n))
+            continue
+        for p in range(n):
+            at = pages_offset + (first + p) * PAGE_SIZE
+            fields = PAGE.unpack_from(container, at)
+            where = "%s/%d" % (name, p)
+            for offset in fields[:1 + SLIDER_COUNT]:
+                string_ok(offset, where)
+            parent = fields[-1]
+            if parent != ROOT and parent >= n:
+                problems.append("%s: parent %d out of range" % (where, parent))
+            for b in range(BUTTON_COUNT):
+                label, icon, anim, _, action, target, _ = BUTTON.unpack_from(
+                    container, at + PAGE.size + b * BUTTON.size)
+                for offset in (label, icon, anim):
+                    string_ok(offset, "%s button %d" % (where, b + 1))
+                if action not in ACTION_NAMES or \
+                        (action == ACTION_OPEN_PAGE and target >= n):
+                    problems.append("%s button %d: bad action %d/%d" %
+                                    (where, b + 1, action, target))
+    return problems
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def cmd_build(args):
+    with open(args.json) as f:
+        profiles = json.load(f).get("profiles", [])
+    container = build(profiles)
+    problems = check(container)
+    if problems:  # a bug here, build rejects what check does
+        sys.exit("\n".join(problems))
+    with open(args.out, "wb") as f:
+        f.write(container)
+    print("%s: %d profiles, %d pages, %d bytes" %
+          (args.out, len(profiles), sum(len(p["pages"]) for p in profiles),
+           len(container)))
+
+
+def cmd_check(args):
+    problems = check(read(args.container))
+    for problem in problems:
+        print(problem)
+    if problems:
+        sys.exit(1)
+    print("%s: ok" % args.container)
+
+
+def cmd_list(args):
+    container = read(args.container)
+    problems = check(container)
+    if problems:
+        sys.exit("\n".join(problems))
+    count = HEADER.unpack_from(container)[2]
+    pages_offset = HEADER.unpack_from(container)[5]
+    for i in range(count):
+        name, apps, first, n = ENTRY.unpack_from(
+            container, HEADER.size + i * ENTRY.size)
+        apps = string(container, apps)
+        print("%s%s" % (string(container, name),
+                        " (%s)" % apps.replace("\n", ", ") if apps else ""))
+        for p in range(n):
+            at = pages_offset + (first + p) * PAGE_SIZE
+            fields = PAGE.unpack_from(container, at)
+            parent = fields[-1]
+            keys = []
+            for b in range(BUTTON_COUNT):
+                label, icon, _, _, action, target, _ = BUTTON.unpack_from(
+                    container, at + PAGE.size + b * BUTTON.size)
+                key = string(container, label) or ""
+                if icon:
+                    key += "[%s]" % string(container, icon)
+                if action == ACTION_OPEN_PAGE:
+                    key += "->%d" % target
+                elif action == ACTION_BACK:
+                    key += "<-"
+                keys.append(key)
+            print("  %d %-12s %-6s %s" %
+                  (p, string(container, fields[0]) or "",
+                   "root" if parent == ROOT else "^%d" % parent,
+                   " | ".join(keys)))
+
+
+def cmd_focus(args):
+    import hid  # pip install hidapi
+
+    app = args.app.encode()
+    if len(app) > FOCUS_LEN:
+        sys.exit("application id longer than %d bytes" % FOCUS_LEN)
+    dev = hid.device()
+    dev.open(USB_VID, USB_PID)
+    # An output report, sent as SET_REPORT since the deck has no OUT endpoint
+    dev.write(bytes([FOCUS_REPORT]) + app.ljust(FOCUS_LEN, b"\0"))
+    dev.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("build", help="build a container from JSON")
+    p.add_argument("json")
+    p.add_argument("out")
+    p.set_defaults(func=cmd_build)
+
+    p = sub.add_parser("check", help="check a container")
+    p.add_argument("container")
+    p.set_defaults(func=cmd_check)
+
+    p = sub.add_parser("list", help="print the profiles of a container")
+    p.add_argument("container")
+    p.set_defaults(func=cmd_list)
+
+    p = sub.add_parser("focus", help="announce the application in focus")
+    p.add_argument("app", help="executable or bundle id, or a profile name")
+    p.set_defaults(func=cmd_focus)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,389 @@
+#!/usr/bin/env python3
+"""Read the deck's trace rings and turn them into a Chrome trace.
+
+The report format is described with DECK_TRACE_HID_REPORT in
+components/deck_trace/deck_trace.h.
+
+  deck_trace.py capture [--out trace.json] [--raw trace.bin]
+  deck_trace.py convert trace.bin [--out trace.json]
+  deck_trace.py latency start|stop|show
+  deck_trace.py telemetry [--watch SECONDS]
+  deck_trace.py hud on|off|toggle
+  deck_trace.py touch start|save FILE|replay|show FILE
+
+capture freezes the rings, reads them and resumes recording. Open the JSON
+in chrome://tracing or https://ui.perfetto.dev. Render spans sit on the core
+that rendered, panel transfers and HID reports on tracks of their own.
+
+latency starts the input latency measurement (components/deck_trace/
+deck_latency.h), which clears the histograms, stops it or prints p50, p99
+and max of every stage. Stages are timed from the touch sample that showed
+the edge.
+
+telemetry prints the health counters (components/deck_trace/
+deck_telemetry.h): frame rate, render and flush times, LVGL heap, touch rate,
+HID report counts and the per-task CPU load and stack headroom. Rates cover
+the time since the previous read, so --watch shows them per interval.
+
+hud shows or hides the performance overlay on the deck's screen (HUD in
+components/deck_gl/deck_gl.h), on builds that have it.
+
+touch works with the touch recording (components/deck_trace/
+deck_touchrec.h). start clears it, save stops it and writes it as a trace
+file, replay has the deck replay it and prints frames, HID reports and frame
+latency, show lists the records of a trace file. Replay a saved trace in the
+simulator (sim/) with its replay command.
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+
+USB_VID = 0x303A
+USB_PID = 0x4001
+HID_REPORT = 6
+HID_REPORT_LEN = 63
+LATENCY_REPORT = 7
+LATENCY_SUMMARY = struct.Struct("<HIII")
+LATENCY_STAGES = ("read", "handled", "photon", "host")
+TELEMETRY_REPORT = 8
+TELEMETRY_SUMMARY = struct.Struct("<BBHH6III2BIH3IB")
+TELEMETRY_TASKS = struct.Struct("<BBBB")
+TELEMETRY_TASK = struct.Struct("<10sHH")
+HUD_REPORT = 9
+HUD_ACTIONS = ("off", "on", "toggle")
+TOUCHREC_REPORT = 10
+TOUCHREC_HEADER = struct.Struct("<II")
+TOUCHREC_RECORD = struct.Struct("<HHH")
+TOUCHREC_RESULT = struct.Struct("<IIHHHII")
+TOUCHREC_MAGIC = 0x31525444
+TOUCHREC_PRESSED = 0x8000
+
+CMD_FREEZE = 1
+CMD_RESUME = 2
+
+RECORD = struct.Struct("<IHHI")
+# Raw file entries: core followed by the record
+RAW = struct.Struct("<BIHHI")
+
+TOUCH_SAMPLE = 1
+INPUT_READ = 2
+RENDER_START = 3
+RENDER_END = 4
+FLUSH_START = 5
+FLUSH_DONE = 6
+HID_ARMED = 7
+HID_SENT = 8
+HID_DROPPED = 9
+MARK = 10
+LATENCY = 11
+
+NAMES = {TOUCH_SAMPLE: "touch sample", INPUT_READ: "input read",
+         RENDER_START: "render", FLUSH_START: "flush", HID_ARMED: "hid report",
+         HID_DROPPED: "hid dropped", MARK: "mark"}
+
+TRACK_PANEL = 10
+TRACK_HID = 11
+
+
+class Deck:
+    def __init__(self, report=HID_REPORT):
+        import hid  # pip install hidapi
+
+        self.report = report
+        self.dev = hid.device()
+        self.dev.open(USB_VID, USB_PID)
+
+    def command(self, cmd):
+        report = bytes([self.report, cmd])
+        report += b"\0" * (1 + HID_REPORT_LEN - len(report))
+        self.dev.send_feature_report(report)
+
+    def get(self):
+        r = bytes(self.dev.get_feature_report(self.report, 1 + HID_REPORT_LEN))
+        # Some platforms return the report ID in front
+        if len(r) > HID_REPORT_LEN:
+            r = r[1:]
+        return r
+
+
+def capture(deck):
+    """Return [(core, ts, event, arg0, arg1)] with 64-bit timestamps."""
+    deck.command(CMD_FREEZE)
+    rings = {}
+    try:
+        while True:
+            r = deck.get()
+            core, n = r[0], r[1]
+            if core == 0xFF:
+                now = struct.unpack_from("<I", r, 3)[0]
+                break
+            for i in range(n):
+                rings.setdefault(core, []).append(
+                    RECORD.unpack_from(r, 3 + i * RECORD.size))
+    finally:
+        deck.command(CMD_RESUME)
+
+    # Timestamps are the low 32 bits of esp_timer; walk every ring back from
+    # the time of the dump so wraps are taken out
+    events = []
+    for core, records in rings.items():
+        epoch = 0
+        prev = now
+        for ts, event, arg0, arg1 in reversed(records):
+            if ts > prev:
+                epoch -= 1 << 32
+            prev = ts
+            events.append((core, epoch + ts, event, arg0, arg1))
+    events.sort(key=lambda e: e[1])
+    base = events[0][1] if events else 0
+    return [(c, ts - base, e, a0, a1) for c, ts, e, a0, a1 in events]
+
+
+def span(name, tid, start, end, args=None):
+    return {"name": name, "ph": "X", "pid": 0, "tid": tid, "ts": start,
+            "dur": max(end - start, 0), "args": args or {}}
+
+
+def chrome_trace(events):
+    out = []
+    for tid, name in ((0, "core 0"), (1, "core 1"), (TRACK_PANEL, "panel"),
+                      (TRACK_HID, "hid")):
+        out.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": tid,
+                    "args": {"name": name}})
+
+    render = {}
+    flushes = []
+    reports = []
+    for core, ts, event, arg0, arg1 in events:
+        if event in (TOUCH_SAMPLE, INPUT_READ):
+            out.append({"name": NAMES[event], "ph": "i", "s": "t", "pid": 0,
+                        "tid": core, "ts": ts,
+                        "args": {"pressed": arg0, "x": arg1 >> 16,
+                                 "y": arg1 & 0xFFFF}})
+        elif event == RENDER_START:
+            render[core] = ts
+        elif event == RENDER_END and core in render:
+            out.append(span("render", core, render.pop(core), ts))
+        elif event == FLUSH_START:
+            flushes.append((ts, arg0, arg1))
+        elif event == FLUSH_DONE and flushes:
+            # Buffers are released in the order they were flushed, the DMA
+            # completion may land on either core
+            start, last, size = flushes.pop(0)
+            out.append(span("flush", TRACK_PANEL, start, ts,
+                            {"w": size >> 16, "h": size & 0xFFFF,
+                             "last": last, "dma": arg0}))
+        elif event == HID_ARMED:
+            reports.append((ts, arg0, arg1))
+        elif event == HID_SENT and reports:
+            start, report_id, data = reports.pop(0)
+            out.append(span("report %d" % report_id, TRACK_HID, start, ts,
+                            {"data": "%08x" % data}))
+        elif event == LATENCY:
+            stage = LATENCY_STAGES[min(arg1 >> 24, len(LATENCY_STAGES) - 1)]
+            out.append({"name": "edge %d %s" % (arg0, stage), "ph": "i",
+                        "s": "g", "pid": 0, "tid": core, "ts": ts,
+                        "args": {"us": arg1 & 0xFFFFFF}})
+        elif event in (HID_DROPPED, MARK):
+            out.append({"name": NAMES[event], "ph": "i", "s": "t", "pid": 0,
+                        "tid": TRACK_HID if event == HID_DROPPED else core,
+                        "ts": ts, "args": {"arg0": arg0, "arg1": arg1}})
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def write_json(events, path):
+    with open(path, "w") as f:
+        json.dump(chrome_trace(events), f)
+    span_us = events[-1][1] - events[0][1] if events else 0
+    print("%s: %d events over %.1f ms" % (path, len(events), span_us / 1000))
+
+
+def cmd_capture(args):
+    events = capture(Deck())
+    if args.raw:
+        with open(args.raw, "wb") as f:
+            for e in events:
+                f.write(RAW.pack(e[0], e[1] & 0xFFFFFFFF, *e[2:]))
+    write_json(events, args.out)
+
+
+def cmd_convert(args):
+    with open(args.raw, "rb") as f:
+        data = f.read()
+    if len(data) % RAW.size:
+        sys.exit("%s: not a raw trace" % args.raw)
+    events = []
+    epoch = 0
+    prev = 0
+    for entry in RAW.iter_unpack(data):
+        # Raw files are sorted and relative to the first event
+        if entry[1] < prev:
+            epoch += 1 << 32
+        prev = entry[1]
+        events.append((entry[0], epoch + entry[1]) + entry[2:])
+    write_json(events, args.out)
+
+
+def cmd_latency(args):
+    deck = Deck(LATENCY_REPORT)
+    if args.action in ("start", "stop"):
+        deck.command(1 if args.action == "start" else 0)
+        return
+    r = deck.get()
+    print("measuring" if r[0] else "stopped")
+    print("%-8s %6s %9s %9s %9s" % ("stage", "edges", "p50 ms", "p99 ms",
+                                   "max ms"))
+    for i, name in enumerate(LATENCY_STAGES):
+        count, p50, p99, peak = LATENCY_SUMMARY.unpack_from(
+            r, 1 + i * LATENCY_SUMMARY.size)
+        print("%-8s %6d %9.2f %9.2f %9.2f" % (name, count, p50 / 1000,
+                                              p99 / 1000, peak / 1000))
+
+
+def telemetry(deck):
+    """Return the summary fields and [(name, cpu_permille, stack_free)]."""
+    deck.command(0)
+    r = deck.get()
+    summary = TELEMETRY_SUMMARY.unpack_from(r)
+    tasks = []
+    # The deck moves on to the next page after every read
+    while len(tasks) < summary[1]:
+        r = deck.get()
+        page, count, first, n = TELEMETRY_TASKS.unpack_from(r)
+        if page == 0 or first != len(tasks):
+            break
+        for i in range(n):
+            name, cpu, stack = TELEMETRY_TASK.unpack_from(
+                r, TELEMETRY_TASKS.size + i * TELEMETRY_TASK.size)
+            tasks.append((name.rstrip(b"\0").decode(errors="replace"), cpu,
+                          stack))
+    return summary, tasks
+
+
+def print_telemetry(summary, tasks):
+    (_, _, window, fps, r50, r99, rmax, f50, f99, fmax, heap_used,
+     heap_largest, used_pct, frag_pct, internal, touch_hz, sent, merged,
+     dropped, tasks_total) = summary
+    print("%.1f s: %.1f fps, touch %d Hz" % (window / 1000, fps / 10,
+                                            touch_hz))
+    print("  render p50 %.2f p99 %.2f max %.2f ms" % (r50 / 1000, r99 / 1000,
+                                                      rmax / 1000))
+    print("  flush  p50 %.2f p99 %.2f max %.2f ms" % (f50 / 1000, f99 / 1000,
+                                                      fmax / 1000))
+    print("  lvgl heap %d KB used (%d%%), largest free %d KB, %d%% "
+          "fragmented" % (heap_used // 1024, used_pct, heap_largest // 1024,
+                          frag_pct))
+    print("  internal RAM %d KB free" % (internal // 1024))
+    print("  hid %d sent, %d merged, %d dropped" % (sent, merged, dropped))
+    if tasks:
+        print("  %-10s %6s %8s" % ("task", "cpu", "stack"))
+    for name, cpu, stack in tasks:
+        load = "-" if cpu == 0xFFFF else "%.1f%%" % (cpu / 10)
+        print("  %-10s %6s %8d" % (name, load, stack))
+    if tasks_total > len(tasks):
+        print("  ... %d more tasks" % (tasks_total - len(tasks)))
+
+
+def cmd_telemetry(args):
+    deck = Deck(TELEMETRY_REPORT)
+    while True:
+        print_telemetry(*telemetry(deck))
+        if not args.watch:
+            break
+        time.sleep(args.watch)
+
+
+def cmd_hud(args):
+    deck = Deck(HUD_REPORT)
+    # An output report, sent as SET_REPORT since the deck has no OUT endpoint
+    deck.dev.write(bytes([HUD_REPORT, HUD_ACTIONS.index(args.action)]))
+
+
+def cmd_touch(args):
+    if args.action in ("save", "show") and not args.file:
+        sys.exit("%s needs a FILE" % args.action)
+    if args.action == "show":
+        with open(args.file, "rb") as f:
+            data = f.read()
+        magic, count = TOUCHREC_HEADER.unpack_from(data)
+        if magic != TOUCHREC_MAGIC:
+            sys.exit("%s: not a touch trace" % args.file)
+        t = 0
+        for i in range(count):
+            dt, x, y = TOUCHREC_RECORD.unpack_from(
+                data, TOUCHREC_HEADER.size + i * TOUCHREC_RECORD.size)
+            # The first gap is to a record before the trace
+            t += dt if i > 0 else 0
+            state = "down" if x & TOUCHREC_PRESSED else "up"
+            print("%8d ms %-4s %4d %4d" % (t, state, x & ~TOUCHREC_PRESSED, y))
+        return
+
+    deck = Deck(TOUCHREC_REPORT)
+    if args.action == "start":
+        deck.command(1)
+    elif args.action == "save":
+        deck.command(0)
+        data = b""
+        while True:
+            r = deck.get()
+            if r[0] == 0:
+                break
+            data += r[2:2 + r[0]]
+        with open(args.file, "wb") as f:
+            f.write(data)
+        count = TOUCHREC_HEADER.unpack_from(data)[1] if data else 0
+        print("%d records written to %s" % (count, args.file))
+    else:
+        deck.command(2)
+        while deck.get()[0]:
+            time.sleep(0.2)
+        (duration, wall, events, frames, reports, mean,
+         peak) = TOUCHREC_RESULT.unpack_from(deck.get(), 2)
+        print("%.2f s replayed in %.2f s: %d edges, %d frames, %d HID "
+              "reports" % (duration / 1000, wall / 1e6, events, frames,
+                           reports))
+        print("  frame latency mean %.2f max %.2f ms" % (mean / 1000,
+                                                         peak / 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("capture", help="read the rings over USB")
+    p.add_argument("--out", default="trace.json")
+    p.add_argument("--raw", help="also keep the records in a binary file")
+    p.set_defaults(func=cmd_capture)
+
+    p = sub.add_parser("convert", help="turn a raw file into a Chrome trace")
+    p.add_argument("raw")
+    p.add_argument("--out", default="trace.json")
+    p.set_defaults(func=cmd_convert)
+
+    p = sub.add_parser("latency", help="input latency histograms")
+    p.add_argument("action", choices=("start", "stop", "show"))
+    p.set_defaults(func=cmd_latency)
+
+    p = sub.add_parser("telemetry", help="health counters")
+    p.add_argument("--watch", type=float, metavar="SECONDS",
+                   help="keep reading at this interval")
+    p.set_defaults(func=cmd_telemetry)
+
+    p = sub.add_parser("hud", help="show or hide the on-screen HUD")
+    p.add_argument("action", choices=HUD_ACTIONS)
+    p.set_defaults(func=cmd_hud)
+
+    p = sub.add_parser("touch", help="record and replay touches")
+    p.add_argument("action", choices=("start", "save", "replay", "show"))
+    p.add_argument("file", nargs="?")
+    p.set_defaults(func=cmd_touch)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()